@@ -2,11 +2,20 @@
 #define IPC_TYPES_H
 
 #include "vector3f.h"		// vector3f_t
+#include "cyclestats.h"		// stCYCLESTATS_Summary_t
 
 #define LEN_PATTERN_MAX		( 16 )
 
-#define TOPIC_FLIGHT_DETAILS	( 0 )
-#define TOPIC_LED_PATTERN		( 1 )
+// The flight task's stages, in the order they run within a tick
+typedef enum
+{
+	FLIGHT_STAGE_RATE,			// Gyro, rate PIDs and the motors
+	FLIGHT_STAGE_ANGLE,			// Accel, sensor fusion and the angle PIDs
+	FLIGHT_STAGE_TELEMETRY,		// This message
+	FLIGHT_STAGE_SLOW,			// Temperature, mag and parameters
+	FLIGHT_STAGE_NUM
+
+} eFLIGHT_Stage_t;
 
 typedef struct
 {
@@ -16,9 +25,24 @@ typedef struct
 	uint16_t uiAccelSampleCount;
 	uint16_t uiGyroSampleCount;
 	uint16_t uiFlightTaskMissed;
+	uint16_t uiI2CErrorCount;
+	uint32_t uiFusionCycles;		// The last sensor fusion update
+	uint16_t auiStageOverrunCount[ FLIGHT_STAGE_NUM ];	// Runs over their budget
 
 } stFlightDetails_t;
 
+// Where the flight task's time went over the last window, in CYCLES_Now
+// counts. Windows are back to back, so summing them covers every tick.
+typedef struct
+{
+	uint16_t uiWindow;				// Counts up each window
+	uint16_t uiCyclesPerUs;			// To turn the counts into time
+	stCYCLESTATS_Summary_t astStage[ FLIGHT_STAGE_NUM ];	// Each stage's runs
+	stCYCLESTATS_Summary_t stSensorRead;	// Watermark to the I2C read done
+	stCYCLESTATS_Summary_t stFusion;		// Sensor fusion, within the angle stage
+
+} stFlightTiming_t;
+
 typedef struct
 {
 	uint16_t auiPattern[ LEN_PATTERN_MAX ];
@@ -26,4 +50,29 @@ typedef struct
 
 } stLedPattern_t;
 
+// Every pubsub topic, the message type it carries and how it is delivered,
+// declared once here. PUBSUB_Publish and PUBSUB_Subscribe check message sizes
+// against this list at compile time.
+//   QUEUE	- every message is queued to each subscriber.
+//   LATEST	- state that consumers only sample, the newest message is also kept
+//			  in a mailbox read with PUBSUB_ReadLatest. Queued subscribers are
+//			  still allowed but shouldn't be needed. One publisher only.
+#define IPC_TOPICS( X ) \
+	X( TOPIC_FLIGHT_DETAILS,	stFlightDetails_t,	LATEST ) \
+	X( TOPIC_FLIGHT_TIMING,		stFlightTiming_t,	LATEST ) \
+	X( TOPIC_LED_PATTERN,		stLedPattern_t,		QUEUE ) \
+
+#define mIPC_TOPIC_ID( eTopic, tMsg, eKind )		eTopic,
+#define mIPC_TOPIC_TYPE( eTopic, tMsg, eKind )		typedef tMsg eTopic##_t;
+
+typedef enum
+{
+	IPC_TOPICS( mIPC_TOPIC_ID )
+	TOPIC_NUM
+
+} eIPC_Topic_t;
+
+// TOPIC_FLIGHT_DETAILS_t etc, the message type of each topic
+IPC_TOPICS( mIPC_TOPIC_TYPE )
+
 #endif
@@ -17,40 +17,51 @@
 
 #include "MadgwickAHRS.h"
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
 
 //---------------------------------------------------------------------------------------------------
 // Definitions
 
-#define sampleFreq	50.0f		// sample frequency in Hz
 #define betaDef		0.1f		// 2 * proportional gain
 
-//---------------------------------------------------------------------------------------------------
-// Variable definitions
-
-volatile float beta = betaDef;								// 2 * proportional gain (Kp)
-volatile float q0 = 1.0f, q1 = 0.0f, q2 = 0.0f, q3 = 0.0f;	// quaternion of sensor frame relative to auxiliary frame
-
 //---------------------------------------------------------------------------------------------------
 // Function declarations
 
 float invSqrt(float x);
+static int imuFeedback(float q0, float q1, float q2, float q3, float ax, float ay, float az, float s[4]);
 
 //====================================================================================================
 // Functions
 
+//---------------------------------------------------------------------------------------------------
+// Filter set up, level with the default gain
+
+void MadgwickSetup(stMADGWICK_Cxt_t *pstCxt) {
+	pstCxt->beta = betaDef;
+	pstCxt->q0 = 1.0f;
+	pstCxt->q1 = 0.0f;
+	pstCxt->q2 = 0.0f;
+	pstCxt->q3 = 0.0f;
+}
+
 //---------------------------------------------------------------------------------------------------
 // AHRS algorithm update
 
-void MadgwickAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz) {
+void MadgwickAHRSupdate(stMADGWICK_Cxt_t *pstCxt, float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt) {
 	float recipNorm;
 	float s0, s1, s2, s3;
 	float qDot1, qDot2, qDot3, qDot4;
 	float hx, hy;
 	float _2q0mx, _2q0my, _2q0mz, _2q1mx, _2bx, _2bz, _4bx, _4bz, _2q0, _2q1, _2q2, _2q3, _2q0q2, _2q2q3, q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;
 
+	// Work on copies, written back once at the end
+	const float beta = pstCxt->beta;
+	float q0 = pstCxt->q0, q1 = pstCxt->q1, q2 = pstCxt->q2, q3 = pstCxt->q3;
+
 	// Use IMU algorithm if magnetometer measurement invalid (avoids NaN in magnetometer normalisation)
 	if((mx == 0.0f) && (my == 0.0f) && (mz == 0.0f)) {
-		MadgwickAHRSupdateIMU(gx, gy, gz, ax, ay, az);
+		MadgwickAHRSupdateIMU(pstCxt, gx, gy, gz, ax, ay, az, dt);
 		return;
 	}
 
@@ -124,10 +135,10 @@ void MadgwickAHRSupdate(float gx, float gy, float gz, float ax, float ay, float
 	}
 
 	// Integrate rate of change of quaternion to yield quaternion
-	q0 += qDot1 * (1.0f / sampleFreq);
-	q1 += qDot2 * (1.0f / sampleFreq);
-	q2 += qDot3 * (1.0f / sampleFreq);
-	q3 += qDot4 * (1.0f / sampleFreq);
+	q0 += qDot1 * dt;
+	q1 += qDot2 * dt;
+	q2 += qDot3 * dt;
+	q3 += qDot4 * dt;
 
 	// Normalise quaternion
 	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
@@ -135,178 +146,157 @@ void MadgwickAHRSupdate(float gx, float gy, float gz, float ax, float ay, float
 	q1 *= recipNorm;
 	q2 *= recipNorm;
 	q3 *= recipNorm;
-}
 
-#if 1
-
-// Implementation of Sebastian Madgwick's "...efficient orientation filter for... inertial/magnetic sensor arrays"
-// (see http://www.x-io.co.uk/category/open-source/ for examples and more details)
-// which fuses acceleration, rotation rate, and magnetic moments to produce a quaternion-based estimate of absolute
-// device orientation -- which can be converted to yaw, pitch, and roll. Useful for stabilizing quadcopters, etc.
-// The performance of the orientation filter is at least as good as conventional Kalman-based filtering algorithms
-// but is much less computationally intensive---it can be performed on a 3.3 V Pro Mini operating at 8 MHz!
-        void MadgwickQuaternionUpdate(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz)
-        {
-            float norm;
-            float hx, hy, _2bx, _2bz;
-            float s1, s2, s3, s4;
-            float qDot1, qDot2, qDot3, qDot4;
-
-            // Auxiliary variables to avoid repeated arithmetic
-            float _2q1mx;
-            float _2q1my;
-            float _2q1mz;
-            float _2q2mx;
-            float _4bx;
-            float _4bz;
-            float _2q1 = 2.0f * q1;
-            float _2q2 = 2.0f * q1;
-            float _2q3 = 2.0f * q2;
-            float _2q4 = 2.0f * q3;
-            float _2q1q3 = 2.0f * q1 * q2;
-            float _2q3q4 = 2.0f * q2 * q3;
-            float q1q1 = q0 * q0;
-            float q1q2 = q0 * q1;
-            float q1q3 = q0 * q2;
-            float q1q4 = q0 * q3;
-            float q2q2 = q1 * q1;
-            float q2q3 = q1 * q2;
-            float q2q4 = q1 * q3;
-            float q3q3 = q2 * q2;
-            float q3q4 = q2 * q3;
-            float q4q4 = q3 * q3;
-
-            // Normalise accelerometer measurement
-            norm = sqrt(ax * ax + ay * ay + az * az);
-            if (norm == 0.0f) return; // handle NaN
-            norm = 1.0f/norm;
-            ax *= norm;
-            ay *= norm;
-            az *= norm;
-
-            // Normalise magnetometer measurement
-            norm = sqrt(mx * mx + my * my + mz * mz);
-            if (norm == 0.0f) return; // handle NaN
-            norm = 1.0f/norm;
-            mx *= norm;
-            my *= norm;
-            mz *= norm;
-
-            // Reference direction of Earth's magnetic field
-            _2q1mx = 2.0f * q0 * mx;
-            _2q1my = 2.0f * q0 * my;
-            _2q1mz = 2.0f * q0 * mz;
-            _2q2mx = 2.0f * q1 * mx;
-            hx = mx * q1q1 - _2q1my * q3 + _2q1mz * q2 + mx * q2q2 + _2q2 * my * q2 + _2q2 * mz * q3 - mx * q3q3 - mx * q4q4;
-            hy = _2q1mx * q3 + my * q1q1 - _2q1mz * q1 + _2q2mx * q2 - my * q2q2 + my * q3q3 + _2q3 * mz * q3 - my * q4q4;
-            _2bx = sqrt(hx * hx + hy * hy);
-            _2bz = -_2q1mx * q2 + _2q1my * q1 + mz * q1q1 + _2q2mx * q3 - mz * q2q2 + _2q3 * my * q3 - mz * q3q3 + mz * q4q4;
-            _4bx = 2.0f * _2bx;
-            _4bz = 2.0f * _2bz;
-
-            // Gradient decent algorithm corrective step
-            s1 = -_2q3 * (2.0f * q2q4 - _2q1q3 - ax) + _2q2 * (2.0f * q1q2 + _2q3q4 - ay) - _2bz * q2 * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - mx) + (-_2bx * q3 + _2bz * q1) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - my) + _2bx * q2 * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - mz);
-            s2 = _2q4 * (2.0f * q2q4 - _2q1q3 - ax) + _2q1 * (2.0f * q1q2 + _2q3q4 - ay) - 4.0f * q1 * (1.0f - 2.0f * q2q2 - 2.0f * q3q3 - az) + _2bz * q3 * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - mx) + (_2bx * q2 + _2bz * q0) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - my) + (_2bx * q3 - _4bz * q1) * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - mz);
-            s3 = -_2q1 * (2.0f * q2q4 - _2q1q3 - ax) + _2q4 * (2.0f * q1q2 + _2q3q4 - ay) - 4.0f * q2 * (1.0f - 2.0f * q2q2 - 2.0f * q3q3 - az) + (-_4bx * q2 - _2bz * q0) * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - mx) + (_2bx * q1 + _2bz * q3) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - my) + (_2bx * q0 - _4bz * q2) * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - mz);
-            s4 = _2q2 * (2.0f * q2q4 - _2q1q3 - ax) + _2q3 * (2.0f * q1q2 + _2q3q4 - ay) + (-_4bx * q3 + _2bz * q1) * (_2bx * (0.5f - q3q3 - q4q4) + _2bz * (q2q4 - q1q3) - mx) + (-_2bx * q0 + _2bz * q2) * (_2bx * (q2q3 - q1q4) + _2bz * (q1q2 + q3q4) - my) + _2bx * q1 * (_2bx * (q1q3 + q2q4) + _2bz * (0.5f - q2q2 - q3q3) - mz);
-            norm = sqrt(s1 * s1 + s2 * s2 + s3 * s3 + s4 * s4);    // normalise step magnitude
-            norm = 1.0f/norm;
-            s1 *= norm;
-            s2 *= norm;
-            s3 *= norm;
-            s4 *= norm;
-
-            // Compute rate of change of quaternion
-            qDot1 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz) - beta * s1;
-            qDot2 = 0.5f * (q0 * gx + q2 * gz - q3 * gy) - beta * s2;
-            qDot3 = 0.5f * (q0 * gy - q1 * gz + q3 * gx) - beta * s3;
-            qDot4 = 0.5f * (q0 * gz + q1 * gy - q2 * gx) - beta * s4;
-
-            // Integrate to yield quaternion
-            q0 += qDot1 * (1.0f / sampleFreq);
-            q1 += qDot2 * (1.0f / sampleFreq);
-            q2 += qDot3 * (1.0f / sampleFreq);
-            q3 += qDot4 * (1.0f / sampleFreq);
-            norm = sqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);    // normalise quaternion
-            norm = 1.0f/norm;
-            q0 = q0 * norm;
-            q1 = q1 * norm;
-            q2 = q2 * norm;
-            q3 = q3 * norm;
-
-        }
-
-#endif
+	pstCxt->q0 = q0;
+	pstCxt->q1 = q1;
+	pstCxt->q2 = q2;
+	pstCxt->q3 = q3;
+}
 
 //---------------------------------------------------------------------------------------------------
 // IMU algorithm update
 
-void MadgwickAHRSupdateIMU(float gx, float gy, float gz, float ax, float ay, float az) {
+void MadgwickAHRSupdateIMU(stMADGWICK_Cxt_t *pstCxt, float gx, float gy, float gz, float ax, float ay, float az, float dt) {
 	float recipNorm;
-	float s0, s1, s2, s3;
+	float s[4];
 	float qDot1, qDot2, qDot3, qDot4;
-	float _2q0, _2q1, _2q2, _2q3, _4q0, _4q1, _4q2 ,_8q1, _8q2, q0q0, q1q1, q2q2, q3q3;
+
+	// Work on copies, written back once at the end
+	const float beta = pstCxt->beta;
+	float q0 = pstCxt->q0, q1 = pstCxt->q1, q2 = pstCxt->q2, q3 = pstCxt->q3;
 
 	// Rate of change of quaternion from gyroscope
 	qDot1 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
 	qDot2 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
-	qDot3 = 0.5f * (q0 * gy - q0 * gz + q3 * gx);
+	qDot3 = 0.5f * (q0 * gy - q1 * gz + q3 * gx);
 	qDot4 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
 
-	// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
-	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+	// Apply feedback step, if the accelerometer measurement is valid
+	if(imuFeedback(q0, q1, q2, q3, ax, ay, az, s)) {
+		qDot1 -= beta * s[0];
+		qDot2 -= beta * s[1];
+		qDot3 -= beta * s[2];
+		qDot4 -= beta * s[3];
+	}
 
-		// Normalise accelerometer measurement
-		recipNorm = invSqrt(ax * ax + ay * ay + az * az);
-		ax *= recipNorm;
-		ay *= recipNorm;
-		az *= recipNorm;   
+	// Integrate rate of change of quaternion to yield quaternion
+	q0 += qDot1 * dt;
+	q1 += qDot2 * dt;
+	q2 += qDot3 * dt;
+	q3 += qDot4 * dt;
 
-		// Auxiliary variables to avoid repeated arithmetic
-		_2q0 = 2.0f * q0;
-		_2q1 = 2.0f * q1;
-		_2q2 = 2.0f * q2;
-		_2q3 = 2.0f * q3;
-		_4q0 = 4.0f * q0;
-		_4q1 = 4.0f * q1;
-		_4q2 = 4.0f * q2;
-		_8q1 = 8.0f * q1;
-		_8q2 = 8.0f * q2;
-		q0q0 = q0 * q0;
-		q1q1 = q1 * q1;
-		q2q2 = q2 * q2;
-		q3q3 = q3 * q3;
+	// Normalise quaternion
+	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	q0 *= recipNorm;
+	q1 *= recipNorm;
+	q2 *= recipNorm;
+	q3 *= recipNorm;
 
-		// Gradient decent algorithm corrective step
-		s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
-		s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
-		s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
-		s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
-		recipNorm = invSqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3); // normalise step magnitude
-		s0 *= recipNorm;
-		s1 *= recipNorm;
-		s2 *= recipNorm;
-		s3 *= recipNorm;
+	pstCxt->q0 = q0;
+	pstCxt->q1 = q1;
+	pstCxt->q2 = q2;
+	pstCxt->q3 = q3;
+}
 
-		// Apply feedback step
-		qDot1 -= beta * s0;
-		qDot2 -= beta * s1;
-		qDot3 -= beta * s2;
-		qDot4 -= beta * s3;
+//---------------------------------------------------------------------------------------------------
+// IMU algorithm update over a FIFO burst, several gyro samples to one accelerometer reading
+
+void MadgwickAHRSupdateIMUBatch(stMADGWICK_Cxt_t *pstCxt, const float gyro[][3], unsigned count, float ax, float ay, float az, float dt) {
+	float recipNorm;
+	float s[4];
+	float qa, qb, qc, qd;
+	unsigned n;
+
+	// Work on copies, written back once at the end
+	const float beta = pstCxt->beta;
+	float q0 = pstCxt->q0, q1 = pstCxt->q1, q2 = pstCxt->q2, q3 = pstCxt->q3;
+
+	// The accelerometer is one reading for the whole burst so the gradient
+	// is worked out once, from the attitude at the start of it
+	if(!imuFeedback(q0, q1, q2, q3, ax, ay, az, s)) {
+		s[0] = s[1] = s[2] = s[3] = 0.0f;
 	}
 
-	// Integrate rate of change of quaternion to yield quaternion
-	q0 += qDot1 * (1.0f / sampleFreq);
-	q1 += qDot2 * (1.0f / sampleFreq);
-	q2 += qDot3 * (1.0f / sampleFreq);
-	q3 += qDot4 * (1.0f / sampleFreq);
+	s[0] *= beta;
+	s[1] *= beta;
+	s[2] *= beta;
+	s[3] *= beta;
 
-	// Normalise quaternion
+	// Integrate each gyro sample with the same feedback step
+	for(n = 0; n < count; n++) {
+		const float hgx = 0.5f * gyro[n][0], hgy = 0.5f * gyro[n][1], hgz = 0.5f * gyro[n][2];
+
+		qa = q0; qb = q1; qc = q2; qd = q3;
+		q0 += ((-qb * hgx - qc * hgy - qd * hgz) - s[0]) * dt;
+		q1 += ((qa * hgx + qc * hgz - qd * hgy) - s[1]) * dt;
+		q2 += ((qa * hgy - qb * hgz + qd * hgx) - s[2]) * dt;
+		q3 += ((qa * hgz + qb * hgy - qc * hgx) - s[3]) * dt;
+	}
+
+	// Normalise quaternion, once as the steps between are small
 	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
 	q0 *= recipNorm;
 	q1 *= recipNorm;
 	q2 *= recipNorm;
 	q3 *= recipNorm;
+
+	pstCxt->q0 = q0;
+	pstCxt->q1 = q1;
+	pstCxt->q2 = q2;
+	pstCxt->q3 = q3;
+}
+
+//---------------------------------------------------------------------------------------------------
+// Normalised gradient of the accelerometer objective function, zero if the measurement is invalid
+
+static int imuFeedback(float q0, float q1, float q2, float q3, float ax, float ay, float az, float s[4]) {
+	float recipNorm;
+	float _2q0, _2q1, _2q2, _2q3, _4q0, _4q1, _4q2 ,_8q1, _8q2, q0q0, q1q1, q2q2, q3q3;
+
+	// Avoids NaN in accelerometer normalisation
+	if((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f)) {
+		return 0;
+	}
+
+	// Normalise accelerometer measurement
+	recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+	ax *= recipNorm;
+	ay *= recipNorm;
+	az *= recipNorm;
+
+	// Auxiliary variables to avoid repeated arithmetic
+	_2q0 = 2.0f * q0;
+	_2q1 = 2.0f * q1;
+	_2q2 = 2.0f * q2;
+	_2q3 = 2.0f * q3;
+	_4q0 = 4.0f * q0;
+	_4q1 = 4.0f * q1;
+	_4q2 = 4.0f * q2;
+	_8q1 = 8.0f * q1;
+	_8q2 = 8.0f * q2;
+	q0q0 = q0 * q0;
+	q1q1 = q1 * q1;
+	q2q2 = q2 * q2;
+	q3q3 = q3 * q3;
+
+	// Gradient decent algorithm corrective step
+	s[0] = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+	s[1] = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+	s[2] = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+	s[3] = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+
+	// At the optimum the gradient is zero and can't be normalised
+	if((s[0] == 0.0f) && (s[1] == 0.0f) && (s[2] == 0.0f) && (s[3] == 0.0f)) {
+		return 0;
+	}
+
+	recipNorm = invSqrt(s[0] * s[0] + s[1] * s[1] + s[2] * s[2] + s[3] * s[3]); // normalise step magnitude
+	s[0] *= recipNorm;
+	s[1] *= recipNorm;
+	s[2] *= recipNorm;
+	s[3] *= recipNorm;
+
+	return 1;
 }
 
 //---------------------------------------------------------------------------------------------------
@@ -316,9 +306,10 @@ void MadgwickAHRSupdateIMU(float gx, float gy, float gz, float ax, float ay, flo
 float invSqrt(float x) {
 	float halfx = 0.5f * x;
 	float y = x;
-	long i = *(long*)&y;
+	int32_t i;
+	memcpy(&i, &y, sizeof(i));		// the float's bits, copied as reading them through an int pointer is undefined
 	i = 0x5f3759df - (i>>1);
-	y = *(float*)&i;
+	memcpy(&y, &i, sizeof(y));
 	y = y * (1.5f - (halfx * y * y));
 	return y;
 }
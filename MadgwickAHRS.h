@@ -14,17 +14,27 @@
 #define MadgwickAHRS_h
 
 //----------------------------------------------------------------------------------------------------
-// Variable declaration
+// Type declaration, one per filter instance
 
-extern volatile float beta;				// algorithm gain
-extern volatile float q0, q1, q2, q3;	// quaternion of sensor frame relative to auxiliary frame
+typedef struct
+{
+	float beta;				// algorithm gain
+	float q0, q1, q2, q3;	// quaternion of sensor frame relative to auxiliary frame
+
+} stMADGWICK_Cxt_t;
 
 //---------------------------------------------------------------------------------------------------
 // Function declarations
 
-void MadgwickAHRSupdate(float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz);
-void MadgwickQuaternionUpdate(float ax, float ay, float az, float gx, float gy, float gz, float mx, float my, float mz);
-void MadgwickAHRSupdateIMU(float gx, float gy, float gz, float ax, float ay, float az);
+// Gyroscope in rad/s, accelerometer and magnetometer in any units, dt the
+// time since the last update in seconds. The batch update takes a FIFO burst
+// of gyro samples dt apart against one accelerometer reading.
+
+void MadgwickSetup(stMADGWICK_Cxt_t *pstCxt);
+void MadgwickAHRSupdate(stMADGWICK_Cxt_t *pstCxt, float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt);
+void MadgwickAHRSupdateIMU(stMADGWICK_Cxt_t *pstCxt, float gx, float gy, float gz, float ax, float ay, float az, float dt);
+void MadgwickAHRSupdateIMUBatch(stMADGWICK_Cxt_t *pstCxt, const float gyro[][3], unsigned count, float ax, float ay, float az, float dt);
+float invSqrt(float x);
 
 #endif
 //=====================================================================================================
@@ -0,0 +1,276 @@
+//=====================================================================================================
+// MahonyAHRS.c
+//=====================================================================================================
+//
+// Madgwick's implementation of Mahony's AHRS algorithm.
+// See: http://www.x-io.co.uk/node/8#open_source_ahrs_and_imu_algorithms
+//
+// Date			Author			Notes
+// 29/09/2011	SOH Madgwick    Initial release
+// 02/10/2011	SOH Madgwick	Optimised for reduced CPU load
+//
+//=====================================================================================================
+
+//---------------------------------------------------------------------------------------------------
+// Header files
+
+#include "MahonyAHRS.h"
+#include "MadgwickAHRS.h"	// invSqrt
+#include <math.h>
+
+//---------------------------------------------------------------------------------------------------
+// Definitions
+
+#define twoKpDef	(2.0f * 0.5f)	// 2 * proportional gain
+#define twoKiDef	(2.0f * 0.0f)	// 2 * integral gain
+
+//---------------------------------------------------------------------------------------------------
+// Function declarations
+
+static int imuError(float q0, float q1, float q2, float q3, float ax, float ay, float az, float e[3]);
+static void integrateFeedback(stMAHONY_Cxt_t *pstCxt, const float e[3], float dt);
+
+//====================================================================================================
+// Functions
+
+//---------------------------------------------------------------------------------------------------
+// Filter set up, level with the default gains
+
+void MahonySetup(stMAHONY_Cxt_t *pstCxt) {
+	pstCxt->twoKp = twoKpDef;
+	pstCxt->twoKi = twoKiDef;
+	pstCxt->q0 = 1.0f;
+	pstCxt->q1 = 0.0f;
+	pstCxt->q2 = 0.0f;
+	pstCxt->q3 = 0.0f;
+	pstCxt->integralFBx = 0.0f;
+	pstCxt->integralFBy = 0.0f;
+	pstCxt->integralFBz = 0.0f;
+}
+
+//---------------------------------------------------------------------------------------------------
+// AHRS algorithm update
+
+void MahonyAHRSupdate(stMAHONY_Cxt_t *pstCxt, float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt) {
+	float recipNorm;
+	float q0q0, q0q1, q0q2, q0q3, q1q1, q1q2, q1q3, q2q2, q2q3, q3q3;
+	float hx, hy, bx, bz;
+	float halfvx, halfvy, halfvz, halfwx, halfwy, halfwz;
+	float e[3];
+	float qa, qb, qc;
+
+	// Work on copies, written back once at the end
+	float q0 = pstCxt->q0, q1 = pstCxt->q1, q2 = pstCxt->q2, q3 = pstCxt->q3;
+
+	// Use IMU algorithm if magnetometer measurement invalid (avoids NaN in magnetometer normalisation)
+	if((mx == 0.0f) && (my == 0.0f) && (mz == 0.0f)) {
+		MahonyAHRSupdateIMU(pstCxt, gx, gy, gz, ax, ay, az, dt);
+		return;
+	}
+
+	// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
+	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+
+		// Normalise accelerometer measurement
+		recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+		ax *= recipNorm;
+		ay *= recipNorm;
+		az *= recipNorm;
+
+		// Normalise magnetometer measurement
+		recipNorm = invSqrt(mx * mx + my * my + mz * mz);
+		mx *= recipNorm;
+		my *= recipNorm;
+		mz *= recipNorm;
+
+		// Auxiliary variables to avoid repeated arithmetic
+		q0q0 = q0 * q0;
+		q0q1 = q0 * q1;
+		q0q2 = q0 * q2;
+		q0q3 = q0 * q3;
+		q1q1 = q1 * q1;
+		q1q2 = q1 * q2;
+		q1q3 = q1 * q3;
+		q2q2 = q2 * q2;
+		q2q3 = q2 * q3;
+		q3q3 = q3 * q3;
+
+		// Reference direction of Earth's magnetic field
+		hx = 2.0f * (mx * (0.5f - q2q2 - q3q3) + my * (q1q2 - q0q3) + mz * (q1q3 + q0q2));
+		hy = 2.0f * (mx * (q1q2 + q0q3) + my * (0.5f - q1q1 - q3q3) + mz * (q2q3 - q0q1));
+		bx = sqrtf(hx * hx + hy * hy);
+		bz = 2.0f * (mx * (q1q3 - q0q2) + my * (q2q3 + q0q1) + mz * (0.5f - q1q1 - q2q2));
+
+		// Estimated direction of gravity and magnetic field
+		halfvx = q1q3 - q0q2;
+		halfvy = q0q1 + q2q3;
+		halfvz = q0q0 - 0.5f + q3q3;
+		halfwx = bx * (0.5f - q2q2 - q3q3) + bz * (q1q3 - q0q2);
+		halfwy = bx * (q1q2 - q0q3) + bz * (q0q1 + q2q3);
+		halfwz = bx * (q0q2 + q1q3) + bz * (0.5f - q1q1 - q2q2);
+
+		// Error is sum of cross product between estimated direction and measured direction of field vectors
+		e[0] = (ay * halfvz - az * halfvy) + (my * halfwz - mz * halfwy);
+		e[1] = (az * halfvx - ax * halfvz) + (mz * halfwx - mx * halfwz);
+		e[2] = (ax * halfvy - ay * halfvx) + (mx * halfwy - my * halfwx);
+
+		// Apply integral and proportional feedback
+		integrateFeedback(pstCxt, e, dt);
+		gx += pstCxt->integralFBx + pstCxt->twoKp * e[0];
+		gy += pstCxt->integralFBy + pstCxt->twoKp * e[1];
+		gz += pstCxt->integralFBz + pstCxt->twoKp * e[2];
+	}
+
+	// Integrate rate of change of quaternion
+	gx *= (0.5f * dt);		// pre-multiply common factors
+	gy *= (0.5f * dt);
+	gz *= (0.5f * dt);
+	qa = q0;
+	qb = q1;
+	qc = q2;
+	q0 += (-qb * gx - qc * gy - q3 * gz);
+	q1 += (qa * gx + qc * gz - q3 * gy);
+	q2 += (qa * gy - qb * gz + q3 * gx);
+	q3 += (qa * gz + qb * gy - qc * gx);
+
+	// Normalise quaternion
+	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	pstCxt->q0 = q0 * recipNorm;
+	pstCxt->q1 = q1 * recipNorm;
+	pstCxt->q2 = q2 * recipNorm;
+	pstCxt->q3 = q3 * recipNorm;
+}
+
+//---------------------------------------------------------------------------------------------------
+// IMU algorithm update
+
+void MahonyAHRSupdateIMU(stMAHONY_Cxt_t *pstCxt, float gx, float gy, float gz, float ax, float ay, float az, float dt) {
+	float recipNorm;
+	float e[3];
+	float qa, qb, qc;
+
+	// Work on copies, written back once at the end
+	float q0 = pstCxt->q0, q1 = pstCxt->q1, q2 = pstCxt->q2, q3 = pstCxt->q3;
+
+	// Apply integral and proportional feedback, if the accelerometer measurement is valid
+	if(imuError(q0, q1, q2, q3, ax, ay, az, e)) {
+		integrateFeedback(pstCxt, e, dt);
+		gx += pstCxt->integralFBx + pstCxt->twoKp * e[0];
+		gy += pstCxt->integralFBy + pstCxt->twoKp * e[1];
+		gz += pstCxt->integralFBz + pstCxt->twoKp * e[2];
+	}
+
+	// Integrate rate of change of quaternion
+	gx *= (0.5f * dt);		// pre-multiply common factors
+	gy *= (0.5f * dt);
+	gz *= (0.5f * dt);
+	qa = q0;
+	qb = q1;
+	qc = q2;
+	q0 += (-qb * gx - qc * gy - q3 * gz);
+	q1 += (qa * gx + qc * gz - q3 * gy);
+	q2 += (qa * gy - qb * gz + q3 * gx);
+	q3 += (qa * gz + qb * gy - qc * gx);
+
+	// Normalise quaternion
+	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	pstCxt->q0 = q0 * recipNorm;
+	pstCxt->q1 = q1 * recipNorm;
+	pstCxt->q2 = q2 * recipNorm;
+	pstCxt->q3 = q3 * recipNorm;
+}
+
+//---------------------------------------------------------------------------------------------------
+// IMU algorithm update over a FIFO burst, several gyro samples to one accelerometer reading
+
+void MahonyAHRSupdateIMUBatch(stMAHONY_Cxt_t *pstCxt, const float gyro[][3], unsigned count, float ax, float ay, float az, float dt) {
+	float recipNorm;
+	float e[3] = { 0.0f, 0.0f, 0.0f };
+	float fbx, fby, fbz;
+	float qa, qb, qc;
+	unsigned n;
+
+	// Work on copies, written back once at the end
+	const float halfdt = 0.5f * dt;
+	float q0 = pstCxt->q0, q1 = pstCxt->q1, q2 = pstCxt->q2, q3 = pstCxt->q3;
+
+	// The accelerometer is one reading for the whole burst so the error is
+	// worked out once, from the attitude at the start of it
+	if(imuError(q0, q1, q2, q3, ax, ay, az, e)) {
+		integrateFeedback(pstCxt, e, dt * count);
+	}
+
+	fbx = pstCxt->integralFBx + pstCxt->twoKp * e[0];
+	fby = pstCxt->integralFBy + pstCxt->twoKp * e[1];
+	fbz = pstCxt->integralFBz + pstCxt->twoKp * e[2];
+
+	// Integrate each gyro sample with the same feedback
+	for(n = 0; n < count; n++) {
+		const float gx = (gyro[n][0] + fbx) * halfdt, gy = (gyro[n][1] + fby) * halfdt, gz = (gyro[n][2] + fbz) * halfdt;
+
+		qa = q0;
+		qb = q1;
+		qc = q2;
+		q0 += (-qb * gx - qc * gy - q3 * gz);
+		q1 += (qa * gx + qc * gz - q3 * gy);
+		q2 += (qa * gy - qb * gz + q3 * gx);
+		q3 += (qa * gz + qb * gy - qc * gx);
+	}
+
+	// Normalise quaternion, once as the steps between are small
+	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	pstCxt->q0 = q0 * recipNorm;
+	pstCxt->q1 = q1 * recipNorm;
+	pstCxt->q2 = q2 * recipNorm;
+	pstCxt->q3 = q3 * recipNorm;
+}
+
+//---------------------------------------------------------------------------------------------------
+// Cross product of the measured and estimated gravity, false if the measurement is invalid
+
+static int imuError(float q0, float q1, float q2, float q3, float ax, float ay, float az, float e[3]) {
+	float recipNorm;
+	float halfvx, halfvy, halfvz;
+
+	// Avoids NaN in accelerometer normalisation
+	if((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f)) {
+		return 0;
+	}
+
+	// Normalise accelerometer measurement
+	recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+	ax *= recipNorm;
+	ay *= recipNorm;
+	az *= recipNorm;
+
+	// Estimated direction of gravity, half of it
+	halfvx = q1 * q3 - q0 * q2;
+	halfvy = q0 * q1 + q2 * q3;
+	halfvz = q0 * q0 - 0.5f + q3 * q3;
+
+	e[0] = (ay * halfvz - az * halfvy);
+	e[1] = (az * halfvx - ax * halfvz);
+	e[2] = (ax * halfvy - ay * halfvx);
+
+	return 1;
+}
+
+//---------------------------------------------------------------------------------------------------
+// Integral feedback, left at zero when it is disabled to stop it winding up
+
+static void integrateFeedback(stMAHONY_Cxt_t *pstCxt, const float e[3], float dt) {
+	if(pstCxt->twoKi > 0.0f) {
+		pstCxt->integralFBx += pstCxt->twoKi * e[0] * dt;
+		pstCxt->integralFBy += pstCxt->twoKi * e[1] * dt;
+		pstCxt->integralFBz += pstCxt->twoKi * e[2] * dt;
+	}
+	else {
+		pstCxt->integralFBx = 0.0f;
+		pstCxt->integralFBy = 0.0f;
+		pstCxt->integralFBz = 0.0f;
+	}
+}
+
+//====================================================================================================
+// END OF CODE
+//====================================================================================================
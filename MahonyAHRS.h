@@ -0,0 +1,41 @@
+//=====================================================================================================
+// MahonyAHRS.h
+//=====================================================================================================
+//
+// Madgwick's implementation of Mahony's AHRS algorithm.
+// See: http://www.x-io.co.uk/node/8#open_source_ahrs_and_imu_algorithms
+//
+// Date			Author			Notes
+// 29/09/2011	SOH Madgwick    Initial release
+// 02/10/2011	SOH Madgwick	Optimised for reduced CPU load
+//
+//=====================================================================================================
+#ifndef MahonyAHRS_h
+#define MahonyAHRS_h
+
+//----------------------------------------------------------------------------------------------------
+// Type declaration, one per filter instance
+
+typedef struct
+{
+	float twoKp;			// 2 * proportional gain (Kp)
+	float twoKi;			// 2 * integral gain (Ki)
+	float q0, q1, q2, q3;	// quaternion of sensor frame relative to auxiliary frame
+	float integralFBx, integralFBy, integralFBz;	// integral error terms scaled by Ki
+
+} stMAHONY_Cxt_t;
+
+//---------------------------------------------------------------------------------------------------
+// Function declarations
+
+// As the Madgwick functions, see MadgwickAHRS.h
+
+void MahonySetup(stMAHONY_Cxt_t *pstCxt);
+void MahonyAHRSupdate(stMAHONY_Cxt_t *pstCxt, float gx, float gy, float gz, float ax, float ay, float az, float mx, float my, float mz, float dt);
+void MahonyAHRSupdateIMU(stMAHONY_Cxt_t *pstCxt, float gx, float gy, float gz, float ax, float ay, float az, float dt);
+void MahonyAHRSupdateIMUBatch(stMAHONY_Cxt_t *pstCxt, const float gyro[][3], unsigned count, float ax, float ay, float az, float dt);
+
+#endif
+//=====================================================================================================
+// End of file
+//=====================================================================================================
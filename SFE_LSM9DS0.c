@@ -569,7 +569,33 @@ void LSM9DS0_readAccel(stLSM9DS0_t * stThis)
 /* ************************************************************************** */
 uint8_t LSM9DS0_fifoCountAccel(stLSM9DS0_t * stThis)
 {
-	return (xmReadByte(stThis, FIFO_SRC_REG) & 0x1F); // Read number of stored accelerometer samples
+	return LSM9DS0_fifoLevel(xmReadByte(stThis, FIFO_SRC_REG), LSM9DS0_FIFO_DEPTH); // Read number of stored accelerometer samples
+}
+
+/* ************************************************************************** */
+uint8_t LSM9DS0_readAccelFifo(stLSM9DS0_t * stThis, int16_t (*out)[3], uint8_t max)
+{
+	uint8_t temp[LSM9DS0_FIFO_DEPTH * 6]; // Six bytes per queued sample
+	uint8_t count;
+
+	if (max > LSM9DS0_FIFO_DEPTH)
+		max = LSM9DS0_FIFO_DEPTH;
+
+	count = LSM9DS0_fifoLevel(xmReadByte(stThis, FIFO_SRC_REG), max);
+	if (count == 0)
+		return 0;
+
+	// One burst for the whole backlog, the XM rolls OUT_Z_H_A over to OUT_X_L_A
+	xmReadBytes(stThis, OUT_X_L_A, temp, count * 6);
+
+	LSM9DS0_unpackFifo(temp, count, out);
+
+	// Keep the class variables pointing at the newest sample
+	stThis->ax = out[count - 1][0];
+	stThis->ay = out[count - 1][1];
+	stThis->az = out[count - 1][2];
+
+	return count;
 }
 
 /* ************************************************************************** */
@@ -587,7 +613,42 @@ void LSM9DS0_readTemp(stLSM9DS0_t * stThis)
 {
 	uint8_t temp[2]; // We'll read two bytes from the temperature sensor into temp	
 	xmReadBytes(stThis, OUT_TEMP_L_XM, temp, 2); // Read 2 bytes, beginning at OUT_TEMP_L_M
-	stThis->temperature = (((int16_t) temp[1] << 12) | temp[0] << 4 ) >> 4; // Temperature is a 12-bit signed integer
+	stThis->temperature = LSM9DS0_unpackTemp(temp);
+}
+
+/* ************************************************************************** */
+int16_t LSM9DS0_unpackTemp(const uint8_t * raw)
+{
+	return (((int16_t) raw[1] << 12) | raw[0] << 4 ) >> 4; // Temperature is a 12-bit signed integer
+}
+
+/* ************************************************************************** */
+uint8_t LSM9DS0_fifoLevel(uint8_t src, uint8_t max)
+{
+	uint8_t count = src & 0x1F; // FSS4-0, the flags above it are not the level
+
+	return (count > max) ? max : count;
+}
+
+/* ************************************************************************** */
+uint8_t LSM9DS0_i2cBurstAddress(uint8_t subAddress)
+{
+	return (uint8_t)(subAddress | 0x80);
+}
+
+/* ************************************************************************** */
+uint8_t LSM9DS0_unpackFifo(const uint8_t * raw, uint8_t count, int16_t (*out)[3])
+{
+	uint8_t ii;
+
+	for (ii = 0; ii < count; ii++)
+	{
+		out[ii][0] = (raw[(ii * 6) + 1] << 8) | raw[(ii * 6) + 0];
+		out[ii][1] = (raw[(ii * 6) + 3] << 8) | raw[(ii * 6) + 2];
+		out[ii][2] = (raw[(ii * 6) + 5] << 8) | raw[(ii * 6) + 4];
+	}
+
+	return count;
 }
 
 /* ************************************************************************** */
@@ -603,7 +664,51 @@ void LSM9DS0_readGyro(stLSM9DS0_t * stThis)
 /* ************************************************************************** */
 uint8_t LSM9DS0_fifoCountGyro(stLSM9DS0_t * stThis)
 {
-	return (gReadByte(stThis, FIFO_SRC_REG_G) & 0x1F); // Read number of stored samples
+	return LSM9DS0_fifoLevel(gReadByte(stThis, FIFO_SRC_REG_G), LSM9DS0_FIFO_DEPTH); // Read number of stored samples
+}
+
+/* ************************************************************************** */
+uint8_t LSM9DS0_readGyroFifo(stLSM9DS0_t * stThis, int16_t (*out)[3], uint8_t max)
+{
+	uint8_t temp[LSM9DS0_FIFO_DEPTH * 6]; // Six bytes per queued sample
+	uint8_t count;
+
+	if (max > LSM9DS0_FIFO_DEPTH)
+		max = LSM9DS0_FIFO_DEPTH;
+
+	count = LSM9DS0_fifoLevel(gReadByte(stThis, FIFO_SRC_REG_G), max);
+	if (count == 0)
+		return 0;
+
+	// One burst for the whole backlog, the gyro rolls OUT_Z_H_G over to OUT_X_L_G
+	gReadBytes(stThis, OUT_X_L_G, temp, count * 6);
+
+	LSM9DS0_unpackFifo(temp, count, out);
+
+	// Keep the class variables pointing at the newest sample
+	stThis->gx = out[count - 1][0];
+	stThis->gy = out[count - 1][1];
+	stThis->gz = out[count - 1][2];
+
+	return count;
+}
+
+/* ************************************************************************** */
+void LSM9DS0_setGyroFifoWatermark(stLSM9DS0_t * stThis, uint8_t wtm)
+{
+	uint8_t temp;
+
+	// Keep the FIFO mode bits set up by initGyro(), WTM[4:0] = watermark level
+	temp = gReadByte(stThis, FIFO_CTRL_REG_G);
+	temp &= ~0x1F;
+	temp |= (wtm & 0x1F);
+	gWriteByte(stThis, FIFO_CTRL_REG_G, temp);
+
+	// Swap I2_DRDY for I2_WTM on DRDY_G, leave INT_G config alone
+	temp = gReadByte(stThis, CTRL_REG3_G);
+	temp &= ~0x0F;
+	temp |= 0x04;
+	gWriteByte(stThis, CTRL_REG3_G, temp);
 }
 
 /* ************************************************************************** */
@@ -965,7 +1070,7 @@ static uint8_t I2CreadByte(stLSM9DS0_t * stThis, uint8_t address, uint8_t subAdd
 /* ************************************************************************** */
 static void I2CreadBytes(stLSM9DS0_t * stThis, uint8_t address, uint8_t subAddress, uint8_t * dest, uint8_t count)
 {
-	uint8_t registerAddress = (uint8_t)(subAddress | 0x80);
+	uint8_t registerAddress = LSM9DS0_i2cBurstAddress(subAddress);
 
 	stThis->read_bytes(stThis, address, registerAddress, dest, count);
 }
@@ -113,6 +113,9 @@ Distributed as-is; no warranty is given.
 #define ACT_THS				0x3E
 #define ACT_DUR				0x3F
 
+// Both the gyro and the accel FIFOs hold up to 32 samples of x/y/z data
+#define LSM9DS0_FIFO_DEPTH	32
+
 // The LSM9DS0 functions over both I2C or SPI. This library supports both.
 // But the interface mode used must be sent to the LSM9DS0 constructor. Use
 // one of these two as the first parameter of the constructor.
@@ -328,8 +331,65 @@ void LSM9DS0_readAccel(stLSM9DS0_t * stThis);
 
 uint8_t LSM9DS0_fifoCountGyro(stLSM9DS0_t * stThis);
 
+// readGyroFifo() -- Drain the gyroscope FIFO with a single burst read.
+// The FIFO level is read first, then every queued sample is read in one
+// auto-incrementing transfer starting at OUT_X_L_G (the gyro wraps its
+// read pointer back to OUT_X_L_G after OUT_Z_H_G while the FIFO is on).
+// The newest sample is also stored in the class' gx, gy, and gz variables.
+// Input:
+//	- out = Array of [x, y, z] raw readings to fill, oldest sample first.
+//	- max = Number of entries available in out.
+// Output: The number of samples stored in out.
+uint8_t LSM9DS0_readGyroFifo(stLSM9DS0_t * stThis, int16_t (*out)[3], uint8_t max);
+
+// setGyroFifoWatermark() -- Raise DRDY_G when the gyro FIFO reaches a level.
+// Keeps the current FIFO mode, sets the watermark level and switches the
+// DRDY_G pin from per-sample data ready to the FIFO watermark interrupt.
+// Input:
+//	- wtm = FIFO level (1 to 31 samples) that asserts DRDY_G.
+void LSM9DS0_setGyroFifoWatermark(stLSM9DS0_t * stThis, uint8_t wtm);
+
 uint8_t LSM9DS0_fifoCountAccel(stLSM9DS0_t * stThis);
 
+// readAccelFifo() -- Drain the accelerometer FIFO with a single burst read.
+// Works the same way as readGyroFifo(), starting at OUT_X_L_A. The newest
+// sample is also stored in the class' ax, ay, and az variables.
+// Input:
+//	- out = Array of [x, y, z] raw readings to fill, oldest sample first.
+//	- max = Number of entries available in out.
+// Output: The number of samples stored in out.
+uint8_t LSM9DS0_readAccelFifo(stLSM9DS0_t * stThis, int16_t (*out)[3], uint8_t max);
+
+// fifoLevel() -- The number of samples a FIFO_SRC_REG or FIFO_SRC_REG_G value
+// says are queued. The watermark, overrun and empty flags above the level are
+// dropped. Shared with FIFO reads made without this driver.
+// Input:
+//	- src = The FIFO source register as read.
+//	- max = Most samples the caller takes.
+// Output: The number of samples to read, no more than max.
+uint8_t LSM9DS0_fifoLevel(uint8_t src, uint8_t max);
+
+// i2cBurstAddress() -- The sub-address that starts a multiple byte I2C read.
+// The part only auto-increments the register address when SUB(7) is set.
+// Input:
+//	- subAddress = The first register to read.
+// Output: subAddress with SUB(7) set.
+uint8_t LSM9DS0_i2cBurstAddress(uint8_t subAddress);
+
+// unpackFifo() -- Convert a FIFO burst read elsewhere into raw readings.
+// Used when the FIFO registers were read without going through this driver,
+// e.g. by an interrupt driven bus transfer. Does not touch the class values.
+// Input:
+//	- raw = count * 6 bytes read from OUT_X_L_G or OUT_X_L_A.
+//	- count = Number of samples in raw.
+//	- out = Array of [x, y, z] raw readings to fill, oldest sample first.
+// Output: The number of samples stored in out.
+uint8_t LSM9DS0_unpackFifo(const uint8_t * raw, uint8_t count, int16_t (*out)[3]);
+
+// unpackTemp() -- Convert the two temperature output registers, read
+// elsewhere starting at OUT_TEMP_L_XM, into a 12-bit signed reading.
+int16_t LSM9DS0_unpackTemp(const uint8_t * raw);
+
 // readMag() -- Read the magnetometer output registers.
 // This function will read all six magnetometer output registers.
 // The readings are stored in the class' mx, my, and mz variables. Read
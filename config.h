@@ -17,4 +17,13 @@
 #define CFG_RECEIVER_VRA		( 4 )
 #define CFG_RECEIVER_VRB		( 5 )
 
+// Run the attitude estimation and control in fixed point (see fixmath.h)
+// rather than soft-float. Comment out to fly the float controller.
+//#define CFG_FIXED_POINT
+
+// Send the flight task's run time histograms (cyclestats.h) over mavlink in
+// place of the printf status line, the two can't share the UART. Comment out
+// for the status line.
+//#define CFG_MAVLINK_TIMING
+
 #endif
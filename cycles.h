@@ -0,0 +1,73 @@
+#ifndef CYCLES_H
+#define CYCLES_H
+
+#include <stdint.h>			// std types
+
+/*
+ * Free running counter for timing stretches of code. On the K20 it is the
+ * DWT cycle counter, one count per core clock. Off target (the host builds)
+ * it counts nanoseconds, which is as close as a PC gets.
+ *
+ * Differences of two reads are good across a wrap of the counter, as long as
+ * what is timed takes less than a full wrap (about 59s on the target).
+ */
+
+#if defined( __arm__ )
+
+#include "MK20D7.h"			// DWT registers
+
+#define CYCLES_DEMCR_TRCENA		( 1UL << 24 )
+#define CYCLES_DWT_CYCCNTENA	( 1UL << 0 )
+
+extern int32_t core_clk_khz;	// sysinit.c, see common.h
+
+/**
+ * @brief		Starts the cycle counter, safe to call more than once.
+ */
+static inline void CYCLES_Setup( void )
+{
+	DEMCR |= CYCLES_DEMCR_TRCENA;
+	DWT_CTRL |= CYCLES_DWT_CYCCNTENA;
+}
+
+/**
+ * @brief		The counter now.
+ */
+static inline uint32_t CYCLES_Now( void )
+{
+	return DWT_CYCCNT;
+}
+
+/**
+ * @brief		Counts per microsecond, the core clock in MHz.
+ */
+static inline uint32_t CYCLES_PerUs( void )
+{
+	return (uint32_t)core_clk_khz / 1000;
+}
+
+#else
+
+#include <time.h>			// clock_gettime
+
+static inline void CYCLES_Setup( void )
+{
+}
+
+static inline uint32_t CYCLES_Now( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return (uint32_t)( ( (uint64_t)stNow.tv_sec * 1000000000ULL ) + (uint64_t)stNow.tv_nsec );
+}
+
+static inline uint32_t CYCLES_PerUs( void )
+{
+	return 1000;
+}
+
+#endif
+
+#endif
@@ -0,0 +1,81 @@
+#include "cyclestats.h"
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <string.h>			// memset
+
+/* ************************************************************************** */
+void CYCLESTATS_Create( stCYCLESTATS_Ctx_t *const pstCtx )
+{
+	memset( pstCtx, 0, sizeof( stCYCLESTATS_Ctx_t ) );
+	pstCtx->uiMin = UINT32_MAX;
+
+	return;
+}
+
+/* ************************************************************************** */
+void CYCLESTATS_Add( stCYCLESTATS_Ctx_t *const pstCtx, const uint32_t uiCycles )
+{
+	uint16_t *puiBucket = &pstCtx->auiBuckets[ CYCLESTATS_Bucket( uiCycles ) ];
+
+	pstCtx->uiCount++;
+	pstCtx->uiSum += uiCycles;
+
+	if ( uiCycles < pstCtx->uiMin )
+	{
+		pstCtx->uiMin = uiCycles;
+	}
+
+	if ( uiCycles > pstCtx->uiMax )
+	{
+		pstCtx->uiMax = uiCycles;
+	}
+
+	if ( UINT16_MAX != *puiBucket )
+	{
+		( *puiBucket )++;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+void CYCLESTATS_Summarise( stCYCLESTATS_Ctx_t *const pstCtx, stCYCLESTATS_Summary_t *const pstSummary )
+{
+	pstSummary->uiCount = pstCtx->uiCount;
+	pstSummary->uiMax = pstCtx->uiMax;
+	memcpy( pstSummary->auiBuckets, pstCtx->auiBuckets, sizeof( pstSummary->auiBuckets ) );
+
+	if ( 0 == pstCtx->uiCount )
+	{
+		pstSummary->uiMin = 0;
+		pstSummary->uiMean = 0;
+	}
+	else
+	{
+		// The only 64 bit division, once a window rather than once a timing
+		pstSummary->uiMin = pstCtx->uiMin;
+		pstSummary->uiMean = (uint32_t)( pstCtx->uiSum / pstCtx->uiCount );
+	}
+
+	CYCLESTATS_Create( pstCtx );
+
+	return;
+}
+
+/* ************************************************************************** */
+uint8_t CYCLESTATS_Bucket( const uint32_t uiCycles )
+{
+	int iBucket;
+
+	if ( 0 == ( uiCycles >> CYCLESTATS_BUCKET_SHIFT ) )
+	{
+		return 0;
+	}
+
+	// One CLZ instruction on the M4
+	iBucket = ( 31 - __builtin_clz( uiCycles ) ) - CYCLESTATS_BUCKET_SHIFT;
+
+	return ( CYCLESTATS_NUM_BUCKETS <= iBucket ) ? ( CYCLESTATS_NUM_BUCKETS - 1 ) : (uint8_t)iBucket;
+}
@@ -0,0 +1,71 @@
+#ifndef CYCLESTATS_H
+#define CYCLESTATS_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+
+/*
+ * Min, max, mean and a log2 histogram of a stretch of code's CYCLES_Now
+ * counts (cycles.h), so on the host they are nanoseconds. Bucket n holds the
+ * counts from 2^(n + CYCLESTATS_BUCKET_SHIFT) up to twice that, the first
+ * bucket also takes anything shorter and the last anything longer. At 48MHz
+ * that is under 2.7us to over 43ms.
+ *
+ * Counts are gathered over a window, CYCLESTATS_Summarise hands the window
+ * over and starts the next one.
+ */
+
+#define CYCLESTATS_NUM_BUCKETS		( 16 )
+#define CYCLESTATS_BUCKET_SHIFT		( 6 )
+
+typedef struct
+{
+	uint32_t uiCount;
+	uint32_t uiMin;
+	uint32_t uiMax;
+	uint64_t uiSum;
+	uint16_t auiBuckets[ CYCLESTATS_NUM_BUCKETS ];	// Stop at UINT16_MAX
+
+} stCYCLESTATS_Ctx_t;
+
+// What a window comes to, small enough to publish
+typedef struct
+{
+	uint32_t uiCount;
+	uint32_t uiMin;
+	uint32_t uiMax;
+	uint32_t uiMean;
+	uint16_t auiBuckets[ CYCLESTATS_NUM_BUCKETS ];
+
+} stCYCLESTATS_Summary_t;
+
+/**
+ * @brief		Initialises a cycle stats context with an empty window.
+ * @param[in]	pstCtx		The cycle stats context to initialise.
+ */
+void CYCLESTATS_Create( stCYCLESTATS_Ctx_t *const pstCtx );
+
+/**
+ * @brief		Adds one timing to the window.
+ * @param[in]	pstCtx		The cycle stats context to use.
+ * @param[in]	uiCycles	Difference of two CYCLES_Now reads.
+ */
+void CYCLESTATS_Add( stCYCLESTATS_Ctx_t *const pstCtx, const uint32_t uiCycles );
+
+/**
+ * @brief		Summarises the window and starts a new one. An empty window
+ * 				summarises to all zeros.
+ * @param[in]	pstCtx		The cycle stats context to use.
+ * @param[out]	pstSummary	The window's figures.
+ */
+void CYCLESTATS_Summarise( stCYCLESTATS_Ctx_t *const pstCtx, stCYCLESTATS_Summary_t *const pstSummary );
+
+/**
+ * @brief		Which histogram bucket a timing goes in.
+ * @param[in]	uiCycles	Difference of two CYCLES_Now reads.
+ * @return		The bucket, 0 to CYCLESTATS_NUM_BUCKETS - 1.
+ */
+uint8_t CYCLESTATS_Bucket( const uint32_t uiCycles );
+
+#endif
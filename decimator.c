@@ -0,0 +1,270 @@
+/**
+ * Combines a burst of FIFO samples into a single controller input so that the
+ * samples we pay for on the I2C bus are used rather than thrown away.
+ */
+#include "decimator.h"
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <string.h>			// memset & friends
+
+#include "vector3f.h"		// vector3f_t
+#include "fixmath.h"		// q16_t & friends
+
+// Hamming windowed sinc, cutoff at 0.1 * sample rate (76Hz for the gyro at
+// 760Hz), unity DC gain.
+static const float afFirCoeffs[ DECIMATOR_FIR_TAPS ] =
+{
+	0.005070f, 0.029358f, 0.110744f, 0.219341f, 0.270975f,
+	0.219341f, 0.110744f, 0.029358f, 0.005070f
+};
+
+// The same filter in Q15, the centre tap rounded up so the DC gain is exactly
+// one. Padded to an even length with a zero tap so it can be run two taps at
+// a time.
+#define FIR_TAPS_PADDED		( DECIMATOR_FIR_TAPS + 1 )
+
+static const int16_t aiFirCoeffsQ15[ FIR_TAPS_PADDED ] =
+{
+	166, 962, 3629, 7187, 8880,
+	7187, 3629, 962, 166, 0
+};
+
+static int32_t RunFirQ( const int16_t *piHist );
+
+/* ************************************************************************** */
+void DECIMATOR_Setup( stDECIMATOR_Cxt_t *pstCxt, const eDECIMATOR_Mode_t eMode, const float fSamplePeriod_s )
+{
+	memset( pstCxt, 0, sizeof( stDECIMATOR_Cxt_t ) );
+
+	pstCxt->eMode = eMode;
+	pstCxt->fSamplePeriod_s = fSamplePeriod_s;
+
+	return;
+}
+
+/* ************************************************************************** */
+void DECIMATOR_Push( stDECIMATOR_Cxt_t *pstCxt, const vector3f_t *const pstSample )
+{
+	pstCxt->stSum = VECTOR3F_Add( pstCxt->stSum, *pstSample );
+	pstCxt->uiCount++;
+
+	pstCxt->astHist[ pstCxt->uiHistIndex++ ] = *pstSample;
+
+	if ( DECIMATOR_FIR_TAPS == pstCxt->uiHistIndex )
+	{
+		pstCxt->uiHistIndex = 0;
+	}
+
+	if ( DECIMATOR_FIR_TAPS > pstCxt->uiHistFill )
+	{
+		pstCxt->uiHistFill++;
+	}
+
+	pstCxt->stLast = *pstSample;
+
+	return;
+}
+
+/* ************************************************************************** */
+uint16_t DECIMATOR_Output( stDECIMATOR_Cxt_t *pstCxt, vector3f_t *const pstValue, vector3f_t *const pstIntegral )
+{
+	uint16_t uiCount = pstCxt->uiCount;
+	uint16_t uiTap;
+	uint16_t uiIndex;
+	vector3f_t stValue;
+
+	if ( NULL != pstIntegral )
+	{
+		*pstIntegral = VECTOR3F_Scale( pstCxt->stSum, pstCxt->fSamplePeriod_s );
+	}
+
+	if ( 0 == uiCount )
+	{
+		// Nothing new - hold the last output
+		*pstValue = pstCxt->stOutput;
+		return 0;
+	}
+
+	switch ( pstCxt->eMode )
+	{
+		case DECIMATOR_MODE_AVERAGE:
+		{
+			stValue = VECTOR3F_Scale( pstCxt->stSum, 1.0f / uiCount );
+			break;
+		}
+
+		case DECIMATOR_MODE_FIR:
+		{
+			if ( DECIMATOR_FIR_TAPS > pstCxt->uiHistFill )
+			{
+				// Not enough history yet to run the filter
+				stValue = pstCxt->stLast;
+				break;
+			}
+
+			// Oldest sample lives at the current write index
+			memset( &stValue, 0, sizeof( stValue ) );
+			uiIndex = pstCxt->uiHistIndex;
+
+			for ( uiTap = 0; uiTap < DECIMATOR_FIR_TAPS; uiTap++ )
+			{
+				stValue.x += afFirCoeffs[ uiTap ] * pstCxt->astHist[ uiIndex ].x;
+				stValue.y += afFirCoeffs[ uiTap ] * pstCxt->astHist[ uiIndex ].y;
+				stValue.z += afFirCoeffs[ uiTap ] * pstCxt->astHist[ uiIndex ].z;
+
+				if ( DECIMATOR_FIR_TAPS == ++uiIndex )
+				{
+					uiIndex = 0;
+				}
+			}
+			break;
+		}
+
+		case DECIMATOR_MODE_LAST:
+		default:
+		{
+			stValue = pstCxt->stLast;
+			break;
+		}
+	}
+
+	pstCxt->stOutput = stValue;
+	*pstValue = stValue;
+
+	// Start accumulating the next output
+	memset( &pstCxt->stSum, 0, sizeof( pstCxt->stSum ) );
+	pstCxt->uiCount = 0;
+
+	return uiCount;
+}
+
+/* ************************************************************************** */
+void DECIMATOR_SetupQ( stDECIMATOR_Q_Cxt_t *pstCxt, const eDECIMATOR_Mode_t eMode, const q30_t qScale, const q30_t qSamplePeriod_s )
+{
+	memset( pstCxt, 0, sizeof( stDECIMATOR_Q_Cxt_t ) );
+
+	pstCxt->eMode = eMode;
+	pstCxt->qScale = qScale;
+	pstCxt->qSamplePeriod_s = qSamplePeriod_s;
+
+	return;
+}
+
+/* ************************************************************************** */
+void DECIMATOR_PushQ( stDECIMATOR_Q_Cxt_t *pstCxt, const int16_t aiSample[3] )
+{
+	uint16_t uiAxis;
+
+	for ( uiAxis = 0; uiAxis < 3; uiAxis++ )
+	{
+		pstCxt->aiSum[ uiAxis ] += aiSample[ uiAxis ];
+		pstCxt->aaiHist[ uiAxis ][ pstCxt->uiHistIndex ] = aiSample[ uiAxis ];
+		pstCxt->aaiHist[ uiAxis ][ pstCxt->uiHistIndex + DECIMATOR_FIR_TAPS ] = aiSample[ uiAxis ];
+		pstCxt->aiLast[ uiAxis ] = aiSample[ uiAxis ];
+	}
+
+	pstCxt->uiCount++;
+
+	if ( DECIMATOR_FIR_TAPS == ++pstCxt->uiHistIndex )
+	{
+		pstCxt->uiHistIndex = 0;
+	}
+
+	if ( DECIMATOR_FIR_TAPS > pstCxt->uiHistFill )
+	{
+		pstCxt->uiHistFill++;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+uint16_t DECIMATOR_OutputQ( stDECIMATOR_Q_Cxt_t *pstCxt, vector3q_t *const pstValue, vector3q_t *const pstIntegral )
+{
+	uint16_t uiCount = pstCxt->uiCount;
+	uint16_t uiAxis;
+	q16_t aqValue[3];
+
+	// Raw sums are scaled to Q16 as Q0 x Q30 >> 14
+	if ( NULL != pstIntegral )
+	{
+		pstIntegral->x = FIXMATH_MulQ16Q30( FIXMATH_MulShift( pstCxt->aiSum[0], pstCxt->qScale, 14 ), pstCxt->qSamplePeriod_s );
+		pstIntegral->y = FIXMATH_MulQ16Q30( FIXMATH_MulShift( pstCxt->aiSum[1], pstCxt->qScale, 14 ), pstCxt->qSamplePeriod_s );
+		pstIntegral->z = FIXMATH_MulQ16Q30( FIXMATH_MulShift( pstCxt->aiSum[2], pstCxt->qScale, 14 ), pstCxt->qSamplePeriod_s );
+	}
+
+	if ( 0 == uiCount )
+	{
+		// Nothing new - hold the last output
+		*pstValue = pstCxt->stOutput;
+		return 0;
+	}
+
+	for ( uiAxis = 0; uiAxis < 3; uiAxis++ )
+	{
+		switch ( pstCxt->eMode )
+		{
+			case DECIMATOR_MODE_AVERAGE:
+			{
+				aqValue[ uiAxis ] = FIXMATH_MulShift( pstCxt->aiSum[ uiAxis ], pstCxt->qScale, 14 ) / uiCount;
+				break;
+			}
+
+			case DECIMATOR_MODE_FIR:
+			{
+				if ( DECIMATOR_FIR_TAPS > pstCxt->uiHistFill )
+				{
+					// Not enough history yet to run the filter
+					aqValue[ uiAxis ] = FIXMATH_MulShift( pstCxt->aiLast[ uiAxis ], pstCxt->qScale, 14 );
+					break;
+				}
+
+				// Oldest sample lives at the current write index, the result
+				// is raw x Q15 so Q15 x Q30 >> 29 brings it to Q16
+				aqValue[ uiAxis ] = FIXMATH_MulShift( RunFirQ( &pstCxt->aaiHist[ uiAxis ][ pstCxt->uiHistIndex ] ),
+													  pstCxt->qScale, 29 );
+				break;
+			}
+
+			case DECIMATOR_MODE_LAST:
+			default:
+			{
+				aqValue[ uiAxis ] = FIXMATH_MulShift( pstCxt->aiLast[ uiAxis ], pstCxt->qScale, 14 );
+				break;
+			}
+		}
+	}
+
+	pstCxt->stOutput.x = aqValue[0];
+	pstCxt->stOutput.y = aqValue[1];
+	pstCxt->stOutput.z = aqValue[2];
+	*pstValue = pstCxt->stOutput;
+
+	// Start accumulating the next output
+	memset( pstCxt->aiSum, 0, sizeof( pstCxt->aiSum ) );
+	pstCxt->uiCount = 0;
+
+	return uiCount;
+}
+
+/* ************************************************************************** */
+static int32_t RunFirQ( const int16_t *piHist )
+{
+	int32_t iAcc = 0;
+	uint32_t uiSamples;
+	uint32_t uiCoeffs;
+	uint16_t uiTap;
+
+	// Two taps per multiply-accumulate, the window may start on an odd
+	// sample so the pairs are picked up with unaligned loads
+	for ( uiTap = 0; uiTap < FIR_TAPS_PADDED; uiTap += 2 )
+	{
+		memcpy( &uiSamples, &piHist[ uiTap ], sizeof( uiSamples ) );
+		memcpy( &uiCoeffs, &aiFirCoeffsQ15[ uiTap ], sizeof( uiCoeffs ) );
+		iAcc = FIXMATH_Smlad( uiSamples, uiCoeffs, iAcc );
+	}
+
+	return iAcc;
+}
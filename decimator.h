@@ -0,0 +1,109 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include "vector3f.h"		// vector3f_t
+#include "fixmath.h"		// q16_t & friends
+
+#define DECIMATOR_FIR_TAPS	( 9 )
+
+typedef enum
+{
+	DECIMATOR_MODE_LAST,		// Newest sample only (no filtering)
+	DECIMATOR_MODE_AVERAGE,		// Boxcar average of every sample since the last output
+	DECIMATOR_MODE_FIR,			// Low-pass FIR over the newest DECIMATOR_FIR_TAPS samples
+
+} eDECIMATOR_Mode_t;
+
+typedef struct
+{
+	eDECIMATOR_Mode_t eMode;
+	float fSamplePeriod_s;
+
+	// Accumulators since the last call to DECIMATOR_Output
+	vector3f_t stSum;
+	uint16_t uiCount;
+
+	// History of raw samples for the FIR, newest at uiHistIndex - 1
+	vector3f_t astHist[ DECIMATOR_FIR_TAPS ];
+	uint16_t uiHistIndex;
+	uint16_t uiHistFill;
+
+	vector3f_t stLast;
+	vector3f_t stOutput;
+
+} stDECIMATOR_Cxt_t;
+
+// Fixed point version, this takes the raw sensor samples and scales once on
+// output rather than per sample
+typedef struct
+{
+	eDECIMATOR_Mode_t eMode;
+	q30_t qScale;				// Output units per raw LSB
+	q30_t qSamplePeriod_s;
+
+	int32_t aiSum[3];
+	uint16_t uiCount;
+
+	// Every sample is written twice, DECIMATOR_FIR_TAPS apart, so the newest
+	// DECIMATOR_FIR_TAPS samples are always contiguous for the filter
+	int16_t aaiHist[3][ 2 * DECIMATOR_FIR_TAPS ];
+	uint16_t uiHistIndex;
+	uint16_t uiHistFill;
+
+	int16_t aiLast[3];
+	vector3q_t stOutput;
+
+} stDECIMATOR_Q_Cxt_t;
+
+/**
+ * @brief		Initialises a decimator context.
+ * @param[in]	pstCxt			The decimator context to initialise.
+ * @param[in]	eMode			How the samples are combined into one output.
+ * @param[in]	fSamplePeriod_s	Sensor sample period (1 / ODR) in seconds.
+ */
+void DECIMATOR_Setup( stDECIMATOR_Cxt_t *pstCxt, const eDECIMATOR_Mode_t eMode, const float fSamplePeriod_s );
+
+/**
+ * @brief		Feeds a single sensor sample into the decimator.
+ * @param[in]	pstCxt			The decimator context to use.
+ * @param[in]	pstSample		The sample, oldest samples must be pushed first.
+ */
+void DECIMATOR_Push( stDECIMATOR_Cxt_t *pstCxt, const vector3f_t *const pstSample );
+
+/**
+ * @brief		Produces one output from the samples pushed since the last call.
+ * @param[in]	pstCxt			The decimator context to use.
+ * @param[out]	pstValue		The filtered value, the previous value is
+ * 								repeated if no new samples arrived.
+ * @param[out]	pstIntegral		Optional, the sum of sample * sample period
+ * 								since the last call, e.g. a delta-angle for a
+ * 								gyro. May be NULL.
+ * @return		The number of samples consumed.
+ */
+uint16_t DECIMATOR_Output( stDECIMATOR_Cxt_t *pstCxt, vector3f_t *const pstValue, vector3f_t *const pstIntegral );
+
+/**
+ * @brief		Initialises a fixed point decimator context.
+ * @param[in]	pstCxt			The decimator context to initialise.
+ * @param[in]	eMode			How the samples are combined into one output.
+ * @param[in]	qScale			Output units per raw LSB, e.g. rad/s per LSB.
+ * @param[in]	qSamplePeriod_s	Sensor sample period (1 / ODR) in seconds.
+ */
+void DECIMATOR_SetupQ( stDECIMATOR_Q_Cxt_t *pstCxt, const eDECIMATOR_Mode_t eMode, const q30_t qScale, const q30_t qSamplePeriod_s );
+
+/**
+ * @brief		Feeds a single raw x/y/z sensor sample into the decimator.
+ * @param[in]	pstCxt			The decimator context to use.
+ * @param[in]	aiSample		The sample, oldest samples must be pushed first.
+ */
+void DECIMATOR_PushQ( stDECIMATOR_Q_Cxt_t *pstCxt, const int16_t aiSample[3] );
+
+/**
+ * @brief		As DECIMATOR_Output, with the outputs scaled into Q16.
+ */
+uint16_t DECIMATOR_OutputQ( stDECIMATOR_Q_Cxt_t *pstCxt, vector3q_t *const pstValue, vector3q_t *const pstIntegral );
+
+#endif
@@ -0,0 +1,79 @@
+#include "drdy.h"
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+
+/* ************************************************************************** */
+void DRDY_Create( stDRDY_Ctx_t *const pstCtx, pfnDRDY_Wake pfnWake, pfnDRDY_Level pfnLevel,
+				  void *const pvUserState )
+{
+	pstCtx->pfnWake = pfnWake;
+	pstCtx->pfnLevel = pfnLevel;
+	pstCtx->pvUserState = pvUserState;
+	pstCtx->bPending = false;
+	pstCtx->bMissed = false;
+	pstCtx->uiSignalCount = 0;
+	pstCtx->uiOverrunCount = 0;
+
+	return;
+}
+
+/* ************************************************************************** */
+void DRDY_Signal( stDRDY_Ctx_t *const pstCtx )
+{
+	pstCtx->uiSignalCount++;
+
+	if ( true == pstCtx->bPending )
+	{
+		// The consumer is still busy with the last batch, DRDY_Complete
+		// wakes it for this one
+		pstCtx->uiOverrunCount++;
+		pstCtx->bMissed = true;
+	}
+	else
+	{
+		pstCtx->bPending = true;
+
+		if ( NULL != pstCtx->pfnWake )
+		{
+			pstCtx->pfnWake( pstCtx->pvUserState );
+		}
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+void DRDY_Complete( stDRDY_Ctx_t *const pstCtx )
+{
+	bool bWaiting;
+
+	// The level is the truth where we have it, an edge counted while busy may
+	// be for data the last batch already took
+	if ( NULL != pstCtx->pfnLevel )
+	{
+		bWaiting = pstCtx->pfnLevel( pstCtx->pvUserState );
+	}
+	else
+	{
+		bWaiting = pstCtx->bMissed;
+	}
+
+	pstCtx->bMissed = false;
+
+	if ( bWaiting )
+	{
+		// Still pending, for the next batch
+		if ( NULL != pstCtx->pfnWake )
+		{
+			pstCtx->pfnWake( pstCtx->pvUserState );
+		}
+	}
+	else
+	{
+		pstCtx->bPending = false;
+	}
+
+	return;
+}
@@ -0,0 +1,61 @@
+#ifndef DRDY_H
+#define DRDY_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+
+typedef void (*pfnDRDY_Wake)( void *const pvUserState );
+typedef bool (*pfnDRDY_Level)( void *const pvUserState );
+
+typedef struct
+{
+	pfnDRDY_Wake pfnWake;
+	pfnDRDY_Level pfnLevel;
+	void *pvUserState;
+
+	volatile bool bPending;
+	volatile bool bMissed;
+	volatile uint32_t uiSignalCount;
+	volatile uint32_t uiOverrunCount;
+
+} stDRDY_Ctx_t;
+
+/**
+ * @brief		Initialises a data ready context. This holds no hardware
+ * 				knowledge, the interrupt source (a pin ISR on target or a
+ * 				simulated source on the host) simply calls DRDY_Signal.
+ * @param[in]	pstCtx		The data ready context to initialise.
+ * @param[in]	pfnWake		Called from interrupt context to wake the consumer.
+ * @param[in]	pfnLevel	Optional, returns the level of the data ready line
+ * 							so DRDY_Complete can tell data is waiting without
+ * 							an edge. NULL to rely on the edges alone.
+ * @param[in]	pvUserState	The state to pass back to the callbacks.
+ */
+void DRDY_Create( stDRDY_Ctx_t *const pstCtx, pfnDRDY_Wake pfnWake, pfnDRDY_Level pfnLevel,
+				  void *const pvUserState );
+
+/**
+ * @brief		Signals that new data is ready, call from interrupt context.
+ * 				The consumer is only woken if it has completed the previous
+ * 				batch, otherwise an overrun is counted and DRDY_Complete wakes
+ * 				it again straight away.
+ * @param[in]	pstCtx		The data ready context to use.
+ */
+void DRDY_Signal( stDRDY_Ctx_t *const pstCtx );
+
+/**
+ * @brief		Called by the consumer once it has finished processing a batch
+ * 				and is about to wait for the next one, with the interrupt that
+ * 				calls DRDY_Signal masked.
+ *
+ * A line that stays high, as a FIFO watermark does while data is left over,
+ * makes no new edge. So if data is already waiting, by the line's level or
+ * failing that an overrun since the last wake, the consumer is woken again
+ * here rather than left waiting for an edge that won't come.
+ *
+ * @param[in]	pstCtx		The data ready context to use.
+ */
+void DRDY_Complete( stDRDY_Ctx_t *const pstCtx );
+
+#endif
@@ -0,0 +1,427 @@
+/**
+ * Multiplicative EKF for attitude, see ekf.h.
+ */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// NULL
+#include <string.h>			// memset & friends
+#include <math.h>			// cosf & friends, levelling off is libm
+
+#include "ekf.h"
+#include "vector3f.h"
+#include "fastmath.h"
+
+#define PI					( 3.14159265359f )
+
+// Starting uncertainty, the attitude after levelling off the accelerometer
+#define P0_ANGLE			( 0.01f )		// rad^2
+#define P0_BIAS				( 0.0025f )		// (rad/s)^2
+
+#define R_MAG				( 0.05f )		// rad^2
+
+// The accelerometer only measures gravity when nothing else is pushing
+#define ACCEL_MIN_G			( 0.5f )
+#define ACCEL_MAX_G			( 1.5f )
+
+// Element i, j of the covariance from its upper triangle, either way round
+#define P( i, j )			afP[ aauiTri[ (i) ][ (j) ] ]
+
+static void Predict( stEKF_Cxt_t *pstCxt, const vector3f_t *pstDelta, const float fTimestep_s );
+static void FuseScalar( stEKF_Cxt_t *pstCxt, float afErr[ EKF_NUM_STATES ], const float afH[3], const float fInnov, const float fR );
+static void FuseAccel( stEKF_Cxt_t *pstCxt, float afErr[ EKF_NUM_STATES ], const vector3f_t *pstAccel );
+static void FuseMag( stEKF_Cxt_t *pstCxt, float afErr[ EKF_NUM_STATES ], const vector3f_t *pstMag );
+static void ApplyError( stEKF_Cxt_t *pstCxt, const float afErr[ EKF_NUM_STATES ] );
+static void Level( stEKF_Cxt_t *pstCxt, const vector3f_t *pstAccel );
+static void Normalise( float afQuat[4] );
+static float WrapPi( float fAngle );
+
+static const uint8_t aauiTri[ EKF_NUM_STATES ][ EKF_NUM_STATES ] =
+{
+	{  0,  1,  2,  3,  4,  5 },
+	{  1,  6,  7,  8,  9, 10 },
+	{  2,  7, 11, 12, 13, 14 },
+	{  3,  8, 12, 15, 16, 17 },
+	{  4,  9, 13, 16, 18, 19 },
+	{  5, 10, 14, 17, 19, 20 },
+};
+
+/* ************************************************************************** */
+void EKF_Setup( stEKF_Cxt_t *pstCxt )
+{
+	float *afP = pstCxt->afP;
+	int i;
+
+	memset( pstCxt, 0, sizeof( stEKF_Cxt_t ) );
+
+	// As KALMAN_Setup
+	pstCxt->fQAngle = 0.001f;
+	pstCxt->fQBias = 0.003f;
+	pstCxt->fRAccel = 0.03f;
+	pstCxt->fRMag = R_MAG;
+
+	pstCxt->afQuat[0] = 1.0f;
+
+	for ( i = 0; i < 3; i++ )
+	{
+		P( i, i ) = P0_ANGLE;
+		P( i + 3, i + 3 ) = P0_BIAS;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+void EKF_SetNoise( stEKF_Cxt_t *pstCxt, const float fQAngle, const float fQBias, const float fRMeasure )
+{
+	pstCxt->fQAngle = fQAngle;
+	pstCxt->fQBias = fQBias;
+	pstCxt->fRAccel = fRMeasure;
+
+	return;
+}
+
+/* ************************************************************************** */
+void EKF_Update( stEKF_Cxt_t *pstCxt,
+				 const vector3f_t *pstGyroDelta,
+				 const vector3f_t *pstAccel,
+				 const vector3f_t *pstMag,
+				 const float fTimestep_s )
+{
+	float afErr[ EKF_NUM_STATES ] = { 0, };
+	vector3f_t stDelta;
+
+	if ( !pstCxt->bStarted )
+	{
+		Level( pstCxt, pstAccel );
+		pstCxt->bStarted = true;
+	}
+
+	stDelta.x = pstGyroDelta->x - ( pstCxt->stBias.x * fTimestep_s );
+	stDelta.y = pstGyroDelta->y - ( pstCxt->stBias.y * fTimestep_s );
+	stDelta.z = pstGyroDelta->z - ( pstCxt->stBias.z * fTimestep_s );
+
+	Predict( pstCxt, &stDelta, fTimestep_s );
+
+	// Each measurement adds to the same error, which is applied once at the end
+	FuseAccel( pstCxt, afErr, pstAccel );
+
+	if ( NULL != pstMag )
+	{
+		FuseMag( pstCxt, afErr, pstMag );
+	}
+
+	ApplyError( pstCxt, afErr );
+
+	return;
+}
+
+/* ************************************************************************** */
+void EKF_GetEuler( const stEKF_Cxt_t *pstCxt, vector3f_t *pstRotation )
+{
+	const float *q = pstCxt->afQuat;
+	// FASTMATH_Asin clamps the sine, rounding can take it just past 1 at +-90
+	// degrees
+	pstRotation->x = FASTMATH_Atan2( 2.0f * ( ( q[0] * q[1] ) + ( q[2] * q[3] ) ), 1.0f - ( 2.0f * ( ( q[1] * q[1] ) + ( q[2] * q[2] ) ) ) );
+	pstRotation->y = FASTMATH_Asin( 2.0f * ( ( q[0] * q[2] ) - ( q[3] * q[1] ) ) );
+	pstRotation->z = FASTMATH_Atan2( 2.0f * ( ( q[0] * q[3] ) + ( q[1] * q[2] ) ), 1.0f - ( 2.0f * ( ( q[2] * q[2] ) + ( q[3] * q[3] ) ) ) );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void Predict( stEKF_Cxt_t *pstCxt, const vector3f_t *pstDelta, const float fTimestep_s )
+{
+	float *q = pstCxt->afQuat;
+	float *afP = pstCxt->afP;
+	float dx = pstDelta->x;
+	float dy = pstDelta->y;
+	float dz = pstDelta->z;
+	float fDt = fTimestep_s;
+	float fAngleSq = ( dx * dx ) + ( dy * dy ) + ( dz * dz );
+	float fCos = 1.0f - ( fAngleSq / 8.0f );				// cos( |d| / 2 )
+	float fSin = 0.5f * ( 1.0f - ( fAngleSq / 24.0f ) );	// sin( |d| / 2 ) / |d|
+	float afQ[4];
+	float aafA[3][3];		// Rotation error block of P
+	float aafB[3][3];		// Rotation error against bias block
+	float aafFA[3][3];
+	float aafFB[3][3];
+	int i;
+	int j;
+
+	// q = q * [ cos( |d| / 2 ), sin( |d| / 2 ) d / |d| ], second order
+	afQ[0] = ( q[0] * fCos ) - ( fSin * ( ( q[1] * dx ) + ( q[2] * dy ) + ( q[3] * dz ) ) );
+	afQ[1] = ( q[1] * fCos ) + ( fSin * ( ( q[0] * dx ) + ( q[2] * dz ) - ( q[3] * dy ) ) );
+	afQ[2] = ( q[2] * fCos ) + ( fSin * ( ( q[0] * dy ) - ( q[1] * dz ) + ( q[3] * dx ) ) );
+	afQ[3] = ( q[3] * fCos ) + ( fSin * ( ( q[0] * dz ) + ( q[1] * dy ) - ( q[2] * dx ) ) );
+	memcpy( q, afQ, sizeof( afQ ) );
+	Normalise( q );
+
+	// The error moves as F = [ I - [d x]  -dt I ]
+	//                        [ 0           I    ]
+	// so with P = [ A B; B' C ] the new blocks are
+	//   A = F A F' - dt ( F B + B' F' ) + dt^2 C + Q_angle dt
+	//   B = F B - dt C
+	//   C = C + Q_bias dt
+	// where F here is I - [d x], only the upper triangles of A and C are kept.
+	for ( i = 0; i < 3; i++ )
+	{
+		for ( j = 0; j < 3; j++ )
+		{
+			aafA[i][j] = P( i, j );
+			aafB[i][j] = P( i, j + 3 );
+		}
+	}
+
+	// F A and F B, rows of [d x] M are ( dy M2 - dz M1, dz M0 - dx M2, dx M1 - dy M0 )
+	for ( j = 0; j < 3; j++ )
+	{
+		aafFA[0][j] = aafA[0][j] - ( ( dy * aafA[2][j] ) - ( dz * aafA[1][j] ) );
+		aafFA[1][j] = aafA[1][j] - ( ( dz * aafA[0][j] ) - ( dx * aafA[2][j] ) );
+		aafFA[2][j] = aafA[2][j] - ( ( dx * aafA[1][j] ) - ( dy * aafA[0][j] ) );
+		aafFB[0][j] = aafB[0][j] - ( ( dy * aafB[2][j] ) - ( dz * aafB[1][j] ) );
+		aafFB[1][j] = aafB[1][j] - ( ( dz * aafB[0][j] ) - ( dx * aafB[2][j] ) );
+		aafFB[2][j] = aafB[2][j] - ( ( dx * aafB[1][j] ) - ( dy * aafB[0][j] ) );
+	}
+
+	// ( F A ) F' = F A + ( F A ) [d x], columns of M [d x] are
+	// ( M1 dz - M2 dy, M2 dx - M0 dz, M0 dy - M1 dx )
+	for ( i = 0; i < 3; i++ )
+	{
+		const float *m = aafFA[i];
+		float afRow[3];
+
+		afRow[0] = m[0] + ( ( m[1] * dz ) - ( m[2] * dy ) );
+		afRow[1] = m[1] + ( ( m[2] * dx ) - ( m[0] * dz ) );
+		afRow[2] = m[2] + ( ( m[0] * dy ) - ( m[1] * dx ) );
+
+		for ( j = i; j < 3; j++ )
+		{
+			P( i, j ) = afRow[j] - ( fDt * ( aafFB[i][j] + aafFB[j][i] ) ) + ( fDt * fDt * P( i + 3, j + 3 ) );
+		}
+
+		P( i, i ) += pstCxt->fQAngle * fDt;
+	}
+
+	for ( i = 0; i < 3; i++ )
+	{
+		for ( j = 0; j < 3; j++ )
+		{
+			P( i, j + 3 ) = aafFB[i][j] - ( fDt * P( i + 3, j + 3 ) );
+		}
+
+		P( i + 3, i + 3 ) += pstCxt->fQBias * fDt;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void FuseScalar( stEKF_Cxt_t *pstCxt, float afErr[ EKF_NUM_STATES ], const float afH[3], const float fInnov, const float fR )
+{
+	float *afP = pstCxt->afP;
+	float afPHt[ EKF_NUM_STATES ];
+	float fS;
+	float fInvS;
+	float fResidual;
+	int i;
+	int j;
+
+	// Every measurement here sees only the rotation error, so H is zero past
+	// the first three states and P H' is the first three columns of P
+	for ( i = 0; i < EKF_NUM_STATES; i++ )
+	{
+		afPHt[i] = ( P( i, 0 ) * afH[0] ) + ( P( i, 1 ) * afH[1] ) + ( P( i, 2 ) * afH[2] );
+	}
+
+	fS = ( afH[0] * afPHt[0] ) + ( afH[1] * afPHt[1] ) + ( afH[2] * afPHt[2] ) + fR;
+	fInvS = 1.0f / fS;
+
+	// Less what the error so far already explains
+	fResidual = fInnov - ( ( afH[0] * afErr[0] ) + ( afH[1] * afErr[1] ) + ( afH[2] * afErr[2] ) );
+
+	// K = P H' / S, err += K r, P -= K H P = P H' ( P H' )' / S
+	for ( i = 0; i < EKF_NUM_STATES; i++ )
+	{
+		float fK = afPHt[i] * fInvS;
+
+		afErr[i] += fK * fResidual;
+
+		for ( j = i; j < EKF_NUM_STATES; j++ )
+		{
+			P( i, j ) -= fK * afPHt[j];
+		}
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void FuseAccel( stEKF_Cxt_t *pstCxt, float afErr[ EKF_NUM_STATES ], const vector3f_t *pstAccel )
+{
+	const float *q = pstCxt->afQuat;
+	float fNorm = FASTMATH_Sqrt( ( pstAccel->x * pstAccel->x ) + ( pstAccel->y * pstAccel->y ) + ( pstAccel->z * pstAccel->z ) );
+	float fInvNorm;
+	float gx;
+	float gy;
+	float gz;
+	float afH[3];
+
+	if ( ( ACCEL_MIN_G > fNorm ) || ( ACCEL_MAX_G < fNorm ) )
+	{
+		return;
+	}
+
+	fInvNorm = 1.0f / fNorm;
+
+	// Where gravity should be in the body, the bottom row of the rotation
+	gx = 2.0f * ( ( q[1] * q[3] ) - ( q[0] * q[2] ) );
+	gy = 2.0f * ( ( q[2] * q[3] ) + ( q[0] * q[1] ) );
+	gz = ( q[0] * q[0] ) - ( q[1] * q[1] ) - ( q[2] * q[2] ) + ( q[3] * q[3] );
+
+	// A rotation error e moves it by g x e, so H is the rows of [g x]
+	afH[0] = 0;
+	afH[1] = -gz;
+	afH[2] = gy;
+	FuseScalar( pstCxt, afErr, afH, ( pstAccel->x * fInvNorm ) - gx, pstCxt->fRAccel );
+
+	afH[0] = gz;
+	afH[1] = 0;
+	afH[2] = -gx;
+	FuseScalar( pstCxt, afErr, afH, ( pstAccel->y * fInvNorm ) - gy, pstCxt->fRAccel );
+
+	afH[0] = -gy;
+	afH[1] = gx;
+	afH[2] = 0;
+	FuseScalar( pstCxt, afErr, afH, ( pstAccel->z * fInvNorm ) - gz, pstCxt->fRAccel );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void FuseMag( stEKF_Cxt_t *pstCxt, float afErr[ EKF_NUM_STATES ], const vector3f_t *pstMag )
+{
+	const float *q = pstCxt->afQuat;
+	float fNorthX;
+	float fNorthY;
+	float fHeading;
+	float afH[3];
+
+	// The field in the level plane, the top two rows of the rotation
+	fNorthX = ( ( 1.0f - ( 2.0f * ( ( q[2] * q[2] ) + ( q[3] * q[3] ) ) ) ) * pstMag->x )
+			+ ( 2.0f * ( ( q[1] * q[2] ) - ( q[0] * q[3] ) ) * pstMag->y )
+			+ ( 2.0f * ( ( q[1] * q[3] ) + ( q[0] * q[2] ) ) * pstMag->z );
+	fNorthY = ( 2.0f * ( ( q[1] * q[2] ) + ( q[0] * q[3] ) ) * pstMag->x )
+			+ ( ( 1.0f - ( 2.0f * ( ( q[1] * q[1] ) + ( q[3] * q[3] ) ) ) ) * pstMag->y )
+			+ ( 2.0f * ( ( q[2] * q[3] ) - ( q[0] * q[1] ) ) * pstMag->z );
+
+	// No reading, or straight up and down
+	if ( 1e-12f > ( fNorthX * fNorthX ) + ( fNorthY * fNorthY ) )
+	{
+		return;
+	}
+
+	fHeading = FASTMATH_Atan2( fNorthY, fNorthX );
+
+	if ( !pstCxt->bMagHeading )
+	{
+		pstCxt->fMagHeading = fHeading;
+		pstCxt->bMagHeading = true;
+		return;
+	}
+
+	// The world frame yaw error is the body error through the bottom row of
+	// the rotation, and an estimate yawed by e sees the field turned by -e
+	afH[0] = 2.0f * ( ( q[1] * q[3] ) - ( q[0] * q[2] ) );
+	afH[1] = 2.0f * ( ( q[2] * q[3] ) + ( q[0] * q[1] ) );
+	afH[2] = ( q[0] * q[0] ) - ( q[1] * q[1] ) - ( q[2] * q[2] ) + ( q[3] * q[3] );
+	FuseScalar( pstCxt, afErr, afH, WrapPi( pstCxt->fMagHeading - fHeading ), pstCxt->fRMag );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void ApplyError( stEKF_Cxt_t *pstCxt, const float afErr[ EKF_NUM_STATES ] )
+{
+	float *q = pstCxt->afQuat;
+	float ex = 0.5f * afErr[0];
+	float ey = 0.5f * afErr[1];
+	float ez = 0.5f * afErr[2];
+	float afQ[4];
+
+	// q = q * [ 1, e / 2 ]
+	afQ[0] = q[0] - ( ( q[1] * ex ) + ( q[2] * ey ) + ( q[3] * ez ) );
+	afQ[1] = q[1] + ( ( q[0] * ex ) + ( q[2] * ez ) - ( q[3] * ey ) );
+	afQ[2] = q[2] + ( ( q[0] * ey ) - ( q[1] * ez ) + ( q[3] * ex ) );
+	afQ[3] = q[3] + ( ( q[0] * ez ) + ( q[1] * ey ) - ( q[2] * ex ) );
+	memcpy( q, afQ, sizeof( afQ ) );
+	Normalise( q );
+
+	pstCxt->stBias.x += afErr[3];
+	pstCxt->stBias.y += afErr[4];
+	pstCxt->stBias.z += afErr[5];
+
+	return;
+}
+
+/* ************************************************************************** */
+static void Level( stEKF_Cxt_t *pstCxt, const vector3f_t *pstAccel )
+{
+	float *q = pstCxt->afQuat;
+	float fRoll;
+	float fPitch;
+	float fCosRoll;
+	float fSinRoll;
+	float fCosPitch;
+	float fSinPitch;
+
+	// Start level if there is no sensible reading to go on
+	if ( 0 == ( pstAccel->x * pstAccel->x ) + ( pstAccel->y * pstAccel->y ) + ( pstAccel->z * pstAccel->z ) )
+	{
+		return;
+	}
+
+	fRoll = atan2f( pstAccel->y, pstAccel->z );
+	fPitch = atan2f( -pstAccel->x, sqrtf( ( pstAccel->y * pstAccel->y ) + ( pstAccel->z * pstAccel->z ) ) );
+
+	fCosRoll = cosf( fRoll / 2 );
+	fSinRoll = sinf( fRoll / 2 );
+	fCosPitch = cosf( fPitch / 2 );
+	fSinPitch = sinf( fPitch / 2 );
+
+	// Roll then pitch, yaw zero
+	q[0] = fCosRoll * fCosPitch;
+	q[1] = fSinRoll * fCosPitch;
+	q[2] = fCosRoll * fSinPitch;
+	q[3] = -fSinRoll * fSinPitch;
+
+	return;
+}
+
+/* ************************************************************************** */
+static void Normalise( float afQuat[4] )
+{
+	float fInvNorm = FASTMATH_InvSqrt( ( afQuat[0] * afQuat[0] ) + ( afQuat[1] * afQuat[1] )
+									   + ( afQuat[2] * afQuat[2] ) + ( afQuat[3] * afQuat[3] ) );
+
+	afQuat[0] *= fInvNorm;
+	afQuat[1] *= fInvNorm;
+	afQuat[2] *= fInvNorm;
+	afQuat[3] *= fInvNorm;
+
+	return;
+}
+
+/* ************************************************************************** */
+static float WrapPi( float fAngle )
+{
+	if ( PI < fAngle )
+	{
+		fAngle -= 2 * PI;
+	}
+	else if ( -PI > fAngle )
+	{
+		fAngle += 2 * PI;
+	}
+
+	return fAngle;
+}
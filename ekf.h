@@ -0,0 +1,84 @@
+#ifndef EKF_H
+#define EKF_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include "vector3f.h"		// vector3f_t
+
+/*
+ * Multiplicative extended Kalman filter for attitude. The state is the body to
+ * world quaternion plus the gyro bias, seven values, but the covariance is kept
+ * over a small body frame rotation error and the bias error, six. After each
+ * update the error is folded back into the quaternion, which so stays unit
+ * length and never has to be constrained inside the filter.
+ *
+ * The gyro delta angle drives the prediction. The accelerometer corrects roll
+ * and pitch against gravity and the magnetometer corrects yaw alone, through
+ * its heading in the level plane, so a magnetic disturbance can't tilt the
+ * estimate. Yaw is zero at the heading the first update sees.
+ *
+ * The covariance is symmetric so only its upper triangle is stored and
+ * updated, and every measurement is fused as a scalar so there is no matrix
+ * to invert.
+ */
+
+#define EKF_NUM_STATES		( 6 )	// Rotation error x y z, gyro bias x y z
+#define EKF_P_LEN			( ( EKF_NUM_STATES * ( EKF_NUM_STATES + 1 ) ) / 2 )
+
+typedef struct
+{
+	// Tuning, as the KALMAN_ filter's so the same numbers fit either
+	float fQAngle;			// Gyro angle noise, rad^2 per second
+	float fQBias;			// Gyro bias random walk, (rad/s)^2 per second
+	float fRAccel;			// Gravity direction noise per axis, rad^2
+	float fRMag;			// Heading noise, rad^2
+
+	float afQuat[4];		// Body to world, w x y z
+	vector3f_t stBias;		// rad/s, subtracted from the gyro
+	float afP[ EKF_P_LEN ];	// Upper triangle, row by row
+
+	float fMagHeading;		// Heading of the field at yaw zero
+	bool bMagHeading;
+	bool bStarted;
+
+} stEKF_Cxt_t;
+
+/**
+ * @brief		Resets the filter, it levels itself off the first accelerometer
+ * 				reading it is given.
+ * @param[out]	pstCxt		Filter context.
+ */
+void EKF_Setup( stEKF_Cxt_t *pstCxt );
+
+/**
+ * @brief		Sets the noise, as KALMAN_SetNoise. The magnetometer's is kept.
+ * @param[in]	pstCxt		Filter context.
+ * @param[in]	fQAngle		Gyro angle noise, rad^2 per second.
+ * @param[in]	fQBias		Gyro bias random walk, (rad/s)^2 per second.
+ * @param[in]	fRMeasure	Accelerometer noise, rad^2.
+ */
+void EKF_SetNoise( stEKF_Cxt_t *pstCxt, const float fQAngle, const float fQBias, const float fRMeasure );
+
+/**
+ * @brief		Predicts over one timestep and corrects with the accelerometer
+ * 				and magnetometer.
+ * @param[in]	pstCxt		Filter context.
+ * @param[in]	pstGyroDelta	Rotation over the timestep, rad.
+ * @param[in]	pstAccel	Accelerometer in g, skipped unless near 1g.
+ * @param[in]	pstMag		Magnetometer, any scale, NULL or zero to skip.
+ * @param[in]	fTimestep_s	The timestep.
+ */
+void EKF_Update( stEKF_Cxt_t *pstCxt,
+				 const vector3f_t *pstGyroDelta,
+				 const vector3f_t *pstAccel,
+				 const vector3f_t *pstMag,
+				 const float fTimestep_s );
+
+/**
+ * @brief		Attitude as roll, pitch and yaw.
+ * @param[in]	pstCxt		Filter context.
+ * @param[out]	pstRotation	x roll, y pitch, z yaw in radians.
+ */
+void EKF_GetEuler( const stEKF_Cxt_t *pstCxt, vector3f_t *pstRotation );
+
+#endif
@@ -0,0 +1,115 @@
+#include "executive.h"
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <string.h>			// memset
+
+#include "cycles.h"			// Cycle counter
+
+/* ************************************************************************** */
+void EXECUTIVE_Create( stEXECUTIVE_Ctx_t *const pstCtx )
+{
+	memset( pstCtx, 0, sizeof( stEXECUTIVE_Ctx_t ) );
+
+	// Safe to call more than once, the stages are timed with it
+	CYCLES_Setup();
+
+	return;
+}
+
+/* ************************************************************************** */
+int EXECUTIVE_AddStage( stEXECUTIVE_Ctx_t *const pstCtx, const char *const pcName, pfnEXECUTIVE_Stage pfnRun,
+						void *const pvUserState, const uint16_t uiDivider, const uint16_t uiPhase,
+						const uint32_t uiBudget_us )
+{
+	stEXECUTIVE_Stage_t *pstStage;
+
+	if ( ( EXECUTIVE_MAX_STAGES <= pstCtx->uiNumStages ) || ( uiPhase >= uiDivider ) )
+	{
+		return -1;
+	}
+
+	pstStage = &pstCtx->astStages[ pstCtx->uiNumStages ];
+	memset( pstStage, 0, sizeof( stEXECUTIVE_Stage_t ) );
+	pstStage->pcName = pcName;
+	pstStage->pfnRun = pfnRun;
+	pstStage->pvUserState = pvUserState;
+	pstStage->uiDivider = uiDivider;
+	pstStage->uiPhase = uiPhase;
+	pstStage->uiBudgetCycles = uiBudget_us * CYCLES_PerUs();
+	CYCLESTATS_Create( &pstStage->stCycles );
+
+	return pstCtx->uiNumStages++;
+}
+
+/* ************************************************************************** */
+void EXECUTIVE_Tick( stEXECUTIVE_Ctx_t *const pstCtx, const uint32_t uiTimestep_us )
+{
+	stEXECUTIVE_Stage_t *pstStage;
+	uint32_t uiStart;
+	uint32_t uiCycles;
+	uint8_t uiIndex;
+
+	for ( uiIndex = 0; uiIndex < pstCtx->uiNumStages; uiIndex++ )
+	{
+		pstStage = &pstCtx->astStages[ uiIndex ];
+		pstStage->uiTimestep_us += uiTimestep_us;
+
+		if ( pstStage->uiPhase != ( pstCtx->uiTick % pstStage->uiDivider ) )
+		{
+			continue;
+		}
+
+		uiStart = CYCLES_Now();
+		pstStage->pfnRun( pstStage->pvUserState, pstStage->uiTimestep_us );
+		uiCycles = CYCLES_Now() - uiStart;
+
+		pstStage->uiTimestep_us = 0;
+		pstStage->uiRunCount++;
+		pstStage->uiLastCycles = uiCycles;
+		CYCLESTATS_Add( &pstStage->stCycles, uiCycles );
+
+		if ( uiCycles > pstStage->uiBudgetCycles )
+		{
+			pstStage->uiOverrunCount++;
+		}
+	}
+
+	pstCtx->uiTick++;
+
+	return;
+}
+
+/* ************************************************************************** */
+bool EXECUTIVE_IsDueNext( const stEXECUTIVE_Ctx_t *const pstCtx, const int iStage )
+{
+	const stEXECUTIVE_Stage_t *pstStage = EXECUTIVE_GetStage( pstCtx, iStage );
+
+	return ( NULL != pstStage ) && ( pstStage->uiPhase == ( pstCtx->uiTick % pstStage->uiDivider ) );
+}
+
+/* ************************************************************************** */
+void EXECUTIVE_TakeCycleStats( stEXECUTIVE_Ctx_t *const pstCtx, const int iStage, stCYCLESTATS_Summary_t *const pstSummary )
+{
+	if ( NULL == EXECUTIVE_GetStage( pstCtx, iStage ) )
+	{
+		memset( pstSummary, 0, sizeof( stCYCLESTATS_Summary_t ) );
+		return;
+	}
+
+	CYCLESTATS_Summarise( &pstCtx->astStages[ iStage ].stCycles, pstSummary );
+
+	return;
+}
+
+/* ************************************************************************** */
+const stEXECUTIVE_Stage_t *EXECUTIVE_GetStage( const stEXECUTIVE_Ctx_t *const pstCtx, const int iStage )
+{
+	if ( ( 0 > iStage ) || ( pstCtx->uiNumStages <= iStage ) )
+	{
+		return NULL;
+	}
+
+	return &pstCtx->astStages[ iStage ];
+}
@@ -0,0 +1,108 @@
+#ifndef EXECUTIVE_H
+#define EXECUTIVE_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+
+#include "cyclestats.h"		// Run time histograms
+
+/*
+ * Multi-rate executive. Something with a steady pace (the flight task, woken
+ * by the gyro) calls EXECUTIVE_Tick once per period and each stage runs on
+ * every uiDivider'th tick, in the order they were added, so the fastest and
+ * most latency sensitive stage should go first. The phase picks which of
+ * those ticks, so slow stages can be kept off the ticks that are already
+ * busy. A stage is told the time since it last ran, the tick timesteps
+ * summed.
+ *
+ * Every run is timed with the cycle counter (cycles.h) against the stage's
+ * budget, a run over budget is counted as an overrun, and goes into the
+ * stage's run time histogram. This holds no hardware
+ * or OS knowledge so it builds on the host as well as the target.
+ */
+
+#define EXECUTIVE_MAX_STAGES	( 8 )
+
+typedef void (*pfnEXECUTIVE_Stage)( void *const pvUserState, const uint32_t uiTimestep_us );
+
+typedef struct
+{
+	const char *pcName;
+	pfnEXECUTIVE_Stage pfnRun;
+	void *pvUserState;
+	uint16_t uiDivider;			// Runs every uiDivider'th tick
+	uint16_t uiPhase;			// Those where tick % uiDivider == uiPhase
+	uint32_t uiBudgetCycles;	// CYCLES_Now counts a run may take
+	uint32_t uiTimestep_us;		// Since it last ran
+
+	uint32_t uiRunCount;
+	uint32_t uiOverrunCount;	// Runs over budget
+	uint32_t uiLastCycles;
+	stCYCLESTATS_Ctx_t stCycles;	// Run times since EXECUTIVE_TakeCycleStats
+
+} stEXECUTIVE_Stage_t;
+
+typedef struct
+{
+	stEXECUTIVE_Stage_t astStages[ EXECUTIVE_MAX_STAGES ];
+	uint8_t uiNumStages;
+	uint32_t uiTick;			// Ticks run so far
+
+} stEXECUTIVE_Ctx_t;
+
+/**
+ * @brief		Initialises an executive with no stages.
+ * @param[in]	pstCtx		The executive context to initialise.
+ */
+void EXECUTIVE_Create( stEXECUTIVE_Ctx_t *const pstCtx );
+
+/**
+ * @brief		Adds a stage.
+ * @param[in]	pstCtx		The executive context to use.
+ * @param[in]	pcName		Name for reporting, not copied.
+ * @param[in]	pfnRun		Called on every uiDivider'th tick.
+ * @param[in]	pvUserState	The state to pass back to pfnRun.
+ * @param[in]	uiDivider	Ticks per run, at least 1.
+ * @param[in]	uiPhase		Which tick of each uiDivider it runs on, from 0.
+ * @param[in]	uiBudget_us	How long a run may take before it is counted
+ * 							as an overrun.
+ * @return		The stage's index, or -1 if there is no room or the divider
+ * 				and phase don't make sense.
+ */
+int EXECUTIVE_AddStage( stEXECUTIVE_Ctx_t *const pstCtx, const char *const pcName, pfnEXECUTIVE_Stage pfnRun,
+						void *const pvUserState, const uint16_t uiDivider, const uint16_t uiPhase,
+						const uint32_t uiBudget_us );
+
+/**
+ * @brief		Runs the stages due this tick.
+ * @param[in]	pstCtx		The executive context to use.
+ * @param[in]	uiTimestep_us	Time since the last tick.
+ */
+void EXECUTIVE_Tick( stEXECUTIVE_Ctx_t *const pstCtx, const uint32_t uiTimestep_us );
+
+/**
+ * @brief		Whether a stage will run on the next tick, so its inputs can
+ * 				be fetched ahead of it.
+ * @param[in]	pstCtx		The executive context to use.
+ * @param[in]	iStage		Index from EXECUTIVE_AddStage.
+ */
+bool EXECUTIVE_IsDueNext( const stEXECUTIVE_Ctx_t *const pstCtx, const int iStage );
+
+/**
+ * @brief		Summarises a stage's run times since this was last called and
+ * 				starts it counting afresh.
+ * @param[in]	pstCtx		The executive context to use.
+ * @param[in]	iStage		Index from EXECUTIVE_AddStage.
+ * @param[out]	pstSummary	The stage's run times, zeros for no such stage.
+ */
+void EXECUTIVE_TakeCycleStats( stEXECUTIVE_Ctx_t *const pstCtx, const int iStage, stCYCLESTATS_Summary_t *const pstSummary );
+
+/**
+ * @brief		A stage's timings and counters, NULL for no such stage.
+ * @param[in]	pstCtx		The executive context to use.
+ * @param[in]	iStage		Index from EXECUTIVE_AddStage.
+ */
+const stEXECUTIVE_Stage_t *EXECUTIVE_GetStage( const stEXECUTIVE_Ctx_t *const pstCtx, const int iStage );
+
+#endif
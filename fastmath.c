@@ -0,0 +1,115 @@
+#include "fastmath.h"
+
+#include <stdint.h>			// std types
+#include <string.h>			// memcpy
+
+#define PI						( 3.14159265359f )
+#define PI_2					( 1.57079632679f )
+
+// atan(z) on [0, 1], Abramowitz and Stegun 4.4.49, |error| <= 1e-5
+#define ATAN_A1					( 0.9998660f )
+#define ATAN_A3					( -0.3302995f )
+#define ATAN_A5					( 0.1801410f )
+#define ATAN_A7					( -0.0851330f )
+#define ATAN_A9					( 0.0208351f )
+
+// asin(x) on [0, 1] as pi/2 - sqrt(1 - x) p(x), Abramowitz and Stegun 4.4.46,
+// |error| <= 2e-8. The shorter 4.4.45 (see FIXMATH_Asin) is 7e-5 out at zero,
+// which is where level flight sits.
+#define ASIN_A0					( 1.5707963050f )
+#define ASIN_A1					( -0.2145988016f )
+#define ASIN_A2					( 0.0889789874f )
+#define ASIN_A3					( -0.0501743046f )
+#define ASIN_A4					( 0.0308918810f )
+#define ASIN_A5					( -0.0170881256f )
+#define ASIN_A6					( 0.0066700901f )
+#define ASIN_A7					( -0.0012624911f )
+
+// First guess at 1 / sqrt( x ) from the bit pattern, within 3.5%
+#define INVSQRT_MAGIC			( 0x5F375A86 )
+
+/* ************************************************************************** */
+float FASTMATH_Atan2( const float y, const float x )
+{
+	float fAbsX = ( 0 > x ) ? -x : x;
+	float fAbsY = ( 0 > y ) ? -y : y;
+	float fRatio;
+	float fRatio2;
+	float fAngle;
+
+	if ( ( 0 == fAbsX ) && ( 0 == fAbsY ) )
+	{
+		return 0;
+	}
+
+	// Fold into the first octant so the ratio is in [0, 1]
+	if ( fAbsY > fAbsX )
+	{
+		fRatio = fAbsX / fAbsY;
+		fRatio2 = fRatio * fRatio;
+		fAngle = PI_2 - ( fRatio * ( ATAN_A1 + ( fRatio2 * ( ATAN_A3 + ( fRatio2 * ( ATAN_A5
+				 + ( fRatio2 * ( ATAN_A7 + ( fRatio2 * ATAN_A9 ) ) ) ) ) ) ) ) );
+	}
+	else
+	{
+		fRatio = fAbsY / fAbsX;
+		fRatio2 = fRatio * fRatio;
+		fAngle = fRatio * ( ATAN_A1 + ( fRatio2 * ( ATAN_A3 + ( fRatio2 * ( ATAN_A5
+				 + ( fRatio2 * ( ATAN_A7 + ( fRatio2 * ATAN_A9 ) ) ) ) ) ) ) );
+	}
+
+	// And back out to the right quadrant
+	if ( 0 > x )
+	{
+		fAngle = PI - fAngle;
+	}
+
+	return ( 0 > y ) ? -fAngle : fAngle;
+}
+
+/* ************************************************************************** */
+float FASTMATH_Asin( const float x )
+{
+	float fAbsX = ( 0 > x ) ? -x : x;
+	float fAngle;
+
+	if ( 1.0f < fAbsX )
+	{
+		fAbsX = 1.0f;
+	}
+
+	fAngle = ASIN_A4 + ( fAbsX * ( ASIN_A5 + ( fAbsX * ( ASIN_A6 + ( fAbsX * ASIN_A7 ) ) ) ) );
+	fAngle = ASIN_A0 + ( fAbsX * ( ASIN_A1 + ( fAbsX * ( ASIN_A2 + ( fAbsX * ( ASIN_A3 + ( fAbsX * fAngle ) ) ) ) ) ) );
+	fAngle = PI_2 - ( FASTMATH_Sqrt( 1.0f - fAbsX ) * fAngle );
+
+	return ( 0 > x ) ? -fAngle : fAngle;
+}
+
+/* ************************************************************************** */
+float FASTMATH_Sqrt( const float x )
+{
+	if ( 0 >= x )
+	{
+		return 0;
+	}
+
+	return x * FASTMATH_InvSqrt( x );
+}
+
+/* ************************************************************************** */
+float FASTMATH_InvSqrt( const float x )
+{
+	float fHalfX = 0.5f * x;
+	float y;
+	int32_t iBits;
+
+	memcpy( &iBits, &x, sizeof( iBits ) );
+	iBits = INVSQRT_MAGIC - ( iBits >> 1 );
+	memcpy( &y, &iBits, sizeof( y ) );
+
+	// Each Newton step squares the relative error, 3.5% -> 0.18% -> 5e-6
+	y = y * ( 1.5f - ( fHalfX * y * y ) );
+	y = y * ( 1.5f - ( fHalfX * y * y ) );
+
+	return y;
+}
@@ -0,0 +1,47 @@
+#ifndef FASTMATH_H
+#define FASTMATH_H
+
+/*
+ * Approximations of the libm functions the attitude estimators lean on. The
+ * K20 has no FPU and newlib's atan2f, asinf and sqrtf are written for
+ * accuracy to the last bit, each costs thousands of cycles in libgcc float
+ * calls. These are a handful of multiplies (and for atan2 one divide) with a
+ * known worst case error, far below the noise of the sensors they are fed.
+ *
+ * The bounds are checked over every float in the reduced range of each
+ * function by host/test_fastmath.c, which is where the numbers below come
+ * from. Inputs are expected to be finite and, for the square roots, normal.
+ *
+ * The Q16 forms are in fixmath.h, FIXMATH_Atan2, FIXMATH_Asin, FIXMATH_Sqrt
+ * and FIXMATH_InvSqrt.
+ */
+
+#define FASTMATH_ATAN2_MAX_ERR		( 1.2e-5f )		// rad
+#define FASTMATH_ASIN_MAX_ERR		( 8.0e-6f )		// rad
+#define FASTMATH_SQRT_MAX_REL_ERR	( 5.0e-6f )
+#define FASTMATH_INVSQRT_MAX_REL_ERR	( 5.0e-6f )
+
+/**
+ * @brief		Four quadrant arctangent of y / x, as atan2f(). 0 when both are
+ * 				zero.
+ */
+float FASTMATH_Atan2( const float y, const float x );
+
+/**
+ * @brief		Arcsine, as asinf(). The input is clamped to [-1, 1] so a sine
+ * 				rounded a hair past 1 gives +-pi/2 rather than NaN.
+ */
+float FASTMATH_Asin( const float x );
+
+/**
+ * @brief		Square root, as sqrtf(). 0 for zero or negative input.
+ */
+float FASTMATH_Sqrt( const float x );
+
+/**
+ * @brief		1 / sqrt( x ) for positive x, for normalising vectors without
+ * 				a divide.
+ */
+float FASTMATH_InvSqrt( const float x );
+
+#endif
@@ -0,0 +1,224 @@
+#include "fixmath.h"
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+
+// Coefficients of the arctangent approximation on [0, 1], see FIXMATH_Atan2
+#define ATAN_PI_4				FIXMATH_Q16( 0.78539816340 )
+#define ATAN_A					FIXMATH_Q16( 0.2447 )
+#define ATAN_B					FIXMATH_Q16( 0.0663 )
+
+// Arcsine on [0, 1], Abramowitz and Stegun 4.4.45, see FIXMATH_Asin
+#define ASIN_A0					FIXMATH_Q16( 1.5707288 )
+#define ASIN_A1					FIXMATH_Q16( -0.2121144 )
+#define ASIN_A2					FIXMATH_Q16( 0.0742610 )
+#define ASIN_A3					FIXMATH_Q16( -0.0187293 )
+
+// First guess at 1 / sqrt( m ) for m in [0.25, 1), ISQRT_A - ISQRT_B m in Q30
+// (both are past the range of a q30_t), within 8.7%
+#define ISQRT_A					( (uint64_t)( 2.130 * 1073741824.0 ) )
+#define ISQRT_B					( (uint64_t)( 1.215 * 1073741824.0 ) )
+#define ISQRT_STEPS				( 3 )
+
+static int32_t DivShift( const int32_t a, const int32_t b, const uint32_t uiShift );
+static int32_t Abs( const int32_t a );
+static uint32_t Normalise( const q16_t a, int32_t *piScale );
+static uint64_t InvSqrtQ30( const uint32_t uiNorm );
+static uint64_t ShiftRound( const uint64_t uiValue, const uint32_t uiShift );
+
+/* ************************************************************************** */
+q16_t FIXMATH_Div( q16_t a, q16_t b )
+{
+	return DivShift( a, b, 16 );
+}
+
+/* ************************************************************************** */
+q30_t FIXMATH_Div30( q30_t a, q30_t b )
+{
+	return DivShift( a, b, 30 );
+}
+
+/* ************************************************************************** */
+q16_t FIXMATH_Sqrt( q16_t a )
+{
+	uint32_t uiNorm;
+	uint64_t uiRoot;
+	int32_t iScale;
+
+	if ( 0 >= a )
+	{
+		return 0;
+	}
+
+	// sqrt( a ) = sqrt( m ) y, with y = 1 / sqrt( m ), by 2^-iScale
+	uiNorm = Normalise( a, &iScale );
+	uiRoot = ( (uint64_t)uiNorm * InvSqrtQ30( uiNorm ) ) >> 30;
+
+	return (q16_t)ShiftRound( uiRoot, (uint32_t)( 14 + iScale ) );
+}
+
+/* ************************************************************************** */
+q16_t FIXMATH_InvSqrt( q16_t a )
+{
+	uint32_t uiNorm;
+	int32_t iScale;
+
+	if ( 0 >= a )
+	{
+		return INT32_MAX;
+	}
+
+	uiNorm = Normalise( a, &iScale );
+
+	return (q16_t)ShiftRound( InvSqrtQ30( uiNorm ), (uint32_t)( 14 - iScale ) );
+}
+
+/* ************************************************************************** */
+q16_t FIXMATH_Asin( q16_t a )
+{
+	q16_t qAbs = Abs( a );
+	q16_t qAngle;
+
+	if ( FIXMATH_Q16_ONE < qAbs )
+	{
+		qAbs = FIXMATH_Q16_ONE;
+	}
+
+	// asin(x) ~= pi/2 - sqrt(1 - x) (a0 + a1 x + a2 x^2 + a3 x^3)
+	qAngle = FIXMATH_PI_2 - FIXMATH_Mul( FIXMATH_Sqrt( FIXMATH_Q16_ONE - qAbs ),
+										 ASIN_A0 + FIXMATH_Mul( qAbs, ASIN_A1 + FIXMATH_Mul( qAbs,
+										 ASIN_A2 + FIXMATH_Mul( qAbs, ASIN_A3 ) ) ) );
+
+	return ( 0 > a ) ? -qAngle : qAngle;
+}
+
+/* ************************************************************************** */
+q16_t FIXMATH_Atan2( q16_t y, q16_t x )
+{
+	int32_t iAbsX = Abs( x );
+	int32_t iAbsY = Abs( y );
+	q16_t qRatio;
+	q16_t qAngle;
+	bool bSwapped;
+
+	if ( ( 0 == iAbsX ) && ( 0 == iAbsY ) )
+	{
+		return 0;
+	}
+
+	// Fold into the first octant so the ratio is in [0, 1]
+	bSwapped = ( iAbsY > iAbsX );
+	qRatio = bSwapped ? FIXMATH_Div( iAbsX, iAbsY ) : FIXMATH_Div( iAbsY, iAbsX );
+
+	// atan(z) ~= pi/4 z - z (z - 1) (0.2447 + 0.0663 z), max error 0.0016 rad
+	qAngle = FIXMATH_Mul( ATAN_PI_4, qRatio )
+			 - FIXMATH_Mul( FIXMATH_Mul( qRatio, qRatio - FIXMATH_Q16_ONE ),
+							ATAN_A + FIXMATH_Mul( ATAN_B, qRatio ) );
+
+	// And back out to the right quadrant
+	if ( bSwapped )
+	{
+		qAngle = FIXMATH_PI_2 - qAngle;
+	}
+
+	if ( 0 > x )
+	{
+		qAngle = FIXMATH_PI - qAngle;
+	}
+
+	return ( 0 > y ) ? -qAngle : qAngle;
+}
+
+/* ************************************************************************** */
+q16_t FIXMATH_FromFloat( const float f )
+{
+	return (q16_t)( ( f * 65536.0f ) + ( ( f >= 0 ) ? 0.5f : -0.5f ) );
+}
+
+/* ************************************************************************** */
+q30_t FIXMATH_FromFloat30( const float f )
+{
+	return (q30_t)( ( f * 1073741824.0f ) + ( ( f >= 0 ) ? 0.5f : -0.5f ) );
+}
+
+/* ************************************************************************** */
+float FIXMATH_ToFloat( const q16_t q )
+{
+	return (float)q / 65536.0f;
+}
+
+/* ************************************************************************** */
+static int32_t DivShift( const int32_t a, const int32_t b, const uint32_t uiShift )
+{
+	int64_t iResult;
+
+	if ( 0 == b )
+	{
+		return ( 0 > a ) ? INT32_MIN : INT32_MAX;
+	}
+
+	iResult = ( (int64_t)a * ( (int64_t)1 << uiShift ) ) / b;
+
+	if ( INT32_MAX < iResult )
+	{
+		return INT32_MAX;
+	}
+	else if ( INT32_MIN > iResult )
+	{
+		return INT32_MIN;
+	}
+
+	return (int32_t)iResult;
+}
+
+/* ************************************************************************** */
+static int32_t Abs( const int32_t a )
+{
+	// -INT32_MIN doesn't fit, one step short is close enough
+	if ( INT32_MIN == a )
+	{
+		return INT32_MAX;
+	}
+
+	return ( 0 > a ) ? -a : a;
+}
+
+/* ************************************************************************** */
+static uint32_t Normalise( const q16_t a, int32_t *piScale )
+{
+	// An even shift that puts a (> 0) in [2^28, 2^30), a Q30 value m in
+	// [0.25, 1). The value of a is then m 2^( -2 iScale ), and its root and
+	// inverse root m's by 2^-iScale and 2^iScale
+	int32_t iShift = __builtin_clz( (uint32_t)a ) - 2;
+
+	iShift &= ~1;
+	*piScale = ( iShift - 14 ) / 2;
+
+	return ( 0 <= iShift ) ? ( (uint32_t)a << iShift ) : ( (uint32_t)a >> -iShift );
+}
+
+/* ************************************************************************** */
+static uint64_t InvSqrtQ30( const uint32_t uiNorm )
+{
+	// 1 / sqrt( m ) in Q30, (1, 2], a linear guess then Newton's
+	// y = y ( 3 - m y^2 ) / 2, each step squares the error, 8.7% -> 1% -> 2e-4
+	// -> 6e-8
+	uint64_t uiY = ISQRT_A - ( ( ISQRT_B * uiNorm ) >> 30 );
+	uint64_t uiMY2;
+	uint32_t uiStep;
+
+	for ( uiStep = 0; uiStep < ISQRT_STEPS; uiStep++ )
+	{
+		uiMY2 = ( uiNorm * ( ( uiY * uiY ) >> 30 ) ) >> 30;
+		uiY = ( uiY * ( ( (uint64_t)3 << 30 ) - uiMY2 ) ) >> 31;
+	}
+
+	return uiY;
+}
+
+/* ************************************************************************** */
+static uint64_t ShiftRound( const uint64_t uiValue, const uint32_t uiShift )
+{
+	return ( uiValue + ( (uint64_t)1 << ( uiShift - 1 ) ) ) >> uiShift;
+}
@@ -0,0 +1,180 @@
+#ifndef FIXMATH_H
+#define FIXMATH_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+
+/*
+ * Fixed point arithmetic for the estimation and control chain. The K20 has no
+ * FPU so every float operation is a libgcc call, these are all integer and
+ * use the Cortex-M4 DSP instructions where they help (saturating add and
+ * subtract, dual 16 bit multiply-accumulate). A plain C version of each is
+ * used on anything else so the same code can be checked on the host.
+ *
+ * Two formats are used:
+ *   q16_t	Q15.16, for angles (rad), rates (rad/s), accelerations (g), stick
+ *   		inputs, PID gains and motor demands. Range +-32768, step 1.5e-5.
+ *   q30_t	Q1.30, for small values that need the resolution, the timestep,
+ *   		Kalman covariances and gains. Range +-2, step 9.3e-10.
+ */
+
+typedef int32_t q16_t;
+typedef int32_t q30_t;
+
+typedef struct
+{
+	q16_t x;
+	q16_t y;
+	q16_t z;
+
+} vector3q_t;
+
+#define FIXMATH_Q16_ONE			( (q16_t)1 << 16 )
+#define FIXMATH_Q30_ONE			( (q30_t)1 << 30 )
+
+// Constant conversions, for use on literals so they fold at compile time
+#define FIXMATH_Q16( f )		( (q16_t)( ( f ) * 65536.0 + ( ( f ) >= 0 ? 0.5 : -0.5 ) ) )
+#define FIXMATH_Q30( f )		( (q30_t)( ( f ) * 1073741824.0 + ( ( f ) >= 0 ? 0.5 : -0.5 ) ) )
+
+#define FIXMATH_PI				FIXMATH_Q16( 3.14159265359 )
+#define FIXMATH_PI_2			FIXMATH_Q16( 1.57079632679 )
+
+// Worst case error of the approximations below, as checked over every input
+// by host/test_fastmath.c
+#define FIXMATH_ATAN2_MAX_ERR	FIXMATH_Q16( 0.0016 )
+#define FIXMATH_ASIN_MAX_ERR	FIXMATH_Q16( 0.0001 )
+#define FIXMATH_SQRT_MAX_ERR	( 1 )
+#define FIXMATH_INVSQRT_MAX_ERR	( 1 )
+
+// These must be inlined even at -O0 or the call costs more than the sum
+#define FIXMATH_INLINE			static inline __attribute__(( always_inline ))
+
+/**
+ * @brief		Saturating add, a single QADD on the target.
+ */
+FIXMATH_INLINE int32_t FIXMATH_Add( int32_t a, int32_t b )
+{
+#if defined( __ARM_FEATURE_DSP )
+	int32_t iResult;
+	__asm__ ( "qadd %0, %1, %2" : "=r" ( iResult ) : "r" ( a ), "r" ( b ) );
+	return iResult;
+#else
+	int64_t iResult = (int64_t)a + b;
+	return ( iResult > INT32_MAX ) ? INT32_MAX : ( iResult < INT32_MIN ) ? INT32_MIN : (int32_t)iResult;
+#endif
+}
+
+/**
+ * @brief		Saturating subtract, a single QSUB on the target.
+ */
+FIXMATH_INLINE int32_t FIXMATH_Sub( int32_t a, int32_t b )
+{
+#if defined( __ARM_FEATURE_DSP )
+	int32_t iResult;
+	__asm__ ( "qsub %0, %1, %2" : "=r" ( iResult ) : "r" ( a ), "r" ( b ) );
+	return iResult;
+#else
+	int64_t iResult = (int64_t)a - b;
+	return ( iResult > INT32_MAX ) ? INT32_MAX : ( iResult < INT32_MIN ) ? INT32_MIN : (int32_t)iResult;
+#endif
+}
+
+/**
+ * @brief		Multiplies two values and shifts the 64 bit product right by
+ * 				uiShift with rounding, an SMULL and a shift on the target. The
+ * 				result is not saturated, callers keep their ranges in bounds.
+ */
+FIXMATH_INLINE int32_t FIXMATH_MulShift( int32_t a, int32_t b, const uint32_t uiShift )
+{
+	return (int32_t)( ( (int64_t)a * b + ( (int64_t)1 << ( uiShift - 1 ) ) ) >> uiShift );
+}
+
+/**
+ * @brief		Q16 x Q16 -> Q16.
+ */
+FIXMATH_INLINE q16_t FIXMATH_Mul( q16_t a, q16_t b )
+{
+	return FIXMATH_MulShift( a, b, 16 );
+}
+
+/**
+ * @brief		Q30 x Q30 -> Q30.
+ */
+FIXMATH_INLINE q30_t FIXMATH_Mul30( q30_t a, q30_t b )
+{
+	return FIXMATH_MulShift( a, b, 30 );
+}
+
+/**
+ * @brief		Q16 x Q30 -> Q16, e.g. a rate by the timestep or an error by a
+ * 				Kalman gain.
+ */
+FIXMATH_INLINE q16_t FIXMATH_MulQ16Q30( q16_t a, q30_t b )
+{
+	return FIXMATH_MulShift( a, b, 30 );
+}
+
+/**
+ * @brief		Dual signed 16 bit multiply-accumulate, iAcc + x.lo * y.lo +
+ * 				x.hi * y.hi. A single SMLAD on the target.
+ */
+FIXMATH_INLINE int32_t FIXMATH_Smlad( uint32_t x, uint32_t y, int32_t iAcc )
+{
+#if defined( __ARM_FEATURE_DSP )
+	int32_t iResult;
+	__asm__ ( "smlad %0, %1, %2, %3" : "=r" ( iResult ) : "r" ( x ), "r" ( y ), "r" ( iAcc ) );
+	return iResult;
+#else
+	return iAcc + ( (int32_t)(int16_t)x * (int16_t)y )
+				+ ( (int32_t)(int16_t)( x >> 16 ) * (int16_t)( y >> 16 ) );
+#endif
+}
+
+/**
+ * @brief		Q16 / Q16 -> Q16, saturated. Dividing by zero gives the
+ * 				largest value of the numerator's sign.
+ */
+q16_t FIXMATH_Div( q16_t a, q16_t b );
+
+/**
+ * @brief		Q30 / Q30 -> Q30, saturated. For ratios such as a Kalman gain
+ * 				that are known to be within +-2.
+ */
+q30_t FIXMATH_Div30( q30_t a, q30_t b );
+
+/**
+ * @brief		Square root of a Q16 value, 0 for negative input. Within
+ * 				FIXMATH_SQRT_MAX_ERR LSBs of the exact root.
+ */
+q16_t FIXMATH_Sqrt( q16_t a );
+
+/**
+ * @brief		1 / sqrt( a ) of a positive Q16 value, the largest value for
+ * 				zero or negative input. Within FIXMATH_INVSQRT_MAX_ERR LSBs of
+ * 				the exact result.
+ */
+q16_t FIXMATH_InvSqrt( q16_t a );
+
+/**
+ * @brief		Arcsine of a Q16 value in Q16 radians, the input is clamped to
+ * 				[-1, 1]. Within FIXMATH_ASIN_MAX_ERR of asinf().
+ */
+q16_t FIXMATH_Asin( q16_t a );
+
+/**
+ * @brief		Four quadrant arctangent of y / x in Q16 radians. The result
+ * 				is within FIXMATH_ATAN2_MAX_ERR, 0.0016 rad (0.09 deg), of
+ * 				atan2f().
+ */
+q16_t FIXMATH_Atan2( q16_t y, q16_t x );
+
+/**
+ * @brief		Runtime conversions, for values such as parameters that arrive
+ * 				as floats. Keep these out of the per-loop path.
+ */
+q16_t FIXMATH_FromFloat( const float f );
+q30_t FIXMATH_FromFloat30( const float f );
+float FIXMATH_ToFloat( const q16_t q );
+
+#endif
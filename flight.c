@@ -8,6 +8,9 @@
 #include "vector3f.h"
 #include "sensor_fusion.h"
 #include "pid.h"
+#include "kalman.h"
+#include "fixmath.h"
+#include "io_driver.h"		// RECEIVER_ ranges
 
 #define PIDGAIN_RATE_YAW_I (0)
 #define PIDGAIN_RATE_YAW_P (0)
@@ -22,36 +25,47 @@
 #define PIDGAIN_ANGLE_D (0)
 
 #define THRESHOLD_THROT_FLIGHT		( 0.1f )
+#define THRESHOLD_THROT_FLIGHT_Q	FIXMATH_Q16( 0.1 )
 
-// PID structures
-static stPidCxt_t stPIDPitchRate;
-static stPidCxt_t stPIDPitchAngle;
-static stPidCxt_t stPIDRollRate;
-static stPidCxt_t stPIDRollAngle;
-static stPidCxt_t stPIDYawRate;
+// Pulse widths come in above RECEIVER_FLOOR, so this is where the sticks centre
+#define RECEIVER_PULSE_CENTRE		( RECEIVER_CENTER - RECEIVER_FLOOR )
+#define RECEIVER_PULSE_HALF_RANGE	( RECEIVER_RANGE / 2 )
 
-static stSENSORFUSION_Cxt_t stSensorFusion;
+// Microseconds to a Q30 timestep, multiplied by 2^50 / 10^6 and shifted down
+#define US_TO_Q30_SHIFT				( 20 )
+#define US_TO_Q30					( ( (uint64_t)1 << ( 30 + US_TO_Q30_SHIFT ) ) / 1000000 )
 
-static vector3f_t stTrim;
-static uint32_t _uiTimestamp;
-static vector3f_t stRotation;
+static void GetTimestepQ( const uint32_t uiTimestep_us, q30_t *pqTimeStep, q16_t *pqInvTimeStep );
 
 /* ************************************************************************** */
-void flight_setup( void )
+void flight_setup( stFLIGHT_Cxt_t *pstCxt )
 {
+	memset( pstCxt, 0, sizeof( stFLIGHT_Cxt_t ) );
+
 	// Set up our sensor function module
-	SENSORFUSION_Setup( &stSensorFusion );
+	SENSORFUSION_Setup( &pstCxt->stSensorFusion );
 
 	// Initialise PIDs
-	PID_Setup( &stPIDPitchAngle, PIDGAIN_ANGLE_I, PIDGAIN_ANGLE_P, PIDGAIN_ANGLE_D, 0, 0 );
-	PID_Setup( &stPIDPitchRate, PIDGAIN_RATE_I, PIDGAIN_RATE_P, PIDGAIN_RATE_D, 0, 0 );
+	PID_Setup( &pstCxt->stPIDPitchAngle, PIDGAIN_ANGLE_I, PIDGAIN_ANGLE_P, PIDGAIN_ANGLE_D, 0, 0 );
+	PID_Setup( &pstCxt->stPIDPitchRate, PIDGAIN_RATE_I, PIDGAIN_RATE_P, PIDGAIN_RATE_D, 0, 0 );
+
+	PID_Setup( &pstCxt->stPIDRollAngle, PIDGAIN_ANGLE_I, PIDGAIN_ANGLE_P, PIDGAIN_ANGLE_D, 0, 0 );
+	PID_Setup( &pstCxt->stPIDRollRate, PIDGAIN_RATE_I, PIDGAIN_RATE_P, PIDGAIN_RATE_D, 0, 0 );
+
+	PID_Setup( &pstCxt->stPIDYawRate, PIDGAIN_RATE_YAW_I, PIDGAIN_RATE_YAW_P, PIDGAIN_RATE_YAW_D, 0, 0 );
 
-	PID_Setup( &stPIDRollAngle, PIDGAIN_ANGLE_I, PIDGAIN_ANGLE_P, PIDGAIN_ANGLE_D, 0, 0 );
-	PID_Setup( &stPIDRollRate, PIDGAIN_RATE_I, PIDGAIN_RATE_P, PIDGAIN_RATE_D, 0, 0 );
+	// And the same again for the fixed point controller
+	SENSORFUSION_SetupQ( &pstCxt->stSensorFusionQ );
 
-	PID_Setup( &stPIDYawRate, PIDGAIN_RATE_YAW_I, PIDGAIN_RATE_YAW_P, PIDGAIN_RATE_YAW_D, 0, 0 );
+	PID_SetupQ( &pstCxt->stPIDPitchAngleQ, FIXMATH_Q16( PIDGAIN_ANGLE_I ), FIXMATH_Q16( PIDGAIN_ANGLE_P ), FIXMATH_Q16( PIDGAIN_ANGLE_D ), 0, 0 );
+	PID_SetupQ( &pstCxt->stPIDPitchRateQ, FIXMATH_Q16( PIDGAIN_RATE_I ), FIXMATH_Q16( PIDGAIN_RATE_P ), FIXMATH_Q16( PIDGAIN_RATE_D ), 0, 0 );
 
-	_uiTimestamp = 0;
+	PID_SetupQ( &pstCxt->stPIDRollAngleQ, FIXMATH_Q16( PIDGAIN_ANGLE_I ), FIXMATH_Q16( PIDGAIN_ANGLE_P ), FIXMATH_Q16( PIDGAIN_ANGLE_D ), 0, 0 );
+	PID_SetupQ( &pstCxt->stPIDRollRateQ, FIXMATH_Q16( PIDGAIN_RATE_I ), FIXMATH_Q16( PIDGAIN_RATE_P ), FIXMATH_Q16( PIDGAIN_RATE_D ), 0, 0 );
+
+	PID_SetupQ( &pstCxt->stPIDYawRateQ, FIXMATH_Q16( PIDGAIN_RATE_YAW_I ), FIXMATH_Q16( PIDGAIN_RATE_YAW_P ), FIXMATH_Q16( PIDGAIN_RATE_YAW_D ), 0, 0 );
+
+	pstCxt->uiTimestamp = 0;
 
 	return;
 }
@@ -86,59 +100,121 @@ void flight_setup( void )
  * RX5 = VRB
  */
 /* ************************************************************************** */
-void flight_process( uint16_t uiTimestep,
+void flight_process( stFLIGHT_Cxt_t *pstCxt,
+					 uint32_t uiTimestep_us,
 					 vector3f_t *pstAccel,
 					 vector3f_t *pstGyro,
+					 vector3f_t *pstGyroDelta,
 					 vector3f_t *pstMag,
 					 stReceiverInput_t *pstReceiverInput,
 					 stMotorDemands_t *pstMotorDemands )
 {
-	float fTimeStep;
-	static uint16_t uiDecimation;
-
-	float fAngleErrRoll;
-	float fAngleErrPitch;
-
-	float fRateTargetRoll;
-	float fRateTargetPitch;
+	// Every stage at the one rate
+	FLIGHT_UpdateAttitude( pstCxt, uiTimestep_us, pstAccel, pstGyro, pstGyroDelta, pstMag );
+	FLIGHT_UpdateAngle( pstCxt, uiTimestep_us, pstReceiverInput );
+	FLIGHT_UpdateRate( pstCxt, uiTimestep_us, pstGyro, pstReceiverInput, pstMotorDemands );
 
-	float fRateErrRoll;
-	float fRateErrPitch;
-	float fRateErrYaw;
-
-	float fAccelTargetRoll;
-	float fAccelTargetPitch;
-	float fAccelTargetYaw;
+	return;
+}
 
+/* ************************************************************************** */
+void FLIGHT_UpdateAttitude( stFLIGHT_Cxt_t *pstCxt,
+							uint32_t uiTimestep_us,
+							vector3f_t *pstAccel,
+							vector3f_t *pstGyro,
+							vector3f_t *pstGyroDelta,
+							vector3f_t *pstMag )
+{
 	// Work out the timestep as a float
-	fTimeStep = ( (float)uiTimestep / 1000 );
-	_uiTimestamp += uiTimestep;
+	float fTimeStep = ( (float)uiTimestep_us / 1000000 );
 
 	// Update sensor fusion module
-	SENSORFUSION_Update( &stSensorFusion,
+	SENSORFUSION_Update( &pstCxt->stSensorFusion,
 						 pstGyro,
+						 pstGyroDelta,
 						 pstAccel,
 						 pstMag,
-						 &stRotation,
+						 &pstCxt->stRotation,
 						 fTimeStep );
 
 	// Apply trim
-	stRotation = VECTOR3F_Subtract( stRotation, stTrim );
+	pstCxt->stRotation = VECTOR3F_Subtract( pstCxt->stRotation, pstCxt->stTrim );
 
 	// TODO Remove debug code
 #if 0
+	static uint16_t uiDecimation;
 	if ( 100 <= uiDecimation++ )
 	{
 		uiDecimation = 0;
 		printf( "Angle = %d: %d, %d, %d\r\n",
-				(int)_uiTimestamp,
-				(int)( ( stRotation.x ) * 1000 ),
-				(int)( ( stRotation.y ) * 1000 ),
-				(int)( ( stRotation.z ) * 1000 )
+				(int)pstCxt->uiTimestamp,
+				(int)( ( pstCxt->stRotation.x ) * 1000 ),
+				(int)( ( pstCxt->stRotation.y ) * 1000 ),
+				(int)( ( pstCxt->stRotation.z ) * 1000 )
 				);
 	}
 #endif
 
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHT_UpdateAngle( stFLIGHT_Cxt_t *pstCxt,
+						 uint32_t uiTimestep_us,
+						 const stReceiverInput_t *pstReceiverInput )
+{
+	float fTimeStep = ( (float)uiTimestep_us / 1000000 );
+	float fAngleErrRoll;
+	float fAngleErrPitch;
+
+	// If throttle is small.. don't fly, and don't wind anything up either
+	if ( THRESHOLD_THROT_FLIGHT > pstReceiverInput->fThrottle )
+	{
+		pstCxt->stRateTarget.x = 0.0f;
+		pstCxt->stRateTarget.y = 0.0f;
+
+		return;
+	}
+
+	// Calculate roll and pitch errors
+	// These are the equal to the pitch and roll inputs from the receiver
+	// minus the actual pitch and roll inputs from the IMU.
+	// The inputs from the roll and elevation stick is multiplied by the VRA
+	// input to allow an element of adjustment. The max requested angle
+	// is +- 0.5 radians which is around +-30 degrees.
+	fAngleErrRoll = ( ( pstReceiverInput->fRoll * pstReceiverInput->fVarA ) - pstCxt->stRotation.x );
+	fAngleErrPitch = ( ( pstReceiverInput->fPitch * pstReceiverInput->fVarA ) - pstCxt->stRotation.y );
+
+	// Update the PIDs
+	// First we feed our angular error to the "angle" PID which will give us
+	// the desired angular speed we need to achieve in order to fix the
+	// angular error.
+	pstCxt->stRateTarget.x = PID_Update( &pstCxt->stPIDRollAngle, fAngleErrRoll, fTimeStep );
+	pstCxt->stRateTarget.y = PID_Update( &pstCxt->stPIDPitchAngle, fAngleErrPitch, fTimeStep );
+
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHT_UpdateRate( stFLIGHT_Cxt_t *pstCxt,
+						uint32_t uiTimestep_us,
+						const vector3f_t *pstGyro,
+						const stReceiverInput_t *pstReceiverInput,
+						stMotorDemands_t *pstMotorDemands )
+{
+	float fTimeStep;
+
+	float fRateErrRoll;
+	float fRateErrPitch;
+	float fRateErrYaw;
+
+	float fAccelTargetRoll;
+	float fAccelTargetPitch;
+	float fAccelTargetYaw;
+
+	fTimeStep = ( (float)uiTimestep_us / 1000000 );
+	pstCxt->uiTimestamp += uiTimestep_us;
+
 	// If throttle is small.. don't fly
 	if ( THRESHOLD_THROT_FLIGHT > pstReceiverInput->fThrottle )
 	{
@@ -152,37 +228,21 @@ void flight_process( uint16_t uiTimestep,
 	{
 		// Throttle is significant - let's fly!
 
-		// Calculate roll and pitch errors
-		// These are the equal to the pitch and roll inputs from the receiver
-		// minus the actual pitch and roll inputs from the IMU.
-		// The inputs from the roll and elevation stick is multiplied by the VRA
-		// input to allow an element of adjustment. The max requested angle
-		// is +- 0.5 radians which is around +-30 degrees.
-		fAngleErrRoll = ( ( pstReceiverInput->fRoll * pstReceiverInput->fVarA ) - stRotation.x );
-		fAngleErrPitch = ( ( pstReceiverInput->fPitch * pstReceiverInput->fVarA ) - stRotation.y );
-
-		// Update the PIDs
-		// First we feed our angular error to the "angle" PID which will give us
-		// the desired angular speed we need to achieve in order to fix the
-		// angular error.
-		fRateTargetRoll = PID_Update( &stPIDRollAngle, fAngleErrRoll, fTimeStep );
-		fRateTargetPitch = PID_Update( &stPIDPitchAngle, fAngleErrPitch, fTimeStep );
-
-		// Then we find the difference between this desired angular speed and
-		// the current angular speed (from the gyroscope) to obtain an error
-		// factor in the current angular speed.
+		// Then we find the difference between the desired angular speed from
+		// the angle PIDs and the current angular speed (from the gyroscope)
+		// to obtain an error factor in the current angular speed.
 		// For example if we are rotating exactly at the desired angular speed,
 		// then this error will be 0 and no offset needs to be applied to the
 		// motors in this axis.
-		fRateErrRoll = ( -fRateTargetRoll + pstGyro->x );
-		fRateErrPitch = ( -fRateTargetPitch + pstGyro->y );
+		fRateErrRoll = ( -pstCxt->stRateTarget.x + pstGyro->x );
+		fRateErrPitch = ( -pstCxt->stRateTarget.y + pstGyro->y );
 		fRateErrYaw = ( ( pstReceiverInput->fYaw * pstReceiverInput->fVarA ) + pstGyro->z );
 
 		// The result of this PID will give us the desired angular acceleration
 		// which we can feed directly to the motors.
-		fAccelTargetRoll = PID_Update( &stPIDRollRate, fRateErrRoll, fTimeStep );
-		fAccelTargetPitch = PID_Update( &stPIDPitchRate, fRateErrPitch, fTimeStep );
-		fAccelTargetYaw = PID_Update( &stPIDYawRate, fRateErrYaw + pstGyro->z, fTimeStep );
+		fAccelTargetRoll = PID_Update( &pstCxt->stPIDRollRate, fRateErrRoll, fTimeStep );
+		fAccelTargetPitch = PID_Update( &pstCxt->stPIDPitchRate, fRateErrPitch, fTimeStep );
+		fAccelTargetYaw = PID_Update( &pstCxt->stPIDYawRate, fRateErrYaw + pstGyro->z, fTimeStep );
 
 		// Set the motor values with offsets applied
 		pstMotorDemands->fFL = ( pstReceiverInput->fThrottle + fAccelTargetPitch - fAccelTargetRoll + fAccelTargetYaw );
@@ -195,30 +255,278 @@ void flight_process( uint16_t uiTimestep,
 }
 
 /* ************************************************************************** */
-void FLIGHT_SetTrim( const vector3f_t *const pstTrim )
+void flight_process_q( stFLIGHT_Cxt_t *pstCxt,
+					   uint32_t uiTimestep_us,
+					   const vector3q_t *pstAccel,
+					   const vector3q_t *pstGyro,
+					   const vector3q_t *pstGyroDelta,
+					   const stReceiverInputQ_t *pstReceiverInput,
+					   stMotorDemandsQ_t *pstMotorDemands )
 {
-	memcpy( &stTrim, pstTrim, sizeof( vector3f_t ) );
+	FLIGHT_UpdateAttitudeQ( pstCxt, uiTimestep_us, pstAccel, pstGyro, pstGyroDelta );
+	FLIGHT_UpdateAngleQ( pstCxt, uiTimestep_us, pstReceiverInput );
+	FLIGHT_UpdateRateQ( pstCxt, uiTimestep_us, pstGyro, pstReceiverInput, pstMotorDemands );
 
 	return;
 }
 
 /* ************************************************************************** */
-void FLIGHT_SetPidGains( const float fRateP, const float fRateD, const float fAngleP )
+void FLIGHT_UpdateAttitudeQ( stFLIGHT_Cxt_t *pstCxt,
+							 uint32_t uiTimestep_us,
+							 const vector3q_t *pstAccel,
+							 const vector3q_t *pstGyro,
+							 const vector3q_t *pstGyroDelta )
 {
-	PID_SetGains( &stPIDPitchRate, fRateP, fRateD, 0 );
-	PID_SetGains( &stPIDRollRate, fRateP, fRateD, 0 );
-	//PID_SetGains( stPIDYawRate, fRateP, fRateD, 0 );
+	q30_t qTimeStep;
+	q16_t qInvTimeStep;
+
+	GetTimestepQ( uiTimestep_us, &qTimeStep, &qInvTimeStep );
 
-	PID_SetGains( &stPIDPitchAngle, fAngleP, 0, 0 );
-	PID_SetGains( &stPIDRollAngle, fAngleP, 0, 0 );
+	SENSORFUSION_UpdateQ( &pstCxt->stSensorFusionQ,
+						  pstGyro,
+						  pstGyroDelta,
+						  pstAccel,
+						  &pstCxt->stRotationQ,
+						  qTimeStep );
+
+	// Apply trim
+	pstCxt->stRotationQ.x -= pstCxt->stTrimQ.x;
+	pstCxt->stRotationQ.y -= pstCxt->stTrimQ.y;
+	pstCxt->stRotationQ.z -= pstCxt->stTrimQ.z;
 
 	return;
 }
 
 /* ************************************************************************** */
-void FLIGHT_GetRotation( vector3f_t *pstRotation )
+void FLIGHT_UpdateAngleQ( stFLIGHT_Cxt_t *pstCxt,
+						  uint32_t uiTimestep_us,
+						  const stReceiverInputQ_t *pstReceiverInput )
 {
-	*pstRotation = stRotation;
+	q30_t qTimeStep;
+	q16_t qInvTimeStep;
+	q16_t qAngleErrRoll;
+	q16_t qAngleErrPitch;
+
+	// The steps below match the float stages, see there for the detail
+	if ( THRESHOLD_THROT_FLIGHT_Q > pstReceiverInput->qThrottle )
+	{
+		pstCxt->stRateTargetQ.x = 0;
+		pstCxt->stRateTargetQ.y = 0;
+
+		return;
+	}
+
+	GetTimestepQ( uiTimestep_us, &qTimeStep, &qInvTimeStep );
+
+	// Angle errors, to the angle PIDs for a rate target
+	qAngleErrRoll = FIXMATH_Mul( pstReceiverInput->qRoll, pstReceiverInput->qVarA ) - pstCxt->stRotationQ.x;
+	qAngleErrPitch = FIXMATH_Mul( pstReceiverInput->qPitch, pstReceiverInput->qVarA ) - pstCxt->stRotationQ.y;
+
+	pstCxt->stRateTargetQ.x = PID_UpdateQ( &pstCxt->stPIDRollAngleQ, qAngleErrRoll, qTimeStep, qInvTimeStep );
+	pstCxt->stRateTargetQ.y = PID_UpdateQ( &pstCxt->stPIDPitchAngleQ, qAngleErrPitch, qTimeStep, qInvTimeStep );
+
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHT_UpdateRateQ( stFLIGHT_Cxt_t *pstCxt,
+						 uint32_t uiTimestep_us,
+						 const vector3q_t *pstGyro,
+						 const stReceiverInputQ_t *pstReceiverInput,
+						 stMotorDemandsQ_t *pstMotorDemands )
+{
+	q30_t qTimeStep;
+	q16_t qInvTimeStep;
+
+	q16_t qRateErrRoll;
+	q16_t qRateErrPitch;
+	q16_t qRateErrYaw;
+
+	q16_t qAccelTargetRoll;
+	q16_t qAccelTargetPitch;
+	q16_t qAccelTargetYaw;
+
+	pstCxt->uiTimestamp += uiTimestep_us;
+
+	if ( THRESHOLD_THROT_FLIGHT_Q > pstReceiverInput->qThrottle )
+	{
+		pstMotorDemands->qFL = 0;
+		pstMotorDemands->qFR = 0;
+		pstMotorDemands->qRL = 0;
+		pstMotorDemands->qRR = 0;
+
+		return;
+	}
+
+	GetTimestepQ( uiTimestep_us, &qTimeStep, &qInvTimeStep );
+
+	// Rate errors, to the rate PIDs for an acceleration target
+	qRateErrRoll = FIXMATH_Sub( pstGyro->x, pstCxt->stRateTargetQ.x );
+	qRateErrPitch = FIXMATH_Sub( pstGyro->y, pstCxt->stRateTargetQ.y );
+	qRateErrYaw = FIXMATH_Add( FIXMATH_Mul( pstReceiverInput->qYaw, pstReceiverInput->qVarA ), pstGyro->z );
+
+	qAccelTargetRoll = PID_UpdateQ( &pstCxt->stPIDRollRateQ, qRateErrRoll, qTimeStep, qInvTimeStep );
+	qAccelTargetPitch = PID_UpdateQ( &pstCxt->stPIDPitchRateQ, qRateErrPitch, qTimeStep, qInvTimeStep );
+	qAccelTargetYaw = PID_UpdateQ( &pstCxt->stPIDYawRateQ, FIXMATH_Add( qRateErrYaw, pstGyro->z ), qTimeStep, qInvTimeStep );
+
+	// Mix, saturating so a large demand can't wrap round to a small one
+	pstMotorDemands->qFL = FIXMATH_Add( FIXMATH_Sub( FIXMATH_Add( pstReceiverInput->qThrottle, qAccelTargetPitch ), qAccelTargetRoll ), qAccelTargetYaw );
+	pstMotorDemands->qFR = FIXMATH_Sub( FIXMATH_Add( FIXMATH_Add( pstReceiverInput->qThrottle, qAccelTargetPitch ), qAccelTargetRoll ), qAccelTargetYaw );
+	pstMotorDemands->qRL = FIXMATH_Sub( FIXMATH_Sub( FIXMATH_Sub( pstReceiverInput->qThrottle, qAccelTargetPitch ), qAccelTargetRoll ), qAccelTargetYaw );
+	pstMotorDemands->qRR = FIXMATH_Add( FIXMATH_Add( FIXMATH_Sub( pstReceiverInput->qThrottle, qAccelTargetPitch ), qAccelTargetRoll ), qAccelTargetYaw );
+
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHT_SetTrim( stFLIGHT_Cxt_t *pstCxt, const vector3f_t *const pstTrim )
+{
+	// Only convert for the fixed point controller when it has changed
+	if ( 0 != memcmp( &pstCxt->stTrim, pstTrim, sizeof( vector3f_t ) ) )
+	{
+		pstCxt->stTrimQ.x = FIXMATH_FromFloat( pstTrim->x );
+		pstCxt->stTrimQ.y = FIXMATH_FromFloat( pstTrim->y );
+		pstCxt->stTrimQ.z = FIXMATH_FromFloat( pstTrim->z );
+	}
+
+	memcpy( &pstCxt->stTrim, pstTrim, sizeof( vector3f_t ) );
+
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHT_SetPidGains( stFLIGHT_Cxt_t *pstCxt, const float fRateP, const float fRateD, const float fAngleP )
+{
+	PID_SetGains( &pstCxt->stPIDPitchRate, fRateP, fRateD, 0 );
+	PID_SetGains( &pstCxt->stPIDRollRate, fRateP, fRateD, 0 );
+	//PID_SetGains( &pstCxt->stPIDYawRate, fRateP, fRateD, 0 );
+
+	PID_SetGains( &pstCxt->stPIDPitchAngle, fAngleP, 0, 0 );
+	PID_SetGains( &pstCxt->stPIDRollAngle, fAngleP, 0, 0 );
+
+	PID_SetGainsQ( &pstCxt->stPIDPitchRateQ, FIXMATH_FromFloat( fRateP ), FIXMATH_FromFloat( fRateD ), 0 );
+	PID_SetGainsQ( &pstCxt->stPIDRollRateQ, pstCxt->stPIDPitchRateQ.qKProp, pstCxt->stPIDPitchRateQ.qKDiff, 0 );
+
+	PID_SetGainsQ( &pstCxt->stPIDPitchAngleQ, FIXMATH_FromFloat( fAngleP ), 0, 0 );
+	PID_SetGainsQ( &pstCxt->stPIDRollAngleQ, pstCxt->stPIDPitchAngleQ.qKProp, 0, 0 );
+
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHT_SetKalmanNoise( stFLIGHT_Cxt_t *pstCxt, const float fQAngle, const float fQBias, const float fRMeasure )
+{
+	KALMAN_SetNoise( &pstCxt->stSensorFusion.stKalmanPitch, fQAngle, fQBias, fRMeasure );
+	KALMAN_SetNoise( &pstCxt->stSensorFusion.stKalmanRoll, fQAngle, fQBias, fRMeasure );
+	EKF_SetNoise( &pstCxt->stSensorFusion.stEkf, fQAngle, fQBias, fRMeasure );
+
+	KALMAN_SetNoiseQ( &pstCxt->stSensorFusionQ.stKalmanPitch,
+					  FIXMATH_FromFloat30( fQAngle ), FIXMATH_FromFloat30( fQBias ), FIXMATH_FromFloat30( fRMeasure ) );
+	KALMAN_SetNoiseQ( &pstCxt->stSensorFusionQ.stKalmanRoll,
+					  pstCxt->stSensorFusionQ.stKalmanPitch.Q_angle,
+					  pstCxt->stSensorFusionQ.stKalmanPitch.Q_bias,
+					  pstCxt->stSensorFusionQ.stKalmanPitch.R_measure );
+
+	return;
+}
+
+/* ************************************************************************** */
+bool FLIGHT_SetFusionStrategy( stFLIGHT_Cxt_t *pstCxt, const eSENSORFUSION_Strategy_t eStrategy )
+{
+	return SENSORFUSION_SetStrategy( &pstCxt->stSensorFusion, eStrategy );
+}
+
+/* ************************************************************************** */
+eSENSORFUSION_Strategy_t FLIGHT_GetFusionStrategy( const stFLIGHT_Cxt_t *pstCxt )
+{
+	return pstCxt->stSensorFusion.eStrategy;
+}
+
+/* ************************************************************************** */
+uint32_t FLIGHT_GetFusionCycles( const stFLIGHT_Cxt_t *pstCxt )
+{
+	return pstCxt->stSensorFusion.uiCycles;
+}
+
+/* ************************************************************************** */
+uint32_t FLIGHT_GetFusionCyclesQ( const stFLIGHT_Cxt_t *pstCxt )
+{
+	return pstCxt->stSensorFusionQ.uiCycles;
+}
+
+/* ************************************************************************** */
+void FLIGHT_GetRotation( const stFLIGHT_Cxt_t *pstCxt, vector3f_t *pstRotation )
+{
+	*pstRotation = pstCxt->stRotation;
+
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHT_GetRotationQ( const stFLIGHT_Cxt_t *pstCxt, vector3q_t *pstRotation )
+{
+	*pstRotation = pstCxt->stRotationQ;
+
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHT_ReceiverFromPulses( const uint16_t auiPulse[ NUM_RCVR_CHANNELS ], stReceiverInput_t *pstReceiverInput )
+{
+	pstReceiverInput->fRoll = ( (float)( (int32_t)auiPulse[0] - RECEIVER_PULSE_CENTRE ) ) / RECEIVER_PULSE_HALF_RANGE;
+	pstReceiverInput->fPitch = ( (float)( (int32_t)auiPulse[1] - RECEIVER_PULSE_CENTRE ) ) / RECEIVER_PULSE_HALF_RANGE;
+	pstReceiverInput->fThrottle = ( (float)auiPulse[2] ) / RECEIVER_RANGE;
+	pstReceiverInput->fYaw = ( (float)( (int32_t)auiPulse[3] - RECEIVER_PULSE_CENTRE ) ) / RECEIVER_PULSE_HALF_RANGE;
+	pstReceiverInput->fVarA = ( (float)auiPulse[4] ) / RECEIVER_RANGE;
+	pstReceiverInput->fVarB = ( (float)auiPulse[5] ) / RECEIVER_RANGE;
+
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHT_ReceiverFromPulsesQ( const uint16_t auiPulse[ NUM_RCVR_CHANNELS ], stReceiverInputQ_t *pstReceiverInput )
+{
+	// The ratio of two integers comes out the same whatever their format
+	pstReceiverInput->qRoll = FIXMATH_Div( (int32_t)auiPulse[0] - RECEIVER_PULSE_CENTRE, RECEIVER_PULSE_HALF_RANGE );
+	pstReceiverInput->qPitch = FIXMATH_Div( (int32_t)auiPulse[1] - RECEIVER_PULSE_CENTRE, RECEIVER_PULSE_HALF_RANGE );
+	pstReceiverInput->qThrottle = FIXMATH_Div( auiPulse[2], RECEIVER_RANGE );
+	pstReceiverInput->qYaw = FIXMATH_Div( (int32_t)auiPulse[3] - RECEIVER_PULSE_CENTRE, RECEIVER_PULSE_HALF_RANGE );
+	pstReceiverInput->qVarA = FIXMATH_Div( auiPulse[4], RECEIVER_RANGE );
+	pstReceiverInput->qVarB = FIXMATH_Div( auiPulse[5], RECEIVER_RANGE );
+
+	return;
+}
+
+/* ************************************************************************** */
+uint32_t FLIGHT_BoundTimestep_us( const uint32_t uiSample_us, const uint32_t uiLastSample_us,
+								  const uint32_t uiMin_us, const uint32_t uiMax_us )
+{
+	// Signed, the microsecond clock wraps and a step can come out backwards
+	int32_t iTimestep_us = (int32_t)( uiSample_us - uiLastSample_us );
+
+	if ( (int32_t)uiMin_us > iTimestep_us )
+	{
+		return uiMin_us;
+	}
+
+	if ( (int32_t)uiMax_us < iTimestep_us )
+	{
+		return uiMax_us;
+	}
+
+	return (uint32_t)iTimestep_us;
+}
+
+/* ************************************************************************** */
+static void GetTimestepQ( const uint32_t uiTimestep_us, q30_t *pqTimeStep, q16_t *pqInvTimeStep )
+{
+	int64_t iInvTimeStep;
+
+	// The timestep in seconds and its inverse for the PID differentials, both
+	// worked out once per stage rather than in each PID
+	*pqTimeStep = (q30_t)( ( (uint64_t)uiTimestep_us * US_TO_Q30 ) >> US_TO_Q30_SHIFT );
+	iInvTimeStep = ( 0 == uiTimestep_us ) ? 0 : ( ( (int64_t)1000000 << 16 ) / uiTimestep_us );
+	*pqInvTimeStep = ( INT32_MAX < iInvTimeStep ) ? INT32_MAX : (q16_t)iInvTimeStep;
 
 	return;
 }
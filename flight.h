@@ -3,7 +3,11 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <stdbool.h>
 #include "vector3f.h"
+#include "fixmath.h"
+#include "pid.h"
+#include "sensor_fusion.h"
 
 #define NUM_MOTORS			( 4 )
 #define NUM_RCVR_CHANNELS	( 6 )
@@ -33,33 +37,252 @@ typedef struct
 
 } stMotorDemands_t;
 
+// Fixed point versions of the above, same ranges in Q16
+typedef struct
+{
+	q16_t qRoll;
+	q16_t qPitch;
+	q16_t qThrottle;
+	q16_t qYaw;
+	q16_t qVarA;
+	q16_t qVarB;
+
+} stReceiverInputQ_t;
+
+typedef struct
+{
+	q16_t qFL;
+	q16_t qFR;
+	q16_t qRL;
+	q16_t qRR;
+
+} stMotorDemandsQ_t;
+
+// Everything one flight controller keeps between calls, so any number of them
+// can run side by side (the host sweep runs one per simulated flight)
+typedef struct
+{
+	// State for flight_process
+	stPidCxt_t stPIDPitchRate;
+	stPidCxt_t stPIDPitchAngle;
+	stPidCxt_t stPIDRollRate;
+	stPidCxt_t stPIDRollAngle;
+	stPidCxt_t stPIDYawRate;
+
+	stSENSORFUSION_Cxt_t stSensorFusion;
+
+	vector3f_t stTrim;
+	vector3f_t stRotation;
+	vector3f_t stRateTarget;	// From the angle PIDs to the rate PIDs, roll x and pitch y
+
+	// State for flight_process_q
+	stPidQCxt_t stPIDPitchRateQ;
+	stPidQCxt_t stPIDPitchAngleQ;
+	stPidQCxt_t stPIDRollRateQ;
+	stPidQCxt_t stPIDRollAngleQ;
+	stPidQCxt_t stPIDYawRateQ;
+
+	stSENSORFUSION_Q_Cxt_t stSensorFusionQ;
+
+	vector3q_t stTrimQ;
+	vector3q_t stRotationQ;
+	vector3q_t stRateTargetQ;
+
+	uint32_t uiTimestamp;		// us, the rate loop's timesteps summed
+
+} stFLIGHT_Cxt_t;
+
 /**
  * @brief		Initialise the flight controller.
+ * @param[out]	pstCxt			Controller context to set up.
+ */
+void flight_setup( stFLIGHT_Cxt_t *pstCxt );
+
+/*
+ * The controller runs in three stages, which flight_process and
+ * flight_process_q run back to back at the one rate:
+ *   attitude	sensor fusion, the estimate of the rotation
+ *   angle		the angle PIDs, the rotation error to a rate target
+ *   rate		the rate PIDs, the rate error to the motor demands
+ * The flight task runs each at its own rate instead, the rate stage every
+ * gyro sample and the other two at a fraction of that, see task_flight.c. A
+ * stage's timestep is the time since that stage last ran.
  */
-void flight_setup( void );
 
 /**
  * @brief		Updates the flight controller with a given set of IMU and
- * 				receiver values.
- * @param[in]	uiTimestep		Time in milliseconds since the last time we were called.
+ * 				receiver values, every stage.
+ * @param[in]	pstCxt			Controller context.
+ * @param[in]	uiTimestep_us	Time in microseconds since the last time we
+ * 								were called, as measured, see timebase.h.
  * @param[in]	stAccel			Current accelerometer readings in g.
  * @param[in]	stGyro			Current gyroscope readings in rad/sec.
+ * @param[in]	pstGyroDelta	Gyro rates integrated over the timestep in rad,
+ * 								may be NULL to use stGyro * timestep instead.
  * @param[in]	stReceiverInput	Current receiver input values.
  * @param[out]	pstMotorDemands	Pointer to where to put the resulting receiver values.
  */
-void flight_process( uint16_t uiTimestep,
+void flight_process( stFLIGHT_Cxt_t *pstCxt,
+					 uint32_t uiTimestep_us,
 					 vector3f_t *pstAccel,
 					 vector3f_t *pstGyro,
+					 vector3f_t *pstGyroDelta,
 					 vector3f_t *pstMag,
 					 stReceiverInput_t *pstReceiverInput,
 					 stMotorDemands_t *pstMotorDemands );
 
+/**
+ * @brief		Fixed point version of flight_process, the estimation and
+ * 				control run entirely in integer arithmetic. Both versions keep
+ * 				their own state in the context so only one should be used
+ * 				with a given context.
+ * @param[in]	pstCxt			Controller context.
+ * @param[in]	uiTimestep_us	Time in microseconds since the last time we
+ * 								were called.
+ * @param[in]	pstAccel		Current accelerometer readings in g.
+ * @param[in]	pstGyro			Current gyroscope readings in rad/sec.
+ * @param[in]	pstGyroDelta	Gyro rates integrated over the timestep in rad,
+ * 								may be NULL to use pstGyro * timestep instead.
+ * @param[in]	pstReceiverInput	Current receiver input values.
+ * @param[out]	pstMotorDemands	Pointer to where to put the resulting receiver values.
+ */
+void flight_process_q( stFLIGHT_Cxt_t *pstCxt,
+					   uint32_t uiTimestep_us,
+					   const vector3q_t *pstAccel,
+					   const vector3q_t *pstGyro,
+					   const vector3q_t *pstGyroDelta,
+					   const stReceiverInputQ_t *pstReceiverInput,
+					   stMotorDemandsQ_t *pstMotorDemands );
+
+/**
+ * @brief		The attitude stage, updates the rotation from the sensors.
+ * @param[in]	pstCxt			Controller context.
+ * @param[in]	uiTimestep_us	Time in microseconds since this stage last ran.
+ * @param[in]	pstAccel		Accelerometer readings in g.
+ * @param[in]	pstGyro			Gyroscope readings in rad/sec.
+ * @param[in]	pstGyroDelta	Gyro rates integrated over the timestep in rad,
+ * 								may be NULL to use pstGyro * timestep instead.
+ * @param[in]	pstMag			Magnetometer readings in gauss.
+ */
+void FLIGHT_UpdateAttitude( stFLIGHT_Cxt_t *pstCxt,
+							uint32_t uiTimestep_us,
+							vector3f_t *pstAccel,
+							vector3f_t *pstGyro,
+							vector3f_t *pstGyroDelta,
+							vector3f_t *pstMag );
+
+/**
+ * @brief		The angle stage, updates the rate target from the rotation and
+ * 				the sticks.
+ * @param[in]	pstCxt			Controller context.
+ * @param[in]	uiTimestep_us	Time in microseconds since this stage last ran.
+ * @param[in]	pstReceiverInput	Current receiver input values.
+ */
+void FLIGHT_UpdateAngle( stFLIGHT_Cxt_t *pstCxt,
+						 uint32_t uiTimestep_us,
+						 const stReceiverInput_t *pstReceiverInput );
+
+/**
+ * @brief		The rate stage, works out the motor demands from the rate
+ * 				target and the gyro.
+ * @param[in]	pstCxt			Controller context.
+ * @param[in]	uiTimestep_us	Time in microseconds since this stage last ran.
+ * @param[in]	pstGyro			Gyroscope readings in rad/sec.
+ * @param[in]	pstReceiverInput	Current receiver input values.
+ * @param[out]	pstMotorDemands	Where to put the motor demands.
+ */
+void FLIGHT_UpdateRate( stFLIGHT_Cxt_t *pstCxt,
+						uint32_t uiTimestep_us,
+						const vector3f_t *pstGyro,
+						const stReceiverInput_t *pstReceiverInput,
+						stMotorDemands_t *pstMotorDemands );
+
+/**
+ * @brief		Fixed point versions of the stages above.
+ */
+void FLIGHT_UpdateAttitudeQ( stFLIGHT_Cxt_t *pstCxt,
+							 uint32_t uiTimestep_us,
+							 const vector3q_t *pstAccel,
+							 const vector3q_t *pstGyro,
+							 const vector3q_t *pstGyroDelta );
+void FLIGHT_UpdateAngleQ( stFLIGHT_Cxt_t *pstCxt,
+						  uint32_t uiTimestep_us,
+						  const stReceiverInputQ_t *pstReceiverInput );
+void FLIGHT_UpdateRateQ( stFLIGHT_Cxt_t *pstCxt,
+						 uint32_t uiTimestep_us,
+						 const vector3q_t *pstGyro,
+						 const stReceiverInputQ_t *pstReceiverInput,
+						 stMotorDemandsQ_t *pstMotorDemands );
+
 /**
  * @brief		Sets the trim.
+ * @param[in]	pstCxt		Controller context.
  * @param[in]	pstTrim		Pointer to the new trim.
  */
-void FLIGHT_SetTrim( const vector3f_t *const pstTrim );
-void FLIGHT_SetPidGains( const float fRateP, const float fRateD, const float fAngleP );
-void FLIGHT_GetRotation( vector3f_t *pstRotation );
+void FLIGHT_SetTrim( stFLIGHT_Cxt_t *pstCxt, const vector3f_t *const pstTrim );
+void FLIGHT_SetPidGains( stFLIGHT_Cxt_t *pstCxt, const float fRateP, const float fRateD, const float fAngleP );
+
+/**
+ * @brief		Sets the noise variances of the pitch and roll Kalman filters,
+ * 				for both the float and fixed point controllers, and of the
+ * 				attitude EKF.
+ * @param[in]	pstCxt		Controller context.
+ * @param[in]	fQAngle		Process noise variance for the angle.
+ * @param[in]	fQBias		Process noise variance for the gyro bias.
+ * @param[in]	fRMeasure	Measurement noise variance.
+ */
+void FLIGHT_SetKalmanNoise( stFLIGHT_Cxt_t *pstCxt, const float fQAngle, const float fQBias, const float fRMeasure );
+
+/**
+ * @brief		Switches the float controller's sensor fusion algorithm, the
+ * 				fixed point one only has the Kalman filter.
+ * @param[in]	pstCxt		Controller context.
+ * @param[in]	eStrategy	The algorithm.
+ * @return		False, with nothing changed, if there is no such algorithm.
+ */
+bool FLIGHT_SetFusionStrategy( stFLIGHT_Cxt_t *pstCxt, const eSENSORFUSION_Strategy_t eStrategy );
+eSENSORFUSION_Strategy_t FLIGHT_GetFusionStrategy( const stFLIGHT_Cxt_t *pstCxt );
+
+/**
+ * @brief		Time the last sensor fusion update took, in CYCLES_Now counts.
+ * @param[in]	pstCxt		Controller context.
+ */
+uint32_t FLIGHT_GetFusionCycles( const stFLIGHT_Cxt_t *pstCxt );
+
+/**
+ * @brief		As FLIGHT_GetFusionCycles, for the fixed point controller.
+ */
+uint32_t FLIGHT_GetFusionCyclesQ( const stFLIGHT_Cxt_t *pstCxt );
+void FLIGHT_GetRotation( const stFLIGHT_Cxt_t *pstCxt, vector3f_t *pstRotation );
+void FLIGHT_GetRotationQ( const stFLIGHT_Cxt_t *pstCxt, vector3q_t *pstRotation );
+
+/**
+ * @brief		Turns receiver pulse widths into stick positions.
+ * @param[in]	auiPulse	Widths above RECEIVER_FLOOR in FTM ticks, as
+ * 							IODRIVER_GetInputPulseWidth returns them, in
+ * 							stReceiverInput_t order.
+ * @param[out]	pstReceiverInput	The stick positions.
+ */
+void FLIGHT_ReceiverFromPulses( const uint16_t auiPulse[ NUM_RCVR_CHANNELS ], stReceiverInput_t *pstReceiverInput );
+
+/**
+ * @brief		Fixed point version of FLIGHT_ReceiverFromPulses.
+ */
+void FLIGHT_ReceiverFromPulsesQ( const uint16_t auiPulse[ NUM_RCVR_CHANNELS ], stReceiverInputQ_t *pstReceiverInput );
+
+/**
+ * @brief		The timestep between two sample times, kept within what the
+ * 				stages can use. A stalled sensor gives no more than the
+ * 				maximum, and a time that is the same as or before the last
+ * 				one, e.g. from a late or missing edge, no less than the
+ * 				minimum.
+ * @param[in]	uiSample_us		This sample's time, see timebase.h.
+ * @param[in]	uiLastSample_us	The last sample's time.
+ * @param[in]	uiMin_us		Shortest step, the sensor's sample period.
+ * @param[in]	uiMax_us		Longest step.
+ * @return		The timestep in microseconds.
+ */
+uint32_t FLIGHT_BoundTimestep_us( const uint32_t uiSample_us, const uint32_t uiLastSample_us,
+								  const uint32_t uiMin_us, const uint32_t uiMax_us );
 
 #endif
@@ -0,0 +1,388 @@
+/* ************************************************************************** **
+ * Host benchmark for the Madgwick and Mahony filters (MadgwickAHRS.c,
+ * MahonyAHRS.c) against the Madgwick update as it was, with its state in
+ * volatile globals and the timestep fixed at 1/50 s.
+ *
+ * The filters are run over a synthetic IMU recording: a smooth roll, pitch
+ * and yaw motion sampled as the flight task sees it, GYRO_PER_LOOP gyro
+ * samples in each FIFO burst and one accelerometer reading per loop, with
+ * white noise on both. The loop is the flight task's 10ms. Each filter gets
+ * the burst as one averaged rate (as SENSORFUSION_Update gives it) and, for
+ * the reworked filters, as the samples themselves through the batch update.
+ *
+ * It prints the host time per loop, averaged over REPEATS passes of the
+ * whole recording, and the RMS roll and pitch error against the true motion
+ * after the first second.
+ *
+ * Build and run with "make bench-ahrs" from the top level.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <stdio.h>			// printf & friends
+#include <string.h>			// memset & friends
+#include <math.h>			// sinf & friends
+#include <time.h>			// clock_gettime
+
+#include "MadgwickAHRS.h"	// Madgwick filter
+#include "MahonyAHRS.h"		// Mahony filter
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define PI					( 3.14159265359f )
+#define LOOP_MS				( 10 )
+#define LOOP_S				( LOOP_MS / 1000.0f )
+#define GYRO_PER_LOOP		( 4 )
+#define GYRO_S				( LOOP_S / GYRO_PER_LOOP )
+#define DURATION_S			( 60 )
+#define NUM_LOOPS			( ( DURATION_S * 1000 ) / LOOP_MS )
+#define SETTLE_LOOPS		( 1000 / LOOP_MS )
+#define REPEATS				( 50 )
+#define GYRO_NOISE_RADS		( 0.01f )
+#define ACCEL_NOISE_G		( 0.01f )
+
+// As the baseline filter had them
+#define LEGACY_SAMPLE_FREQ	( 50.0f )
+#define LEGACY_BETA			( 0.1f )
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+typedef struct
+{
+	float aafGyro[ GYRO_PER_LOOP ][3];	// rad/s
+	float afRate[3];					// The burst averaged
+	float afAccel[3];					// g
+	float fRoll;						// The truth at the end of the loop
+	float fPitch;
+
+} stLoop_t;
+
+typedef enum
+{
+	RUN_LEGACY,
+	RUN_MADGWICK,
+	RUN_MADGWICK_BATCH,
+	RUN_MAHONY,
+	RUN_MAHONY_BATCH,
+	RUN_NUM
+
+} eRun_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static void MakeRecording( void );
+static void Truth( const float fTime_s, float afEuler[3], float afRate[3] );
+static float Gaussian( void );
+static void RunFilter( const eRun_t eRun, const bool bScore, double *pdSumSqRoll, double *pdSumSqPitch );
+static void LegacyUpdateIMU( float gx, float gy, float gz, float ax, float ay, float az );
+static uint64_t NowNs( void );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static stLoop_t astLoops[ NUM_LOOPS ];
+static uint32_t uiRandom = 1;
+
+static const char *const apcRunNames[ RUN_NUM ] =
+{
+	"legacy madgwick",
+	"madgwick",
+	"madgwick batch",
+	"mahony",
+	"mahony batch",
+};
+
+// The baseline filter's state, as it was
+static volatile float fLegacyBeta = LEGACY_BETA;
+static volatile float q0 = 1.0f, q1 = 0.0f, q2 = 0.0f, q3 = 0.0f;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( void )
+{
+	double dSumSqRoll;
+	double dSumSqPitch;
+	uint64_t uiStartNs;
+	double dNsPerLoop;
+	int iRepeat;
+	int iRun;
+
+	MakeRecording();
+
+	printf( "%d loops of %d ms, %d gyro samples each, %d passes timed\n\n",
+			NUM_LOOPS, LOOP_MS, GYRO_PER_LOOP, REPEATS );
+	printf( "%-20s %-12s %-10s %-10s\n", "filter", "ns per loop", "roll rms", "pitch rms" );
+
+	for ( iRun = 0; iRun < RUN_NUM; iRun++ )
+	{
+		dSumSqRoll = 0;
+		dSumSqPitch = 0;
+		RunFilter( (eRun_t)iRun, true, &dSumSqRoll, &dSumSqPitch );
+
+		uiStartNs = NowNs();
+
+		for ( iRepeat = 0; iRepeat < REPEATS; iRepeat++ )
+		{
+			RunFilter( (eRun_t)iRun, false, NULL, NULL );
+		}
+
+		dNsPerLoop = (double)( NowNs() - uiStartNs ) / ( (double)REPEATS * NUM_LOOPS );
+
+		printf( "%-20s %-12.1f %-10.4f %-10.4f\n", apcRunNames[ iRun ], dNsPerLoop,
+				sqrt( dSumSqRoll / ( NUM_LOOPS - SETTLE_LOOPS ) ), sqrt( dSumSqPitch / ( NUM_LOOPS - SETTLE_LOOPS ) ) );
+	}
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static void MakeRecording( void )
+{
+	float afEuler[3];
+	float afRate[3];
+	float fTime_s;
+	int iLoop;
+	int iSample;
+	int iAxis;
+
+	for ( iLoop = 0; iLoop < NUM_LOOPS; iLoop++ )
+	{
+		stLoop_t *pstLoop = &astLoops[ iLoop ];
+
+		memset( pstLoop->afRate, 0, sizeof( pstLoop->afRate ) );
+
+		// Each gyro sample is the rate mid way through its period
+		for ( iSample = 0; iSample < GYRO_PER_LOOP; iSample++ )
+		{
+			fTime_s = ( iLoop * LOOP_S ) + ( ( iSample + 0.5f ) * GYRO_S );
+			Truth( fTime_s, afEuler, afRate );
+
+			for ( iAxis = 0; iAxis < 3; iAxis++ )
+			{
+				pstLoop->aafGyro[ iSample ][ iAxis ] = afRate[ iAxis ] + ( GYRO_NOISE_RADS * Gaussian() );
+				pstLoop->afRate[ iAxis ] += pstLoop->aafGyro[ iSample ][ iAxis ] / GYRO_PER_LOOP;
+			}
+		}
+
+		// Gravity in the body frame at the end of the loop, nothing else
+		// accelerates it
+		Truth( ( iLoop + 1 ) * LOOP_S, afEuler, afRate );
+		pstLoop->afAccel[0] = -sinf( afEuler[1] ) + ( ACCEL_NOISE_G * Gaussian() );
+		pstLoop->afAccel[1] = ( sinf( afEuler[0] ) * cosf( afEuler[1] ) ) + ( ACCEL_NOISE_G * Gaussian() );
+		pstLoop->afAccel[2] = ( cosf( afEuler[0] ) * cosf( afEuler[1] ) ) + ( ACCEL_NOISE_G * Gaussian() );
+		pstLoop->fRoll = afEuler[0];
+		pstLoop->fPitch = afEuler[1];
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void Truth( const float fTime_s, float afEuler[3], float afRate[3] )
+{
+	// Sinusoids in each Euler angle, different rates so they all mix
+	const float afAmp[3] = { 0.5f, 0.4f, 1.0f };
+	const float afFreq[3] = { 2 * PI * 0.3f, 2 * PI * 0.23f, 2 * PI * 0.1f };
+	const float afPhase[3] = { 0.0f, 1.0f, 2.0f };
+	float afDot[3];
+	float fSr, fCr, fSp, fCp;
+	int iAxis;
+
+	for ( iAxis = 0; iAxis < 3; iAxis++ )
+	{
+		afEuler[ iAxis ] = afAmp[ iAxis ] * sinf( ( afFreq[ iAxis ] * fTime_s ) + afPhase[ iAxis ] );
+		afDot[ iAxis ] = afAmp[ iAxis ] * afFreq[ iAxis ] * cosf( ( afFreq[ iAxis ] * fTime_s ) + afPhase[ iAxis ] );
+	}
+
+	fSr = sinf( afEuler[0] );
+	fCr = cosf( afEuler[0] );
+	fSp = sinf( afEuler[1] );
+	fCp = cosf( afEuler[1] );
+
+	// Body rates from the Euler angle rates, roll pitch yaw order
+	afRate[0] = afDot[0] - ( afDot[2] * fSp );
+	afRate[1] = ( afDot[1] * fCr ) + ( afDot[2] * fCp * fSr );
+	afRate[2] = ( -afDot[1] * fSr ) + ( afDot[2] * fCp * fCr );
+
+	return;
+}
+
+/* ************************************************************************** */
+static float Gaussian( void )
+{
+	float fU1;
+	float fU2;
+
+	// Box-Muller off a 32 bit LCG, the same every run
+	uiRandom = ( uiRandom * 1664525u ) + 1013904223u;
+	fU1 = ( ( uiRandom >> 8 ) + 1.0f ) / 16777217.0f;
+	uiRandom = ( uiRandom * 1664525u ) + 1013904223u;
+	fU2 = ( uiRandom >> 8 ) / 16777216.0f;
+
+	return sqrtf( -2.0f * logf( fU1 ) ) * cosf( 2 * PI * fU2 );
+}
+
+/* ************************************************************************** */
+static void RunFilter( const eRun_t eRun, const bool bScore, double *pdSumSqRoll, double *pdSumSqPitch )
+{
+	stMADGWICK_Cxt_t stMadgwick;
+	stMAHONY_Cxt_t stMahony;
+	float fQ0 = 1, fQ1 = 0, fQ2 = 0, fQ3 = 0;
+	float fRoll;
+	float fPitch;
+	int iLoop;
+
+	MadgwickSetup( &stMadgwick );
+	MahonySetup( &stMahony );
+	q0 = 1.0f;
+	q1 = q2 = q3 = 0.0f;
+
+	for ( iLoop = 0; iLoop < NUM_LOOPS; iLoop++ )
+	{
+		const stLoop_t *pstLoop = &astLoops[ iLoop ];
+		const float *pfRate = pstLoop->afRate;
+		const float *pfAccel = pstLoop->afAccel;
+
+		switch ( eRun )
+		{
+			case RUN_LEGACY:
+				LegacyUpdateIMU( pfRate[0], pfRate[1], pfRate[2], pfAccel[0], pfAccel[1], pfAccel[2] );
+				fQ0 = q0; fQ1 = q1; fQ2 = q2; fQ3 = q3;
+				break;
+			case RUN_MADGWICK:
+				MadgwickAHRSupdateIMU( &stMadgwick, pfRate[0], pfRate[1], pfRate[2],
+									   pfAccel[0], pfAccel[1], pfAccel[2], LOOP_S );
+				fQ0 = stMadgwick.q0; fQ1 = stMadgwick.q1; fQ2 = stMadgwick.q2; fQ3 = stMadgwick.q3;
+				break;
+			case RUN_MADGWICK_BATCH:
+				MadgwickAHRSupdateIMUBatch( &stMadgwick, pstLoop->aafGyro, GYRO_PER_LOOP,
+											pfAccel[0], pfAccel[1], pfAccel[2], GYRO_S );
+				fQ0 = stMadgwick.q0; fQ1 = stMadgwick.q1; fQ2 = stMadgwick.q2; fQ3 = stMadgwick.q3;
+				break;
+			case RUN_MAHONY:
+				MahonyAHRSupdateIMU( &stMahony, pfRate[0], pfRate[1], pfRate[2],
+									 pfAccel[0], pfAccel[1], pfAccel[2], LOOP_S );
+				fQ0 = stMahony.q0; fQ1 = stMahony.q1; fQ2 = stMahony.q2; fQ3 = stMahony.q3;
+				break;
+			case RUN_MAHONY_BATCH:
+				MahonyAHRSupdateIMUBatch( &stMahony, pstLoop->aafGyro, GYRO_PER_LOOP,
+										  pfAccel[0], pfAccel[1], pfAccel[2], GYRO_S );
+				fQ0 = stMahony.q0; fQ1 = stMahony.q1; fQ2 = stMahony.q2; fQ3 = stMahony.q3;
+				break;
+			default:
+				break;
+		}
+
+		if ( !bScore || ( SETTLE_LOOPS > iLoop ) )
+		{
+			continue;
+		}
+
+		// As SENSORFUSION_Update turns the quaternion into angles
+		fRoll = atan2f( 2.0f * ( fQ0 * fQ1 + fQ2 * fQ3 ), fQ0 * fQ0 - fQ1 * fQ1 - fQ2 * fQ2 + fQ3 * fQ3 );
+		fPitch = -asinf( fminf( fmaxf( 2.0f * ( fQ1 * fQ3 - fQ0 * fQ2 ), -1.0f ), 1.0f ) );
+
+		*pdSumSqRoll += (double)( fRoll - pstLoop->fRoll ) * ( fRoll - pstLoop->fRoll );
+		*pdSumSqPitch += (double)( fPitch - pstLoop->fPitch ) * ( fPitch - pstLoop->fPitch );
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void LegacyUpdateIMU( float gx, float gy, float gz, float ax, float ay, float az )
+{
+	// MadgwickAHRSupdateIMU as it was, bugs and all, only invSqrt is the
+	// current one so it gives the same answer on a 64 bit host
+	float recipNorm;
+	float s0, s1, s2, s3;
+	float qDot1, qDot2, qDot3, qDot4;
+	float _2q0, _2q1, _2q2, _2q3, _4q0, _4q1, _4q2 ,_8q1, _8q2, q0q0, q1q1, q2q2, q3q3;
+
+	// Rate of change of quaternion from gyroscope
+	qDot1 = 0.5f * (-q1 * gx - q2 * gy - q3 * gz);
+	qDot2 = 0.5f * (q0 * gx + q2 * gz - q3 * gy);
+	qDot3 = 0.5f * (q0 * gy - q0 * gz + q3 * gx);
+	qDot4 = 0.5f * (q0 * gz + q1 * gy - q2 * gx);
+
+	// Compute feedback only if accelerometer measurement valid (avoids NaN in accelerometer normalisation)
+	if(!((ax == 0.0f) && (ay == 0.0f) && (az == 0.0f))) {
+
+		// Normalise accelerometer measurement
+		recipNorm = invSqrt(ax * ax + ay * ay + az * az);
+		ax *= recipNorm;
+		ay *= recipNorm;
+		az *= recipNorm;
+
+		// Auxiliary variables to avoid repeated arithmetic
+		_2q0 = 2.0f * q0;
+		_2q1 = 2.0f * q1;
+		_2q2 = 2.0f * q2;
+		_2q3 = 2.0f * q3;
+		_4q0 = 4.0f * q0;
+		_4q1 = 4.0f * q1;
+		_4q2 = 4.0f * q2;
+		_8q1 = 8.0f * q1;
+		_8q2 = 8.0f * q2;
+		q0q0 = q0 * q0;
+		q1q1 = q1 * q1;
+		q2q2 = q2 * q2;
+		q3q3 = q3 * q3;
+
+		// Gradient decent algorithm corrective step
+		s0 = _4q0 * q2q2 + _2q2 * ax + _4q0 * q1q1 - _2q1 * ay;
+		s1 = _4q1 * q3q3 - _2q3 * ax + 4.0f * q0q0 * q1 - _2q0 * ay - _4q1 + _8q1 * q1q1 + _8q1 * q2q2 + _4q1 * az;
+		s2 = 4.0f * q0q0 * q2 + _2q0 * ax + _4q2 * q3q3 - _2q3 * ay - _4q2 + _8q2 * q1q1 + _8q2 * q2q2 + _4q2 * az;
+		s3 = 4.0f * q1q1 * q3 - _2q1 * ax + 4.0f * q2q2 * q3 - _2q2 * ay;
+		recipNorm = invSqrt(s0 * s0 + s1 * s1 + s2 * s2 + s3 * s3); // normalise step magnitude
+		s0 *= recipNorm;
+		s1 *= recipNorm;
+		s2 *= recipNorm;
+		s3 *= recipNorm;
+
+		// Apply feedback step
+		qDot1 -= fLegacyBeta * s0;
+		qDot2 -= fLegacyBeta * s1;
+		qDot3 -= fLegacyBeta * s2;
+		qDot4 -= fLegacyBeta * s3;
+	}
+
+	// Integrate rate of change of quaternion to yield quaternion
+	q0 += qDot1 * (1.0f / LEGACY_SAMPLE_FREQ);
+	q1 += qDot2 * (1.0f / LEGACY_SAMPLE_FREQ);
+	q2 += qDot3 * (1.0f / LEGACY_SAMPLE_FREQ);
+	q3 += qDot4 * (1.0f / LEGACY_SAMPLE_FREQ);
+
+	// Normalise quaternion
+	recipNorm = invSqrt(q0 * q0 + q1 * q1 + q2 * q2 + q3 * q3);
+	q0 *= recipNorm;
+	q1 *= recipNorm;
+	q2 *= recipNorm;
+	q3 *= recipNorm;
+
+	return;
+}
+
+/* ************************************************************************** */
+static uint64_t NowNs( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return ( (uint64_t)stNow.tv_sec * 1000000000ULL ) + (uint64_t)stNow.tv_nsec;
+}
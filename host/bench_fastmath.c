@@ -0,0 +1,258 @@
+/* ************************************************************************** **
+ * Host benchmark for the approximations in fastmath.h and fixmath.h against
+ * libm.
+ *
+ * Each function is called through a pointer over NUM_INPUTS values in the
+ * range the estimators give it, the same pointer call for all three so only
+ * the function differs. The best of RUNS passes is printed, in host ns per
+ * call.
+ *
+ * The host has an FPU, libm's sqrtf is a single instruction on it and its
+ * atan2f and asinf are a few dozen, so this understates the gap. On the K20
+ * every float operation is a libgcc call and the libm functions are long
+ * chains of them, time them there with the cycle counter (cycles.h).
+ *
+ * Build and run with "make bench-fastmath" from the top level.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdio.h>			// printf & friends
+#include <math.h>			// atan2f & friends
+#include <time.h>			// clock_gettime
+
+#include "fastmath.h"		// Float approximations
+#include "fixmath.h"		// Fixed point arithmetic
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define NUM_INPUTS				( 1 << 16 )
+#define RUNS					( 50 )
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+
+// One function's inputs, in both forms
+typedef struct
+{
+	float afA[ NUM_INPUTS ];
+	float afB[ NUM_INPUTS ];
+	q16_t aqA[ NUM_INPUTS ];
+	q16_t aqB[ NUM_INPUTS ];
+
+} stInputs_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static void MakeInputs( const float fMinA, const float fMaxA, const float fMinB, const float fMaxB );
+static double TimeF1( float (*pfFunc)( float ) );
+static double TimeF2( float (*pfFunc)( float, float ) );
+static double TimeQ1( q16_t (*pfFunc)( q16_t ) );
+static double TimeQ2( q16_t (*pfFunc)( q16_t, q16_t ) );
+static float LibAtan2( float y, float x );
+static float LibAsin( float x );
+static float LibSqrt( float x );
+static float LibInvSqrt( float x );
+static float Uniform( const float fMin, const float fMax );
+static double NowNs( void );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static stInputs_t stInputs;
+static uint32_t uiNoiseState = 1;
+static volatile float fSink;
+static volatile q16_t qSink;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( void )
+{
+	printf( "%-22s %-10s %-10s %-10s\n", "host ns per call", "libm", "fastmath", "Q16" );
+
+	// An accelerometer's components, in g
+	MakeInputs( -2.0f, 2.0f, -2.0f, 2.0f );
+	printf( "%-22s %-10.1f %-10.1f %-10.1f\n", "atan2",
+			TimeF2( LibAtan2 ), TimeF2( FASTMATH_Atan2 ), TimeQ2( FIXMATH_Atan2 ) );
+
+	// The sine of the pitch
+	MakeInputs( -1.0f, 1.0f, 0, 0 );
+	printf( "%-22s %-10.1f %-10.1f %-10.1f\n", "asin",
+			TimeF1( LibAsin ), TimeF1( FASTMATH_Asin ), TimeQ1( FIXMATH_Asin ) );
+
+	// Squared magnitudes, of an accelerometer reading or a quaternion
+	MakeInputs( 0.25f, 4.0f, 0, 0 );
+	printf( "%-22s %-10.1f %-10.1f %-10.1f\n", "sqrt",
+			TimeF1( LibSqrt ), TimeF1( FASTMATH_Sqrt ), TimeQ1( FIXMATH_Sqrt ) );
+	printf( "%-22s %-10.1f %-10.1f %-10.1f\n", "invsqrt",
+			TimeF1( LibInvSqrt ), TimeF1( FASTMATH_InvSqrt ), TimeQ1( FIXMATH_InvSqrt ) );
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static void MakeInputs( const float fMinA, const float fMaxA, const float fMinB, const float fMaxB )
+{
+	uint32_t uiIndex;
+
+	for ( uiIndex = 0; uiIndex < NUM_INPUTS; uiIndex++ )
+	{
+		stInputs.afA[ uiIndex ] = Uniform( fMinA, fMaxA );
+		stInputs.afB[ uiIndex ] = Uniform( fMinB, fMaxB );
+		stInputs.aqA[ uiIndex ] = FIXMATH_FromFloat( stInputs.afA[ uiIndex ] );
+		stInputs.aqB[ uiIndex ] = FIXMATH_FromFloat( stInputs.afB[ uiIndex ] );
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static double TimeF1( float (*pfFunc)( float ) )
+{
+	double dBest = 1e30;
+	double dStart;
+	float fSum;
+	uint32_t uiRun;
+	uint32_t uiIndex;
+
+	for ( uiRun = 0; uiRun < RUNS; uiRun++ )
+	{
+		fSum = 0;
+		dStart = NowNs();
+		for ( uiIndex = 0; uiIndex < NUM_INPUTS; uiIndex++ )
+		{
+			fSum += pfFunc( stInputs.afA[ uiIndex ] );
+		}
+		dBest = fmin( dBest, ( NowNs() - dStart ) / NUM_INPUTS );
+		fSink = fSum;
+	}
+
+	return dBest;
+}
+
+/* ************************************************************************** */
+static double TimeF2( float (*pfFunc)( float, float ) )
+{
+	double dBest = 1e30;
+	double dStart;
+	float fSum;
+	uint32_t uiRun;
+	uint32_t uiIndex;
+
+	for ( uiRun = 0; uiRun < RUNS; uiRun++ )
+	{
+		fSum = 0;
+		dStart = NowNs();
+		for ( uiIndex = 0; uiIndex < NUM_INPUTS; uiIndex++ )
+		{
+			fSum += pfFunc( stInputs.afA[ uiIndex ], stInputs.afB[ uiIndex ] );
+		}
+		dBest = fmin( dBest, ( NowNs() - dStart ) / NUM_INPUTS );
+		fSink = fSum;
+	}
+
+	return dBest;
+}
+
+/* ************************************************************************** */
+static double TimeQ1( q16_t (*pfFunc)( q16_t ) )
+{
+	double dBest = 1e30;
+	double dStart;
+	q16_t qSum;
+	uint32_t uiRun;
+	uint32_t uiIndex;
+
+	for ( uiRun = 0; uiRun < RUNS; uiRun++ )
+	{
+		qSum = 0;
+		dStart = NowNs();
+		for ( uiIndex = 0; uiIndex < NUM_INPUTS; uiIndex++ )
+		{
+			qSum += pfFunc( stInputs.aqA[ uiIndex ] );
+		}
+		dBest = fmin( dBest, ( NowNs() - dStart ) / NUM_INPUTS );
+		qSink = qSum;
+	}
+
+	return dBest;
+}
+
+/* ************************************************************************** */
+static double TimeQ2( q16_t (*pfFunc)( q16_t, q16_t ) )
+{
+	double dBest = 1e30;
+	double dStart;
+	q16_t qSum;
+	uint32_t uiRun;
+	uint32_t uiIndex;
+
+	for ( uiRun = 0; uiRun < RUNS; uiRun++ )
+	{
+		qSum = 0;
+		dStart = NowNs();
+		for ( uiIndex = 0; uiIndex < NUM_INPUTS; uiIndex++ )
+		{
+			qSum += pfFunc( stInputs.aqA[ uiIndex ], stInputs.aqB[ uiIndex ] );
+		}
+		dBest = fmin( dBest, ( NowNs() - dStart ) / NUM_INPUTS );
+		qSink = qSum;
+	}
+
+	return dBest;
+}
+
+/* ************************************************************************** */
+static float LibAtan2( float y, float x )
+{
+	return atan2f( y, x );
+}
+
+/* ************************************************************************** */
+static float LibAsin( float x )
+{
+	return asinf( x );
+}
+
+/* ************************************************************************** */
+static float LibSqrt( float x )
+{
+	return sqrtf( x );
+}
+
+/* ************************************************************************** */
+static float LibInvSqrt( float x )
+{
+	return 1.0f / sqrtf( x );
+}
+
+/* ************************************************************************** */
+static float Uniform( const float fMin, const float fMax )
+{
+	// Repeatable
+	uiNoiseState = ( uiNoiseState * 1103515245u ) + 12345u;
+
+	return fMin + ( ( fMax - fMin ) * (float)( ( uiNoiseState >> 8 ) & 0xFFFF ) / 65536.0f );
+}
+
+/* ************************************************************************** */
+static double NowNs( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return ( (double)stNow.tv_sec * 1e9 ) + (double)stNow.tv_nsec;
+}
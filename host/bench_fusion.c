@@ -0,0 +1,329 @@
+/* ************************************************************************** **
+ * Every sensor fusion algorithm run over the same simulated flight, to pick
+ * the cheapest one that is accurate enough.
+ *
+ * One flight is flown closed loop as sitl does (flightsim.c), with the filter
+ * -f names. Alongside it each algorithm, and the fixed point chain's Kalman
+ * filter, gets its own copy of the flight task's processing (flightchain.c)
+ * fed exactly the same ticks, so they all see the same sensor data and their
+ * motor demands go nowhere. They start at -b seconds into the flight, the
+ * quadrotor tilted by the first roll step, so they have to find the attitude.
+ *
+ * For each it prints the host time per SENSORFUSION_Update (the cycle count
+ * the fusion keeps, nanoseconds off target), the RMS error against the true
+ * attitude from a second after it started, and the convergence time: how
+ * long until roll and pitch were both within CONVERGED_RAD and stayed there
+ * for CONVERGED_HOLD_S.
+ *
+ * Usage: bench_fusion [-f filter] [-t seconds] [-s seed] [-b seconds]
+ *
+ * Build and run with "make bench-fusion" from the top level,
+ * BENCH_FUSION_ARGS is passed on.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <stdio.h>			// printf & friends
+#include <stdlib.h>			// qsort & friends
+#include <string.h>			// memset & friends
+#include <math.h>			// fabsf & friends
+#include <unistd.h>			// getopt
+
+#include "flightsim.h"		// Closed loop flight
+#include "flightchain.h"	// The flight task's processing
+#include "sensor_fusion.h"	// The algorithms
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define PI						( 3.14159265359f )
+#define NUM_SHADOWS				( SENSORFUSION_NUM_STRATEGIES + 1 )	// And the fixed point Kalman
+#define DEFAULT_BEGIN_S			( 2.5f )	// Half way through the first roll step
+#define CONVERGED_RAD			( 0.05f )
+#define CONVERGED_HOLD_S		( 1.0f )
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+typedef struct
+{
+	char acName[ 24 ];
+	stFLIGHTCHAIN_Cxt_t stChain;
+	uint32_t *puiNs;
+	uint32_t uiUpdates;
+
+	stFLIGHTSIM_Error_t stRoll;
+	stFLIGHTSIM_Error_t stPitch;
+	stFLIGHTSIM_Error_t stYaw;
+
+	float fInSince_s;			// Negative while outside CONVERGED_RAD
+	float fConverged_s;			// Negative until converged
+
+} stShadow_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static void SetupShadow( stShadow_t *pstShadow, const stFLIGHTSIM_Cxt_t *pstFlight, const int iStrategy,
+						 const uint32_t uiMaxLoops );
+static void RunShadow( stShadow_t *pstShadow, const stFLIGHTSIM_Cxt_t *pstFlight, const float fBegin_s );
+static void PrintShadow( stShadow_t *pstShadow );
+static void AddError( stFLIGHTSIM_Error_t *pstError, const float fError );
+static float WrapPi( float fAngle );
+static int CompareU32( const void *pvA, const void *pvB );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static stFLIGHTSIM_Cxt_t stFlight;
+static stShadow_t astShadows[ NUM_SHADOWS ];
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( int argc, char **argv )
+{
+	stFLIGHTSIM_Config_t stConfig;
+	float fBegin_s = DEFAULT_BEGIN_S;
+	uint32_t uiMaxLoops;
+	int iShadow;
+	int iOpt;
+
+	FLIGHTSIM_DefaultConfig( &stConfig );
+
+	while ( -1 != ( iOpt = getopt( argc, argv, "f:t:s:b:" ) ) )
+	{
+		switch ( iOpt )
+		{
+			case 'f':
+				if ( !SENSORFUSION_FindStrategy( optarg, &stConfig.eFusion ) )
+				{
+					fprintf( stderr, "%s: no such sensor fusion\n", optarg );
+					return 2;
+				}
+				break;
+			case 't': stConfig.fDuration_s = strtof( optarg, NULL ); break;
+			case 's': stConfig.uiSeed = (uint32_t)strtoul( optarg, NULL, 0 ); break;
+			case 'b': fBegin_s = strtof( optarg, NULL ); break;
+			default:
+				fprintf( stderr, "usage: %s [-f filter] [-t seconds] [-s seed] [-b seconds]\n", argv[0] );
+				return 2;
+		}
+	}
+
+	FLIGHTSIM_Setup( &stFlight, &stConfig );
+
+	uiMaxLoops = (uint32_t)( ( stConfig.fDuration_s * FLIGHTSIM_GYRO_HZ ) / stConfig.uiGyroPerLoop ) + 1;
+
+	for ( iShadow = 0; iShadow < NUM_SHADOWS; iShadow++ )
+	{
+		SetupShadow( &astShadows[ iShadow ], &stFlight, iShadow, uiMaxLoops );
+
+		if ( NULL == astShadows[ iShadow ].puiNs )
+		{
+			return 2;
+		}
+	}
+
+	while ( FLIGHTSIM_Advance( &stFlight ) && ( stFlight.uiLoops < uiMaxLoops ) )
+	{
+		FLIGHTSIM_Control( &stFlight );
+		FLIGHTSIM_Score( &stFlight );
+
+		for ( iShadow = 0; iShadow < NUM_SHADOWS; iShadow++ )
+		{
+			RunShadow( &astShadows[ iShadow ], &stFlight, fBegin_s );
+		}
+	}
+
+	printf( "%.1f s flown with %s, filters from %.1f s, converged within %.2f rad for %.1f s\n\n",
+			stFlight.stSim.fTime_s, SENSORFUSION_GetStrategyName( stConfig.eFusion ),
+			fBegin_s, CONVERGED_RAD, CONVERGED_HOLD_S );
+
+	printf( "%-16s %-23s %-26s %-10s\n", "", "host ns per update", "rms error (rad)", "converged" );
+	printf( "%-16s %-7s %-7s %-7s %-8s %-8s %-8s  %-10s\n",
+			"filter", "mean", "median", "p99", "roll", "pitch", "yaw", "after (s)" );
+
+	for ( iShadow = 0; iShadow < NUM_SHADOWS; iShadow++ )
+	{
+		PrintShadow( &astShadows[ iShadow ] );
+		free( astShadows[ iShadow ].puiNs );
+	}
+
+	if ( stFlight.bLost )
+	{
+		printf( "\nFAIL: lost control at %.2f s\n", stFlight.stSim.fTime_s );
+		return 1;
+	}
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static void SetupShadow( stShadow_t *pstShadow, const stFLIGHTSIM_Cxt_t *pstFlight, const int iStrategy,
+						 const uint32_t uiMaxLoops )
+{
+	const stFLIGHTSIM_Config_t *pstConfig = &pstFlight->stConfig;
+	bool bFixed = ( SENSORFUSION_NUM_STRATEGIES == iStrategy );
+
+	memset( pstShadow, 0, sizeof( stShadow_t ) );
+
+	if ( bFixed )
+	{
+		snprintf( pstShadow->acName, sizeof( pstShadow->acName ), "kalman (fixed)" );
+	}
+	else
+	{
+		snprintf( pstShadow->acName, sizeof( pstShadow->acName ), "%s",
+				  SENSORFUSION_GetStrategyName( (eSENSORFUSION_Strategy_t)iStrategy ) );
+	}
+
+	// Tuned as the flight's own controller
+	FLIGHTCHAIN_Setup( &pstShadow->stChain, &pstFlight->stChain.stScale, bFixed );
+	FLIGHT_SetPidGains( &pstShadow->stChain.stFlight, pstConfig->fRateP, pstConfig->fRateD, pstConfig->fAngleP );
+	FLIGHT_SetKalmanNoise( &pstShadow->stChain.stFlight, pstConfig->fQAngle, pstConfig->fQBias, pstConfig->fRMeasure );
+
+	if ( !bFixed )
+	{
+		FLIGHT_SetFusionStrategy( &pstShadow->stChain.stFlight, (eSENSORFUSION_Strategy_t)iStrategy );
+	}
+
+	pstShadow->puiNs = calloc( uiMaxLoops, sizeof( uint32_t ) );
+	pstShadow->fInSince_s = -1;
+	pstShadow->fConverged_s = -1;
+
+	return;
+}
+
+/* ************************************************************************** */
+static void RunShadow( stShadow_t *pstShadow, const stFLIGHTSIM_Cxt_t *pstFlight, const float fBegin_s )
+{
+	const vector3f_t *pstTruth = &pstFlight->stTruth;
+	float fTime_s = pstFlight->stSim.fTime_s;
+	stMotorDemands_t stDemands;
+	vector3f_t stEstimate;
+	bool bIn;
+
+	if ( fTime_s < fBegin_s )
+	{
+		return;
+	}
+
+	FLIGHTCHAIN_Run( &pstShadow->stChain, &pstFlight->stRecord.stTick, &stDemands, &stEstimate );
+
+	pstShadow->puiNs[ pstShadow->uiUpdates++ ] = pstShadow->stChain.bFixed
+												 ? FLIGHT_GetFusionCyclesQ( &pstShadow->stChain.stFlight )
+												 : FLIGHT_GetFusionCycles( &pstShadow->stChain.stFlight );
+
+	if ( fBegin_s + FLIGHTSIM_SETTLE_S <= fTime_s )
+	{
+		AddError( &pstShadow->stRoll, stEstimate.x - pstTruth->x );
+		AddError( &pstShadow->stPitch, stEstimate.y - pstTruth->y );
+		AddError( &pstShadow->stYaw, WrapPi( stEstimate.z - pstTruth->z ) );
+	}
+
+	if ( 0 <= pstShadow->fConverged_s )
+	{
+		return;
+	}
+
+	bIn = ( CONVERGED_RAD >= fabsf( stEstimate.x - pstTruth->x ) ) && ( CONVERGED_RAD >= fabsf( stEstimate.y - pstTruth->y ) );
+
+	if ( !bIn )
+	{
+		pstShadow->fInSince_s = -1;
+	}
+	else if ( 0 > pstShadow->fInSince_s )
+	{
+		pstShadow->fInSince_s = fTime_s;
+	}
+	else if ( CONVERGED_HOLD_S <= fTime_s - pstShadow->fInSince_s )
+	{
+		pstShadow->fConverged_s = pstShadow->fInSince_s - fBegin_s;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void PrintShadow( stShadow_t *pstShadow )
+{
+	uint32_t uiCount = pstShadow->uiUpdates;
+	double dSum = 0;
+	uint32_t uiIndex;
+
+	printf( "%-16s ", pstShadow->acName );
+
+	if ( 0 == uiCount )
+	{
+		printf( "never started\n" );
+		return;
+	}
+
+	for ( uiIndex = 0; uiIndex < uiCount; uiIndex++ )
+	{
+		dSum += pstShadow->puiNs[ uiIndex ];
+	}
+
+	qsort( pstShadow->puiNs, uiCount, sizeof( uint32_t ), CompareU32 );
+
+	printf( "%-7.0f %-7u %-7u %-8.4f %-8.4f %-8.4f  ", dSum / uiCount,
+			(unsigned)pstShadow->puiNs[ uiCount / 2 ], (unsigned)pstShadow->puiNs[ ( uiCount * 99 ) / 100 ],
+			FLIGHTSIM_Rms( &pstShadow->stRoll ), FLIGHTSIM_Rms( &pstShadow->stPitch ), FLIGHTSIM_Rms( &pstShadow->stYaw ) );
+
+	if ( 0 <= pstShadow->fConverged_s )
+	{
+		printf( "%.2f\n", pstShadow->fConverged_s );
+	}
+	else
+	{
+		printf( "never\n" );
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void AddError( stFLIGHTSIM_Error_t *pstError, const float fError )
+{
+	pstError->dSumSq += (double)fError * fError;
+	pstError->fMax = fmaxf( pstError->fMax, fabsf( fError ) );
+	pstError->uiCount++;
+
+	return;
+}
+
+/* ************************************************************************** */
+static float WrapPi( float fAngle )
+{
+	while ( PI < fAngle )
+	{
+		fAngle -= 2 * PI;
+	}
+
+	while ( -PI > fAngle )
+	{
+		fAngle += 2 * PI;
+	}
+
+	return fAngle;
+}
+
+/* ************************************************************************** */
+static int CompareU32( const void *pvA, const void *pvB )
+{
+	uint32_t uiA = *(const uint32_t*)pvA;
+	uint32_t uiB = *(const uint32_t*)pvB;
+
+	return ( uiA > uiB ) - ( uiA < uiB );
+}
@@ -0,0 +1,229 @@
+/* ************************************************************************** **
+ * Host micro-benchmark for PUBSUB_Publish.
+ *
+ * Measures the cost of publishing to a queued topic against the number of
+ * subscribers on that topic and the number of subscriptions held on other
+ * topics. The old implementation, a
+ * linear scan of every subscription in the system, is timed alongside on the
+ * same subscriptions for comparison. Queues are the copy-only stand-ins from
+ * freertos_stub.c so only the dispatch and the item copy are measured.
+ *
+ * A second table compares sampling a LATEST topic from its mailbox with
+ * draining a queue of the same messages down to the newest one.
+ *
+ * Build and run with "make bench" from the top level.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <stdio.h>			// printf & friends
+#include <string.h>			// memset & friends
+#include <time.h>			// clock_gettime
+
+#include "FreeRTOS.h"		// FreeRTOS
+#include "queue.h"			// FreeRTOS queues
+
+#include "pubsub.h"			// IPC publish-subscribe
+#include "IPC_types.h"		// stFlightDetails_t
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#ifndef MAX_SUBS
+#error "Build with the same -DMAX_SUBS as pubsub.c, see the Makefile"
+#endif
+
+#define PUBLISH_ITERATIONS		( 200000 )
+#define QUEUE_LEN				( 16 )
+#define MAX_OWN_SUBS			( 8 )
+#define MAX_OTHER_SUBS			( MAX_SUBS - MAX_OWN_SUBS )
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+
+// What the old PUBSUB_Publish walked, every subscription in the system
+typedef struct
+{
+	uint32_t uiTopic;
+	QueueHandle_t xQueue;
+
+} stLinearSub_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static double NowNs( void );
+static void LinearPublish( const stLinearSub_t *pastSubs, size_t sNumSubs, uint32_t uiTopic, const void *pvMsg );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static stLinearSub_t astLinearSubs[ MAX_SUBS ];
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( void )
+{
+	static const size_t asOwnSubs[] = { 1, 2, 4, 8 };
+	static const size_t asOtherSubs[] = { 0, 8, 24, 56 };
+
+	stFlightDetails_t stFlightDetails;
+	stLedPattern_t stLedPattern;
+	hPUBSUB_Subscription_t hQueued;
+	uint32_t uiBacklog;
+	hPUBSUB_Subscription_t hSub;
+	size_t sOwn;
+	size_t sOther;
+	size_t sNumLinear;
+	size_t sOwnLeft;
+	size_t sOtherLeft;
+	uint32_t uiIter;
+	double dStart;
+	double dIndexedNs;
+	double dLinearNs;
+
+	memset( &stFlightDetails, 0, sizeof( stFlightDetails ) );
+	memset( &stLedPattern, 0, sizeof( stLedPattern ) );
+
+	printf( "%-10s %-10s %-14s %-14s\n", "own_subs", "other_subs", "indexed_ns", "linear_ns" );
+
+	for ( sOwn = 0; sOwn < sizeof( asOwnSubs ) / sizeof( asOwnSubs[0] ); sOwn++ )
+	{
+		for ( sOther = 0; sOther < sizeof( asOtherSubs ) / sizeof( asOtherSubs[0] ); sOther++ )
+		{
+			if ( ( asOwnSubs[sOwn] > MAX_OWN_SUBS ) || ( asOtherSubs[sOther] > MAX_OTHER_SUBS ) )
+			{
+				continue;
+			}
+
+			// Fresh registry for each case, the other subscriptions are
+			// interleaved with ours as they would be at start up
+			PUBSUB_Create();
+			sNumLinear = 0;
+			sOwnLeft = asOwnSubs[sOwn];
+			sOtherLeft = asOtherSubs[sOther];
+
+			while ( ( 0 < sOwnLeft ) || ( 0 < sOtherLeft ) )
+			{
+				if ( ( 0 < sOwnLeft ) && ( ( 0 == sOtherLeft ) || ( 0 == ( sNumLinear % 2 ) ) ) )
+				{
+					sOwnLeft--;
+					hSub = PUBSUB_Subscribe( TOPIC_LED_PATTERN, sizeof( stLedPattern_t ), QUEUE_LEN );
+					astLinearSubs[sNumLinear].uiTopic = TOPIC_LED_PATTERN;
+					astLinearSubs[sNumLinear].xQueue = xQueueCreate( QUEUE_LEN, sizeof( stLedPattern_t ) );
+				}
+				else
+				{
+					sOtherLeft--;
+					hSub = PUBSUB_Subscribe( TOPIC_FLIGHT_DETAILS, sizeof( stFlightDetails_t ), QUEUE_LEN );
+					astLinearSubs[sNumLinear].uiTopic = TOPIC_FLIGHT_DETAILS;
+					astLinearSubs[sNumLinear].xQueue = xQueueCreate( QUEUE_LEN, sizeof( stFlightDetails_t ) );
+				}
+
+				if ( NULL == hSub )
+				{
+					printf( "Out of subscriptions, build with a larger MAX_SUBS\n" );
+					return 1;
+				}
+
+				sNumLinear++;
+			}
+
+			dStart = NowNs();
+			for ( uiIter = 0; uiIter < PUBLISH_ITERATIONS; uiIter++ )
+			{
+				stLedPattern.sPatternLen = uiIter;
+				PUBSUB_Publish( TOPIC_LED_PATTERN, &stLedPattern );
+			}
+			dIndexedNs = ( NowNs() - dStart ) / PUBLISH_ITERATIONS;
+
+			dStart = NowNs();
+			for ( uiIter = 0; uiIter < PUBLISH_ITERATIONS; uiIter++ )
+			{
+				stLedPattern.sPatternLen = uiIter;
+				LinearPublish( astLinearSubs, sNumLinear, TOPIC_LED_PATTERN, &stLedPattern );
+			}
+			dLinearNs = ( NowNs() - dStart ) / PUBLISH_ITERATIONS;
+
+			printf( "%-10u %-10u %-14.1f %-14.1f\n",
+					(unsigned)asOwnSubs[sOwn],
+					(unsigned)asOtherSubs[sOther],
+					dIndexedNs,
+					dLinearNs );
+		}
+	}
+
+	// Sampling state: the newest TOPIC_FLIGHT_DETAILS from its mailbox versus
+	// draining a queue that has built up a backlog since the last sample
+	PUBSUB_Create();
+	hQueued = PUBSUB_Subscribe( TOPIC_FLIGHT_DETAILS, sizeof( stFlightDetails_t ), QUEUE_LEN );
+	PUBSUB_Publish( TOPIC_FLIGHT_DETAILS, &stFlightDetails );
+
+	printf( "\n%-10s %-14s %-14s\n", "backlog", "latest_ns", "queue_ns" );
+
+	for ( uiBacklog = 1; uiBacklog <= QUEUE_LEN; uiBacklog *= 2 )
+	{
+		dStart = NowNs();
+		for ( uiIter = 0; uiIter < PUBLISH_ITERATIONS; uiIter++ )
+		{
+			PUBSUB_ReadLatest( TOPIC_FLIGHT_DETAILS, &stFlightDetails );
+		}
+		dIndexedNs = ( NowNs() - dStart ) / PUBLISH_ITERATIONS;
+
+		dLinearNs = 0;
+		for ( uiIter = 0; uiIter < PUBLISH_ITERATIONS / QUEUE_LEN; uiIter++ )
+		{
+			for ( sOwn = 0; sOwn < uiBacklog; sOwn++ )
+			{
+				PUBSUB_Publish( TOPIC_FLIGHT_DETAILS, &stFlightDetails );
+			}
+
+			dStart = NowNs();
+			while ( true == PUBSUB_Receive( hQueued, &stFlightDetails ) );
+			dLinearNs += NowNs() - dStart;
+		}
+		dLinearNs /= ( PUBLISH_ITERATIONS / QUEUE_LEN );
+
+		printf( "%-10u %-14.1f %-14.1f\n", (unsigned)uiBacklog, dIndexedNs, dLinearNs );
+	}
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static double NowNs( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return ( (double)stNow.tv_sec * 1e9 ) + (double)stNow.tv_nsec;
+}
+
+/* ************************************************************************** */
+static void LinearPublish( const stLinearSub_t *pastSubs, size_t sNumSubs, uint32_t uiTopic, const void *pvMsg )
+{
+	size_t sIndex;
+
+	for ( sIndex = 0; sIndex < sNumSubs; sIndex++ )
+	{
+		if ( pastSubs[sIndex].uiTopic == uiTopic )
+		{
+			xQueueSend( pastSubs[sIndex].xQueue, pvMsg, 0 );
+		}
+	}
+
+	return;
+}
@@ -0,0 +1,482 @@
+/* ************************************************************************** **
+ * Host equivalence check and timing for the fixed point flight controller.
+ *
+ * A synthetic flight is turned into raw LSM9DS0 FIFO samples and stick pulse
+ * widths, as the flight task would see them, and fed to both the float chain
+ * (DECIMATOR -> flight_process) and the fixed point chain (DECIMATOR_*Q ->
+ * flight_process_q). The attitude and motor demands of the two are compared
+ * loop by loop and the run fails if they drift apart by more than the
+ * tolerances below.
+ *
+ * Then both carry on over sample times that repeat or go backwards, as a late
+ * or missing DRDY_G edge gives them, and straight through a zero timestep.
+ * The run fails if that leaves a float motor demand that isn't finite.
+ *
+ * Each chain is then timed on its own over the same input. The host has an
+ * FPU so this understates the gap, on the K20 every float operation is a
+ * libgcc call. Use the target's cycle counter for the numbers that matter.
+ *
+ * Build and run with "make compare-fixed" from the top level.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <stdio.h>			// printf & friends
+#include <string.h>			// memset & friends
+#include <math.h>			// sinf & friends
+#include <time.h>			// clock_gettime
+
+#include "flight.h"			// Flight controller
+#include "decimator.h"		// FIFO sample aggregation
+#include "fixmath.h"		// Fixed point arithmetic
+#include "io_driver.h"		// RECEIVER_ ranges
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define NUM_LOOPS				( 20000 )	// Three and a half minutes at the flight rate
+#define LOOP_MS					( 10 )
+#define GYRO_PER_LOOP			( 4 )
+#define ACCEL_PER_LOOP_MAX		( 9 )
+#define TIMING_RUNS				( 5 )
+#define STAMP_LOOPS				( 200 )		// Over each odd sample time
+
+#define PI						( 3.14159265359f )
+#define DEG2RAD					( PI / 180 )
+
+// As configured by the flight task, 500dps and 8g full scale
+#define GYRO_RES_DPS			( 500.0f / 32768.0f )
+#define ACCEL_RES_G				( 8.0f / 32768.0f )
+#define GYRO_SAMPLE_PERIOD_S	( 1.0f / 380.0f )
+#define ACCEL_SAMPLE_PERIOD_S	( 1.0f / 800.0f )
+
+// The bounds the flight task puts on its timestep
+#define GYRO_SAMPLE_PERIOD_US	( 1000000UL / 380 )
+#define TIMESTEP_MAX_US			( 2 * LOOP_MS * 1000UL )
+
+// A fixed gyro offset for the Kalman filters to find, in raw LSBs
+#define GYRO_OFFSET_LSB			( 40 )
+
+// How far apart the two chains may be
+#define TOL_ATTITUDE_RAD		( 0.005f )
+#define TOL_MOTOR				( 0.01f )
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+
+// Everything one flight loop reads from the sensors and receiver
+typedef struct
+{
+	int16_t aiGyro[ GYRO_PER_LOOP ][3];
+	int16_t aiAccel[ ACCEL_PER_LOOP_MAX ][3];
+	uint8_t uiAccelCount;
+	uint16_t auiPulse[ NUM_RCVR_CHANNELS ];
+
+} stLoopInput_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static void MakeInputs( void );
+static void SetupChains( void );
+static bool CheckTimesteps( void );
+static void RunFloat( const stLoopInput_t *pstIn, const uint32_t uiTimestep_us, vector3f_t *pstRotation,
+					  stMotorDemands_t *pstDemands );
+static void RunFixed( const stLoopInput_t *pstIn, const uint32_t uiTimestep_us, vector3q_t *pstRotation,
+					  stMotorDemandsQ_t *pstDemands );
+static int16_t ToRaw( const float fValue, const float fRes );
+static float Noise( void );
+static double NowNs( void );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static stLoopInput_t astInputs[ NUM_LOOPS ];
+static stDECIMATOR_Cxt_t stGyroDecimator;
+static stDECIMATOR_Cxt_t stAccelDecimator;
+static stDECIMATOR_Q_Cxt_t stGyroDecimatorQ;
+static stDECIMATOR_Q_Cxt_t stAccelDecimatorQ;
+static stFLIGHT_Cxt_t stFlight;
+static uint32_t uiNoiseState = 1;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( void )
+{
+	vector3f_t stRotation;
+	vector3q_t stRotationQ;
+	stMotorDemands_t stDemands;
+	stMotorDemandsQ_t stDemandsQ;
+	float fMaxAttitude = 0;
+	float fMaxMotor = 0;
+	float afMotor[4];
+	float fDiff;
+	uint32_t uiLoop;
+	uint32_t uiRun;
+	uint32_t uiMotor;
+	double dStart;
+	double dFloatNs;
+	double dFixedNs;
+	volatile q16_t qSink = 0;
+	volatile float fSink = 0;
+	bool bFinite;
+
+	MakeInputs();
+
+	// Both chains in lockstep on the same input
+	SetupChains();
+
+	for ( uiLoop = 0; uiLoop < NUM_LOOPS; uiLoop++ )
+	{
+		RunFloat( &astInputs[ uiLoop ], LOOP_MS * 1000, &stRotation, &stDemands );
+		RunFixed( &astInputs[ uiLoop ], LOOP_MS * 1000, &stRotationQ, &stDemandsQ );
+
+		fDiff = fmaxf( fabsf( stRotation.x - FIXMATH_ToFloat( stRotationQ.x ) ),
+					   fabsf( stRotation.y - FIXMATH_ToFloat( stRotationQ.y ) ) );
+		fMaxAttitude = fmaxf( fMaxAttitude, fDiff );
+
+		afMotor[0] = stDemands.fFL - FIXMATH_ToFloat( stDemandsQ.qFL );
+		afMotor[1] = stDemands.fFR - FIXMATH_ToFloat( stDemandsQ.qFR );
+		afMotor[2] = stDemands.fRL - FIXMATH_ToFloat( stDemandsQ.qRL );
+		afMotor[3] = stDemands.fRR - FIXMATH_ToFloat( stDemandsQ.qRR );
+
+		for ( uiMotor = 0; uiMotor < 4; uiMotor++ )
+		{
+			fMaxMotor = fmaxf( fMaxMotor, fabsf( afMotor[ uiMotor ] ) );
+		}
+	}
+
+	printf( "%-22s %-12s %-12s\n", "max |float - fixed|", "measured", "tolerance" );
+	printf( "%-22s %-12.6f %-12.6f\n", "attitude (rad)", fMaxAttitude, TOL_ATTITUDE_RAD );
+	printf( "%-22s %-12.6f %-12.6f\n", "motor demand", fMaxMotor, TOL_MOTOR );
+
+	// Carrying on from there
+	bFinite = CheckTimesteps();
+
+	// Then each chain on its own, best of a few runs
+	dFloatNs = 1e30;
+	dFixedNs = 1e30;
+
+	for ( uiRun = 0; uiRun < TIMING_RUNS; uiRun++ )
+	{
+		SetupChains();
+		dStart = NowNs();
+		for ( uiLoop = 0; uiLoop < NUM_LOOPS; uiLoop++ )
+		{
+			RunFloat( &astInputs[ uiLoop ], LOOP_MS * 1000, &stRotation, &stDemands );
+			fSink = stDemands.fFL;
+		}
+		dFloatNs = fmin( dFloatNs, ( NowNs() - dStart ) / NUM_LOOPS );
+
+		SetupChains();
+		dStart = NowNs();
+		for ( uiLoop = 0; uiLoop < NUM_LOOPS; uiLoop++ )
+		{
+			RunFixed( &astInputs[ uiLoop ], LOOP_MS * 1000, &stRotationQ, &stDemandsQ );
+			qSink = stDemandsQ.qFL;
+		}
+		dFixedNs = fmin( dFixedNs, ( NowNs() - dStart ) / NUM_LOOPS );
+	}
+
+	( void )qSink;
+	( void )fSink;
+
+	printf( "\n%-22s %-12s %-12s\n", "host ns per loop", "float", "fixed" );
+	printf( "%-22s %-12.1f %-12.1f\n", "decimate to motors", dFloatNs, dFixedNs );
+
+	if ( ( TOL_ATTITUDE_RAD < fMaxAttitude ) || ( TOL_MOTOR < fMaxMotor ) )
+	{
+		printf( "\nFAIL: the fixed point chain does not match the float chain\n" );
+		return 1;
+	}
+
+	if ( !bFinite )
+	{
+		printf( "\nFAIL: an odd timestep left a motor demand that isn't a number\n" );
+		return 1;
+	}
+
+	printf( "\nPASS\n" );
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static bool CheckTimesteps( void )
+{
+	// Every other sample time is odd, relative to the last one. The bound
+	// normally stands between the stamps and the controller, the last case
+	// leaves it out and hands the controller a zero timestep directly.
+	static const struct
+	{
+		const char *pcName;
+		int32_t iStamp_us;
+		bool bBound;
+
+	} astCases[] =
+	{
+		{ "same stamp",		0,						true },
+		{ "stamp -1us",		-1,						true },
+		{ "stamp -1 loop",	-( LOOP_MS * 1000 ),	true },
+		{ "zero step",		0,						false },
+	};
+	vector3f_t stRotation;
+	vector3q_t stRotationQ;
+	stMotorDemands_t stDemands;
+	stMotorDemandsQ_t stDemandsQ;
+	uint32_t uiLast_us = 0xFFFFFF00;		// So the clock wraps on the way
+	uint32_t uiStamp_us;
+	uint32_t uiTimestep_us;
+	uint32_t uiMinStep_us;
+	uint32_t uiLoop;
+	size_t sCase;
+	bool bOk;
+	bool bPass = true;
+
+	printf( "\n%-22s %-12s %s\n", "odd sample time", "step (us)", "result" );
+
+	for ( sCase = 0; sCase < ( sizeof( astCases ) / sizeof( astCases[0] ) ); sCase++ )
+	{
+		uiMinStep_us = TIMESTEP_MAX_US;
+		bOk = true;
+
+		for ( uiLoop = 0; uiLoop < STAMP_LOOPS; uiLoop++ )
+		{
+			uiStamp_us = uiLast_us + ( ( uiLoop & 1 ) ? astCases[ sCase ].iStamp_us : ( LOOP_MS * 1000 ) );
+
+			if ( astCases[ sCase ].bBound )
+			{
+				uiTimestep_us = FLIGHT_BoundTimestep_us( uiStamp_us, uiLast_us, GYRO_SAMPLE_PERIOD_US, TIMESTEP_MAX_US );
+				bOk = bOk && ( GYRO_SAMPLE_PERIOD_US <= uiTimestep_us ) && ( TIMESTEP_MAX_US >= uiTimestep_us );
+			}
+			else
+			{
+				uiTimestep_us = uiStamp_us - uiLast_us;
+			}
+
+			uiLast_us = uiStamp_us;
+			uiMinStep_us = ( uiTimestep_us < uiMinStep_us ) ? uiTimestep_us : uiMinStep_us;
+
+			RunFloat( &astInputs[ uiLoop ], uiTimestep_us, &stRotation, &stDemands );
+			RunFixed( &astInputs[ uiLoop ], uiTimestep_us, &stRotationQ, &stDemandsQ );
+
+			bOk = bOk && isfinite( stDemands.fFL ) && isfinite( stDemands.fFR )
+					  && isfinite( stDemands.fRL ) && isfinite( stDemands.fRR )
+					  && isfinite( stRotation.x ) && isfinite( stRotation.y );
+		}
+
+		printf( "%-22s %-12u %s\n", astCases[ sCase ].pcName, (unsigned)uiMinStep_us, bOk ? "ok" : "FAILED" );
+
+		bPass = bOk && bPass;
+	}
+
+	return bPass;
+}
+
+/* ************************************************************************** */
+static void MakeInputs( void )
+{
+	stLoopInput_t *pstIn;
+	uint32_t uiLoop;
+	uint32_t uiSample;
+	uint32_t uiAccelTotal = 0;
+	float fTime;
+	float fRoll;
+	float fPitch;
+	float fRollRate;
+	float fPitchRate;
+	float fYawRate;
+	float fStickRoll;
+	float fStickPitch;
+
+	for ( uiLoop = 0; uiLoop < NUM_LOOPS; uiLoop++ )
+	{
+		pstIn = &astInputs[ uiLoop ];
+
+		for ( uiSample = 0; uiSample < GYRO_PER_LOOP; uiSample++ )
+		{
+			// Roll and pitch wander up to +-0.6 rad at a few tenths of a Hz
+			fTime = ( ( uiLoop * GYRO_PER_LOOP ) + uiSample ) * GYRO_SAMPLE_PERIOD_S;
+			fRollRate = 0.6f * 1.3f * cosf( 1.3f * fTime );
+			fPitchRate = 0.4f * 2.1f * cosf( 2.1f * fTime + 1.0f );
+			fYawRate = 0.5f * sinf( 0.2f * fTime );
+
+			pstIn->aiGyro[ uiSample ][0] = ToRaw( ( fRollRate / DEG2RAD ) + Noise(), GYRO_RES_DPS ) + GYRO_OFFSET_LSB;
+			pstIn->aiGyro[ uiSample ][1] = ToRaw( ( fPitchRate / DEG2RAD ) + Noise(), GYRO_RES_DPS ) - GYRO_OFFSET_LSB;
+			pstIn->aiGyro[ uiSample ][2] = ToRaw( ( fYawRate / DEG2RAD ) + Noise(), GYRO_RES_DPS );
+		}
+
+		// The accel runs at 800Hz so a loop sees eight or nine samples
+		pstIn->uiAccelCount = 0;
+
+		while ( ( uiAccelTotal * ACCEL_SAMPLE_PERIOD_S ) < ( ( uiLoop + 1 ) * GYRO_PER_LOOP * GYRO_SAMPLE_PERIOD_S ) )
+		{
+			fTime = uiAccelTotal * ACCEL_SAMPLE_PERIOD_S;
+			fRoll = 0.6f * sinf( 1.3f * fTime );
+			fPitch = 0.4f * sinf( 2.1f * fTime + 1.0f );
+
+			// Gravity in the body frame, as sensor_fusion.c reads it back
+			uiSample = pstIn->uiAccelCount++;
+			pstIn->aiAccel[ uiSample ][0] = ToRaw( -sinf( fPitch ) + ( 0.01f * Noise() ), ACCEL_RES_G );
+			pstIn->aiAccel[ uiSample ][1] = ToRaw( sinf( fRoll ) * cosf( fPitch ) + ( 0.01f * Noise() ), ACCEL_RES_G );
+			pstIn->aiAccel[ uiSample ][2] = ToRaw( cosf( fRoll ) * cosf( fPitch ) + ( 0.01f * Noise() ), ACCEL_RES_G );
+			uiAccelTotal++;
+		}
+
+		// Mid throttle with the sticks moving, VRA at half
+		fTime = uiLoop * LOOP_MS / 1000.0f;
+		fStickRoll = 0.8f * sinf( 0.7f * fTime );
+		fStickPitch = 0.8f * cosf( 0.5f * fTime );
+
+		// Widths above RECEIVER_FLOOR, as IODRIVER_GetInputPulseWidth gives them
+		pstIn->auiPulse[ 0 ] = (uint16_t)( ( RECEIVER_RANGE / 2 ) + (int32_t)( fStickRoll * ( RECEIVER_RANGE / 2 ) ) );
+		pstIn->auiPulse[ 1 ] = (uint16_t)( ( RECEIVER_RANGE / 2 ) + (int32_t)( fStickPitch * ( RECEIVER_RANGE / 2 ) ) );
+		pstIn->auiPulse[ 2 ] = RECEIVER_RANGE / 2;
+		pstIn->auiPulse[ 3 ] = ( RECEIVER_RANGE / 2 ) + ( RECEIVER_RANGE / 20 );
+		pstIn->auiPulse[ 4 ] = RECEIVER_RANGE / 2;
+		pstIn->auiPulse[ 5 ] = 0;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void SetupChains( void )
+{
+	flight_setup( &stFlight );
+
+	DECIMATOR_Setup( &stGyroDecimator, DECIMATOR_MODE_FIR, GYRO_SAMPLE_PERIOD_S );
+	DECIMATOR_Setup( &stAccelDecimator, DECIMATOR_MODE_AVERAGE, ACCEL_SAMPLE_PERIOD_S );
+
+	DECIMATOR_SetupQ( &stGyroDecimatorQ, DECIMATOR_MODE_FIR,
+					  FIXMATH_FromFloat30( GYRO_RES_DPS * DEG2RAD ), FIXMATH_Q30( GYRO_SAMPLE_PERIOD_S ) );
+	DECIMATOR_SetupQ( &stAccelDecimatorQ, DECIMATOR_MODE_AVERAGE,
+					  FIXMATH_FromFloat30( ACCEL_RES_G ), FIXMATH_Q30( ACCEL_SAMPLE_PERIOD_S ) );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void RunFloat( const stLoopInput_t *pstIn, const uint32_t uiTimestep_us, vector3f_t *pstRotation,
+					  stMotorDemands_t *pstDemands )
+{
+	vector3f_t stSample;
+	vector3f_t stGyro;
+	vector3f_t stGyroDelta;
+	vector3f_t stAccel;
+	vector3f_t stMag = { 0, };
+	stReceiverInput_t stReceiver;
+	uint32_t uiSample;
+
+	// As the float stages in task_flight.c
+	for ( uiSample = 0; uiSample < GYRO_PER_LOOP; uiSample++ )
+	{
+		stSample.x = pstIn->aiGyro[ uiSample ][0] * GYRO_RES_DPS;
+		stSample.y = pstIn->aiGyro[ uiSample ][1] * GYRO_RES_DPS;
+		stSample.z = pstIn->aiGyro[ uiSample ][2] * GYRO_RES_DPS;
+		DECIMATOR_Push( &stGyroDecimator, &stSample );
+	}
+
+	DECIMATOR_Output( &stGyroDecimator, &stGyro, &stGyroDelta );
+
+	for ( uiSample = 0; uiSample < pstIn->uiAccelCount; uiSample++ )
+	{
+		stSample.x = pstIn->aiAccel[ uiSample ][0] * ACCEL_RES_G;
+		stSample.y = pstIn->aiAccel[ uiSample ][1] * ACCEL_RES_G;
+		stSample.z = pstIn->aiAccel[ uiSample ][2] * ACCEL_RES_G;
+		DECIMATOR_Push( &stAccelDecimator, &stSample );
+	}
+
+	DECIMATOR_Output( &stAccelDecimator, &stAccel, NULL );
+
+	stGyro = VECTOR3F_Scale( stGyro, DEG2RAD );
+	stGyroDelta = VECTOR3F_Scale( stGyroDelta, DEG2RAD );
+
+	FLIGHT_ReceiverFromPulses( pstIn->auiPulse, &stReceiver );
+
+	flight_process( &stFlight, uiTimestep_us, &stAccel, &stGyro, &stGyroDelta, &stMag, &stReceiver, pstDemands );
+	FLIGHT_GetRotation( &stFlight, pstRotation );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void RunFixed( const stLoopInput_t *pstIn, const uint32_t uiTimestep_us, vector3q_t *pstRotation,
+					  stMotorDemandsQ_t *pstDemands )
+{
+	vector3q_t stGyro;
+	vector3q_t stGyroDelta;
+	vector3q_t stAccel;
+	stReceiverInputQ_t stReceiver;
+	uint32_t uiSample;
+
+	// As the fixed point stages in task_flight.c
+	for ( uiSample = 0; uiSample < GYRO_PER_LOOP; uiSample++ )
+	{
+		DECIMATOR_PushQ( &stGyroDecimatorQ, pstIn->aiGyro[ uiSample ] );
+	}
+
+	DECIMATOR_OutputQ( &stGyroDecimatorQ, &stGyro, &stGyroDelta );
+
+	for ( uiSample = 0; uiSample < pstIn->uiAccelCount; uiSample++ )
+	{
+		DECIMATOR_PushQ( &stAccelDecimatorQ, pstIn->aiAccel[ uiSample ] );
+	}
+
+	DECIMATOR_OutputQ( &stAccelDecimatorQ, &stAccel, NULL );
+
+	FLIGHT_ReceiverFromPulsesQ( pstIn->auiPulse, &stReceiver );
+
+	flight_process_q( &stFlight, uiTimestep_us, &stAccel, &stGyro, &stGyroDelta, &stReceiver, pstDemands );
+	FLIGHT_GetRotationQ( &stFlight, pstRotation );
+
+	return;
+}
+
+/* ************************************************************************** */
+static int16_t ToRaw( const float fValue, const float fRes )
+{
+	float fRaw = roundf( fValue / fRes );
+
+	if ( 32767.0f < fRaw )
+	{
+		return 32767;
+	}
+	else if ( -32768.0f > fRaw )
+	{
+		return -32768;
+	}
+
+	return (int16_t)fRaw;
+}
+
+/* ************************************************************************** */
+static float Noise( void )
+{
+	// Repeatable, roughly uniform in +-1
+	uiNoiseState = ( uiNoiseState * 1103515245u ) + 12345u;
+
+	return ( (float)( ( uiNoiseState >> 8 ) & 0xFFFF ) / 32768.0f ) - 1.0f;
+}
+
+/* ************************************************************************** */
+static double NowNs( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return ( (double)stNow.tv_sec * 1e9 ) + (double)stNow.tv_nsec;
+}
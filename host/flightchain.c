@@ -0,0 +1,164 @@
+/* ************************************************************************** **
+ * The flight task's processing of one tick of raw inputs, see flightchain.h.
+ * Shared by the simulated flights (flightsim.c) and log replay (replay.c).
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <string.h>			// memset & friends
+
+#include "flightchain.h"	// Module header
+#include "flight.h"			// Flight controller
+#include "decimator.h"		// FIFO sample aggregation
+#include "fixmath.h"		// Fixed point arithmetic
+#include "sensorlog.h"		// Raw tick inputs
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define PI						( 3.14159265359f )
+#define DEG2RAD					( PI / 180 )
+#define FNV_PRIME				( 0x100000001B3ULL )
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+void FLIGHTCHAIN_Setup( stFLIGHTCHAIN_Cxt_t *pstCxt, const stSENSORLOG_Header_t *pstScale, const bool bFixed )
+{
+	memset( pstCxt, 0, sizeof( stFLIGHTCHAIN_Cxt_t ) );
+	pstCxt->bFixed = bFixed;
+	pstCxt->stScale = *pstScale;
+
+	flight_setup( &pstCxt->stFlight );
+
+	// As the flight task sets them up
+	DECIMATOR_Setup( &pstCxt->stGyroDecimator, DECIMATOR_MODE_FIR, pstScale->fGyroPeriod_s );
+	DECIMATOR_Setup( &pstCxt->stAccelDecimator, DECIMATOR_MODE_AVERAGE, pstScale->fAccelPeriod_s );
+
+	DECIMATOR_SetupQ( &pstCxt->stGyroDecimatorQ, DECIMATOR_MODE_FIR,
+					  FIXMATH_FromFloat30( pstScale->fGyroRes_dps * DEG2RAD ), FIXMATH_Q30( pstScale->fGyroPeriod_s ) );
+	DECIMATOR_SetupQ( &pstCxt->stAccelDecimatorQ, DECIMATOR_MODE_AVERAGE,
+					  FIXMATH_FromFloat30( pstScale->fAccelRes_g ), FIXMATH_Q30( pstScale->fAccelPeriod_s ) );
+
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHTCHAIN_Run( stFLIGHTCHAIN_Cxt_t *pstCxt, const stSENSORLOG_Tick_t *pstTick,
+					  stMotorDemands_t *pstDemands, vector3f_t *pstAttitude )
+{
+	const stSENSORLOG_Header_t *pstScale = &pstCxt->stScale;
+	const int16_t (*paaiGyro)[3] = (const int16_t (*)[3])( pstTick + 1 );
+	const int16_t (*paaiAccel)[3] = paaiGyro + pstTick->uiGyroCount;
+	vector3f_t stSample;
+	vector3f_t stGyro;
+	vector3f_t stGyroDelta;
+	vector3f_t stAccel;
+	vector3f_t stMag;
+	vector3q_t stGyroQ;
+	vector3q_t stGyroDeltaQ;
+	vector3q_t stAccelQ;
+	vector3q_t stRotationQ;
+	stReceiverInput_t stReceiver;
+	stReceiverInputQ_t stReceiverQ;
+	stMotorDemandsQ_t stDemandsQ;
+	uint32_t uiSample;
+
+	if ( pstCxt->bFixed )
+	{
+		// As the fixed point stages in task_flight.c
+		for ( uiSample = 0; uiSample < pstTick->uiGyroCount; uiSample++ )
+		{
+			DECIMATOR_PushQ( &pstCxt->stGyroDecimatorQ, paaiGyro[ uiSample ] );
+		}
+
+		DECIMATOR_OutputQ( &pstCxt->stGyroDecimatorQ, &stGyroQ, &stGyroDeltaQ );
+
+		for ( uiSample = 0; uiSample < pstTick->uiAccelCount; uiSample++ )
+		{
+			DECIMATOR_PushQ( &pstCxt->stAccelDecimatorQ, paaiAccel[ uiSample ] );
+		}
+
+		DECIMATOR_OutputQ( &pstCxt->stAccelDecimatorQ, &stAccelQ, NULL );
+
+		FLIGHT_ReceiverFromPulsesQ( pstTick->auiPulse, &stReceiverQ );
+
+		flight_process_q( &pstCxt->stFlight, pstTick->uiDt_us, &stAccelQ, &stGyroQ, &stGyroDeltaQ, &stReceiverQ, &stDemandsQ );
+		FLIGHT_GetRotationQ( &pstCxt->stFlight, &stRotationQ );
+
+		pstDemands->fFL = FIXMATH_ToFloat( stDemandsQ.qFL );
+		pstDemands->fFR = FIXMATH_ToFloat( stDemandsQ.qFR );
+		pstDemands->fRL = FIXMATH_ToFloat( stDemandsQ.qRL );
+		pstDemands->fRR = FIXMATH_ToFloat( stDemandsQ.qRR );
+		pstAttitude->x = FIXMATH_ToFloat( stRotationQ.x );
+		pstAttitude->y = FIXMATH_ToFloat( stRotationQ.y );
+		pstAttitude->z = FIXMATH_ToFloat( stRotationQ.z );
+	}
+	else
+	{
+		// As the float stages in task_flight.c
+		for ( uiSample = 0; uiSample < pstTick->uiGyroCount; uiSample++ )
+		{
+			stSample.x = paaiGyro[ uiSample ][0] * pstScale->fGyroRes_dps;
+			stSample.y = paaiGyro[ uiSample ][1] * pstScale->fGyroRes_dps;
+			stSample.z = paaiGyro[ uiSample ][2] * pstScale->fGyroRes_dps;
+			DECIMATOR_Push( &pstCxt->stGyroDecimator, &stSample );
+		}
+
+		DECIMATOR_Output( &pstCxt->stGyroDecimator, &stGyro, &stGyroDelta );
+
+		for ( uiSample = 0; uiSample < pstTick->uiAccelCount; uiSample++ )
+		{
+			stSample.x = paaiAccel[ uiSample ][0] * pstScale->fAccelRes_g;
+			stSample.y = paaiAccel[ uiSample ][1] * pstScale->fAccelRes_g;
+			stSample.z = paaiAccel[ uiSample ][2] * pstScale->fAccelRes_g;
+			DECIMATOR_Push( &pstCxt->stAccelDecimator, &stSample );
+		}
+
+		DECIMATOR_Output( &pstCxt->stAccelDecimator, &stAccel, NULL );
+
+		stMag.x = pstTick->aiMag[0] * pstScale->fMagRes_gauss;
+		stMag.y = pstTick->aiMag[1] * pstScale->fMagRes_gauss;
+		stMag.z = pstTick->aiMag[2] * pstScale->fMagRes_gauss;
+
+		stGyro = VECTOR3F_Scale( stGyro, DEG2RAD );
+		stGyroDelta = VECTOR3F_Scale( stGyroDelta, DEG2RAD );
+
+		FLIGHT_ReceiverFromPulses( pstTick->auiPulse, &stReceiver );
+
+		flight_process( &pstCxt->stFlight, pstTick->uiDt_us, &stAccel, &stGyro, &stGyroDelta, &stMag, &stReceiver, pstDemands );
+		FLIGHT_GetRotation( &pstCxt->stFlight, pstAttitude );
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+uint64_t FLIGHTCHAIN_Digest( uint64_t uiDigest, const stMotorDemands_t *pstDemands, const vector3f_t *pstAttitude )
+{
+	float afOut[7];
+	uint8_t auiBytes[ sizeof( afOut ) ];
+	size_t uiByte;
+
+	afOut[0] = pstDemands->fFL;
+	afOut[1] = pstDemands->fFR;
+	afOut[2] = pstDemands->fRL;
+	afOut[3] = pstDemands->fRR;
+	afOut[4] = pstAttitude->x;
+	afOut[5] = pstAttitude->y;
+	afOut[6] = pstAttitude->z;
+	memcpy( auiBytes, afOut, sizeof( afOut ) );
+
+	for ( uiByte = 0; uiByte < sizeof( auiBytes ); uiByte++ )
+	{
+		uiDigest = ( uiDigest ^ auiBytes[ uiByte ] ) * FNV_PRIME;
+	}
+
+	return uiDigest;
+}
@@ -0,0 +1,64 @@
+#ifndef FLIGHTCHAIN_H
+#define FLIGHTCHAIN_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include "vector3f.h"		// vector3f_t
+#include "flight.h"			// Flight controller
+#include "decimator.h"		// FIFO sample aggregation
+#include "sensorlog.h"		// Raw tick inputs
+
+/*
+ * What the flight task does with one tick of raw inputs: the FIFO samples
+ * through the decimators, the pulse widths into stick positions, then
+ * flight_process (or flight_process_q), the flight task's rate and angle
+ * stages run back to back every tick. The temperature is carried but the gyro
+ * bias table is board calibration and stays in the flight task.
+ *
+ * The input is a sensor log tick so a simulated flight, a recorded one and its
+ * replay all go through exactly the same code.
+ */
+
+#define FLIGHTCHAIN_DIGEST_INIT		( 0xCBF29CE484222325ULL )	// FNV-1a offset basis
+
+typedef struct
+{
+	bool bFixed;
+	stSENSORLOG_Header_t stScale;
+	stFLIGHT_Cxt_t stFlight;
+	stDECIMATOR_Cxt_t stGyroDecimator;
+	stDECIMATOR_Cxt_t stAccelDecimator;
+	stDECIMATOR_Q_Cxt_t stGyroDecimatorQ;
+	stDECIMATOR_Q_Cxt_t stAccelDecimatorQ;
+
+} stFLIGHTCHAIN_Cxt_t;
+
+/**
+ * @brief		Sets up the controller and decimators as the flight task does.
+ * @param[out]	pstCxt		Chain context.
+ * @param[in]	pstScale	Log header giving the sample scaling and rates.
+ * @param[in]	bFixed		Run flight_process_q rather than flight_process.
+ */
+void FLIGHTCHAIN_Setup( stFLIGHTCHAIN_Cxt_t *pstCxt, const stSENSORLOG_Header_t *pstScale, const bool bFixed );
+
+/**
+ * @brief		Runs one tick.
+ * @param[in]	pstCxt		Chain context.
+ * @param[in]	pstTick		The tick, followed in memory by its samples.
+ * @param[out]	pstDemands	Motor demands.
+ * @param[out]	pstAttitude	Attitude estimate in radians, fixed point converted.
+ */
+void FLIGHTCHAIN_Run( stFLIGHTCHAIN_Cxt_t *pstCxt, const stSENSORLOG_Tick_t *pstTick,
+					  stMotorDemands_t *pstDemands, vector3f_t *pstAttitude );
+
+/**
+ * @brief		Folds one tick's outputs into a running FNV-1a digest, equal
+ * 				digests mean the runs matched bit for bit.
+ * @param[in]	uiDigest	The digest so far, FLIGHTCHAIN_DIGEST_INIT to start.
+ * @param[in]	pstDemands	Motor demands.
+ * @param[in]	pstAttitude	Attitude estimate.
+ * @return		The new digest.
+ */
+uint64_t FLIGHTCHAIN_Digest( uint64_t uiDigest, const stMotorDemands_t *pstDemands, const vector3f_t *pstAttitude );
+
+#endif
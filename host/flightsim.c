@@ -0,0 +1,295 @@
+/* ************************************************************************** **
+ * One closed loop simulated flight, see flightsim.h. Shared by the software in
+ * the loop run (sitl.c) and the gain sweep (sweep.c).
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <string.h>			// memset & friends
+#include <math.h>			// sqrt & friends
+
+#include "flightsim.h"		// Module header
+#include "flight.h"			// Flight controller
+#include "flightchain.h"	// The flight task's processing
+#include "sensorlog.h"		// Raw tick inputs
+#include "quadsim.h"		// Quadrotor model
+#include "io_driver.h"		// RECEIVER_ ranges
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define GYRO_SAMPLE_PERIOD_S	( 1.0f / FLIGHTSIM_GYRO_HZ )
+#define ACCEL_SAMPLE_PERIOD_S	( 1.0f / FLIGHTSIM_ACCEL_HZ )
+
+#define DEFAULT_DURATION_S		( 32 )
+#define DEFAULT_GYRO_PER_LOOP	( 4 )		// The flight task's FIFO watermark
+#define STICK_VARA				( 0.5f )	// Stick of 1 asks for 0.5 rad
+#define LOST_ANGLE_RAD			( 1.2f )
+#define STICK_PERIOD_S			( 12.0f )
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+typedef struct
+{
+	float fStart_s;
+	float fRoll;
+	float fPitch;
+
+} stStickStep_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static void GetSticks( const float fTime_s, const float fHover, stReceiverInput_t *pstReceiver );
+static void SticksToPulses( const stReceiverInput_t *pstReceiver, uint16_t auiPulse[ SENSORLOG_NUM_PULSES ] );
+static uint16_t ToPulse( const float fStick, const bool bCentred );
+static void AddError( stFLIGHTSIM_Error_t *pstError, const float fError );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+
+// Repeats every STICK_PERIOD_S
+static const stStickStep_t astSticks[] =
+{
+	{  0.0f,  0.0f,  0.0f },
+	{  2.0f,  0.4f,  0.0f },
+	{  3.0f,  0.0f,  0.0f },
+	{  4.0f, -0.4f,  0.0f },
+	{  5.0f,  0.0f,  0.0f },
+	{  6.0f,  0.0f,  0.4f },
+	{  7.0f,  0.0f,  0.0f },
+	{  8.0f,  0.0f, -0.4f },
+	{  9.0f,  0.0f,  0.0f },
+	{ 10.0f,  0.3f,  0.3f },
+	{ 11.0f,  0.0f,  0.0f },
+};
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+void FLIGHTSIM_DefaultConfig( stFLIGHTSIM_Config_t *pstConfig )
+{
+	stFLIGHT_Cxt_t stFlight;
+
+	// Take the gains and filter noise from a fresh controller rather than
+	// keeping a second copy of them here
+	flight_setup( &stFlight );
+
+	pstConfig->fDuration_s = DEFAULT_DURATION_S;
+	pstConfig->uiSeed = 1;
+	pstConfig->uiGyroPerLoop = DEFAULT_GYRO_PER_LOOP;
+	pstConfig->bFixed = false;
+	pstConfig->eFusion = FLIGHT_GetFusionStrategy( &stFlight );
+	pstConfig->fRateP = stFlight.stPIDRollRate.fKProp;
+	pstConfig->fRateD = stFlight.stPIDRollRate.fKDiff;
+	pstConfig->fAngleP = stFlight.stPIDRollAngle.fKProp;
+	pstConfig->fQAngle = stFlight.stSensorFusion.stKalmanRoll.Q_angle;
+	pstConfig->fQBias = stFlight.stSensorFusion.stKalmanRoll.Q_bias;
+	pstConfig->fRMeasure = stFlight.stSensorFusion.stKalmanRoll.R_measure;
+
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHTSIM_Setup( stFLIGHTSIM_Cxt_t *pstCxt, const stFLIGHTSIM_Config_t *pstConfig )
+{
+	stQUADSIM_Params_t stParams;
+	stSENSORLOG_Header_t stHeader;
+
+	memset( pstCxt, 0, sizeof( stFLIGHTSIM_Cxt_t ) );
+	pstCxt->stConfig = *pstConfig;
+
+	if ( FLIGHTSIM_GYRO_PER_LOOP_MAX < pstCxt->stConfig.uiGyroPerLoop )
+	{
+		pstCxt->stConfig.uiGyroPerLoop = FLIGHTSIM_GYRO_PER_LOOP_MAX;
+	}
+	else if ( 0 == pstCxt->stConfig.uiGyroPerLoop )
+	{
+		pstCxt->stConfig.uiGyroPerLoop = 1;
+	}
+
+	pstCxt->uiSteps = (uint64_t)( pstCxt->stConfig.fDuration_s * FLIGHTSIM_PHYSICS_HZ );
+
+	QUADSIM_DefaultParams( &stParams );
+	QUADSIM_Setup( &pstCxt->stSim, &stParams, pstCxt->stConfig.uiSeed );
+	pstCxt->fHover = QUADSIM_HoverDemand( &stParams );
+
+	memset( &stHeader, 0, sizeof( stHeader ) );
+	stHeader.uiMagic = SENSORLOG_MAGIC;
+	stHeader.uiVersion = SENSORLOG_VERSION;
+	stHeader.uiHeaderLen = sizeof( stSENSORLOG_Header_t );
+	stHeader.fGyroRes_dps = QUADSIM_GYRO_RES_DPS;
+	stHeader.fAccelRes_g = QUADSIM_ACCEL_RES_G;
+	stHeader.fMagRes_gauss = QUADSIM_MAG_RES_GAUSS;
+	stHeader.fGyroPeriod_s = GYRO_SAMPLE_PERIOD_S;
+	stHeader.fAccelPeriod_s = ACCEL_SAMPLE_PERIOD_S;
+
+	FLIGHTCHAIN_Setup( &pstCxt->stChain, &stHeader, pstConfig->bFixed );
+	FLIGHT_SetPidGains( &pstCxt->stChain.stFlight, pstConfig->fRateP, pstConfig->fRateD, pstConfig->fAngleP );
+	FLIGHT_SetKalmanNoise( &pstCxt->stChain.stFlight, pstConfig->fQAngle, pstConfig->fQBias, pstConfig->fRMeasure );
+	FLIGHT_SetFusionStrategy( &pstCxt->stChain.stFlight, pstConfig->eFusion );
+
+	return;
+}
+
+/* ************************************************************************** */
+bool FLIGHTSIM_Advance( stFLIGHTSIM_Cxt_t *pstCxt )
+{
+	stSENSORLOG_Tick_t *pstTick = &pstCxt->stRecord.stTick;
+	uint64_t uiDt_us;
+
+	pstCxt->uiGyroCount = 0;
+	pstCxt->uiAccelCount = 0;
+
+	while ( !pstCxt->bLost && ( pstCxt->uiStep < pstCxt->uiSteps ) )
+	{
+		pstCxt->uiStep++;
+		QUADSIM_Step( &pstCxt->stSim, 1.0f / FLIGHTSIM_PHYSICS_HZ );
+
+		// Samples land in the FIFOs at the sensor rates
+		if ( pstCxt->uiAccelTaken < ( pstCxt->uiStep * FLIGHTSIM_ACCEL_HZ ) / FLIGHTSIM_PHYSICS_HZ )
+		{
+			pstCxt->uiAccelTaken++;
+
+			if ( FLIGHTSIM_ACCEL_PER_LOOP_MAX > pstCxt->uiAccelCount )
+			{
+				QUADSIM_SampleAccel( &pstCxt->stSim, pstCxt->aaiAccel[ pstCxt->uiAccelCount++ ] );
+			}
+		}
+
+		if ( pstCxt->uiGyroTaken >= ( pstCxt->uiStep * FLIGHTSIM_GYRO_HZ ) / FLIGHTSIM_PHYSICS_HZ )
+		{
+			continue;
+		}
+
+		pstCxt->uiGyroTaken++;
+		QUADSIM_SampleGyro( &pstCxt->stSim, GYRO_SAMPLE_PERIOD_S, pstCxt->stRecord.aaiSample[ pstCxt->uiGyroCount++ ] );
+
+		// Watermark reached, this is where the flight task wakes
+		if ( pstCxt->stConfig.uiGyroPerLoop <= pstCxt->uiGyroCount )
+		{
+			uiDt_us = ( ( pstCxt->uiStep - pstCxt->uiLoopStep ) * 1000000 ) / FLIGHTSIM_PHYSICS_HZ;
+			pstCxt->uiLoopStep = pstCxt->uiStep;
+
+			pstTick->uiDt_us = ( UINT16_MAX < uiDt_us ) ? UINT16_MAX : (uint16_t)uiDt_us;
+			pstTick->uiGyroCount = (uint8_t)pstCxt->uiGyroCount;
+			pstTick->uiAccelCount = (uint8_t)pstCxt->uiAccelCount;
+			pstTick->iTemp = 0;
+			memcpy( pstCxt->stRecord.aaiSample[ pstCxt->uiGyroCount ], pstCxt->aaiAccel,
+					pstCxt->uiAccelCount * sizeof( pstCxt->aaiAccel[0] ) );
+
+			QUADSIM_SampleMag( &pstCxt->stSim, pstTick->aiMag );
+			GetSticks( pstCxt->stSim.fTime_s, pstCxt->fHover, &pstCxt->stReceiver );
+			SticksToPulses( &pstCxt->stReceiver, pstTick->auiPulse );
+
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* ************************************************************************** */
+void FLIGHTSIM_Control( stFLIGHTSIM_Cxt_t *pstCxt )
+{
+	FLIGHTCHAIN_Run( &pstCxt->stChain, &pstCxt->stRecord.stTick, &pstCxt->stDemands, &pstCxt->stEstimate );
+
+	QUADSIM_SetMotorDemands( &pstCxt->stSim, &pstCxt->stDemands );
+	pstCxt->uiLoops++;
+
+	return;
+}
+
+/* ************************************************************************** */
+void FLIGHTSIM_Score( stFLIGHTSIM_Cxt_t *pstCxt )
+{
+	const stReceiverInput_t *pstReceiver = &pstCxt->stReceiver;
+	vector3f_t *pstTruth = &pstCxt->stTruth;
+
+	QUADSIM_GetAttitude( &pstCxt->stSim, pstTruth );
+
+	if ( FLIGHTSIM_SETTLE_S <= pstCxt->stSim.fTime_s )
+	{
+		AddError( &pstCxt->stTrackRoll, ( pstReceiver->fRoll * pstReceiver->fVarA ) - pstTruth->x );
+		AddError( &pstCxt->stTrackPitch, ( pstReceiver->fPitch * pstReceiver->fVarA ) - pstTruth->y );
+		AddError( &pstCxt->stEstRoll, pstCxt->stEstimate.x - pstTruth->x );
+		AddError( &pstCxt->stEstPitch, pstCxt->stEstimate.y - pstTruth->y );
+	}
+
+	pstCxt->bLost = ( LOST_ANGLE_RAD < fabsf( pstTruth->x ) ) || ( LOST_ANGLE_RAD < fabsf( pstTruth->y ) )
+					|| isnan( pstTruth->x ) || isnan( pstTruth->y );
+
+	return;
+}
+
+/* ************************************************************************** */
+float FLIGHTSIM_Rms( const stFLIGHTSIM_Error_t *pstError )
+{
+	return ( 0 == pstError->uiCount ) ? 0 : (float)sqrt( pstError->dSumSq / pstError->uiCount );
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static void GetSticks( const float fTime_s, const float fHover, stReceiverInput_t *pstReceiver )
+{
+	float fPhase = fmodf( fTime_s, STICK_PERIOD_S );
+	uint32_t uiStep = 0;
+
+	while ( ( ( uiStep + 1 ) < ( sizeof( astSticks ) / sizeof( astSticks[0] ) ) )
+			&& ( astSticks[ uiStep + 1 ].fStart_s <= fPhase ) )
+	{
+		uiStep++;
+	}
+
+	pstReceiver->fRoll = astSticks[ uiStep ].fRoll;
+	pstReceiver->fPitch = astSticks[ uiStep ].fPitch;
+	pstReceiver->fThrottle = fHover;
+	pstReceiver->fYaw = 0;
+	pstReceiver->fVarA = STICK_VARA;
+	pstReceiver->fVarB = 0;
+
+	return;
+}
+
+/* ************************************************************************** */
+static void SticksToPulses( const stReceiverInput_t *pstReceiver, uint16_t auiPulse[ SENSORLOG_NUM_PULSES ] )
+{
+	auiPulse[0] = ToPulse( pstReceiver->fRoll, true );
+	auiPulse[1] = ToPulse( pstReceiver->fPitch, true );
+	auiPulse[2] = ToPulse( pstReceiver->fThrottle, false );
+	auiPulse[3] = ToPulse( pstReceiver->fYaw, true );
+	auiPulse[4] = ToPulse( pstReceiver->fVarA, false );
+	auiPulse[5] = ToPulse( pstReceiver->fVarB, false );
+
+	return;
+}
+
+/* ************************************************************************** */
+static uint16_t ToPulse( const float fStick, const bool bCentred )
+{
+	// Above RECEIVER_FLOOR, as IODRIVER_GetInputPulseWidth gives them
+	float fPulse = bCentred ? ( ( RECEIVER_RANGE / 2 ) * ( 1.0f + fStick ) ) : ( RECEIVER_RANGE * fStick );
+
+	return (uint16_t)roundf( fminf( fmaxf( fPulse, 0 ), RECEIVER_RANGE ) );
+}
+
+/* ************************************************************************** */
+static void AddError( stFLIGHTSIM_Error_t *pstError, const float fError )
+{
+	pstError->dSumSq += (double)fError * fError;
+	pstError->fMax = fmaxf( pstError->fMax, fabsf( fError ) );
+	pstError->uiCount++;
+
+	return;
+}
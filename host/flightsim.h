@@ -0,0 +1,133 @@
+#ifndef FLIGHTSIM_H
+#define FLIGHTSIM_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include "vector3f.h"		// vector3f_t
+#include "flight.h"			// Flight controller
+#include "flightchain.h"	// The flight task's processing
+#include "sensorlog.h"		// Raw tick inputs
+#include "quadsim.h"		// Quadrotor model
+
+/*
+ * One closed loop flight: the flight controller, the flight task's decimators
+ * and the quadrotor model, with the sticks following a fixed set of roll and
+ * pitch steps. The model is stepped at FLIGHTSIM_PHYSICS_HZ and its IMU
+ * sampled at the rates the flight task configures, every uiGyroPerLoop gyro
+ * samples (the FIFO watermark) the raw inputs are gathered into a sensor log
+ * record and the controller runs on it as the flight task would.
+ *
+ * Everything lives in the context so flights can run side by side, sitl.c
+ * flies one and sweep.c flies thousands across threads.
+ */
+
+#define FLIGHTSIM_PHYSICS_HZ			( 8000 )
+#define FLIGHTSIM_GYRO_HZ				( 380 )
+#define FLIGHTSIM_ACCEL_HZ				( 800 )
+#define FLIGHTSIM_GYRO_PER_LOOP_MAX		( 16 )
+#define FLIGHTSIM_ACCEL_PER_LOOP_MAX	( 32 )	// The FIFO depth
+#define FLIGHTSIM_SETTLE_S				( 1.0f )	// Not counted in the errors
+
+typedef struct
+{
+	float fDuration_s;
+	uint32_t uiSeed;			// Sensor noise, runs with the same seed repeat exactly
+	uint32_t uiGyroPerLoop;		// FIFO watermark, sets the loop rate
+	bool bFixed;				// Fly flight_process_q rather than flight_process
+	eSENSORFUSION_Strategy_t eFusion;	// flight_process's sensor fusion
+
+	// Applied with FLIGHT_SetPidGains and FLIGHT_SetKalmanNoise
+	float fRateP;
+	float fRateD;
+	float fAngleP;
+	float fQAngle;
+	float fQBias;
+	float fRMeasure;
+
+} stFLIGHTSIM_Config_t;
+
+typedef struct
+{
+	double dSumSq;
+	float fMax;
+	uint32_t uiCount;
+
+} stFLIGHTSIM_Error_t;
+
+typedef struct
+{
+	stFLIGHTSIM_Config_t stConfig;
+	stQUADSIM_Cxt_t stSim;
+	stFLIGHTCHAIN_Cxt_t stChain;	// stChain.stScale is the log header
+	float fHover;
+
+	// The accel FIFO since the last loop, the gyro goes straight into stRecord
+	int16_t aaiAccel[ FLIGHTSIM_ACCEL_PER_LOOP_MAX ][3];
+	uint32_t uiGyroCount;
+	uint32_t uiAccelCount;
+	uint32_t uiGyroTaken;
+	uint32_t uiAccelTaken;
+	uint64_t uiStep;
+	uint64_t uiSteps;
+	uint64_t uiLoopStep;
+
+	// The latest loop
+	stSENSORLOG_Record_t stRecord;	// What the controller is given
+	stReceiverInput_t stReceiver;	// The sticks before they became pulses
+	stMotorDemands_t stDemands;
+	vector3f_t stEstimate;
+	vector3f_t stTruth;
+	uint32_t uiLoops;
+	bool bLost;
+
+	stFLIGHTSIM_Error_t stTrackRoll;
+	stFLIGHTSIM_Error_t stTrackPitch;
+	stFLIGHTSIM_Error_t stEstRoll;
+	stFLIGHTSIM_Error_t stEstPitch;
+
+} stFLIGHTSIM_Cxt_t;
+
+/**
+ * @brief		Fills in a 32s flight at the flight task's loop rate with the
+ * 				gains and filter noise flight_setup starts with.
+ * @param[out]	pstConfig	Configuration to fill in.
+ */
+void FLIGHTSIM_DefaultConfig( stFLIGHTSIM_Config_t *pstConfig );
+
+/**
+ * @brief		Starts a flight, the model hovering and the controller fresh.
+ * @param[out]	pstCxt		Flight context.
+ * @param[in]	pstConfig	What to fly, copied.
+ */
+void FLIGHTSIM_Setup( stFLIGHTSIM_Cxt_t *pstCxt, const stFLIGHTSIM_Config_t *pstConfig );
+
+/**
+ * @brief		Steps the model until the gyro FIFO reaches the watermark and
+ * 				reads the sticks and magnetometer, as the flight task wakes,
+ * 				leaving them in stRecord.
+ * @param[in]	pstCxt		Flight context.
+ * @return		False once the flight is over or control was lost.
+ */
+bool FLIGHTSIM_Advance( stFLIGHTSIM_Cxt_t *pstCxt );
+
+/**
+ * @brief		Runs the decimators and flight controller over stRecord and
+ * 				gives the model the motor demands, the part that is timed.
+ * @param[in]	pstCxt		Flight context.
+ */
+void FLIGHTSIM_Control( stFLIGHTSIM_Cxt_t *pstCxt );
+
+/**
+ * @brief		Scores the loop against the true attitude and checks whether
+ * 				control has been lost.
+ * @param[in]	pstCxt		Flight context.
+ */
+void FLIGHTSIM_Score( stFLIGHTSIM_Cxt_t *pstCxt );
+
+/**
+ * @brief		Root mean square of an error.
+ * @param[in]	pstError	Accumulated error.
+ */
+float FLIGHTSIM_Rms( const stFLIGHTSIM_Error_t *pstError );
+
+#endif
@@ -0,0 +1,111 @@
+/* ************************************************************************** **
+ * Just enough of the FreeRTOS queue and critical section API to link the IPC
+ * modules into host tools. Queues copy their items into a ring that wraps
+ * over the oldest item, so a send costs what the real item copy costs without
+ * a benchmark ever having to drain them. This is not the FreeRTOS semantics
+ * and must not be used where queue contents matter.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <stdlib.h>			// malloc
+#include <string.h>			// memcpy & friends
+
+#include "FreeRTOS.h"		// FreeRTOS
+#include "queue.h"			// FreeRTOS queues
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+typedef struct
+{
+	uint8_t *pbyStorage;
+	UBaseType_t uxLength;
+	UBaseType_t uxItemSize;
+	UBaseType_t uxHead;
+	UBaseType_t uxWaiting;
+
+} stStubQueue_t;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+QueueHandle_t xQueueGenericCreate( const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, const uint8_t ucQueueType )
+{
+	stStubQueue_t *pstQueue = malloc( sizeof( stStubQueue_t ) );
+
+	pstQueue->pbyStorage = malloc( uxQueueLength * uxItemSize );
+	pstQueue->uxLength = uxQueueLength;
+	pstQueue->uxItemSize = uxItemSize;
+	pstQueue->uxHead = 0;
+	pstQueue->uxWaiting = 0;
+
+	return (QueueHandle_t)pstQueue;
+}
+
+/* ************************************************************************** */
+BaseType_t xQueueGenericSend( QueueHandle_t xQueue, const void * const pvItemToQueue, TickType_t xTicksToWait, const BaseType_t xCopyPosition )
+{
+	stStubQueue_t *pstQueue = (stStubQueue_t*)xQueue;
+
+	memcpy( &pstQueue->pbyStorage[ pstQueue->uxHead * pstQueue->uxItemSize ], pvItemToQueue, pstQueue->uxItemSize );
+
+	if ( ++pstQueue->uxHead == pstQueue->uxLength )
+	{
+		pstQueue->uxHead = 0;
+	}
+
+	if ( pstQueue->uxWaiting < pstQueue->uxLength )
+	{
+		pstQueue->uxWaiting++;
+	}
+
+	return pdTRUE;
+}
+
+/* ************************************************************************** */
+BaseType_t xQueueGenericReceive( QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait, const BaseType_t xJustPeek )
+{
+	stStubQueue_t *pstQueue = (stStubQueue_t*)xQueue;
+	UBaseType_t uxTail;
+
+	if ( 0 == pstQueue->uxWaiting )
+	{
+		return pdFALSE;
+	}
+
+	uxTail = ( pstQueue->uxHead + pstQueue->uxLength - pstQueue->uxWaiting ) % pstQueue->uxLength;
+	memcpy( pvBuffer, &pstQueue->pbyStorage[ uxTail * pstQueue->uxItemSize ], pstQueue->uxItemSize );
+
+	if ( pdFALSE == xJustPeek )
+	{
+		pstQueue->uxWaiting--;
+	}
+
+	return pdTRUE;
+}
+
+/* ************************************************************************** */
+UBaseType_t uxQueueMessagesWaiting( const QueueHandle_t xQueue )
+{
+	return ( (stStubQueue_t*)xQueue )->uxWaiting;
+}
+
+/* ************************************************************************** */
+void vPortEnterCritical( void )
+{
+	// Host tools are single threaded
+	return;
+}
+
+/* ************************************************************************** */
+void vPortExitCritical( void )
+{
+	return;
+}
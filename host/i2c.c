@@ -0,0 +1,300 @@
+/*
+ * Host stand-in for i2c.c, see "make host".
+ *
+ * Transfers run to completion inside the call against the simulated LSM9DS0
+ * rather than from an interrupt. Completion callbacks and done_fn are still
+ * made, from the calling task once the transfer is over, so the flight task's
+ * FromISR path is exercised as on the target.
+ */
+
+#include "i2c.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "lsm9ds0_sim.h"
+
+volatile I2C_Channel i2c_channels[I2C_NUMBER_OF_DEVICES];
+
+static volatile I2C_Stats i2c_stats[I2C_NUMBER_OF_DEVICES];
+
+static bool i2c_run_sequence( const uint16_t *sequence, uint32_t sequence_length, uint8_t *received_data );
+static int32_t i2c_begin( uint32_t channel_number );
+static int i2c_transfer( const uint32_t channel_number, uint16_t *sequence, uint32_t sequence_length, uint8_t *received_data );
+
+uint32_t i2c_init( uint8_t i2c_number, uint8_t mult, uint8_t icr )
+{
+	(void)mult;
+	(void)icr;
+
+	taskENTER_CRITICAL();
+	LSM9DS0SIM_Reset();
+	taskEXIT_CRITICAL();
+
+	i2c_channels[i2c_number].status = I2C_AVAILABLE;
+
+	return i2c_number;
+}
+
+int32_t i2c_send_sequence( uint32_t channel_number,
+						   uint16_t *sequence,
+						   uint32_t sequence_length,
+						   uint8_t *received_data,
+						   void (*callback_fn)(void*),
+						   void *user_data )
+{
+	volatile I2C_Channel *channel = &(i2c_channels[channel_number]);
+	bool ok;
+
+	if ( 0 != i2c_begin( channel_number ) )
+	{
+		return -1;
+	}
+
+	channel->callback_fn = callback_fn;
+	channel->user_data = user_data;
+
+	taskENTER_CRITICAL();
+	ok = i2c_run_sequence( sequence, sequence_length, received_data );
+	taskEXIT_CRITICAL();
+
+	if ( ok )
+	{
+		i2c_stats[channel_number].transfers++;
+		channel->status = I2C_AVAILABLE;
+	}
+	else
+	{
+		i2c_stats[channel_number].errors++;
+		channel->status = I2C_ERROR;
+	}
+
+	if ( NULL != callback_fn )
+	{
+		callback_fn( user_data );
+	}
+
+	return 0;
+}
+
+int32_t i2c_send_jobs( uint32_t channel_number,
+					   I2C_Job *jobs,
+					   uint32_t job_count,
+					   void (*callback_fn)(void*),
+					   void *user_data )
+{
+	volatile I2C_Channel *channel = &(i2c_channels[channel_number]);
+	I2C_Job *job = jobs;
+	I2C_Job *job_end = jobs + job_count;
+	bool ok = true;
+
+	/* Skip any jobs that have been emptied out */
+	while ( ( job < job_end ) && ( 0 == job->sequence_length ) )
+	{
+		job++;
+	}
+
+	if ( job == job_end )
+	{
+		return -1;
+	}
+
+	if ( 0 != i2c_begin( channel_number ) )
+	{
+		return -1;
+	}
+
+	channel->callback_fn = callback_fn;
+	channel->user_data = user_data;
+
+	/* done_fn may shorten or skip a later job, so lengths are read as we go */
+	for ( ; ok && ( job < job_end ); job++ )
+	{
+		if ( 0 == job->sequence_length )
+		{
+			continue;
+		}
+
+		taskENTER_CRITICAL();
+		ok = i2c_run_sequence( job->sequence, job->sequence_length, job->received_data );
+		taskEXIT_CRITICAL();
+
+		if ( ok && ( NULL != job->done_fn ) )
+		{
+			job->done_fn( job );
+		}
+	}
+
+	if ( ok )
+	{
+		i2c_stats[channel_number].transfers++;
+		channel->status = I2C_AVAILABLE;
+	}
+	else
+	{
+		i2c_stats[channel_number].errors++;
+		channel->status = I2C_ERROR;
+	}
+
+	if ( NULL != callback_fn )
+	{
+		callback_fn( user_data );
+	}
+
+	return 0;
+}
+
+void i2c_abort( const uint32_t channel_number )
+{
+	/* Nothing is ever left in flight here */
+	i2c_channels[channel_number].status = I2C_ERROR;
+}
+
+void i2c_get_stats( const uint32_t channel_number, I2C_Stats *const stats )
+{
+	*stats = i2c_stats[channel_number];
+}
+
+int i2c_read_byte( const uint32_t channel_number,
+				   const uint8_t device,
+				   const uint8_t addr,
+				   uint8_t *const data )
+{
+	uint16_t init_sequence[] = { ( device << 1 ) | I2C_WRITING, addr, I2C_RESTART, ( device << 1 ) | I2C_READING, I2C_READ };
+
+	return i2c_transfer( channel_number, init_sequence, 5, data );
+}
+
+int i2c_read_bytes( const uint32_t channel_number,
+					const uint8_t device,
+					const uint8_t addr,
+					uint8_t *const data,
+					size_t count )
+{
+	size_t index;
+	uint16_t sequence[4 + I2C_READ_BYTES_MAX] = { ( device << 1 ) | I2C_WRITING, addr, I2C_RESTART, ( device << 1 ) | I2C_READING };
+	size_t offset = 4;
+
+	if ( ( 0 == count ) || ( I2C_READ_BYTES_MAX < count ) )
+	{
+		return -1;
+	}
+
+	for ( index = 0; index < count; index++ )
+	{
+		sequence[offset] = I2C_READ;
+		offset++;
+	}
+
+	return i2c_transfer( channel_number, sequence, offset, data );
+}
+
+int i2c_write_byte( const uint32_t channel_number,
+					const uint8_t device,
+					const uint8_t addr,
+					const uint8_t data )
+{
+	uint16_t sequence[] = { ( device << 1 ) | I2C_WRITING, addr, data };
+
+	return i2c_transfer( channel_number, sequence, 3, NULL );
+}
+
+/*
+  Claims a channel for a transfer, failing as the target does if another is still running.
+*/
+static int32_t i2c_begin( uint32_t channel_number )
+{
+	volatile I2C_Channel *channel = &(i2c_channels[channel_number]);
+	int32_t result = 0;
+
+	taskENTER_CRITICAL();
+
+	if ( channel->status == I2C_BUSY )
+	{
+		i2c_stats[channel_number].errors++;
+		result = -1;
+	}
+	else
+	{
+		channel->status = I2C_BUSY;
+	}
+
+	taskEXIT_CRITICAL();
+
+	return result;
+}
+
+/*
+  Plays a sequence against the simulated devices. The byte after each address write is the register, with the MSB
+  asking for auto-increment as on the LSM9DS0, and any bytes after that are written to successive registers. Returns
+  false if no device answered the address.
+*/
+static bool i2c_run_sequence( const uint16_t *sequence, uint32_t sequence_length, uint8_t *received_data )
+{
+	const uint16_t *end = sequence + sequence_length;
+	bool expect_address = true;
+	bool have_register = false;
+	bool increment = false;
+	uint8_t device = 0;
+	uint8_t reg = 0;
+
+	for ( ; sequence < end; sequence++ )
+	{
+		if ( I2C_RESTART == *sequence )
+		{
+			expect_address = true;
+		}
+		else if ( expect_address )
+		{
+			device = (uint8_t)( *sequence >> 1 );
+
+			if ( !LSM9DS0SIM_Ack( device ) )
+			{
+				return false;
+			}
+
+			expect_address = false;
+			have_register = ( I2C_READING == ( *sequence & 1 ) );
+		}
+		else if ( I2C_READ == *sequence )
+		{
+			*received_data++ = LSM9DS0SIM_Read( device, reg );
+
+			if ( increment )
+			{
+				reg = LSM9DS0SIM_NextReg( reg );
+			}
+		}
+		else if ( !have_register )
+		{
+			reg = (uint8_t)( *sequence & 0x7F );
+			increment = ( 0 != ( *sequence & 0x80 ) );
+			have_register = true;
+		}
+		else
+		{
+			LSM9DS0SIM_Write( device, reg, (uint8_t)*sequence );
+
+			if ( increment )
+			{
+				reg = LSM9DS0SIM_NextReg( reg );
+			}
+		}
+	}
+
+	return true;
+}
+
+static int i2c_transfer( const uint32_t channel_number, uint16_t *sequence, uint32_t sequence_length, uint8_t *received_data )
+{
+	if ( 0 != i2c_send_sequence( channel_number, sequence, sequence_length, received_data, NULL, NULL ) )
+	{
+		return -1;
+	}
+
+	return ( I2C_AVAILABLE == i2c_channels[channel_number].status ) ? 0 : -1;
+}
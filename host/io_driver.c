@@ -0,0 +1,199 @@
+/**
+ * io_driver
+ * @brief	Host stand-in for io_driver.c, see "make host".
+ *
+ * There are no timers to capture receiver pulses or drive the ESCs, the input
+ * widths sit at a sticks centred, throttle closed position and output widths
+ * are just stored. This module also plays the part of the hardware around the
+ * firmware, a highest priority task moves the simulated LSM9DS0 on every tick
+ * and raises the DRDY_G "interrupt" when its line goes high.
+ */
+#include <io_driver.h>	// Module header file
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "FreeRTOS.h"	// FreeRTOS
+#include "task.h"		// xTaskCreate & friends
+
+#include "lsm9ds0_sim.h"	// Simulated IMU
+
+#define HARDWARE_TASK_PRIORITY	( configMAX_PRIORITIES - 1 )
+#define HARDWARE_TASK_STACK		( configMINIMAL_STACK_SIZE * 2 )
+
+static uint32_t auiInputPulse[ RECEIVER_NUM_CHAN_IN ] =
+{
+	RECEIVER_CENTER, RECEIVER_CENTER, RECEIVER_FLOOR, RECEIVER_CENTER, RECEIVER_FLOOR, RECEIVER_FLOOR,
+};
+
+static uint32_t auiOutputPulse[ RECEIVER_NUM_CHAN_OUT ] =
+{
+	RECEIVER_FTM_1MS, RECEIVER_FTM_1MS, RECEIVER_FTM_1MS, RECEIVER_FTM_1MS,
+};
+
+static pfnIODRIVER_PinIrq pfnGyroDrdyIrq = NULL;
+static void *pvGyroDrdyUserState = NULL;
+static bool bLed = false;
+
+static void HardwareTask( void *pvParameters );
+
+/**
+ * @brief		Starts the task that stands in for the hardware.
+ */
+void IODRIVER_Setup( void )
+{
+	xTaskCreate( HardwareTask,
+				 "Hardware",
+				 HARDWARE_TASK_STACK,
+				 NULL,
+				 HARDWARE_TASK_PRIORITY,
+				 NULL );
+}
+
+/**
+ * @brief		Gets the latest pulse duration for a given channel, relative to
+ * 				RECEIVER_FLOOR as on the target.
+ *
+ * @param[in]	channel		The ID of the channel to read, must be in the range
+ * 							0..RECEIVER_NUM_CHAN_IN.
+ */
+uint32_t IODRIVER_GetInputPulseWidth( int channel )
+{
+	if ( channel < RECEIVER_NUM_CHAN_IN )
+	{
+		return auiInputPulse[channel] - RECEIVER_FLOOR;
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+/**
+ * @brief		Gets the latest pulse duration for a given channel.
+ *
+ * @param[in]	channel		The ID of the channel to read, must be in the range
+ * 							0..RECEIVER_NUM_CHAN_OUT.
+ * @param[out]	pulseDurationTicks The value in ticks.
+ *
+ * @returns		Error code, success if != 0.
+ */
+int IODRIVER_GetOutputPulseWidth( int channel, uint32_t *pulseDurationTicks )
+{
+	if ( channel < RECEIVER_NUM_CHAN_OUT )
+	{
+		*pulseDurationTicks = auiOutputPulse[channel];
+
+		return 1;
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+/**
+ * @brief		Sets the pulse duration of one of the output channels.
+ *
+ * @param[in]	channel		The ID of the channel to set, must be in the range
+ * 							0..RECEIVER_NUM_CHAN_OUT.
+ * @param[in]	pulseDurationTicks The value in ticks.
+ *
+ * @returns		Error code, success if != 0.
+ */
+int IODRIVER_SetOutputPulseWidth( int channel, uint32_t pulseDurationTicks )
+{
+	if ( channel < RECEIVER_NUM_CHAN_OUT )
+	{
+		auiOutputPulse[channel] = ( pulseDurationTicks + RECEIVER_FTM_1MS );
+
+		return 1;
+	}
+	else
+	{
+		return 0;
+	}
+}
+
+/**
+ * @brief		Routes the simulated DRDY_G line to a callback, made from the
+ * 				hardware task on every rising edge.
+ *
+ * @param[in]	pfnIrq		Called on every rising edge of DRDY_G.
+ * @param[in]	pvUserState	The state to pass back to the callback.
+ */
+void IODRIVER_SetupGyroDataReady( pfnIODRIVER_PinIrq pfnIrq, void *const pvUserState )
+{
+	taskENTER_CRITICAL();
+
+	pfnGyroDrdyIrq = pfnIrq;
+	pvGyroDrdyUserState = pvUserState;
+
+	taskEXIT_CRITICAL();
+
+	return;
+}
+
+/**
+ * @brief		The level of the simulated DRDY_G line.
+ * @return		True if high.
+ */
+bool IODRIVER_GyroDataReady( void )
+{
+	bool bLevel;
+
+	taskENTER_CRITICAL();
+	bLevel = LSM9DS0SIM_GyroDataReady();
+	taskEXIT_CRITICAL();
+
+	return bLevel;
+}
+
+/**
+ * @brief		Turns the "on board LED" on or off, changes are printed.
+ * @param[in]	bState		True for on.
+ */
+void IODRIVER_SetLed( const bool bState )
+{
+	if ( bState != bLed )
+	{
+		bLed = bState;
+		fprintf( stderr, "led: %s\n", bState ? "on" : "off" );
+	}
+
+	return;
+}
+
+/**
+ * @brief		Moves the simulated sensors on once a tick and makes the pin
+ * 				interrupt callback on each rising edge of DRDY_G.
+ */
+static void HardwareTask( void *pvParameters )
+{
+	TickType_t xLastWake = xTaskGetTickCount();
+	bool bDrdy = false;
+	bool bRisingEdge;
+
+	(void)pvParameters;
+
+	for ( ;; )
+	{
+		vTaskDelayUntil( &xLastWake, 1 );
+
+		taskENTER_CRITICAL();
+
+		LSM9DS0SIM_Advance( (uint32_t)( ( (uint64_t)xLastWake * 1000 ) / configTICK_RATE_HZ ) );
+
+		bRisingEdge = ( false == bDrdy ) && LSM9DS0SIM_GyroDataReady();
+		bDrdy = LSM9DS0SIM_GyroDataReady();
+
+		taskEXIT_CRITICAL();
+
+		// The callback talks to the I2C stand-in, which takes the critical
+		// section itself
+		if ( bRisingEdge && ( NULL != pfnGyroDrdyIrq ) )
+		{
+			pfnGyroDrdyIrq( pvGyroDrdyUserState );
+		}
+	}
+}
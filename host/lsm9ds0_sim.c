@@ -0,0 +1,289 @@
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include "lsm9ds0_sim.h"
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <string.h>			// memset & friends
+
+#include "SFE_LSM9DS0.h"	// Register addresses
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define SIM_ADDR_G				( 0x6B )
+#define SIM_ADDR_XM				( 0x1D )
+#define SIM_NUM_REGS			( 128 )
+
+// Output data rates from the control registers, the gyro's DR bits give
+// 95Hz doubling and the accel's AODR 25Hz doubling from 4, below that is
+// treated as off
+#define SIM_GYRO_ODR_HZ( r )	( 95UL << ( ( r ) >> 6 ) )
+#define SIM_ACCEL_ODR_HZ( r )	( ( 4 > ( ( r ) >> 4 ) ) ? 0 : ( 25UL << ( ( ( r ) >> 4 ) - 4 ) ) )
+
+// Sitting level at 8g full scale, 1g is 4096 LSB
+#define SIM_ACCEL_1G_LSB		( 4096 )
+#define SIM_GYRO_NOISE_LSB		( 3 )
+#define SIM_ACCEL_NOISE_LSB		( 8 )
+#define SIM_TEMP_RAW			( 20 )
+
+// FIFO_SRC bits, the level field can't show a full FIFO so it stops at 31
+#define FIFO_SRC_WTM			( 0x80 )
+#define FIFO_SRC_OVRN			( 0x40 )
+#define FIFO_SRC_EMPTY			( 0x20 )
+#define FIFO_SRC_FSS_MAX		( 0x1F )
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+typedef struct
+{
+	int16_t aaiSample[ LSM9DS0_FIFO_DEPTH ][3];
+	uint8_t uiHead;
+	uint8_t uiCount;
+	bool bOverrun;
+	uint32_t uiTaken;			// Samples taken since reset
+	uint32_t uiPhase;			// Towards the next sample, in Hz ms
+
+} stSimFifo_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static uint32_t FifoDue( stSimFifo_t *pstFifo, const uint32_t uiElapsedMs, const uint32_t uiOdrHz );
+static void FifoPush( stSimFifo_t *pstFifo, const int16_t iX, const int16_t iY, const int16_t iZ );
+static uint8_t FifoReadByte( stSimFifo_t *pstFifo, const uint8_t uiReg );
+static uint8_t FifoSource( const stSimFifo_t *pstFifo, const uint8_t uiWatermark );
+static int16_t Noise( const int16_t iAmplitude );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static uint8_t auiRegG[ SIM_NUM_REGS ];
+static uint8_t auiRegXM[ SIM_NUM_REGS ];
+static stSimFifo_t stGyroFifo;
+static stSimFifo_t stAccelFifo;
+static uint32_t uiNoiseState;
+static uint32_t uiLastMs;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+void LSM9DS0SIM_Reset( void )
+{
+	memset( auiRegG, 0, sizeof( auiRegG ) );
+	memset( auiRegXM, 0, sizeof( auiRegXM ) );
+	memset( &stGyroFifo, 0, sizeof( stGyroFifo ) );
+	memset( &stAccelFifo, 0, sizeof( stAccelFifo ) );
+	uiNoiseState = 1;
+	uiLastMs = 0;
+
+	return;
+}
+
+/* ************************************************************************** */
+bool LSM9DS0SIM_Ack( const uint8_t uiAddress )
+{
+	return ( SIM_ADDR_G == uiAddress ) || ( SIM_ADDR_XM == uiAddress );
+}
+
+/* ************************************************************************** */
+uint8_t LSM9DS0SIM_Read( const uint8_t uiAddress, const uint8_t uiReg )
+{
+	uint8_t uiIndex = uiReg % SIM_NUM_REGS;
+
+	if ( SIM_ADDR_G == uiAddress )
+	{
+		switch ( uiIndex )
+		{
+			case WHO_AM_I_G:		return 0xD4;
+			case FIFO_SRC_REG_G:	return FifoSource( &stGyroFifo, auiRegG[ FIFO_CTRL_REG_G ] & FIFO_SRC_FSS_MAX );
+			default:				break;
+		}
+
+		if ( ( OUT_X_L_G <= uiIndex ) && ( ( OUT_X_L_G + 6 ) > uiIndex ) )
+		{
+			return FifoReadByte( &stGyroFifo, uiIndex - OUT_X_L_G );
+		}
+
+		return auiRegG[ uiIndex ];
+	}
+
+	switch ( uiIndex )
+	{
+		case WHO_AM_I_XM:		return 0x49;
+		case FIFO_SRC_REG:		return FifoSource( &stAccelFifo, auiRegXM[ FIFO_CTRL_REG ] & FIFO_SRC_FSS_MAX );
+		case OUT_TEMP_L_XM:		return (uint8_t)( SIM_TEMP_RAW & 0xFF );
+		case OUT_TEMP_H_XM:		return (uint8_t)( ( SIM_TEMP_RAW >> 8 ) & 0x0F );
+		default:				break;
+	}
+
+	if ( ( OUT_X_L_A <= uiIndex ) && ( ( OUT_X_L_A + 6 ) > uiIndex ) )
+	{
+		return FifoReadByte( &stAccelFifo, uiIndex - OUT_X_L_A );
+	}
+
+	return auiRegXM[ uiIndex ];
+}
+
+/* ************************************************************************** */
+void LSM9DS0SIM_Write( const uint8_t uiAddress, const uint8_t uiReg, const uint8_t uiData )
+{
+	if ( SIM_ADDR_G == uiAddress )
+	{
+		auiRegG[ uiReg % SIM_NUM_REGS ] = uiData;
+	}
+	else
+	{
+		auiRegXM[ uiReg % SIM_NUM_REGS ] = uiData;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+uint8_t LSM9DS0SIM_NextReg( const uint8_t uiReg )
+{
+	// OUT_X_L_G and OUT_X_L_A share an address, as do the Z_H registers
+	if ( ( OUT_X_L_G + 5 ) == uiReg )
+	{
+		return OUT_X_L_G;
+	}
+
+	return uiReg + 1;
+}
+
+/* ************************************************************************** */
+void LSM9DS0SIM_Advance( const uint32_t uiNowMs )
+{
+	uint32_t uiElapsedMs = uiNowMs - uiLastMs;
+	uint32_t uiGyroDue;
+	uint32_t uiAccelDue;
+
+	// Paced from the rates set now, so a rate change doesn't bring a burst of
+	// the samples it would have taken since reset
+	uiGyroDue = FifoDue( &stGyroFifo, uiElapsedMs, SIM_GYRO_ODR_HZ( auiRegG[ CTRL_REG1_G ] ) );
+	uiAccelDue = FifoDue( &stAccelFifo, uiElapsedMs, SIM_ACCEL_ODR_HZ( auiRegXM[ CTRL_REG1_XM ] ) );
+	uiLastMs = uiNowMs;
+
+	while ( 0 < uiGyroDue-- )
+	{
+		FifoPush( &stGyroFifo,
+				  Noise( SIM_GYRO_NOISE_LSB ),
+				  Noise( SIM_GYRO_NOISE_LSB ),
+				  Noise( SIM_GYRO_NOISE_LSB ) );
+	}
+
+	while ( 0 < uiAccelDue-- )
+	{
+		FifoPush( &stAccelFifo,
+				  Noise( SIM_ACCEL_NOISE_LSB ),
+				  Noise( SIM_ACCEL_NOISE_LSB ),
+				  SIM_ACCEL_1G_LSB + Noise( SIM_ACCEL_NOISE_LSB ) );
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+bool LSM9DS0SIM_GyroDataReady( void )
+{
+	uint8_t uiWatermark = auiRegG[ FIFO_CTRL_REG_G ] & FIFO_SRC_FSS_MAX;
+
+	return ( 0 != uiWatermark ) && ( stGyroFifo.uiCount >= uiWatermark );
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static uint32_t FifoDue( stSimFifo_t *pstFifo, const uint32_t uiElapsedMs, const uint32_t uiOdrHz )
+{
+	uint32_t uiDue;
+
+	pstFifo->uiPhase += uiElapsedMs * uiOdrHz;
+	uiDue = pstFifo->uiPhase / 1000;
+	pstFifo->uiPhase -= uiDue * 1000;
+
+	return uiDue;
+}
+
+/* ************************************************************************** */
+static void FifoPush( stSimFifo_t *pstFifo, const int16_t iX, const int16_t iY, const int16_t iZ )
+{
+	uint8_t uiSlot;
+
+	// Stream mode, a full FIFO drops its oldest sample
+	if ( LSM9DS0_FIFO_DEPTH == pstFifo->uiCount )
+	{
+		pstFifo->uiHead = ( pstFifo->uiHead + 1 ) % LSM9DS0_FIFO_DEPTH;
+		pstFifo->uiCount--;
+		pstFifo->bOverrun = true;
+	}
+
+	uiSlot = ( pstFifo->uiHead + pstFifo->uiCount ) % LSM9DS0_FIFO_DEPTH;
+	pstFifo->aaiSample[ uiSlot ][0] = iX;
+	pstFifo->aaiSample[ uiSlot ][1] = iY;
+	pstFifo->aaiSample[ uiSlot ][2] = iZ;
+	pstFifo->uiCount++;
+	pstFifo->uiTaken++;
+
+	return;
+}
+
+/* ************************************************************************** */
+static uint8_t FifoReadByte( stSimFifo_t *pstFifo, const uint8_t uiByte )
+{
+	uint16_t uiValue = (uint16_t)pstFifo->aaiSample[ pstFifo->uiHead ][ uiByte / 2 ];
+
+	// Reading Z_H finishes the sample, an empty FIFO repeats its last one
+	if ( ( 5 == uiByte ) && ( 0 < pstFifo->uiCount ) )
+	{
+		if ( 1 < pstFifo->uiCount )
+		{
+			pstFifo->uiHead = ( pstFifo->uiHead + 1 ) % LSM9DS0_FIFO_DEPTH;
+		}
+
+		pstFifo->uiCount--;
+		pstFifo->bOverrun = false;
+	}
+
+	return ( 0 == ( uiByte & 1 ) ) ? (uint8_t)( uiValue & 0xFF ) : (uint8_t)( uiValue >> 8 );
+}
+
+/* ************************************************************************** */
+static uint8_t FifoSource( const stSimFifo_t *pstFifo, const uint8_t uiWatermark )
+{
+	uint8_t uiSource = ( pstFifo->uiCount > FIFO_SRC_FSS_MAX ) ? FIFO_SRC_FSS_MAX : pstFifo->uiCount;
+
+	if ( ( 0 != uiWatermark ) && ( pstFifo->uiCount >= uiWatermark ) )
+	{
+		uiSource |= FIFO_SRC_WTM;
+	}
+
+	if ( pstFifo->bOverrun )
+	{
+		uiSource |= FIFO_SRC_OVRN;
+	}
+
+	if ( 0 == pstFifo->uiCount )
+	{
+		uiSource |= FIFO_SRC_EMPTY;
+	}
+
+	return uiSource;
+}
+
+/* ************************************************************************** */
+static int16_t Noise( const int16_t iAmplitude )
+{
+	// Repeatable, roughly uniform in +-iAmplitude
+	uiNoiseState = ( uiNoiseState * 1103515245u ) + 12345u;
+
+	return (int16_t)( (int32_t)( ( uiNoiseState >> 16 ) % ( ( 2 * iAmplitude ) + 1 ) ) - iAmplitude );
+}
@@ -0,0 +1,66 @@
+#ifndef LSM9DS0SIM_H
+#define LSM9DS0SIM_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+
+/*
+ * Register level stand-in for the LSM9DS0 on the host build. The host i2c.c
+ * routes bus traffic here. The gyro and accel FIFOs fill at the rates
+ * task_flight.c configures (760Hz and 400Hz) as host time passes, and the
+ * gyro's DRDY_G line follows its FIFO watermark as the real pin does.
+ *
+ * The sensor is sitting still and level until something else supplies the
+ * samples. Nothing here is thread safe, callers must hold off the scheduler
+ * (taskENTER_CRITICAL) around every call.
+ */
+
+/**
+ * @brief		Resets the register file and empties the FIFOs.
+ */
+void LSM9DS0SIM_Reset( void );
+
+/**
+ * @brief		Whether a device answers at an I2C address.
+ * @param[in]	uiAddress	7 bit I2C address.
+ */
+bool LSM9DS0SIM_Ack( const uint8_t uiAddress );
+
+/**
+ * @brief		Reads a register, output data registers pop the FIFO once the
+ * 				last byte of a sample has been read.
+ * @param[in]	uiAddress	7 bit I2C address.
+ * @param[in]	uiReg		Register to read.
+ */
+uint8_t LSM9DS0SIM_Read( const uint8_t uiAddress, const uint8_t uiReg );
+
+/**
+ * @brief		Writes a register.
+ * @param[in]	uiAddress	7 bit I2C address.
+ * @param[in]	uiReg		Register to write.
+ * @param[in]	uiData		Value to write.
+ */
+void LSM9DS0SIM_Write( const uint8_t uiAddress, const uint8_t uiReg, const uint8_t uiData );
+
+/**
+ * @brief		The register an auto-incrementing access moves on to. The
+ * 				output registers wrap back to X_L so a burst drains the FIFO.
+ * @param[in]	uiReg		The register just accessed.
+ */
+uint8_t LSM9DS0SIM_NextReg( const uint8_t uiReg );
+
+/**
+ * @brief		Moves the sensors on to a new time, queueing every sample they
+ * 				would have taken since the last call.
+ * @param[in]	uiNowMs		Time since start up in milliseconds.
+ */
+void LSM9DS0SIM_Advance( const uint32_t uiNowMs );
+
+/**
+ * @brief		The level of the DRDY_G pin, high while the gyro FIFO is at or
+ * 				above its watermark.
+ */
+bool LSM9DS0SIM_GyroDataReady( void );
+
+#endif
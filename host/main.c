@@ -0,0 +1,109 @@
+/*
+ * Entry point for the host build, see "make host". This is main.c without the
+ * board bring up, the same tasks run against the FreeRTOS POSIX port with the
+ * drivers in this directory standing in for the hardware.
+ */
+#include <stdio.h>			/* printf)_ & friends */
+#include <stdlib.h>			/* abort */
+#include <stdbool.h>		// bool definition
+
+#include "common.h"			/* uC specific dfns */
+#include "FreeRTOS.h"		// FreeRTOS
+#include "FreeRTOSConfig.h"	// FreeRTOS portable config
+#include "task.h"			// vTaskStartScheduler
+
+#include "i2c.h"			/* i2c ldd */
+#include "uart.h"			/* uart ldd */
+#include "io_driver.h"
+#include "timebase.h"		/* Microsecond clock */
+#include "task_flight.h"	/* Initialises the flight task */
+#include "task_comms.h"		/* Comms task */
+#include "params.h"			/* System parameters */
+#include "paramstore.h"		/* Parameters kept in flash */
+#include "task_led.h"		/* Led task */
+
+int port_putchar( int c )
+{
+	uart_putchar( UART0_BASE_PTR, (char)c );
+	return 1;
+}
+
+int port_write( const void *buf, int len )
+{
+	return (int)uart_write( UART0_BASE_PTR, buf, (size_t)len );
+}
+
+int port_read( void *buf, int max )
+{
+	return (int)uart_read( UART0_BASE_PTR, buf, (size_t)max );
+}
+
+int port_getchar( void )
+{
+	return uart_getchar( UART0_BASE_PTR );
+}
+
+int port_getchar_nonblock( void )
+{
+	return uart_getchar_nonblock( UART0_BASE_PTR );
+}
+
+/**
+ * @brief		Called by configASSERT, abort so a debugger or valgrind shows
+ * 				the stack that got here.
+ * @param[in]	pcFile		File of the failed assertion.
+ * @param[in]	ulLine		Line of the failed assertion.
+ */
+void vAssertCalled( const char *const pcFile, unsigned long ulLine )
+{
+	fprintf( stderr, "assert: %s:%lu\n", pcFile, ulLine );
+	abort();
+}
+
+/**
+ * @brief		Called if a call to pvPortMalloc() fails.
+ */
+void vApplicationMallocFailedHook( void )
+{
+	fprintf( stderr, "malloc failed\n" );
+	abort();
+}
+
+/**
+** @brief		Entry point to program.
+** @return		Error code.
+*/
+int main( void )
+{
+	// The UART is a pty here, its path is printed so something can attach
+	uart_init( UART0_BASE_PTR, 115200 );
+
+	// The microsecond clock the flight loop times its samples with
+	TIMEBASE_Setup();
+
+	// Starts the task that moves the simulated IMU along and raises DRDY_G
+	IODRIVER_Setup();
+
+	// Resets the simulated IMU the I2C stand-in talks to
+	i2c_init( 0, 0x01, 0x20 );
+
+	// The parameters' name index, before anything can look one up
+	PARAM_Create();
+
+	// Then the values kept from last time, before the tasks read them
+	PARAMSTORE_Create();
+
+	// Create tasks
+	TASK_FLIGHT_Create();
+	TASK_COMMS_Create();
+	TASK_LED_Create();
+
+	// printf goes to stdout here rather than through the uart
+	printf( "Hello from TeensyQuad!\r\n" );
+
+	// Start the tasks and timer running, this only returns if the port could
+	// not start
+	vTaskStartScheduler();
+
+	return 1;
+}
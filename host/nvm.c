@@ -0,0 +1,136 @@
+/*
+ * Host stand-in for nvm.c, see "make host" and "make test-paramstore".
+ *
+ * The sectors live in a file, NVM_FILE from the environment or teensyquad.nvm
+ * in the working directory, created erased if it isn't there. NVM_Setup reads
+ * it afresh, so calling it again is a reset. Programming a word that isn't
+ * erased fails, as it must never be done to the real flash, and an erase
+ * reads as busy for NVM_ERASE_US like the real one, so the journal has to
+ * poll for it. Every change is written through to the file at once.
+ */
+
+#include "nvm.h"
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define NVM_ERASE_US		( 20000 )
+#define NVM_DEFAULT_FILE	"teensyquad.nvm"
+
+static uint32_t auiFlash[ NVM_NUM_SECTORS ][ NVM_SECTOR_SIZE / sizeof( uint32_t ) ];
+static FILE *pFile;
+static uint64_t uiEraseDone_us;
+static eNVM_Status_t eLastErase;
+
+static bool WriteThrough( const uint8_t uiSector, const uint16_t uiOffset, const size_t sBytes );
+static uint64_t Monotonic_us( void );
+
+bool NVM_Setup( void )
+{
+	const char *pcPath = getenv( "NVM_FILE" );
+
+	if ( NULL == pcPath )
+	{
+		pcPath = NVM_DEFAULT_FILE;
+	}
+
+	if ( NULL != pFile )
+	{
+		fclose( pFile );
+	}
+
+	memset( auiFlash, 0xFF, sizeof( auiFlash ) );
+	uiEraseDone_us = 0;
+	eLastErase = NVM_IDLE;
+
+	pFile = fopen( pcPath, "r+b" );
+
+	if ( NULL == pFile )
+	{
+		pFile = fopen( pcPath, "w+b" );
+	}
+
+	if ( NULL == pFile )
+	{
+		fprintf( stderr, "nvm: can't open %s\n", pcPath );
+		return false;
+	}
+
+	// A short file is erased past its end, and made full size
+	if ( sizeof( auiFlash ) != fread( auiFlash, 1, sizeof( auiFlash ), pFile ) )
+	{
+		clearerr( pFile );
+		return WriteThrough( 0, 0, sizeof( auiFlash ) );
+	}
+
+	return true;
+}
+
+const uint32_t *NVM_Sector( const uint8_t uiSector )
+{
+	return auiFlash[ uiSector ];
+}
+
+bool NVM_Program( const uint8_t uiSector, const uint16_t uiOffset, const uint32_t uiWord )
+{
+	uint32_t *puiWord;
+
+	if ( ( NULL == pFile ) || ( NVM_NUM_SECTORS <= uiSector ) || ( NVM_SECTOR_SIZE <= uiOffset )
+		 || ( 0 != ( uiOffset & 3 ) ) || ( NVM_BUSY == NVM_Status() ) )
+	{
+		return false;
+	}
+
+	puiWord = &auiFlash[ uiSector ][ uiOffset / sizeof( uint32_t ) ];
+
+	if ( NVM_ERASED_WORD != *puiWord )
+	{
+		return false;
+	}
+
+	*puiWord = uiWord;
+
+	return WriteThrough( uiSector, uiOffset, sizeof( uint32_t ) );
+}
+
+bool NVM_StartErase( const uint8_t uiSector )
+{
+	if ( ( NULL == pFile ) || ( NVM_NUM_SECTORS <= uiSector ) || ( NVM_BUSY == NVM_Status() ) )
+	{
+		return false;
+	}
+
+	memset( auiFlash[ uiSector ], 0xFF, NVM_SECTOR_SIZE );
+	eLastErase = WriteThrough( uiSector, 0, NVM_SECTOR_SIZE ) ? NVM_IDLE : NVM_ERROR;
+	uiEraseDone_us = Monotonic_us() + NVM_ERASE_US;
+
+	return true;
+}
+
+eNVM_Status_t NVM_Status( void )
+{
+	return ( Monotonic_us() < uiEraseDone_us ) ? NVM_BUSY : eLastErase;
+}
+
+static bool WriteThrough( const uint8_t uiSector, const uint16_t uiOffset, const size_t sBytes )
+{
+	const uint8_t *pbyFrom = (const uint8_t *)auiFlash[ uiSector ] + uiOffset;
+
+	return ( 0 == fseek( pFile, (long)( ( uiSector * NVM_SECTOR_SIZE ) + uiOffset ), SEEK_SET ) )
+		   && ( sBytes == fwrite( pbyFrom, 1, sBytes, pFile ) )
+		   && ( 0 == fflush( pFile ) );
+}
+
+static uint64_t Monotonic_us( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return ( (uint64_t)stNow.tv_sec * 1000000ULL ) + ( (uint64_t)stNow.tv_nsec / 1000 );
+}
@@ -0,0 +1,344 @@
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include "quadsim.h"
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <string.h>			// memset & friends
+#include <math.h>			// sqrtf & friends
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define GRAVITY					( 9.80665f )
+#define PI						( 3.14159265359f )
+#define RAD2DEG					( 180.0f / PI )
+#define START_ALTITUDE_M		( 10.0f )
+
+// Earth's field in the world frame, roughly mid latitude
+#define MAG_WORLD_X				( 0.20f )
+#define MAG_WORLD_Y				( 0.0f )
+#define MAG_WORLD_Z				( -0.40f )
+
+// Motor positions on the diagonals, FL FR RL RR as in flight.c
+static const float afMotorX[ NUM_MOTORS ] = { 1, 1, -1, -1 };
+static const float afMotorY[ NUM_MOTORS ] = { 1, -1, 1, -1 };
+
+// Reaction torque direction, FL and RR spin anticlockwise so push the body
+// clockwise
+static const float afMotorSpin[ NUM_MOTORS ] = { -1, 1, 1, -1 };
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static float Thrust( const stQUADSIM_Params_t *pstParams, const float fSpeed );
+static vector3f_t BodyToWorld( const float afQuat[4], const vector3f_t stBody );
+static vector3f_t WorldToBody( const float afQuat[4], const vector3f_t stWorld );
+static int16_t ToRaw( const float fValue, const float fRes );
+static float Gaussian( stQUADSIM_Cxt_t *pstCxt );
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+void QUADSIM_DefaultParams( stQUADSIM_Params_t *pstParams )
+{
+	pstParams->fMass_kg = 0.45f;
+	pstParams->stInertia.x = 0.0035f;
+	pstParams->stInertia.y = 0.0035f;
+	pstParams->stInertia.z = 0.0060f;
+	pstParams->fArm_m = 0.115f;
+	pstParams->fMotorTau_s = 0.035f;
+	pstParams->fThrustMax_N = 3.2f;
+	pstParams->fThrustExpo = 0.6f;
+	pstParams->fYawMoment_m = 0.016f;
+	pstParams->fDrag = 0.25f;
+	pstParams->fRotDrag = 0.002f;
+
+	pstParams->stGyroBias_dps.x = 0.5f;
+	pstParams->stGyroBias_dps.y = -0.3f;
+	pstParams->stGyroBias_dps.z = 0.2f;
+	pstParams->fGyroBiasWalk_dps = 0.01f;
+	pstParams->fGyroNoise_dps = 0.2f;
+	pstParams->fAccelNoise_g = 0.015f;
+	pstParams->fMagNoise_gauss = 0.005f;
+
+	return;
+}
+
+/* ************************************************************************** */
+void QUADSIM_Setup( stQUADSIM_Cxt_t *pstCxt, const stQUADSIM_Params_t *pstParams, const uint32_t uiSeed )
+{
+	float fHover;
+	uint32_t uiMotor;
+
+	memset( pstCxt, 0, sizeof( stQUADSIM_Cxt_t ) );
+
+	pstCxt->stParams = *pstParams;
+	pstCxt->stPos.z = START_ALTITUDE_M;
+	pstCxt->afQuat[0] = 1.0f;
+	pstCxt->stSpecificForce.z = 1.0f;
+	pstCxt->stGyroBias_dps = pstParams->stGyroBias_dps;
+
+	// Spun up to hover so the run doesn't start with a drop
+	fHover = QUADSIM_HoverDemand( pstParams );
+
+	for ( uiMotor = 0; uiMotor < NUM_MOTORS; uiMotor++ )
+	{
+		pstCxt->afMotor[ uiMotor ] = fHover;
+		pstCxt->afDemand[ uiMotor ] = fHover;
+	}
+
+	// xorshift can't start from zero
+	pstCxt->uiNoiseState = ( 0 == uiSeed ) ? 1 : uiSeed;
+
+	return;
+}
+
+/* ************************************************************************** */
+float QUADSIM_HoverDemand( const stQUADSIM_Params_t *pstParams )
+{
+	// Solve e s^2 + ( 1 - e ) s = m g / 4 Tmax for the speed s
+	float fNeed = ( pstParams->fMass_kg * GRAVITY ) / ( NUM_MOTORS * pstParams->fThrustMax_N );
+	float fExpo = pstParams->fThrustExpo;
+
+	if ( 0.0f == fExpo )
+	{
+		return fNeed;
+	}
+
+	return ( -( 1.0f - fExpo ) + sqrtf( ( ( 1.0f - fExpo ) * ( 1.0f - fExpo ) ) + ( 4.0f * fExpo * fNeed ) ) ) / ( 2.0f * fExpo );
+}
+
+/* ************************************************************************** */
+void QUADSIM_SetMotorDemands( stQUADSIM_Cxt_t *pstCxt, const stMotorDemands_t *pstDemands )
+{
+	const float afDemand[ NUM_MOTORS ] = { pstDemands->fFL, pstDemands->fFR, pstDemands->fRL, pstDemands->fRR };
+	uint32_t uiMotor;
+
+	for ( uiMotor = 0; uiMotor < NUM_MOTORS; uiMotor++ )
+	{
+		pstCxt->afDemand[ uiMotor ] = fminf( fmaxf( afDemand[ uiMotor ], 0.0f ), 1.0f );
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+void QUADSIM_Step( stQUADSIM_Cxt_t *pstCxt, const float fDt_s )
+{
+	const stQUADSIM_Params_t *pstParams = &pstCxt->stParams;
+	float fLag = 1.0f - expf( -fDt_s / pstParams->fMotorTau_s );
+	float fArm = pstParams->fArm_m * 0.70710678f;
+	float fThrust;
+	float fTotalThrust = 0;
+	vector3f_t stTorque = { 0, };
+	vector3f_t stMomentum;
+	vector3f_t stForce;
+	vector3f_t stAccel;
+	vector3f_t stBodyThrust = { 0, };
+	float afQuatDot[4];
+	float fNorm;
+	vector3f_t *pstRate = &pstCxt->stRate;
+	float *pfQuat = pstCxt->afQuat;
+	uint32_t uiMotor;
+
+	// Motors chase their demands, then push and twist the frame
+	for ( uiMotor = 0; uiMotor < NUM_MOTORS; uiMotor++ )
+	{
+		pstCxt->afMotor[ uiMotor ] += ( pstCxt->afDemand[ uiMotor ] - pstCxt->afMotor[ uiMotor ] ) * fLag;
+		fThrust = Thrust( pstParams, pstCxt->afMotor[ uiMotor ] );
+
+		fTotalThrust += fThrust;
+		stTorque.x += afMotorY[ uiMotor ] * fArm * fThrust;
+		stTorque.y -= afMotorX[ uiMotor ] * fArm * fThrust;
+		stTorque.z += afMotorSpin[ uiMotor ] * pstParams->fYawMoment_m * fThrust;
+	}
+
+	stTorque = VECTOR3F_Subtract( stTorque, VECTOR3F_Scale( *pstRate, pstParams->fRotDrag ) );
+
+	// Euler's equations, I w' = T - w x I w
+	stMomentum.x = pstParams->stInertia.x * pstRate->x;
+	stMomentum.y = pstParams->stInertia.y * pstRate->y;
+	stMomentum.z = pstParams->stInertia.z * pstRate->z;
+
+	pstRate->x += fDt_s * ( stTorque.x - ( pstRate->y * stMomentum.z - pstRate->z * stMomentum.y ) ) / pstParams->stInertia.x;
+	pstRate->y += fDt_s * ( stTorque.y - ( pstRate->z * stMomentum.x - pstRate->x * stMomentum.z ) ) / pstParams->stInertia.y;
+	pstRate->z += fDt_s * ( stTorque.z - ( pstRate->x * stMomentum.y - pstRate->y * stMomentum.x ) ) / pstParams->stInertia.z;
+
+	// q' = q (0, w) / 2 with the new rates, then renormalise
+	afQuatDot[0] = 0.5f * ( -pfQuat[1] * pstRate->x - pfQuat[2] * pstRate->y - pfQuat[3] * pstRate->z );
+	afQuatDot[1] = 0.5f * (  pfQuat[0] * pstRate->x + pfQuat[2] * pstRate->z - pfQuat[3] * pstRate->y );
+	afQuatDot[2] = 0.5f * (  pfQuat[0] * pstRate->y - pfQuat[1] * pstRate->z + pfQuat[3] * pstRate->x );
+	afQuatDot[3] = 0.5f * (  pfQuat[0] * pstRate->z + pfQuat[1] * pstRate->y - pfQuat[2] * pstRate->x );
+
+	pfQuat[0] += afQuatDot[0] * fDt_s;
+	pfQuat[1] += afQuatDot[1] * fDt_s;
+	pfQuat[2] += afQuatDot[2] * fDt_s;
+	pfQuat[3] += afQuatDot[3] * fDt_s;
+
+	fNorm = 1.0f / sqrtf( pfQuat[0] * pfQuat[0] + pfQuat[1] * pfQuat[1] + pfQuat[2] * pfQuat[2] + pfQuat[3] * pfQuat[3] );
+	pfQuat[0] *= fNorm;
+	pfQuat[1] *= fNorm;
+	pfQuat[2] *= fNorm;
+	pfQuat[3] *= fNorm;
+
+	// Thrust along body z, drag against the air, gravity down
+	stBodyThrust.z = fTotalThrust;
+	stForce = VECTOR3F_Subtract( BodyToWorld( pfQuat, stBodyThrust ), VECTOR3F_Scale( pstCxt->stVel, pstParams->fDrag ) );
+	stAccel = VECTOR3F_Scale( stForce, 1.0f / pstParams->fMass_kg );
+	stAccel.z -= GRAVITY;
+
+	// The ground holds the model up but leaves it free to tip
+	if ( ( 0.0f >= pstCxt->stPos.z ) && ( 0.0f > stAccel.z ) )
+	{
+		pstCxt->stPos.z = 0;
+		memset( &pstCxt->stVel, 0, sizeof( pstCxt->stVel ) );
+		memset( &stAccel, 0, sizeof( stAccel ) );
+	}
+
+	pstCxt->stVel = VECTOR3F_Add( pstCxt->stVel, VECTOR3F_Scale( stAccel, fDt_s ) );
+	pstCxt->stPos = VECTOR3F_Add( pstCxt->stPos, VECTOR3F_Scale( pstCxt->stVel, fDt_s ) );
+
+	// An accelerometer reads everything but gravity
+	stAccel.z += GRAVITY;
+	pstCxt->stSpecificForce = VECTOR3F_Scale( WorldToBody( pfQuat, stAccel ), 1.0f / GRAVITY );
+
+	pstCxt->fTime_s += fDt_s;
+
+	return;
+}
+
+/* ************************************************************************** */
+void QUADSIM_SampleGyro( stQUADSIM_Cxt_t *pstCxt, const float fPeriod_s, int16_t aiRaw[3] )
+{
+	const stQUADSIM_Params_t *pstParams = &pstCxt->stParams;
+	float fWalk = pstParams->fGyroBiasWalk_dps * sqrtf( fPeriod_s );
+
+	pstCxt->stGyroBias_dps.x += fWalk * Gaussian( pstCxt );
+	pstCxt->stGyroBias_dps.y += fWalk * Gaussian( pstCxt );
+	pstCxt->stGyroBias_dps.z += fWalk * Gaussian( pstCxt );
+
+	aiRaw[0] = ToRaw( ( pstCxt->stRate.x * RAD2DEG ) + pstCxt->stGyroBias_dps.x + ( pstParams->fGyroNoise_dps * Gaussian( pstCxt ) ), QUADSIM_GYRO_RES_DPS );
+	aiRaw[1] = ToRaw( ( pstCxt->stRate.y * RAD2DEG ) + pstCxt->stGyroBias_dps.y + ( pstParams->fGyroNoise_dps * Gaussian( pstCxt ) ), QUADSIM_GYRO_RES_DPS );
+	aiRaw[2] = ToRaw( ( pstCxt->stRate.z * RAD2DEG ) + pstCxt->stGyroBias_dps.z + ( pstParams->fGyroNoise_dps * Gaussian( pstCxt ) ), QUADSIM_GYRO_RES_DPS );
+
+	return;
+}
+
+/* ************************************************************************** */
+void QUADSIM_SampleAccel( stQUADSIM_Cxt_t *pstCxt, int16_t aiRaw[3] )
+{
+	float fNoise = pstCxt->stParams.fAccelNoise_g;
+
+	aiRaw[0] = ToRaw( pstCxt->stSpecificForce.x + ( fNoise * Gaussian( pstCxt ) ), QUADSIM_ACCEL_RES_G );
+	aiRaw[1] = ToRaw( pstCxt->stSpecificForce.y + ( fNoise * Gaussian( pstCxt ) ), QUADSIM_ACCEL_RES_G );
+	aiRaw[2] = ToRaw( pstCxt->stSpecificForce.z + ( fNoise * Gaussian( pstCxt ) ), QUADSIM_ACCEL_RES_G );
+
+	return;
+}
+
+/* ************************************************************************** */
+void QUADSIM_SampleMag( stQUADSIM_Cxt_t *pstCxt, int16_t aiRaw[3] )
+{
+	const vector3f_t stWorld = { MAG_WORLD_X, MAG_WORLD_Y, MAG_WORLD_Z };
+	float fNoise = pstCxt->stParams.fMagNoise_gauss;
+	vector3f_t stMag = WorldToBody( pstCxt->afQuat, stWorld );
+
+	aiRaw[0] = ToRaw( stMag.x + ( fNoise * Gaussian( pstCxt ) ), QUADSIM_MAG_RES_GAUSS );
+	aiRaw[1] = ToRaw( stMag.y + ( fNoise * Gaussian( pstCxt ) ), QUADSIM_MAG_RES_GAUSS );
+	aiRaw[2] = ToRaw( stMag.z + ( fNoise * Gaussian( pstCxt ) ), QUADSIM_MAG_RES_GAUSS );
+
+	return;
+}
+
+/* ************************************************************************** */
+void QUADSIM_GetAttitude( const stQUADSIM_Cxt_t *pstCxt, vector3f_t *pstAttitude )
+{
+	const float *pfQuat = pstCxt->afQuat;
+	float fSinPitch = 2.0f * ( pfQuat[0] * pfQuat[2] - pfQuat[3] * pfQuat[1] );
+
+	pstAttitude->x = atan2f( 2.0f * ( pfQuat[0] * pfQuat[1] + pfQuat[2] * pfQuat[3] ),
+							 1.0f - 2.0f * ( pfQuat[1] * pfQuat[1] + pfQuat[2] * pfQuat[2] ) );
+	pstAttitude->y = asinf( fminf( fmaxf( fSinPitch, -1.0f ), 1.0f ) );
+	pstAttitude->z = atan2f( 2.0f * ( pfQuat[0] * pfQuat[3] + pfQuat[1] * pfQuat[2] ),
+							 1.0f - 2.0f * ( pfQuat[2] * pfQuat[2] + pfQuat[3] * pfQuat[3] ) );
+
+	return;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static float Thrust( const stQUADSIM_Params_t *pstParams, const float fSpeed )
+{
+	return pstParams->fThrustMax_N * ( ( ( 1.0f - pstParams->fThrustExpo ) * fSpeed )
+									   + ( pstParams->fThrustExpo * fSpeed * fSpeed ) );
+}
+
+/* ************************************************************************** */
+static vector3f_t BodyToWorld( const float afQuat[4], const vector3f_t stBody )
+{
+	float w = afQuat[0];
+	float x = afQuat[1];
+	float y = afQuat[2];
+	float z = afQuat[3];
+	vector3f_t stWorld;
+
+	stWorld.x = ( 1 - 2 * ( y * y + z * z ) ) * stBody.x + 2 * ( x * y - w * z ) * stBody.y + 2 * ( x * z + w * y ) * stBody.z;
+	stWorld.y = 2 * ( x * y + w * z ) * stBody.x + ( 1 - 2 * ( x * x + z * z ) ) * stBody.y + 2 * ( y * z - w * x ) * stBody.z;
+	stWorld.z = 2 * ( x * z - w * y ) * stBody.x + 2 * ( y * z + w * x ) * stBody.y + ( 1 - 2 * ( x * x + y * y ) ) * stBody.z;
+
+	return stWorld;
+}
+
+/* ************************************************************************** */
+static vector3f_t WorldToBody( const float afQuat[4], const vector3f_t stWorld )
+{
+	// The inverse of a unit quaternion is its conjugate
+	const float afConj[4] = { afQuat[0], -afQuat[1], -afQuat[2], -afQuat[3] };
+
+	return BodyToWorld( afConj, stWorld );
+}
+
+/* ************************************************************************** */
+static int16_t ToRaw( const float fValue, const float fRes )
+{
+	float fRaw = roundf( fValue / fRes );
+
+	if ( 32767.0f < fRaw )
+	{
+		return 32767;
+	}
+	else if ( -32768.0f > fRaw )
+	{
+		return -32768;
+	}
+
+	return (int16_t)fRaw;
+}
+
+/* ************************************************************************** */
+static float Gaussian( stQUADSIM_Cxt_t *pstCxt )
+{
+	float fU1;
+	float fU2;
+
+	// Box-Muller on two xorshift32 draws, (0, 1] so the log is finite
+	pstCxt->uiNoiseState ^= pstCxt->uiNoiseState << 13;
+	pstCxt->uiNoiseState ^= pstCxt->uiNoiseState >> 17;
+	pstCxt->uiNoiseState ^= pstCxt->uiNoiseState << 5;
+	fU1 = ( (float)( pstCxt->uiNoiseState >> 8 ) + 1.0f ) / 16777216.0f;
+
+	pstCxt->uiNoiseState ^= pstCxt->uiNoiseState << 13;
+	pstCxt->uiNoiseState ^= pstCxt->uiNoiseState >> 17;
+	pstCxt->uiNoiseState ^= pstCxt->uiNoiseState << 5;
+	fU2 = (float)( pstCxt->uiNoiseState >> 8 ) / 16777216.0f;
+
+	return sqrtf( -2.0f * logf( fU1 ) ) * cosf( 2.0f * PI * fU2 );
+}
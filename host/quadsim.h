@@ -0,0 +1,130 @@
+#ifndef QUADSIM_H
+#define QUADSIM_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include "vector3f.h"		// vector3f_t
+#include "flight.h"			// stMotorDemands_t
+
+/*
+ * Rigid body quadrotor for software in the loop runs on the host. The frame
+ * is the one flight.c uses: x forward, y left, z up, so +roll is right side
+ * down, +pitch is nose down and +yaw is anticlockwise from above.
+ *
+ * Each motor's speed lags its demand (first order) and thrust follows a curve
+ * between linear and quadratic in speed. The IMU samples the true rates and
+ * specific force through a bias, bias random walk and white noise model and
+ * is quantised to the scales the flight task sets up (500dps, 8g), so the
+ * output can go through the same decimators as the real FIFO samples.
+ *
+ * Everything lives in the context so any number can run side by side.
+ */
+
+#define QUADSIM_GYRO_RES_DPS	( 500.0f / 32768.0f )
+#define QUADSIM_ACCEL_RES_G		( 8.0f / 32768.0f )
+#define QUADSIM_MAG_RES_GAUSS	( 4.0f / 32768.0f )
+
+typedef struct
+{
+	float fMass_kg;
+	vector3f_t stInertia;		// Principal moments, kg m^2
+	float fArm_m;				// Centre to motor
+	float fMotorTau_s;			// Speed lag time constant
+	float fThrustMax_N;			// Per motor at full demand
+	float fThrustExpo;			// 0 linear, 1 quadratic in demand
+	float fYawMoment_m;			// Reaction torque per newton of thrust
+	float fDrag;				// Linear drag, N per m/s
+	float fRotDrag;				// Rotational damping, Nm per rad/s
+
+	vector3f_t stGyroBias_dps;	// Bias at start up
+	float fGyroBiasWalk_dps;	// Bias random walk, dps per root second
+	float fGyroNoise_dps;		// White noise, 1 sigma per sample
+	float fAccelNoise_g;		// White noise, 1 sigma per sample
+	float fMagNoise_gauss;		// White noise, 1 sigma per sample
+
+} stQUADSIM_Params_t;
+
+typedef struct
+{
+	stQUADSIM_Params_t stParams;
+
+	vector3f_t stPos;			// World, m
+	vector3f_t stVel;			// World, m/s
+	float afQuat[4];			// Body to world, w x y z
+	vector3f_t stRate;			// Body, rad/s
+	vector3f_t stSpecificForce;	// Body, g, what an ideal accelerometer reads
+	float afMotor[ NUM_MOTORS ];	// Lagged speeds, 0..1
+	float afDemand[ NUM_MOTORS ];	// FL, FR, RL, RR as flight.c
+	vector3f_t stGyroBias_dps;
+	float fTime_s;
+
+	uint32_t uiNoiseState;
+
+} stQUADSIM_Cxt_t;
+
+/**
+ * @brief		Fills in a small (450g, 230mm) airframe.
+ * @param[out]	pstParams	Parameters to fill in.
+ */
+void QUADSIM_DefaultParams( stQUADSIM_Params_t *pstParams );
+
+/**
+ * @brief		Starts a model level and at rest, hovering at 10m.
+ * @param[in]	pstCxt		Model context.
+ * @param[in]	pstParams	Airframe and sensor parameters, copied.
+ * @param[in]	uiSeed		Noise seed, runs with the same seed repeat exactly.
+ */
+void QUADSIM_Setup( stQUADSIM_Cxt_t *pstCxt, const stQUADSIM_Params_t *pstParams, const uint32_t uiSeed );
+
+/**
+ * @brief		The motor demand that hovers, for use as the throttle stick.
+ * @param[in]	pstParams	Airframe parameters.
+ */
+float QUADSIM_HoverDemand( const stQUADSIM_Params_t *pstParams );
+
+/**
+ * @brief		Sets the demand the motors follow, clipped to 0..1 as an ESC
+ * 				would.
+ * @param[in]	pstCxt		Model context.
+ * @param[in]	pstDemands	Demands from the flight controller.
+ */
+void QUADSIM_SetMotorDemands( stQUADSIM_Cxt_t *pstCxt, const stMotorDemands_t *pstDemands );
+
+/**
+ * @brief		Moves the model on. Keep fDt_s to a millisecond or less.
+ * @param[in]	pstCxt		Model context.
+ * @param[in]	fDt_s		Time step in seconds.
+ */
+void QUADSIM_Step( stQUADSIM_Cxt_t *pstCxt, const float fDt_s );
+
+/**
+ * @brief		Takes one raw gyro sample, as read from the FIFO.
+ * @param[in]	pstCxt		Model context.
+ * @param[in]	fPeriod_s	Sample period, for the bias random walk.
+ * @param[out]	aiRaw		x, y, z in LSBs of QUADSIM_GYRO_RES_DPS.
+ */
+void QUADSIM_SampleGyro( stQUADSIM_Cxt_t *pstCxt, const float fPeriod_s, int16_t aiRaw[3] );
+
+/**
+ * @brief		Takes one raw accelerometer sample, as read from the FIFO.
+ * @param[in]	pstCxt		Model context.
+ * @param[out]	aiRaw		x, y, z in LSBs of QUADSIM_ACCEL_RES_G.
+ */
+void QUADSIM_SampleAccel( stQUADSIM_Cxt_t *pstCxt, int16_t aiRaw[3] );
+
+/**
+ * @brief		Takes one raw magnetometer sample of the field in the body frame.
+ * @param[in]	pstCxt		Model context.
+ * @param[out]	aiRaw		x, y, z in LSBs of QUADSIM_MAG_RES_GAUSS.
+ */
+void QUADSIM_SampleMag( stQUADSIM_Cxt_t *pstCxt, int16_t aiRaw[3] );
+
+/**
+ * @brief		The true attitude as roll, pitch and yaw in radians.
+ * @param[in]	pstCxt		Model context.
+ * @param[out]	pstAttitude	x roll, y pitch, z yaw.
+ */
+void QUADSIM_GetAttitude( const stQUADSIM_Cxt_t *pstCxt, vector3f_t *pstAttitude );
+
+#endif
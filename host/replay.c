@@ -0,0 +1,276 @@
+/* ************************************************************************** **
+ * Replays a sensor log (sensorlog.h) through the flight task's processing,
+ * the same decimators, SENSORFUSION_Update and flight_process, see
+ * flightchain.c.
+ *
+ * The log is memory mapped and read in place. It is walked once to check it
+ * before anything is timed, which also faults it in, so the per tick times
+ * are the controller's alone.
+ *
+ * At the end it prints the host CPU time per tick, and of the sensor fusion
+ * update within it, and an FNV-1a digest of every
+ * motor demand and attitude estimate. The digest changes if a single bit of
+ * output does, so two builds, or a build and the "sitl -l" run that recorded
+ * the log, can be compared at a glance. -o writes the outputs themselves.
+ *
+ * Usage: replay [-q] [-o out.csv] log
+ *   -q  run the fixed point chain (flight_process_q)
+ *
+ * Build and run with "make replay" from the top level, REPLAY_ARGS is passed
+ * on and REPLAY_LOG names the log, recorded with sitl if it is missing.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <stdio.h>			// printf & friends
+#include <stdlib.h>			// qsort & friends
+#include <time.h>			// clock_gettime
+#include <unistd.h>			// getopt
+#include <fcntl.h>			// open
+#include <sys/mman.h>		// mmap
+#include <sys/stat.h>		// fstat
+
+#include "flightchain.h"	// The flight task's processing
+#include "sensorlog.h"		// Raw tick inputs
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static uint32_t CountTicks( const uint8_t *puiLog, const size_t uiLen );
+static void PrintTimes( const char *pcName, uint32_t *puiNs, const uint32_t uiCount );
+static int CompareU32( const void *pvA, const void *pvB );
+static uint64_t NowNs( void );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static stFLIGHTCHAIN_Cxt_t stChain;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( int argc, char **argv )
+{
+	const stSENSORLOG_Header_t *pstHeader;
+	const stSENSORLOG_Tick_t *pstTick;
+	const uint8_t *puiLog;
+	stMotorDemands_t stDemands;
+	vector3f_t stAttitude;
+	struct stat stStat;
+	size_t uiOffset;
+	uint32_t *puiTickNs;
+	uint32_t *puiFusionNs;
+	uint32_t uiTicks;
+	uint32_t uiTick;
+	uint64_t uiTime_us = 0;
+	uint64_t uiDigest = FLIGHTCHAIN_DIGEST_INIT;
+	uint64_t uiStartNs;
+	bool bFixed = false;
+	FILE *pxOut = NULL;
+	int iFd;
+	int iOpt;
+
+	while ( -1 != ( iOpt = getopt( argc, argv, "qo:" ) ) )
+	{
+		switch ( iOpt )
+		{
+			case 'q': bFixed = true; break;
+			case 'o':
+				if ( NULL == ( pxOut = fopen( optarg, "w" ) ) )
+				{
+					perror( optarg );
+					return 2;
+				}
+				fprintf( pxOut, "t,fl,fr,rl,rr,roll,pitch,yaw\n" );
+				break;
+			default:
+				fprintf( stderr, "usage: %s [-q] [-o out.csv] log\n", argv[0] );
+				return 2;
+		}
+	}
+
+	if ( optind + 1 != argc )
+	{
+		fprintf( stderr, "usage: %s [-q] [-o out.csv] log\n", argv[0] );
+		return 2;
+	}
+
+	if ( ( 0 > ( iFd = open( argv[ optind ], O_RDONLY ) ) ) || ( 0 != fstat( iFd, &stStat ) ) )
+	{
+		perror( argv[ optind ] );
+		return 2;
+	}
+
+	if ( (size_t)stStat.st_size < sizeof( stSENSORLOG_Header_t ) )
+	{
+		fprintf( stderr, "%s: too short for a sensor log\n", argv[ optind ] );
+		return 2;
+	}
+
+	puiLog = mmap( NULL, (size_t)stStat.st_size, PROT_READ, MAP_PRIVATE, iFd, 0 );
+	close( iFd );
+
+	if ( MAP_FAILED == puiLog )
+	{
+		perror( "mmap" );
+		return 2;
+	}
+
+	madvise( (void*)puiLog, (size_t)stStat.st_size, MADV_SEQUENTIAL );
+
+	pstHeader = (const stSENSORLOG_Header_t*)puiLog;
+
+	if ( ( SENSORLOG_MAGIC != pstHeader->uiMagic ) || ( SENSORLOG_VERSION != pstHeader->uiVersion )
+		 || ( sizeof( stSENSORLOG_Header_t ) > pstHeader->uiHeaderLen ) || ( 0 != ( pstHeader->uiHeaderLen & 1 ) )
+		 || ( (size_t)stStat.st_size < pstHeader->uiHeaderLen ) )
+	{
+		fprintf( stderr, "%s: not a version %u sensor log\n", argv[ optind ], (unsigned)SENSORLOG_VERSION );
+		return 2;
+	}
+
+	uiTicks = CountTicks( puiLog, (size_t)stStat.st_size );
+	puiTickNs = calloc( uiTicks + 1, sizeof( uint32_t ) );
+	puiFusionNs = calloc( uiTicks + 1, sizeof( uint32_t ) );
+
+	if ( ( NULL == puiTickNs ) || ( NULL == puiFusionNs ) )
+	{
+		return 2;
+	}
+
+	FLIGHTCHAIN_Setup( &stChain, pstHeader, bFixed );
+
+	for ( uiTick = 0, uiOffset = pstHeader->uiHeaderLen; uiTick < uiTicks; uiTick++ )
+	{
+		pstTick = (const stSENSORLOG_Tick_t*)( puiLog + uiOffset );
+		uiOffset += SENSORLOG_TICK_LEN( pstTick );
+
+		uiStartNs = NowNs();
+		FLIGHTCHAIN_Run( &stChain, pstTick, &stDemands, &stAttitude );
+		puiTickNs[ uiTick ] = (uint32_t)( NowNs() - uiStartNs );
+		puiFusionNs[ uiTick ] = bFixed ? FLIGHT_GetFusionCyclesQ( &stChain.stFlight ) : FLIGHT_GetFusionCycles( &stChain.stFlight );
+
+		uiDigest = FLIGHTCHAIN_Digest( uiDigest, &stDemands, &stAttitude );
+		uiTime_us += pstTick->uiDt_us;
+
+		if ( NULL != pxOut )
+		{
+			fprintf( pxOut, "%.6f,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g\n", uiTime_us / 1e6,
+					 stDemands.fFL, stDemands.fFR, stDemands.fRL, stDemands.fRR,
+					 stAttitude.x, stAttitude.y, stAttitude.z );
+		}
+	}
+
+	if ( NULL != pxOut )
+	{
+		fclose( pxOut );
+	}
+
+	printf( "%s chain, %u ticks, %.1f s of flight", bFixed ? "fixed point" : "float", (unsigned)uiTicks, uiTime_us / 1e6 );
+
+	if ( uiOffset != (size_t)stStat.st_size )
+	{
+		printf( ", %u trailing bytes ignored", (unsigned)( stStat.st_size - uiOffset ) );
+	}
+
+	printf( "\n\n" );
+
+	if ( 0 < uiTicks )
+	{
+		printf( "%-24s %-10s %-10s %-10s %-10s\n", "host ns per tick", "mean", "median", "p99", "max" );
+		PrintTimes( "decimate + control", puiTickNs, uiTicks );
+		PrintTimes( "sensor fusion", puiFusionNs, uiTicks );
+		printf( "\n" );
+	}
+
+	printf( "output digest %016llx\n", (unsigned long long)uiDigest );
+
+	free( puiTickNs );
+	free( puiFusionNs );
+	munmap( (void*)puiLog, (size_t)stStat.st_size );
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static uint32_t CountTicks( const uint8_t *puiLog, const size_t uiLen )
+{
+	const stSENSORLOG_Header_t *pstHeader = (const stSENSORLOG_Header_t*)puiLog;
+	const stSENSORLOG_Tick_t *pstTick;
+	size_t uiOffset = pstHeader->uiHeaderLen;
+	uint32_t uiTicks = 0;
+
+	// Stops at the first tick that is cut short or can't be right, a log from
+	// a flight that ended badly still replays up to there
+	while ( uiOffset + sizeof( stSENSORLOG_Tick_t ) <= uiLen )
+	{
+		pstTick = (const stSENSORLOG_Tick_t*)( puiLog + uiOffset );
+
+		if ( ( SENSORLOG_SAMPLES_MAX < pstTick->uiGyroCount ) || ( SENSORLOG_SAMPLES_MAX < pstTick->uiAccelCount )
+			 || ( uiOffset + SENSORLOG_TICK_LEN( pstTick ) > uiLen ) )
+		{
+			break;
+		}
+
+		uiOffset += SENSORLOG_TICK_LEN( pstTick );
+		uiTicks++;
+	}
+
+	return uiTicks;
+}
+
+/* ************************************************************************** */
+static void PrintTimes( const char *pcName, uint32_t *puiNs, const uint32_t uiCount )
+{
+	double dSum = 0;
+	uint32_t uiIndex;
+
+	for ( uiIndex = 0; uiIndex < uiCount; uiIndex++ )
+	{
+		dSum += puiNs[ uiIndex ];
+	}
+
+	qsort( puiNs, uiCount, sizeof( uint32_t ), CompareU32 );
+
+	printf( "%-24s %-10.0f %-10u %-10u %-10u\n", pcName,
+			dSum / uiCount, (unsigned)puiNs[ uiCount / 2 ],
+			(unsigned)puiNs[ ( uiCount * 99 ) / 100 ], (unsigned)puiNs[ uiCount - 1 ] );
+
+	return;
+}
+
+/* ************************************************************************** */
+static int CompareU32( const void *pvA, const void *pvB )
+{
+	uint32_t uiA = *(const uint32_t*)pvA;
+	uint32_t uiB = *(const uint32_t*)pvB;
+
+	return ( uiA > uiB ) - ( uiA < uiB );
+}
+
+/* ************************************************************************** */
+static uint64_t NowNs( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return ( (uint64_t)stNow.tv_sec * 1000000000ULL ) + (uint64_t)stNow.tv_nsec;
+}
@@ -0,0 +1,337 @@
+/* ************************************************************************** **
+ * Software in the loop: the flight controller flying the quadrotor model.
+ *
+ * The model (quadsim.c) is stepped at FLIGHTSIM_PHYSICS_HZ. Its IMU is sampled
+ * at the rates the flight task configures and at each FIFO watermark the
+ * samples go through the flight task's decimators into flight_process() and
+ * the motor demands that come back are fed to the model, see flightsim.c. The
+ * sticks follow a fixed set of roll and pitch steps.
+ *
+ * At the end it prints the host CPU time of each control loop (decimation and
+ * flight_process) and how well the attitude tracked the sticks and how well
+ * the estimate tracked the true attitude. The loop and the sensor fusion are
+ * also put through the flight task's run time histograms (cyclestats.h), with
+ * the host's nanosecond counter (cycles.h) standing in for the cycle counter.
+ *
+ * Usage: sitl [-r] [-q] [-f filter] [-t seconds] [-s seed] [-o trace.csv] [-l log]
+ *   -r  run in real time rather than as fast as possible
+ *   -q  fly the fixed point chain (flight_process_q)
+ *   -f  the sensor fusion, by SENSORFUSION_GetStrategyName's name
+ *   -l  record the controller's inputs as a sensor log (sensorlog.h) for
+ *       "make replay", with a digest of its outputs to check the replay by
+ *
+ * Build and run with "make sitl" from the top level, SITL_ARGS is passed on.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <stdio.h>			// printf & friends
+#include <stdlib.h>			// qsort & friends
+#include <time.h>			// clock_gettime
+#include <unistd.h>			// getopt
+
+#include "flightsim.h"		// Closed loop flight
+#include "flightchain.h"	// Output digest
+#include "sensorlog.h"		// Raw tick inputs
+#include "cycles.h"			// Cycle counter
+#include "cyclestats.h"		// Run time histograms
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static void PrintError( const char *pcName, const stFLIGHTSIM_Error_t *pstError );
+static void PrintHistograms( const stCYCLESTATS_Summary_t *pstLoop, const stCYCLESTATS_Summary_t *pstFusion );
+static int CompareU32( const void *pvA, const void *pvB );
+static uint64_t NowNs( void );
+static void SleepUntilNs( const uint64_t uiWhen );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static stFLIGHTSIM_Cxt_t stFlight;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( int argc, char **argv )
+{
+	stFLIGHTSIM_Config_t stConfig;
+	stQUADSIM_Cxt_t *pstSim = &stFlight.stSim;
+	uint32_t *puiLoopNs;
+	uint32_t uiLoops = 0;
+	uint32_t uiMaxLoops;
+	uint32_t uiOverruns = 0;
+	uint64_t uiStartNs;
+	uint64_t uiLoopStartNs;
+	uint64_t uiWallNs;
+	bool bRealTime = false;
+	FILE *pxTrace = NULL;
+	FILE *pxLog = NULL;
+	uint64_t uiDigest = FLIGHTCHAIN_DIGEST_INIT;
+	stCYCLESTATS_Ctx_t stLoopCycles;
+	stCYCLESTATS_Ctx_t stFusionCycles;
+	stCYCLESTATS_Summary_t stLoopSummary;
+	stCYCLESTATS_Summary_t stFusionSummary;
+	uint32_t uiLoopStart;
+	int iOpt;
+
+	FLIGHTSIM_DefaultConfig( &stConfig );
+
+	while ( -1 != ( iOpt = getopt( argc, argv, "rqf:t:s:o:l:" ) ) )
+	{
+		switch ( iOpt )
+		{
+			case 'r': bRealTime = true; break;
+			case 'q': stConfig.bFixed = true; break;
+			case 'f':
+				if ( !SENSORFUSION_FindStrategy( optarg, &stConfig.eFusion ) )
+				{
+					fprintf( stderr, "%s: no such sensor fusion\n", optarg );
+					return 2;
+				}
+				break;
+			case 't': stConfig.fDuration_s = strtof( optarg, NULL ); break;
+			case 's': stConfig.uiSeed = (uint32_t)strtoul( optarg, NULL, 0 ); break;
+			case 'o':
+				if ( NULL == ( pxTrace = fopen( optarg, "w" ) ) )
+				{
+					perror( optarg );
+					return 2;
+				}
+				fprintf( pxTrace, "t,target_roll,target_pitch,roll,pitch,est_roll,est_pitch,fl,fr,rl,rr\n" );
+				break;
+			case 'l':
+				if ( NULL == ( pxLog = fopen( optarg, "wb" ) ) )
+				{
+					perror( optarg );
+					return 2;
+				}
+				break;
+			default:
+				fprintf( stderr, "usage: %s [-r] [-q] [-f filter] [-t seconds] [-s seed] [-o trace.csv] [-l log]\n", argv[0] );
+				return 2;
+		}
+	}
+
+	FLIGHTSIM_Setup( &stFlight, &stConfig );
+
+	if ( NULL != pxLog )
+	{
+		fwrite( &stFlight.stChain.stScale, sizeof( stSENSORLOG_Header_t ), 1, pxLog );
+	}
+
+	uiMaxLoops = (uint32_t)( ( stConfig.fDuration_s * FLIGHTSIM_GYRO_HZ ) / stConfig.uiGyroPerLoop ) + 1;
+	puiLoopNs = calloc( uiMaxLoops, sizeof( uint32_t ) );
+
+	if ( NULL == puiLoopNs )
+	{
+		return 2;
+	}
+
+	CYCLES_Setup();
+	CYCLESTATS_Create( &stLoopCycles );
+	CYCLESTATS_Create( &stFusionCycles );
+
+	uiStartNs = NowNs();
+
+	while ( FLIGHTSIM_Advance( &stFlight ) && ( uiLoops < uiMaxLoops ) )
+	{
+		if ( bRealTime )
+		{
+			if ( NowNs() > uiStartNs + (uint64_t)( pstSim->fTime_s * 1e9 ) + ( stFlight.stRecord.stTick.uiDt_us * 1000ULL ) )
+			{
+				uiOverruns++;
+			}
+
+			SleepUntilNs( uiStartNs + (uint64_t)( pstSim->fTime_s * 1e9 ) );
+		}
+
+		uiLoopStartNs = NowNs();
+		uiLoopStart = CYCLES_Now();
+		FLIGHTSIM_Control( &stFlight );
+		CYCLESTATS_Add( &stLoopCycles, CYCLES_Now() - uiLoopStart );
+		puiLoopNs[ uiLoops++ ] = (uint32_t)( NowNs() - uiLoopStartNs );
+
+		CYCLESTATS_Add( &stFusionCycles, stConfig.bFixed ? FLIGHT_GetFusionCyclesQ( &stFlight.stChain.stFlight )
+														 : FLIGHT_GetFusionCycles( &stFlight.stChain.stFlight ) );
+
+		FLIGHTSIM_Score( &stFlight );
+
+		if ( NULL != pxLog )
+		{
+			fwrite( &stFlight.stRecord, SENSORLOG_TICK_LEN( &stFlight.stRecord.stTick ), 1, pxLog );
+			uiDigest = FLIGHTCHAIN_Digest( uiDigest, &stFlight.stDemands, &stFlight.stEstimate );
+		}
+
+		if ( NULL != pxTrace )
+		{
+			const stReceiverInput_t *pstReceiver = &stFlight.stReceiver;
+
+			fprintf( pxTrace, "%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.3f,%.3f,%.3f,%.3f\n",
+					 pstSim->fTime_s, pstReceiver->fRoll * pstReceiver->fVarA, pstReceiver->fPitch * pstReceiver->fVarA,
+					 stFlight.stTruth.x, stFlight.stTruth.y, stFlight.stEstimate.x, stFlight.stEstimate.y,
+					 pstSim->afDemand[0], pstSim->afDemand[1], pstSim->afDemand[2], pstSim->afDemand[3] );
+		}
+	}
+
+	uiWallNs = NowNs() - uiStartNs;
+
+	if ( NULL != pxTrace )
+	{
+		fclose( pxTrace );
+	}
+
+	if ( NULL != pxLog )
+	{
+		fclose( pxLog );
+	}
+
+	printf( "%s chain, %.1f s simulated in %.3f s (%.0fx real time), %u loops",
+			stConfig.bFixed ? "fixed point" : "float", pstSim->fTime_s, uiWallNs / 1e9,
+			pstSim->fTime_s / ( uiWallNs / 1e9 ), (unsigned)uiLoops );
+
+	if ( bRealTime )
+	{
+		printf( ", %u overran", (unsigned)uiOverruns );
+	}
+
+	printf( "\n\n" );
+
+	if ( 0 < uiLoops )
+	{
+		double dSum = 0;
+		uint32_t uiLoop;
+
+		for ( uiLoop = 0; uiLoop < uiLoops; uiLoop++ )
+		{
+			dSum += puiLoopNs[ uiLoop ];
+		}
+
+		qsort( puiLoopNs, uiLoops, sizeof( uint32_t ), CompareU32 );
+
+		printf( "%-24s %-10s %-10s %-10s %-10s\n", "host ns per loop", "mean", "median", "p99", "max" );
+		printf( "%-24s %-10.0f %-10u %-10u %-10u\n\n", "decimate + control",
+				dSum / uiLoops, (unsigned)puiLoopNs[ uiLoops / 2 ],
+				(unsigned)puiLoopNs[ ( uiLoops * 99 ) / 100 ], (unsigned)puiLoopNs[ uiLoops - 1 ] );
+
+		// One window for the whole flight
+		CYCLESTATS_Summarise( &stLoopCycles, &stLoopSummary );
+		CYCLESTATS_Summarise( &stFusionCycles, &stFusionSummary );
+		PrintHistograms( &stLoopSummary, &stFusionSummary );
+	}
+
+	printf( "%-24s %-10s %-10s\n", "error (rad)", "rms", "max" );
+	PrintError( "roll tracking", &stFlight.stTrackRoll );
+	PrintError( "pitch tracking", &stFlight.stTrackPitch );
+	PrintError( "roll estimate", &stFlight.stEstRoll );
+	PrintError( "pitch estimate", &stFlight.stEstPitch );
+
+	if ( NULL != pxLog )
+	{
+		printf( "\nlogged %u ticks, output digest %016llx\n", (unsigned)uiLoops, (unsigned long long)uiDigest );
+	}
+
+	free( puiLoopNs );
+
+	if ( stFlight.bLost )
+	{
+		printf( "\nFAIL: lost control at %.2f s\n", pstSim->fTime_s );
+		return 1;
+	}
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static void PrintError( const char *pcName, const stFLIGHTSIM_Error_t *pstError )
+{
+	printf( "%-24s %-10.4f %-10.4f\n", pcName, FLIGHTSIM_Rms( pstError ), pstError->fMax );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void PrintHistograms( const stCYCLESTATS_Summary_t *pstLoop, const stCYCLESTATS_Summary_t *pstFusion )
+{
+	int iFirst = CYCLESTATS_NUM_BUCKETS;
+	int iLast = -1;
+	int iBucket;
+
+	printf( "%-24s %-10s %-10s %-10s\n", "host ns, cyclestats", "min", "mean", "max" );
+	printf( "%-24s %-10u %-10u %-10u\n", "decimate + control",
+			(unsigned)pstLoop->uiMin, (unsigned)pstLoop->uiMean, (unsigned)pstLoop->uiMax );
+	printf( "%-24s %-10u %-10u %-10u\n\n", "sensor fusion",
+			(unsigned)pstFusion->uiMin, (unsigned)pstFusion->uiMean, (unsigned)pstFusion->uiMax );
+
+	// Only the buckets from the first to the last one used
+	for ( iBucket = 0; iBucket < CYCLESTATS_NUM_BUCKETS; iBucket++ )
+	{
+		if ( ( 0 != pstLoop->auiBuckets[ iBucket ] ) || ( 0 != pstFusion->auiBuckets[ iBucket ] ) )
+		{
+			iFirst = ( iFirst > iBucket ) ? iBucket : iFirst;
+			iLast = iBucket;
+		}
+	}
+
+	printf( "%-24s %-10s %-10s\n", "host ns from", "loops", "fusions" );
+
+	for ( iBucket = iFirst; iBucket <= iLast; iBucket++ )
+	{
+		printf( "%-24lu %-10u %-10u\n", ( 0 == iBucket ) ? 0UL : ( 1UL << ( iBucket + CYCLESTATS_BUCKET_SHIFT ) ),
+				(unsigned)pstLoop->auiBuckets[ iBucket ], (unsigned)pstFusion->auiBuckets[ iBucket ] );
+	}
+
+	printf( "\n" );
+
+	return;
+}
+
+/* ************************************************************************** */
+static int CompareU32( const void *pvA, const void *pvB )
+{
+	uint32_t uiA = *(const uint32_t*)pvA;
+	uint32_t uiB = *(const uint32_t*)pvB;
+
+	return ( uiA > uiB ) - ( uiA < uiB );
+}
+
+/* ************************************************************************** */
+static uint64_t NowNs( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return ( (uint64_t)stNow.tv_sec * 1000000000ULL ) + (uint64_t)stNow.tv_nsec;
+}
+
+/* ************************************************************************** */
+static void SleepUntilNs( const uint64_t uiWhen )
+{
+	struct timespec stWhen;
+
+	stWhen.tv_sec = (time_t)( uiWhen / 1000000000ULL );
+	stWhen.tv_nsec = (long)( uiWhen % 1000000000ULL );
+
+	while ( 0 != clock_nanosleep( CLOCK_MONOTONIC, TIMER_ABSTIME, &stWhen, NULL ) );
+
+	return;
+}
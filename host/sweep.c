@@ -0,0 +1,405 @@
+/* ************************************************************************** **
+ * Gain sweep: thousands of simulated flights across every core.
+ *
+ * Every combination of the values in the tables below (rate and angle PID
+ * gains, Kalman filter noise and loop rate, as the FIFO watermark) is flown
+ * through the same closed loop as sitl (flightsim.c), once per seed. Flights
+ * are shared out between worker threads, each with its own flight context,
+ * and the combinations are printed best first by attitude tracking error.
+ * Combinations that lost control on any seed go to the bottom.
+ *
+ * Usage: sweep [-q] [-j threads] [-t seconds] [-n seeds] [-k rows] [-o all.csv]
+ *   -q  fly the fixed point chain (flight_process_q)
+ *   -j  worker threads, one per online CPU by default
+ *   -n  seeds flown per combination, the errors are averaged over them
+ *   -k  rows of the ranking to print
+ *   -o  write every combination to a CSV file, in sweep order
+ *
+ * Build and run with "make sweep" from the top level, SWEEP_ARGS is passed on.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <stdio.h>			// printf & friends
+#include <stdlib.h>			// qsort & friends
+#include <math.h>			// sqrt & friends
+#include <time.h>			// clock_gettime
+#include <unistd.h>			// getopt, sysconf
+#include <pthread.h>		// pthread_create & friends
+
+#include "flightsim.h"		// Closed loop flight
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define DEFAULT_DURATION_S		( 24 )		// Two passes through the stick steps
+#define DEFAULT_SEEDS			( 1 )
+#define DEFAULT_ROWS			( 20 )
+#define MAX_THREADS				( 256 )
+
+#define ARRAY_LEN( a )			( sizeof( a ) / sizeof( ( a )[0] ) )
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+typedef struct
+{
+	stFLIGHTSIM_Config_t stConfig;
+
+	// Averaged over the seeds
+	float fTrackRms;
+	float fTrackMax;
+	float fEstRms;
+	uint32_t uiLost;
+
+} stSweepResult_t;
+
+typedef struct
+{
+	stSweepResult_t *pstResults;
+	uint32_t uiCount;
+	uint32_t uiSeeds;
+
+	pthread_mutex_t xLock;
+	uint32_t uiNext;
+	uint32_t uiDone;
+
+} stSweep_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static void MakeConfigs( stSweep_t *pstSweep, const stFLIGHTSIM_Config_t *pstBase );
+static void *Worker( void *pvSweep );
+static void Fly( stSweepResult_t *pstResult, const uint32_t uiSeeds );
+static void PrintHeader( void );
+static void PrintResult( const char *pcRank, const stSweepResult_t *pstResult );
+static float Score( const stSweepResult_t *pstResult );
+static int CompareResults( const void *pvA, const void *pvB );
+static double NowS( void );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+
+// The grid, edit to taste. The run time is the product of the lengths.
+static const float afRateP[] = { 0.04f, 0.06f, 0.08f, 0.10f, 0.12f };
+static const float afRateD[] = { 0.0f, 0.0005f, 0.001f, 0.002f };
+static const float afAngleP[] = { 3.0f, 4.0f, 6.0f, 8.0f };
+static const float afQAngle[] = { 0.0005f, 0.001f, 0.002f };
+static const float afQBias[] = { 0.001f, 0.003f };
+static const float afRMeasure[] = { 0.01f, 0.03f, 0.1f };
+static const uint32_t auiGyroPerLoop[] = { 2, 4, 8 };
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( int argc, char **argv )
+{
+	stFLIGHTSIM_Config_t stBase;
+	stSweepResult_t stDefault;
+	stSweep_t stSweep;
+	pthread_t axThreads[ MAX_THREADS ];
+	uint32_t uiThreads = (uint32_t)sysconf( _SC_NPROCESSORS_ONLN );
+	uint32_t uiRows = DEFAULT_ROWS;
+	uint32_t uiThread;
+	uint32_t uiResult;
+	double dStart_s;
+	FILE *pxCsv = NULL;
+	char acRank[ 16 ];
+	int iOpt;
+
+	FLIGHTSIM_DefaultConfig( &stBase );
+	stBase.fDuration_s = DEFAULT_DURATION_S;
+	stSweep.uiSeeds = DEFAULT_SEEDS;
+
+	while ( -1 != ( iOpt = getopt( argc, argv, "qj:t:n:k:o:" ) ) )
+	{
+		switch ( iOpt )
+		{
+			case 'q': stBase.bFixed = true; break;
+			case 'j': uiThreads = (uint32_t)strtoul( optarg, NULL, 0 ); break;
+			case 't': stBase.fDuration_s = strtof( optarg, NULL ); break;
+			case 'n': stSweep.uiSeeds = (uint32_t)strtoul( optarg, NULL, 0 ); break;
+			case 'k': uiRows = (uint32_t)strtoul( optarg, NULL, 0 ); break;
+			case 'o':
+				if ( NULL == ( pxCsv = fopen( optarg, "w" ) ) )
+				{
+					perror( optarg );
+					return 2;
+				}
+				break;
+			default:
+				fprintf( stderr, "usage: %s [-q] [-j threads] [-t seconds] [-n seeds] [-k rows] [-o all.csv]\n", argv[0] );
+				return 2;
+		}
+	}
+
+	uiThreads = ( 0 == uiThreads ) ? 1 : ( ( MAX_THREADS < uiThreads ) ? MAX_THREADS : uiThreads );
+	stSweep.uiSeeds = ( 0 == stSweep.uiSeeds ) ? 1 : stSweep.uiSeeds;
+
+	MakeConfigs( &stSweep, &stBase );
+
+	if ( NULL == stSweep.pstResults )
+	{
+		return 2;
+	}
+
+	// What the controller does out of the box, for reference
+	stDefault.stConfig = stBase;
+	Fly( &stDefault, stSweep.uiSeeds );
+
+	printf( "%s chain, %u combinations x %u seeds of %.0f s on %u threads\n",
+			stBase.bFixed ? "fixed point" : "float", (unsigned)stSweep.uiCount,
+			(unsigned)stSweep.uiSeeds, stBase.fDuration_s, (unsigned)uiThreads );
+
+	dStart_s = NowS();
+	pthread_mutex_init( &stSweep.xLock, NULL );
+	stSweep.uiNext = 0;
+	stSweep.uiDone = 0;
+
+	for ( uiThread = 0; uiThread < uiThreads; uiThread++ )
+	{
+		if ( 0 != pthread_create( &axThreads[ uiThread ], NULL, Worker, &stSweep ) )
+		{
+			perror( "pthread_create" );
+			return 2;
+		}
+	}
+
+	for ( uiThread = 0; uiThread < uiThreads; uiThread++ )
+	{
+		pthread_join( axThreads[ uiThread ], NULL );
+	}
+
+	pthread_mutex_destroy( &stSweep.xLock );
+
+	printf( "%.1f s, %.0f simulated flight seconds per second\n\n", NowS() - dStart_s,
+			( (double)stSweep.uiCount * stSweep.uiSeeds * stBase.fDuration_s ) / ( NowS() - dStart_s ) );
+
+	// The CSV keeps the sweep order so runs can be diffed
+	if ( NULL != pxCsv )
+	{
+		fprintf( pxCsv, "rate_p,rate_d,angle_p,q_angle,q_bias,r_measure,loop_ms,track_rms,track_max,est_rms,lost\n" );
+
+		for ( uiResult = 0; uiResult < stSweep.uiCount; uiResult++ )
+		{
+			const stSweepResult_t *pstResult = &stSweep.pstResults[ uiResult ];
+
+			fprintf( pxCsv, "%g,%g,%g,%g,%g,%g,%u,%.5f,%.5f,%.5f,%u\n",
+					 pstResult->stConfig.fRateP, pstResult->stConfig.fRateD, pstResult->stConfig.fAngleP,
+					 pstResult->stConfig.fQAngle, pstResult->stConfig.fQBias, pstResult->stConfig.fRMeasure,
+					 (unsigned)( ( pstResult->stConfig.uiGyroPerLoop * 1000 ) / FLIGHTSIM_GYRO_HZ ),
+					 pstResult->fTrackRms, pstResult->fTrackMax, pstResult->fEstRms, (unsigned)pstResult->uiLost );
+		}
+
+		fclose( pxCsv );
+	}
+
+	qsort( stSweep.pstResults, stSweep.uiCount, sizeof( stSweepResult_t ), CompareResults );
+
+	PrintHeader();
+	PrintResult( "default", &stDefault );
+
+	for ( uiResult = 0; ( uiResult < stSweep.uiCount ) && ( uiResult < uiRows ); uiResult++ )
+	{
+		snprintf( acRank, sizeof( acRank ), "%u", (unsigned)( uiResult + 1 ) );
+		PrintResult( acRank, &stSweep.pstResults[ uiResult ] );
+	}
+
+	free( stSweep.pstResults );
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static void MakeConfigs( stSweep_t *pstSweep, const stFLIGHTSIM_Config_t *pstBase )
+{
+	stFLIGHTSIM_Config_t *pstConfig;
+	uint32_t uiIndex;
+	uint32_t uiDigits;
+
+	pstSweep->uiCount = ARRAY_LEN( afRateP ) * ARRAY_LEN( afRateD ) * ARRAY_LEN( afAngleP )
+					  * ARRAY_LEN( afQAngle ) * ARRAY_LEN( afQBias ) * ARRAY_LEN( afRMeasure )
+					  * ARRAY_LEN( auiGyroPerLoop );
+	pstSweep->pstResults = calloc( pstSweep->uiCount, sizeof( stSweepResult_t ) );
+
+	if ( NULL == pstSweep->pstResults )
+	{
+		return;
+	}
+
+	// Each index is a mixed radix number, one digit per table, the last table
+	// varying fastest
+	for ( uiIndex = 0; uiIndex < pstSweep->uiCount; uiIndex++ )
+	{
+		pstConfig = &pstSweep->pstResults[ uiIndex ].stConfig;
+		*pstConfig = *pstBase;
+		uiDigits = uiIndex;
+
+		pstConfig->uiGyroPerLoop = auiGyroPerLoop[ uiDigits % ARRAY_LEN( auiGyroPerLoop ) ];
+		uiDigits /= ARRAY_LEN( auiGyroPerLoop );
+		pstConfig->fRMeasure = afRMeasure[ uiDigits % ARRAY_LEN( afRMeasure ) ];
+		uiDigits /= ARRAY_LEN( afRMeasure );
+		pstConfig->fQBias = afQBias[ uiDigits % ARRAY_LEN( afQBias ) ];
+		uiDigits /= ARRAY_LEN( afQBias );
+		pstConfig->fQAngle = afQAngle[ uiDigits % ARRAY_LEN( afQAngle ) ];
+		uiDigits /= ARRAY_LEN( afQAngle );
+		pstConfig->fAngleP = afAngleP[ uiDigits % ARRAY_LEN( afAngleP ) ];
+		uiDigits /= ARRAY_LEN( afAngleP );
+		pstConfig->fRateD = afRateD[ uiDigits % ARRAY_LEN( afRateD ) ];
+		uiDigits /= ARRAY_LEN( afRateD );
+		pstConfig->fRateP = afRateP[ uiDigits % ARRAY_LEN( afRateP ) ];
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void *Worker( void *pvSweep )
+{
+	stSweep_t *pstSweep = pvSweep;
+	uint32_t uiIndex;
+
+	for ( ;; )
+	{
+		// Take the next combination, the flights themselves share nothing
+		pthread_mutex_lock( &pstSweep->xLock );
+		uiIndex = pstSweep->uiNext++;
+		pthread_mutex_unlock( &pstSweep->xLock );
+
+		if ( uiIndex >= pstSweep->uiCount )
+		{
+			break;
+		}
+
+		Fly( &pstSweep->pstResults[ uiIndex ], pstSweep->uiSeeds );
+
+		pthread_mutex_lock( &pstSweep->xLock );
+
+		if ( 0 == ( ++pstSweep->uiDone % 100 ) )
+		{
+			fprintf( stderr, "\r%u / %u", (unsigned)pstSweep->uiDone, (unsigned)pstSweep->uiCount );
+		}
+
+		if ( pstSweep->uiDone == pstSweep->uiCount )
+		{
+			fprintf( stderr, "\r%20s\r", "" );
+		}
+
+		pthread_mutex_unlock( &pstSweep->xLock );
+	}
+
+	return NULL;
+}
+
+/* ************************************************************************** */
+static void Fly( stSweepResult_t *pstResult, const uint32_t uiSeeds )
+{
+	stFLIGHTSIM_Cxt_t stFlight;
+	stFLIGHTSIM_Config_t stConfig = pstResult->stConfig;
+	float fRoll;
+	float fPitch;
+	uint32_t uiSeed;
+
+	pstResult->fTrackRms = 0;
+	pstResult->fTrackMax = 0;
+	pstResult->fEstRms = 0;
+	pstResult->uiLost = 0;
+
+	for ( uiSeed = 1; uiSeed <= uiSeeds; uiSeed++ )
+	{
+		stConfig.uiSeed = uiSeed;
+		FLIGHTSIM_Setup( &stFlight, &stConfig );
+
+		while ( FLIGHTSIM_Advance( &stFlight ) )
+		{
+			FLIGHTSIM_Control( &stFlight );
+			FLIGHTSIM_Score( &stFlight );
+		}
+
+		// Roll and pitch together
+		fRoll = FLIGHTSIM_Rms( &stFlight.stTrackRoll );
+		fPitch = FLIGHTSIM_Rms( &stFlight.stTrackPitch );
+		pstResult->fTrackRms += sqrtf( ( ( fRoll * fRoll ) + ( fPitch * fPitch ) ) / 2 ) / uiSeeds;
+		pstResult->fTrackMax = fmaxf( pstResult->fTrackMax, fmaxf( stFlight.stTrackRoll.fMax, stFlight.stTrackPitch.fMax ) );
+
+		fRoll = FLIGHTSIM_Rms( &stFlight.stEstRoll );
+		fPitch = FLIGHTSIM_Rms( &stFlight.stEstPitch );
+		pstResult->fEstRms += sqrtf( ( ( fRoll * fRoll ) + ( fPitch * fPitch ) ) / 2 ) / uiSeeds;
+
+		if ( stFlight.bLost )
+		{
+			pstResult->uiLost++;
+		}
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void PrintHeader( void )
+{
+	printf( "%-8s %-8s %-8s %-8s %-8s %-8s %-8s %-8s %-10s %-10s %-10s %s\n",
+			"rank", "rate P", "rate D", "angle P", "Q angle", "Q bias", "R", "loop ms",
+			"track rms", "track max", "est rms", "lost" );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void PrintResult( const char *pcRank, const stSweepResult_t *pstResult )
+{
+	const stFLIGHTSIM_Config_t *pstConfig = &pstResult->stConfig;
+
+	printf( "%-8s %-8g %-8g %-8g %-8g %-8g %-8g %-8u %-10.4f %-10.4f %-10.4f %u\n",
+			pcRank, pstConfig->fRateP, pstConfig->fRateD, pstConfig->fAngleP,
+			pstConfig->fQAngle, pstConfig->fQBias, pstConfig->fRMeasure,
+			(unsigned)( ( pstConfig->uiGyroPerLoop * 1000 ) / FLIGHTSIM_GYRO_HZ ),
+			pstResult->fTrackRms, pstResult->fTrackMax, pstResult->fEstRms, (unsigned)pstResult->uiLost );
+
+	return;
+}
+
+/* ************************************************************************** */
+static float Score( const stSweepResult_t *pstResult )
+{
+	// A flight that lost control only scores until it crashed, so it can't be
+	// compared with the others
+	return ( 0 != pstResult->uiLost ) ? INFINITY : pstResult->fTrackRms;
+}
+
+/* ************************************************************************** */
+static int CompareResults( const void *pvA, const void *pvB )
+{
+	float fA = Score( pvA );
+	float fB = Score( pvB );
+
+	if ( isinf( fA ) && isinf( fB ) )
+	{
+		// Both lost, the one that crashed less often first
+		return (int)( (const stSweepResult_t*)pvA )->uiLost - (int)( (const stSweepResult_t*)pvB )->uiLost;
+	}
+
+	return ( fA > fB ) - ( fA < fB );
+}
+
+/* ************************************************************************** */
+static double NowS( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return stNow.tv_sec + ( stNow.tv_nsec / 1e9 );
+}
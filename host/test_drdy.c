@@ -0,0 +1,310 @@
+/* ************************************************************************** **
+ * Host check of the data ready gate (drdy.c) against a model of the gyro's
+ * FIFO and its DRDY_G line. The FIFO fills at 760Hz with the watermark at one
+ * sample, so the line stays high whenever anything is queued.
+ *
+ * A millisecond at a time the FIFO is moved on and every rising edge of
+ * DRDY_G is signalled, as the pin interrupt would be. A model of the flight
+ * task is woken through DRDY_Signal, drains the FIFO as the sensor read does,
+ * ticks and calls DRDY_Complete. Each case upsets one tick:
+ *   - the task overruns, so the next edge comes while it is busy
+ *   - a sample lands during the read, so the line never falls
+ *   - the read hangs, so only the task's timeout brings it back
+ * With the watermark held the line stays high and there is no edge to come,
+ * so the next read must start as soon as the task is ready, well within a
+ * tick, rather than when the timeout goes. No other timeouts are allowed and
+ * the FIFO must be drained at the end.
+ *
+ * Build and run with "make test-drdy" from the top level.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stdio.h>			// printf & friends
+
+#include "drdy.h"			// Data ready gate
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define FIFO_ODR_HZ			( 760 )
+#define FIFO_DEPTH			( 32 )
+#define FIFO_WATERMARK		( 1 )
+
+#define WAKE_TIMEOUT_MS		( 5 )
+#define RUN_MS				( 200 )
+#define EVENT_TICK			( 50 )
+#define MIN_TICKS			( 130 )			// 760Hz is 152 in RUN_MS, less the upset
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+typedef struct
+{
+	const char *pcName;
+	bool bLevel;			// DRDY_Complete can see the line, or only the edges
+	uint32_t uiBusyMs;		// The event tick runs this long
+	bool bLandMidRead;		// A sample arrives after the event read's count
+	bool bHang;				// The event read never finishes
+	uint32_t uiTimeouts;	// Expected
+
+} stCase_t;
+
+// The flight task's side
+typedef struct
+{
+	bool bNotified;			// The read it was woken for has finished
+	bool bBusy;
+	uint32_t uiBusyUntilMs;
+	uint32_t uiWaitFromMs;
+
+	uint32_t uiTicks;
+	uint32_t uiReads;
+	uint32_t uiTimeouts;
+
+	// From the first DRDY_Complete after the upset to the read it starts
+	bool bWatch;
+	bool bAwait;
+	uint32_t uiReadyMs;
+	int32_t iLatencyMs;
+
+} stTask_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static bool RunCase( const stCase_t *pstCase );
+static void RunTask( void );
+static void AdvanceFifo( void );
+static void UpdatePin( void );
+static void Wake( void *const pvUserState );
+static bool Level( void *const pvUserState );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static const stCase_t astCases[] =
+{
+	{ "overrun",			true,	3,	false,	false,	0 },
+	{ "overrun, edges",		false,	3,	false,	false,	0 },
+	{ "late sample",		true,	0,	true,	false,	0 },
+	{ "hung read",			true,	0,	false,	true,	1 },
+	{ "hung read, edges",	false,	0,	false,	true,	1 },
+};
+
+static const stCase_t *pstRunning;
+static stDRDY_Ctx_t stDrdy;
+static stTask_t stTask;
+static uint32_t uiNowMs;
+static bool bPin;
+
+// The gyro FIFO, only its level matters here
+static uint32_t uiFifoCount;
+static uint32_t uiFifoPhase;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( void )
+{
+	size_t sIndex;
+	bool bPass = true;
+
+	printf( "%-18s %-7s %-7s %-9s %-9s %-8s %s\n", "case", "ticks", "reads", "overruns", "timeouts", "latency", "result" );
+
+	for ( sIndex = 0; sIndex < ( sizeof( astCases ) / sizeof( astCases[0] ) ); sIndex++ )
+	{
+		bPass = RunCase( &astCases[ sIndex ] ) && bPass;
+	}
+
+	if ( !bPass )
+	{
+		printf( "\nFAIL: the flight loop waited on a data ready edge that never came\n" );
+		return 1;
+	}
+
+	printf( "\nPASS\n" );
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static bool RunCase( const stCase_t *pstCase )
+{
+	stTask_t stZero = { 0 };
+	bool bOk;
+
+	pstRunning = pstCase;
+	stTask = stZero;
+	stTask.iLatencyMs = -1;
+	uiNowMs = 0;
+	bPin = false;
+	uiFifoCount = 0;
+	uiFifoPhase = 0;
+
+	DRDY_Create( &stDrdy, Wake, pstCase->bLevel ? Level : NULL, NULL );
+
+	// As the flight task starts, the first read without waiting for an edge
+	DRDY_Signal( &stDrdy );
+
+	while ( RUN_MS > uiNowMs )
+	{
+		uiNowMs++;
+		AdvanceFifo();
+		UpdatePin();
+		RunTask();
+	}
+
+	bOk = ( 0 == stTask.iLatencyMs ) && ( pstCase->uiTimeouts == stTask.uiTimeouts )
+		  && ( MIN_TICKS <= stTask.uiTicks ) && ( 1 >= uiFifoCount );
+
+	printf( "%-18s %-7u %-7u %-9u %-9u %-8d %s\n", pstCase->pcName, (unsigned)stTask.uiTicks,
+			(unsigned)stTask.uiReads, (unsigned)stDrdy.uiOverrunCount, (unsigned)stTask.uiTimeouts,
+			(int)stTask.iLatencyMs, bOk ? "ok" : "FAILED" );
+
+	return bOk;
+}
+
+/* ************************************************************************** */
+static void RunTask( void )
+{
+	for ( ; ; )
+	{
+		if ( stTask.bBusy )
+		{
+			if ( uiNowMs < stTask.uiBusyUntilMs )
+			{
+				return;
+			}
+
+			if ( stTask.bWatch )
+			{
+				stTask.bWatch = false;
+				stTask.bAwait = true;
+				stTask.uiReadyMs = uiNowMs;
+			}
+
+			// Masked on target, nothing else runs here
+			stTask.bBusy = false;
+			stTask.uiWaitFromMs = uiNowMs;
+			DRDY_Complete( &stDrdy );
+		}
+
+		if ( stTask.bNotified )
+		{
+			stTask.bNotified = false;
+			stTask.uiTicks++;
+			stTask.bBusy = true;
+			stTask.uiBusyUntilMs = uiNowMs;
+
+			if ( EVENT_TICK == stTask.uiTicks )
+			{
+				stTask.uiBusyUntilMs += pstRunning->uiBusyMs;
+				stTask.bWatch = stTask.bWatch || ( 0 != pstRunning->uiBusyMs );
+			}
+		}
+		else if ( ( uiNowMs - stTask.uiWaitFromMs ) >= WAKE_TIMEOUT_MS )
+		{
+			// The read is given up on as i2c_abort would, and signalled so
+			// that DRDY_Complete starts the next one
+			stTask.uiTimeouts++;
+			DRDY_Signal( &stDrdy );
+			stTask.bBusy = true;
+			stTask.uiBusyUntilMs = uiNowMs;
+		}
+		else
+		{
+			return;
+		}
+	}
+}
+
+/* ************************************************************************** */
+static void AdvanceFifo( void )
+{
+	uint32_t uiDue;
+
+	// Stream mode, a full FIFO drops its oldest sample
+	uiFifoPhase += FIFO_ODR_HZ;
+	uiDue = uiFifoPhase / 1000;
+	uiFifoPhase -= uiDue * 1000;
+	uiFifoCount += uiDue;
+
+	if ( FIFO_DEPTH < uiFifoCount )
+	{
+		uiFifoCount = FIFO_DEPTH;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void UpdatePin( void )
+{
+	bool bLevel = Level( NULL );
+	bool bRising = bLevel && !bPin;
+
+	// The pin interrupt is on the rising edge only, and the read it starts
+	// moves the pin on before we get back here
+	bPin = bLevel;
+
+	if ( bRising )
+	{
+		DRDY_Signal( &stDrdy );
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void Wake( void *const pvUserState )
+{
+	uint32_t uiCount;
+	bool bEvent;
+
+	stTask.uiReads++;
+	bEvent = ( EVENT_TICK == stTask.uiReads );
+
+	if ( stTask.bAwait )
+	{
+		stTask.bAwait = false;
+		stTask.iLatencyMs = (int32_t)( uiNowMs - stTask.uiReadyMs );
+	}
+
+	if ( bEvent && pstRunning->bHang )
+	{
+		stTask.bWatch = true;
+		return;
+	}
+
+	// The count first, then exactly that many samples as the sensor jobs do
+	uiCount = uiFifoCount;
+
+	if ( bEvent && pstRunning->bLandMidRead )
+	{
+		uiFifoCount++;
+		stTask.bWatch = true;
+	}
+
+	uiFifoCount -= uiCount;
+
+	UpdatePin();
+	stTask.bNotified = true;
+
+	return;
+}
+
+/* ************************************************************************** */
+static bool Level( void *const pvUserState )
+{
+	return ( FIFO_WATERMARK <= uiFifoCount );
+}
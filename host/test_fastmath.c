@@ -0,0 +1,283 @@
+/* ************************************************************************** **
+ * Host check of the error bounds in fastmath.h and fixmath.h.
+ *
+ * Every approximation is run over every input in its reduced range and
+ * compared with the double precision libm result:
+ *   atan2		every float ratio in [0, 1] either side of the diagonal, which
+ *   			is all the polynomial sees, and every 256th of them in all
+ *   			eight octants for the folding
+ *   asin		every float in [-1, 1]
+ *   sqrt		every float in [1, 4), the relative error repeats with each
+ *   invsqrt	even power of two, and every 64th float over the normal range
+ *   Q16		every Q16 input, in [-1, 1] for asin and the atan2 ratio
+ *
+ * The worst error found is printed against the bound in the header and the
+ * run fails if any is over. It takes a few minutes on one core.
+ *
+ * Build and run with "make test-fastmath" from the top level.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stdio.h>			// printf & friends
+#include <string.h>			// memcpy
+#include <float.h>			// FLT_MIN & friends
+#include <math.h>			// atan2 & friends
+
+#include "fastmath.h"		// Float approximations
+#include "fixmath.h"		// Fixed point arithmetic
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define PI						( 3.14159265358979 )
+#define Q16_LSB					( 1.0 / 65536.0 )
+
+#define OCTANT_STRIDE			( 256 )		// Floats per ratio checked in every octant
+#define NORMAL_STRIDE			( 64 )		// Floats per value checked over the normal range
+#define PAIRS					( 1u << 24 )	// Random Q16 atan2 inputs
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+
+// The worst of one check
+typedef struct
+{
+	double dMaxErr;
+	double dAt;
+	uint64_t uiCount;
+
+} stResult_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static bool Report( const char *pcName, const stResult_t *pstResult, const double dBound, const char *pcUnit );
+static void Record( stResult_t *pstResult, const double dErr, const double dAt );
+static double AngleErr( const double dGot, const double dWant );
+static uint32_t FloatBits( const float f );
+static float BitsFloat( const uint32_t uiBits );
+static int32_t Random( void );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static uint32_t uiRandomState = 1;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( void )
+{
+	stResult_t stResult;
+	uint32_t uiBits;
+	uint32_t uiOctant;
+	uint32_t uiPair;
+	int64_t iQ;
+	float fX;
+	float fY;
+	q16_t qY;
+	q16_t qX;
+	bool bPass = true;
+
+	printf( "%-26s %-12s %-12s %-12s %-14s\n", "", "inputs", "max error", "bound", "at" );
+
+	// Float atan2, the ratio in [0, 1] below the diagonal and above it
+	memset( &stResult, 0, sizeof( stResult ) );
+	for ( uiBits = 0; uiBits <= FloatBits( 1.0f ); uiBits++ )
+	{
+		fX = BitsFloat( uiBits );
+		Record( &stResult, AngleErr( FASTMATH_Atan2( fX, 1.0f ), atan2( fX, 1.0 ) ), fX );
+		Record( &stResult, AngleErr( FASTMATH_Atan2( 1.0f, fX ), atan2( 1.0, fX ) ), fX );
+	}
+	bPass &= Report( "atan2 ratio", &stResult, FASTMATH_ATAN2_MAX_ERR, "rad" );
+
+	memset( &stResult, 0, sizeof( stResult ) );
+	for ( uiBits = 0; uiBits <= FloatBits( 1.0f ); uiBits += OCTANT_STRIDE )
+	{
+		for ( uiOctant = 0; uiOctant < 8; uiOctant++ )
+		{
+			fY = ( uiOctant & 1 ) ? -BitsFloat( uiBits ) : BitsFloat( uiBits );
+			fX = ( uiOctant & 2 ) ? -1.0f : 1.0f;
+
+			if ( uiOctant & 4 )
+			{
+				Record( &stResult, AngleErr( FASTMATH_Atan2( fX, fY ), atan2( fX, fY ) ), fY );
+			}
+			else
+			{
+				Record( &stResult, AngleErr( FASTMATH_Atan2( fY, fX ), atan2( fY, fX ) ), fY );
+			}
+		}
+	}
+	bPass &= Report( "atan2 octants", &stResult, FASTMATH_ATAN2_MAX_ERR, "rad" );
+
+	// Float asin, both signs
+	memset( &stResult, 0, sizeof( stResult ) );
+	for ( uiBits = 0; uiBits <= FloatBits( 1.0f ); uiBits++ )
+	{
+		fX = BitsFloat( uiBits );
+		Record( &stResult, fabs( FASTMATH_Asin( fX ) - asin( fX ) ), fX );
+		Record( &stResult, fabs( FASTMATH_Asin( -fX ) + asin( fX ) ), -fX );
+	}
+	bPass &= Report( "asin", &stResult, FASTMATH_ASIN_MAX_ERR, "rad" );
+
+	// Float square roots, relative
+	memset( &stResult, 0, sizeof( stResult ) );
+	for ( uiBits = FloatBits( 1.0f ); uiBits < FloatBits( 4.0f ); uiBits++ )
+	{
+		fX = BitsFloat( uiBits );
+		Record( &stResult, fabs( FASTMATH_Sqrt( fX ) / sqrt( fX ) - 1.0 ), fX );
+	}
+	for ( uiBits = FloatBits( FLT_MIN ); uiBits <= FloatBits( FLT_MAX ) - NORMAL_STRIDE; uiBits += NORMAL_STRIDE )
+	{
+		fX = BitsFloat( uiBits );
+		Record( &stResult, fabs( FASTMATH_Sqrt( fX ) / sqrt( fX ) - 1.0 ), fX );
+	}
+	bPass &= Report( "sqrt", &stResult, FASTMATH_SQRT_MAX_REL_ERR, "relative" );
+
+	memset( &stResult, 0, sizeof( stResult ) );
+	for ( uiBits = FloatBits( 1.0f ); uiBits < FloatBits( 4.0f ); uiBits++ )
+	{
+		fX = BitsFloat( uiBits );
+		Record( &stResult, fabs( FASTMATH_InvSqrt( fX ) * sqrt( fX ) - 1.0 ), fX );
+	}
+	for ( uiBits = FloatBits( FLT_MIN ); uiBits <= FloatBits( FLT_MAX ) - NORMAL_STRIDE; uiBits += NORMAL_STRIDE )
+	{
+		fX = BitsFloat( uiBits );
+		Record( &stResult, fabs( FASTMATH_InvSqrt( fX ) * sqrt( fX ) - 1.0 ), fX );
+	}
+	bPass &= Report( "invsqrt", &stResult, FASTMATH_INVSQRT_MAX_REL_ERR, "relative" );
+
+	// Q16 atan2, every ratio in every octant, then random pairs for the divide
+	memset( &stResult, 0, sizeof( stResult ) );
+	for ( qY = 0; qY <= FIXMATH_Q16_ONE; qY++ )
+	{
+		for ( uiOctant = 0; uiOctant < 8; uiOctant++ )
+		{
+			iQ = ( uiOctant & 1 ) ? -qY : qY;
+			qX = ( uiOctant & 2 ) ? -FIXMATH_Q16_ONE : FIXMATH_Q16_ONE;
+
+			if ( uiOctant & 4 )
+			{
+				Record( &stResult, AngleErr( FIXMATH_Atan2( qX, iQ ) * Q16_LSB, atan2( qX, iQ ) ), iQ * Q16_LSB );
+			}
+			else
+			{
+				Record( &stResult, AngleErr( FIXMATH_Atan2( iQ, qX ) * Q16_LSB, atan2( iQ, qX ) ), iQ * Q16_LSB );
+			}
+		}
+	}
+	for ( uiPair = 0; uiPair < PAIRS; uiPair++ )
+	{
+		qY = Random();
+		qX = Random();
+		Record( &stResult, AngleErr( FIXMATH_Atan2( qY, qX ) * Q16_LSB, atan2( qY, qX ) ), qY * Q16_LSB );
+	}
+	bPass &= Report( "Q16 atan2", &stResult, FIXMATH_ATAN2_MAX_ERR * Q16_LSB, "rad" );
+
+	memset( &stResult, 0, sizeof( stResult ) );
+	for ( iQ = -FIXMATH_Q16_ONE; iQ <= FIXMATH_Q16_ONE; iQ++ )
+	{
+		Record( &stResult, fabs( FIXMATH_Asin( (q16_t)iQ ) * Q16_LSB - asin( iQ * Q16_LSB ) ), iQ * Q16_LSB );
+	}
+	bPass &= Report( "Q16 asin", &stResult, FIXMATH_ASIN_MAX_ERR * Q16_LSB, "rad" );
+
+	memset( &stResult, 0, sizeof( stResult ) );
+	for ( iQ = 0; iQ <= INT32_MAX; iQ++ )
+	{
+		Record( &stResult, fabs( FIXMATH_Sqrt( (q16_t)iQ ) - sqrt( iQ * 65536.0 ) ), iQ * Q16_LSB );
+	}
+	bPass &= Report( "Q16 sqrt", &stResult, FIXMATH_SQRT_MAX_ERR, "LSB" );
+
+	memset( &stResult, 0, sizeof( stResult ) );
+	for ( iQ = 1; iQ <= INT32_MAX; iQ++ )
+	{
+		Record( &stResult, fabs( FIXMATH_InvSqrt( (q16_t)iQ ) - ( 65536.0 * 256.0 ) / sqrt( (double)iQ ) ), iQ * Q16_LSB );
+	}
+	bPass &= Report( "Q16 invsqrt", &stResult, FIXMATH_INVSQRT_MAX_ERR, "LSB" );
+
+	if ( !bPass )
+	{
+		printf( "\nFAIL: an approximation is outside its bound\n" );
+		return 1;
+	}
+
+	printf( "\nPASS\n" );
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static bool Report( const char *pcName, const stResult_t *pstResult, const double dBound, const char *pcUnit )
+{
+	char acName[40];
+	bool bPass = ( pstResult->dMaxErr <= dBound );
+
+	snprintf( acName, sizeof( acName ), "%s (%s)", pcName, pcUnit );
+	printf( "%-26s %-12llu %-12.3g %-12.3g %-14.9g%s\n", acName, (unsigned long long)pstResult->uiCount,
+			pstResult->dMaxErr, dBound, pstResult->dAt, bPass ? "" : "  over" );
+
+	return bPass;
+}
+
+/* ************************************************************************** */
+static void Record( stResult_t *pstResult, const double dErr, const double dAt )
+{
+	// A NaN fails the comparison and is kept as an infinite error
+	if ( !( dErr <= pstResult->dMaxErr ) )
+	{
+		pstResult->dMaxErr = ( dErr == dErr ) ? dErr : INFINITY;
+		pstResult->dAt = dAt;
+	}
+
+	pstResult->uiCount++;
+
+	return;
+}
+
+/* ************************************************************************** */
+static double AngleErr( const double dGot, const double dWant )
+{
+	// +pi and -pi are the same angle, atan2 of -0 picks the other one
+	return fabs( remainder( dGot - dWant, 2 * PI ) );
+}
+
+/* ************************************************************************** */
+static uint32_t FloatBits( const float f )
+{
+	uint32_t uiBits;
+
+	memcpy( &uiBits, &f, sizeof( uiBits ) );
+
+	return uiBits;
+}
+
+/* ************************************************************************** */
+static float BitsFloat( const uint32_t uiBits )
+{
+	float f;
+
+	memcpy( &f, &uiBits, sizeof( f ) );
+
+	return f;
+}
+
+/* ************************************************************************** */
+static int32_t Random( void )
+{
+	// Repeatable, uniform over +-32 in Q16
+	uiRandomState = ( uiRandomState * 1103515245u ) + 12345u;
+
+	return (int32_t)( uiRandomState >> 10 ) - ( 1 << 21 );
+}
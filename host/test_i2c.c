@@ -0,0 +1,562 @@
+/* ************************************************************************** **
+ * Host check of the I2C interrupt's job lists (i2c_send_jobs) against a model
+ * of the K20's I2C module and two devices on the bus.
+ *
+ * i2c.c is built in here with its register block moved to memory, and the
+ * little of FreeRTOS it links against is stubbed out below. After the driver
+ * starts a list, or returns from its interrupt, the model does what the
+ * hardware would do with the control register and data register as they
+ * stand: sends a START, repeated start, byte or STOP, has the addressed
+ * device ACK or NAK a byte or supply one, then raises the interrupt again.
+ * Every bus condition, each job's done_fn and the list's callback are logged
+ * in the order they happen and checked against what each case expects:
+ *   - jobs go out in order, joined by repeated starts, with one STOP at the
+ *     end and the callback after it
+ *   - each done_fn runs once, as soon as its job is done and before the next
+ *     one starts, and a length it sets takes effect, 0 skipping the job
+ *   - a NAK part way down the list stops the bus at once, reports I2C_ERROR
+ *     through the callback and runs nothing after it
+ *   - i2c_abort part way down the list stops the bus without the callback
+ *     and leaves the channel ready for the next list
+ *
+ * Build and run with "make test-i2c" from the top level.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stdio.h>			// printf & friends
+#include <string.h>			// strcat & friends
+
+// The driver under test, on a register block of our own and without the
+// Cortex-M interrupt masking. common.h first so i2c.c's copy is a no-op and
+// these stand.
+#include "common.h"			// Chip definitions
+
+static struct I2C_MemMap stRegs;
+
+#undef I2C_BASE_PTRS
+#define I2C_BASE_PTRS		{ &stRegs }
+#undef EnableInterrupts
+#define EnableInterrupts
+#undef DisableInterrupts
+#define DisableInterrupts
+
+#include "../i2c.c"			// I2C driver
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define DEV_G				( 0x6B )
+#define DEV_XM				( 0x1D )
+#define DEV_ABSENT			( 0x50 )
+#define REG_READ_ONLY		( 0x0F )		// WHO_AM_I, a write to it is NAKed
+#define REG_COUNT			( 0x2F )		// Holds how many bytes job B reads
+#define AUTO_INCREMENT		( 0x80 )
+#define NUM_REGS			( 128 )
+
+#define LOG_LEN				( 512 )
+#define MAX_READS			( 8 )
+#define MAX_IRQS			( 200 )
+#define mArrayLen( x )		( sizeof( x ) / sizeof( x[0] ) )
+
+// The start of a sequence reading from reg on, the I2C_READs follow
+#define mReadSeq( dev, reg )	( ( dev ) << 1 ) | I2C_WRITING, ( reg ), I2C_RESTART, ( ( dev ) << 1 ) | I2C_READING
+#define READ_SEQ_HEADER		( 4 )
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+
+// The device end of the bus
+typedef struct
+{
+	bool bActive;			// Between a START and a STOP
+	bool bAddressNext;		// The next byte written is an address
+	int iDevice;			// Index into auiDeviceRegs, -1 if none answered
+	bool bRegSet;			// The register has been written since the address
+	bool bAutoIncrement;
+	uint8_t uiReg;
+
+} stBus_t;
+
+typedef struct
+{
+	const char *pcName;
+	uint8_t uiCount;		// In REG_COUNT, what job A's done_fn sizes job B by
+	uint8_t uiDeviceB;		// Job B's device, DEV_ABSENT for a NAK on its address
+	bool bWriteA;			// Job A writes uiWriteReg rather than reading the count
+	uint8_t uiWriteReg;
+	uint32_t uiAbortAfter;	// Interrupts before i2c_abort and a fresh start, 0 for none
+	const char *pcExpected;
+	uint8_t uiStatus;		// At the end
+
+} stCase_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static bool RunCase( const stCase_t *pstCase );
+static uint32_t RunBus( const uint32_t uiMaxIrqs );
+static bool BusStopped( void );
+static bool BusWrite( const uint8_t uiByte );
+static uint8_t BusRead( void );
+static int DeviceIndex( const uint8_t uiAddress );
+static uint8_t RegValue( const int iDevice, const uint8_t uiReg );
+static void Log( const char *pcEvent );
+static void DoneA( I2C_Job *pstJob );
+static void DoneB( I2C_Job *pstJob );
+static void DoneC( I2C_Job *pstJob );
+static void ListDone( void *pvUserState );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static const stCase_t astCases[] =
+{
+	{
+		"three jobs", 3, DEV_G, false, 0, 0,
+		"S D6 2F Sr D7 r~ A Sr D6 A8 Sr D7 r r r~ B Sr 3A 85 Sr 3B r r~ C P cb",
+		I2C_AVAILABLE
+	},
+	{
+		"one byte for B", 1, DEV_G, false, 0, 0,
+		"S D6 2F Sr D7 r~ A Sr D6 A8 Sr D7 r~ B Sr 3A 85 Sr 3B r r~ C P cb",
+		I2C_AVAILABLE
+	},
+	{
+		"B skipped", 0, DEV_G, false, 0, 0,
+		"S D6 2F Sr D7 r~ A Sr 3A 85 Sr 3B r r~ C P cb",
+		I2C_AVAILABLE
+	},
+	{
+		"write then read", 2, DEV_G, true, 0x20, 0,
+		"S D6 20 CF A Sr D6 A8 Sr D7 r r~ B Sr 3A 85 Sr 3B r r~ C P cb",
+		I2C_AVAILABLE
+	},
+	{
+		"NAK on address", 3, DEV_ABSENT, false, 0, 0,
+		"S D6 2F Sr D7 r~ A Sr A0! P cb",
+		I2C_ERROR
+	},
+	{
+		"NAK on last write", 2, DEV_G, true, REG_READ_ONLY, 0,
+		"S D6 0F CF! P cb",
+		I2C_ERROR
+	},
+	{
+		"abort in B", 3, DEV_G, false, 0, 6,
+		"S D6 2F Sr D7 r~ A Sr D6 A8 P "
+		"S D6 2F Sr D7 r~ A Sr D6 A8 Sr D7 r r r~ B Sr 3A 85 Sr 3B r r~ C P cb",
+		I2C_AVAILABLE
+	},
+};
+
+static stBus_t stBus;
+static uint8_t auiDeviceRegs[2][ NUM_REGS ];
+static char acLog[ LOG_LEN ];
+static uint32_t uiCallbacks;
+
+// Job A reads the count or writes a register, B reads the count's worth from
+// the same device and C reads two from the other. Sized for the longest.
+static uint16_t auiSeqA[ READ_SEQ_HEADER + 1 ];
+static uint16_t auiSeqB[ READ_SEQ_HEADER + MAX_READS ];
+static uint16_t auiSeqC[ READ_SEQ_HEADER + 2 ];
+static uint8_t auiDataA[1];
+static uint8_t auiDataB[ MAX_READS ];
+static uint8_t auiDataC[2];
+static I2C_Job astJobs[3];
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( void )
+{
+	size_t sIndex;
+	bool bPass = true;
+
+	for ( sIndex = 0; sIndex < ( sizeof( astCases ) / sizeof( astCases[0] ) ); sIndex++ )
+	{
+		bPass = RunCase( &astCases[ sIndex ] ) && bPass;
+	}
+
+	if ( !bPass )
+	{
+		printf( "\nFAIL: a job list did not go out as it should\n" );
+		return 1;
+	}
+
+	printf( "\nPASS\n" );
+
+	return 0;
+}
+
+/* ************************************************************************** */
+QueueHandle_t xQueueGenericCreate( const UBaseType_t uxQueueLength, const UBaseType_t uxItemSize, const uint8_t ucQueueType )
+{
+	// Only the blocking transfers use the semaphore, and no case here does
+	return NULL;
+}
+
+/* ************************************************************************** */
+BaseType_t xQueueGenericReceive( QueueHandle_t xQueue, void * const pvBuffer, TickType_t xTicksToWait, const BaseType_t xJustPeek )
+{
+	return pdFALSE;
+}
+
+/* ************************************************************************** */
+BaseType_t xQueueGiveFromISR( QueueHandle_t xQueue, BaseType_t * const pxHigherPriorityTaskWoken )
+{
+	return pdTRUE;
+}
+
+/* ************************************************************************** */
+void vPortEnterCritical( void )
+{
+	// Single threaded, and the interrupt only runs when the model raises it
+	return;
+}
+
+/* ************************************************************************** */
+void vPortExitCritical( void )
+{
+	return;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static bool RunCase( const stCase_t *pstCase )
+{
+	const uint16_t auiReadA[] = { mReadSeq( DEV_G, REG_COUNT ), I2C_READ };
+	const uint16_t auiReadB[] = { mReadSeq( pstCase->uiDeviceB, 0x28 | AUTO_INCREMENT ) };
+	const uint16_t auiReadC[] = { mReadSeq( DEV_XM, 0x05 | AUTO_INCREMENT ), I2C_READ, I2C_READ };
+	const uint16_t auiWriteA[] = { ( DEV_G << 1 ) | I2C_WRITING, pstCase->uiWriteReg, 0xCF };
+	I2C_Stats stBefore;
+	I2C_Stats stAfter;
+	uint32_t uiIndex;
+	bool bOk;
+
+	memset( &stRegs, 0, sizeof( stRegs ) );
+	memset( &stBus, 0, sizeof( stBus ) );
+	memset( auiDataA, 0, sizeof( auiDataA ) );
+	memset( auiDataB, 0, sizeof( auiDataB ) );
+	memset( auiDataC, 0, sizeof( auiDataC ) );
+	memset( astJobs, 0, sizeof( astJobs ) );
+	acLog[0] = '\0';
+	uiCallbacks = 0;
+
+	for ( uiIndex = 0; uiIndex < NUM_REGS; uiIndex++ )
+	{
+		auiDeviceRegs[0][ uiIndex ] = RegValue( 0, (uint8_t)uiIndex );
+		auiDeviceRegs[1][ uiIndex ] = RegValue( 1, (uint8_t)uiIndex );
+	}
+
+	auiDeviceRegs[0][ REG_COUNT ] = pstCase->uiCount;
+
+	// The reads for B are filled in up front, A's done_fn says how many to do
+	memcpy( auiSeqB, auiReadB, sizeof( auiReadB ) );
+
+	for ( uiIndex = READ_SEQ_HEADER; uiIndex < ( READ_SEQ_HEADER + MAX_READS ); uiIndex++ )
+	{
+		auiSeqB[ uiIndex ] = I2C_READ;
+	}
+
+	memcpy( auiSeqC, auiReadC, sizeof( auiReadC ) );
+
+	if ( pstCase->bWriteA )
+	{
+		memcpy( auiSeqA, auiWriteA, sizeof( auiWriteA ) );
+		astJobs[0].sequence_length = mArrayLen( auiWriteA );
+	}
+	else
+	{
+		memcpy( auiSeqA, auiReadA, sizeof( auiReadA ) );
+		astJobs[0].sequence_length = mArrayLen( auiReadA );
+	}
+
+	astJobs[0].sequence = auiSeqA;
+	astJobs[0].received_data = auiDataA;
+	astJobs[0].done_fn = DoneA;
+	astJobs[0].user_data = &astJobs[1];
+	astJobs[1].sequence = auiSeqB;
+	astJobs[1].sequence_length = READ_SEQ_HEADER + MAX_READS;
+	astJobs[1].received_data = auiDataB;
+	astJobs[1].done_fn = DoneB;
+	astJobs[2].sequence = auiSeqC;
+	astJobs[2].sequence_length = mArrayLen( auiReadC );
+	astJobs[2].received_data = auiDataC;
+	astJobs[2].done_fn = DoneC;
+
+	i2c_get_stats( 0, &stBefore );
+
+	bOk = ( 0 == i2c_send_jobs( 0, astJobs, mArrayLen( astJobs ), ListDone, &astJobs[0] ) );
+
+	if ( 0 != pstCase->uiAbortAfter )
+	{
+		// Stopped without the callback, then the list again from the top
+		bOk = ( pstCase->uiAbortAfter == RunBus( pstCase->uiAbortAfter ) ) && bOk;
+		i2c_abort( 0 );
+		bOk = BusStopped() && ( 0 == uiCallbacks ) && ( I2C_ERROR == i2c_channels[0].status ) && bOk;
+
+		i2c_get_stats( 0, &stBefore );
+		bOk = ( 0 == i2c_send_jobs( 0, astJobs, mArrayLen( astJobs ), ListDone, &astJobs[0] ) ) && bOk;
+	}
+
+	bOk = ( MAX_IRQS > RunBus( MAX_IRQS ) ) && bOk;
+
+	i2c_get_stats( 0, &stAfter );
+
+	bOk = bOk && ( 0 == strcmp( pstCase->pcExpected, acLog ) ) && ( pstCase->uiStatus == i2c_channels[0].status );
+
+	// The callback once for the list, and a transfer or an error counted to
+	// match
+	bOk = bOk && ( 1 == uiCallbacks );
+	bOk = bOk && ( ( I2C_AVAILABLE == pstCase->uiStatus )
+				   ? ( ( stBefore.transfers + 1 ) == stAfter.transfers )
+				   : ( ( stBefore.errors + 1 ) == stAfter.errors ) );
+
+	// The reads landed in their own job's buffer
+	if ( I2C_AVAILABLE == pstCase->uiStatus )
+	{
+		for ( uiIndex = 0; uiIndex < pstCase->uiCount; uiIndex++ )
+		{
+			bOk = bOk && ( RegValue( 0, 0x28 + uiIndex ) == auiDataB[ uiIndex ] );
+		}
+
+		bOk = bOk && ( RegValue( 1, 0x05 ) == auiDataC[0] ) && ( RegValue( 1, 0x06 ) == auiDataC[1] );
+		bOk = bOk && ( pstCase->bWriteA ? ( 0xCF == auiDeviceRegs[0][ pstCase->uiWriteReg ] )
+										: ( pstCase->uiCount == auiDataA[0] ) );
+	}
+
+	printf( "%-18s %s\n", pstCase->pcName, bOk ? "ok" : "FAILED" );
+
+	if ( !bOk )
+	{
+		printf( "  got      %s\n  expected %s\n", acLog, pstCase->pcExpected );
+	}
+
+	return bOk;
+}
+
+/* ************************************************************************** */
+static uint32_t RunBus( const uint32_t uiMaxIrqs )
+{
+	uint32_t uiIrqs = 0;
+	char acEvent[8];
+	uint8_t uiByte;
+	bool bAck;
+
+	for ( ; ; )
+	{
+		if ( BusStopped() )
+		{
+			return uiIrqs;
+		}
+
+		if ( uiMaxIrqs <= uiIrqs )
+		{
+			return uiIrqs;
+		}
+
+		if ( 0 != ( stRegs.C1 & I2C_C1_TX_MASK ) )
+		{
+			// Transmitting, the driver has written the next byte to D. MST
+			// rising was a START, RSTA a repeated one, and either is followed
+			// by an address.
+			if ( !stBus.bActive )
+			{
+				stBus.bActive = true;
+				stBus.bAddressNext = true;
+				Log( "S" );
+			}
+			else if ( 0 != ( stRegs.C1 & I2C_C1_RSTA_MASK ) )
+			{
+				stRegs.C1 &= ~I2C_C1_RSTA_MASK;
+				stBus.bAddressNext = true;
+				Log( "Sr" );
+			}
+
+			uiByte = stRegs.D;
+			bAck = BusWrite( uiByte );
+			snprintf( acEvent, sizeof( acEvent ), "%02X%s", (unsigned)uiByte, bAck ? "" : "!" );
+			Log( acEvent );
+
+			stRegs.S = I2C_S_IICIF_MASK | ( bAck ? 0 : I2C_S_RXAK_MASK );
+		}
+		else
+		{
+			// Receiving, the driver's read of D clocked in the next byte,
+			// which we ACK unless TXAK says not to
+			stRegs.D = BusRead();
+			Log( ( 0 != ( stRegs.C1 & I2C_C1_TXAK_MASK ) ) ? "r~" : "r" );
+
+			stRegs.S = I2C_S_IICIF_MASK;
+		}
+
+		uiIrqs++;
+		I2C0_IRQHandler();
+	}
+}
+
+/* ************************************************************************** */
+static bool BusStopped( void )
+{
+	// MST falling is the STOP, and the driver is done with the bus
+	if ( 0 != ( stRegs.C1 & I2C_C1_MST_MASK ) )
+	{
+		return false;
+	}
+
+	if ( stBus.bActive )
+	{
+		stBus.bActive = false;
+		Log( "P" );
+	}
+
+	return true;
+}
+
+/* ************************************************************************** */
+static bool BusWrite( const uint8_t uiByte )
+{
+	if ( stBus.bAddressNext )
+	{
+		stBus.bAddressNext = false;
+		stBus.iDevice = DeviceIndex( uiByte >> 1 );
+
+		// The register is kept for the read after a repeated start
+		if ( I2C_WRITING == ( uiByte & 1 ) )
+		{
+			stBus.bRegSet = false;
+		}
+
+		return ( 0 <= stBus.iDevice );
+	}
+
+	if ( 0 > stBus.iDevice )
+	{
+		return false;
+	}
+
+	if ( !stBus.bRegSet )
+	{
+		stBus.bRegSet = true;
+		stBus.bAutoIncrement = ( 0 != ( uiByte & AUTO_INCREMENT ) );
+		stBus.uiReg = uiByte & ~AUTO_INCREMENT;
+
+		return true;
+	}
+
+	if ( REG_READ_ONLY == stBus.uiReg )
+	{
+		return false;
+	}
+
+	auiDeviceRegs[ stBus.iDevice ][ stBus.uiReg % NUM_REGS ] = uiByte;
+	stBus.uiReg += stBus.bAutoIncrement ? 1 : 0;
+
+	return true;
+}
+
+/* ************************************************************************** */
+static uint8_t BusRead( void )
+{
+	uint8_t uiByte;
+
+	// Nobody driving the bus, the pull ups read as ones
+	if ( 0 > stBus.iDevice )
+	{
+		return 0xFF;
+	}
+
+	uiByte = auiDeviceRegs[ stBus.iDevice ][ stBus.uiReg % NUM_REGS ];
+	stBus.uiReg += stBus.bAutoIncrement ? 1 : 0;
+
+	return uiByte;
+}
+
+/* ************************************************************************** */
+static int DeviceIndex( const uint8_t uiAddress )
+{
+	switch ( uiAddress )
+	{
+		case DEV_G:		return 0;
+		case DEV_XM:	return 1;
+		default:		return -1;
+	}
+}
+
+/* ************************************************************************** */
+static uint8_t RegValue( const int iDevice, const uint8_t uiReg )
+{
+	// Different on every register of both devices
+	return (uint8_t)( ( uiReg * 7 ) + ( iDevice * 0x80 ) + 1 );
+}
+
+/* ************************************************************************** */
+static void Log( const char *pcEvent )
+{
+	if ( '\0' != acLog[0] )
+	{
+		strncat( acLog, " ", LOG_LEN - strlen( acLog ) - 1 );
+	}
+
+	strncat( acLog, pcEvent, LOG_LEN - strlen( acLog ) - 1 );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void DoneA( I2C_Job *pstJob )
+{
+	I2C_Job *pstNext = (I2C_Job*)pstJob->user_data;
+	uint8_t uiCount = auiDeviceRegs[0][ REG_COUNT ];
+
+	Log( "A" );
+
+	// As the FIFO count jobs do, size the next read by what was just read.
+	// A write has nothing to size it by, so the count is taken as read.
+	if ( I2C_READ == pstJob->sequence[ pstJob->sequence_length - 1 ] )
+	{
+		uiCount = pstJob->received_data[0];
+	}
+
+	pstNext->sequence_length = ( 0 == uiCount ) ? 0 : ( READ_SEQ_HEADER + uiCount );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void DoneB( I2C_Job *pstJob )
+{
+	Log( "B" );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void DoneC( I2C_Job *pstJob )
+{
+	Log( "C" );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void ListDone( void *pvUserState )
+{
+	// Made from the interrupt, after the STOP if there was one
+	(void)BusStopped();
+
+	uiCallbacks++;
+	Log( "cb" );
+
+	return;
+}
@@ -0,0 +1,339 @@
+/* ************************************************************************** **
+ * Host check and timing of the Kalman filter's steady state mode (kalman.h).
+ *
+ * Two of each filter, float and fixed point, are run side by side over the
+ * same synthetic gyro and accelerometer angle, one with steady state allowed
+ * and one always doing the full update. Part way through the noise is changed
+ * and later the timestep, each of which has to drop the steady filter back to
+ * the full update and let it settle again. The last phase alternates the
+ * timestep as the flight loop's measured one does, which has to settle all
+ * the same.
+ *
+ * The run fails if the steady filter's angle is ever more than
+ * TOL_ANGLE_RAD from the full one's, or if it doesn't reach steady state in
+ * every phase. It then times both updates on their own, converged.
+ *
+ * Build and run with "make test-kalman" from the top level.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stdio.h>			// printf & friends
+#include <math.h>			// sinf & friends
+#include <time.h>			// clock_gettime
+
+#include "kalman.h"			// Kalman filter
+#include "fixmath.h"		// Fixed point arithmetic
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define PI						( 3.14159265359f )
+#define NUM_PHASES				( 4 )
+#define PHASE_S					( 30.0f )
+#define GYRO_BIAS_RADS			( 0.05f )
+#define GYRO_NOISE_RADS			( 0.02f )
+#define ACCEL_NOISE_RAD			( 0.05f )
+#define TIMED_UPDATES			( 1000000 )
+#define TIMING_RUNS				( 5 )
+
+// How far apart the two filters may be
+#define TOL_ANGLE_RAD			( 0.001f )
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+
+// What changes at the start of each phase
+typedef struct
+{
+	const char *pcName;
+	float fDt;
+	float fJitter;		// Added and taken off the timestep in turn
+	float fQAngle;
+	float fQBias;
+	float fRMeasure;
+
+} stPhase_t;
+
+// Worst difference and when steady state was reached, per phase
+typedef struct
+{
+	float fMaxDiff;
+	float fSteadyAt_s;
+	uint32_t uiSteadyUpdates;
+
+} stResult_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static void Truth( const float fTime_s, float *pfAngle, float *pfRate );
+static float Noise( void );
+static void Record( stResult_t *pstResult, const float fDiff, const bool bSteady, const float fTime_s );
+static void Print( const char *pcName, const stResult_t *pstResult, bool *pbPass );
+static double TimeFloat( const bool bSteadyState );
+static double TimeFixed( const bool bSteadyState );
+static double NowNs( void );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static const stPhase_t astPhases[ NUM_PHASES ] =
+{
+	{ .pcName = "defaults",	 .fDt = 0.010f, .fQAngle = 0.001f, .fQBias = 0.003f, .fRMeasure = 0.03f },
+	{ .pcName = "new noise", .fDt = 0.010f, .fQAngle = 0.002f, .fQBias = 0.001f, .fRMeasure = 0.05f },
+	{ .pcName = "new dt",	 .fDt = 0.005f, .fQAngle = 0.002f, .fQBias = 0.001f, .fRMeasure = 0.05f },
+	{ .pcName = "jittered dt", .fDt = 0.0105625f, .fJitter = 0.0000625f,
+	  .fQAngle = 0.002f, .fQBias = 0.001f, .fRMeasure = 0.05f },
+};
+
+static uint32_t uiNoiseState = 1;
+static volatile float fSink;
+static volatile q16_t qSink;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( void )
+{
+	stKALMAN_Cxt_t stFull;
+	stKALMAN_Cxt_t stSteady;
+	stKALMAN_Q_Cxt_t stFullQ;
+	stKALMAN_Q_Cxt_t stSteadyQ;
+	stResult_t astResult[ NUM_PHASES ] = { { 0 } };
+	stResult_t astResultQ[ NUM_PHASES ] = { { 0 } };
+	const stPhase_t *pstPhase;
+	char acName[40];
+	uint32_t uiPhase;
+	uint32_t uiStep;
+	uint32_t uiSteps;
+	float fTime_s = 0;
+	float fTrue;
+	float fRate;
+	float fGyro;
+	float fAccel;
+	float fFull;
+	float fSteady;
+	float fDt;
+	q30_t qDt;
+	bool bPass = true;
+
+	KALMAN_Setup( &stFull );
+	KALMAN_Setup( &stSteady );
+	KALMAN_SetSteadyState( &stSteady, true );
+	KALMAN_SetupQ( &stFullQ );
+	KALMAN_SetupQ( &stSteadyQ );
+	KALMAN_SetSteadyStateQ( &stSteadyQ, true );
+
+	for ( uiPhase = 0; uiPhase < NUM_PHASES; uiPhase++ )
+	{
+		pstPhase = &astPhases[ uiPhase ];
+		uiSteps = (uint32_t)( ( PHASE_S / pstPhase->fDt ) + 0.5f );
+
+		KALMAN_SetNoise( &stFull, pstPhase->fQAngle, pstPhase->fQBias, pstPhase->fRMeasure );
+		KALMAN_SetNoise( &stSteady, pstPhase->fQAngle, pstPhase->fQBias, pstPhase->fRMeasure );
+		KALMAN_SetNoiseQ( &stFullQ, FIXMATH_FromFloat30( pstPhase->fQAngle ),
+						  FIXMATH_FromFloat30( pstPhase->fQBias ), FIXMATH_FromFloat30( pstPhase->fRMeasure ) );
+		KALMAN_SetNoiseQ( &stSteadyQ, stFullQ.Q_angle, stFullQ.Q_bias, stFullQ.R_measure );
+
+		astResult[ uiPhase ].fSteadyAt_s = -1;
+		astResultQ[ uiPhase ].fSteadyAt_s = -1;
+
+		for ( uiStep = 0; uiStep < uiSteps; uiStep++ )
+		{
+			fDt = pstPhase->fDt + ( ( uiStep & 1 ) ? pstPhase->fJitter : -pstPhase->fJitter );
+			qDt = FIXMATH_FromFloat30( fDt );
+			fTime_s += fDt;
+			Truth( fTime_s, &fTrue, &fRate );
+			fGyro = fRate + GYRO_BIAS_RADS + ( GYRO_NOISE_RADS * Noise() );
+			fAccel = fTrue + ( ACCEL_NOISE_RAD * Noise() );
+
+			fFull = KALMAN_Update( &stFull, fGyro, fAccel, fDt );
+			fSteady = KALMAN_Update( &stSteady, fGyro, fAccel, fDt );
+			Record( &astResult[ uiPhase ], fabsf( fSteady - fFull ), KALMAN_IsSteady( &stSteady ), fTime_s );
+
+			fFull = FIXMATH_ToFloat( KALMAN_UpdateQ( &stFullQ, FIXMATH_FromFloat( fGyro ), FIXMATH_FromFloat( fAccel ), qDt ) );
+			fSteady = FIXMATH_ToFloat( KALMAN_UpdateQ( &stSteadyQ, FIXMATH_FromFloat( fGyro ), FIXMATH_FromFloat( fAccel ), qDt ) );
+			Record( &astResultQ[ uiPhase ], fabsf( fSteady - fFull ), KALMAN_IsSteadyQ( &stSteadyQ ), fTime_s );
+		}
+
+		// Time from the start of the phase
+		if ( 0 <= astResult[ uiPhase ].fSteadyAt_s )
+		{
+			astResult[ uiPhase ].fSteadyAt_s -= fTime_s - PHASE_S;
+		}
+		if ( 0 <= astResultQ[ uiPhase ].fSteadyAt_s )
+		{
+			astResultQ[ uiPhase ].fSteadyAt_s -= fTime_s - PHASE_S;
+		}
+	}
+
+	printf( "%-26s %-14s %-14s %-14s\n", "steady against full", "max diff (rad)", "steady at (s)", "steady updates" );
+
+	for ( uiPhase = 0; uiPhase < NUM_PHASES; uiPhase++ )
+	{
+		snprintf( acName, sizeof( acName ), "float, %s", astPhases[ uiPhase ].pcName );
+		Print( acName, &astResult[ uiPhase ], &bPass );
+	}
+
+	for ( uiPhase = 0; uiPhase < NUM_PHASES; uiPhase++ )
+	{
+		snprintf( acName, sizeof( acName ), "fixed, %s", astPhases[ uiPhase ].pcName );
+		Print( acName, &astResultQ[ uiPhase ], &bPass );
+	}
+
+	printf( "\n%-26s %-14s %-14s\n", "host ns per update", "full", "steady" );
+	printf( "%-26s %-14.1f %-14.1f\n", "float", TimeFloat( false ), TimeFloat( true ) );
+	printf( "%-26s %-14.1f %-14.1f\n", "fixed", TimeFixed( false ), TimeFixed( true ) );
+
+	if ( !bPass )
+	{
+		printf( "\nFAIL: the steady state filter does not match the full one\n" );
+		return 1;
+	}
+
+	printf( "\nPASS\n" );
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static void Truth( const float fTime_s, float *pfAngle, float *pfRate )
+{
+	const float fW1 = 2 * PI * 0.3f;
+	const float fW2 = 2 * PI * 1.7f;
+
+	*pfAngle = ( 0.5f * sinf( fW1 * fTime_s ) ) + ( 0.2f * sinf( fW2 * fTime_s ) );
+	*pfRate = ( 0.5f * fW1 * cosf( fW1 * fTime_s ) ) + ( 0.2f * fW2 * cosf( fW2 * fTime_s ) );
+
+	return;
+}
+
+/* ************************************************************************** */
+static float Noise( void )
+{
+	// Repeatable, roughly uniform in +-1
+	uiNoiseState = ( uiNoiseState * 1103515245u ) + 12345u;
+
+	return ( (float)( ( uiNoiseState >> 8 ) & 0xFFFF ) / 32768.0f ) - 1.0f;
+}
+
+/* ************************************************************************** */
+static void Record( stResult_t *pstResult, const float fDiff, const bool bSteady, const float fTime_s )
+{
+	pstResult->fMaxDiff = fmaxf( pstResult->fMaxDiff, fDiff );
+
+	if ( bSteady )
+	{
+		if ( 0 > pstResult->fSteadyAt_s )
+		{
+			pstResult->fSteadyAt_s = fTime_s;
+		}
+
+		pstResult->uiSteadyUpdates++;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void Print( const char *pcName, const stResult_t *pstResult, bool *pbPass )
+{
+	bool bPass = ( TOL_ANGLE_RAD >= pstResult->fMaxDiff ) && ( 0 <= pstResult->fSteadyAt_s );
+
+	printf( "%-26s %-14.6f %-14.2f %-14u%s\n", pcName, pstResult->fMaxDiff, pstResult->fSteadyAt_s,
+			(unsigned)pstResult->uiSteadyUpdates, bPass ? "" : "  FAIL" );
+
+	*pbPass = *pbPass && bPass;
+
+	return;
+}
+
+/* ************************************************************************** */
+static double TimeFloat( const bool bSteadyState )
+{
+	stKALMAN_Cxt_t stFilter;
+	double dBest = 1e30;
+	double dStart;
+	float fSum = 0;
+	uint32_t uiRun;
+	uint32_t uiStep;
+
+	KALMAN_Setup( &stFilter );
+	KALMAN_SetSteadyState( &stFilter, bSteadyState );
+
+	// Converge first, the noise is precomputed so only the update is timed
+	for ( uiStep = 0; uiStep < 10 * KALMAN_STEADY_COUNT; uiStep++ )
+	{
+		KALMAN_Update( &stFilter, 0.1f * Noise(), 0.1f * Noise(), 0.01f );
+	}
+
+	for ( uiRun = 0; uiRun < TIMING_RUNS; uiRun++ )
+	{
+		dStart = NowNs();
+		for ( uiStep = 0; uiStep < TIMED_UPDATES; uiStep++ )
+		{
+			fSum += KALMAN_Update( &stFilter, ( uiStep & 1 ) ? 0.01f : -0.01f, ( uiStep & 2 ) ? 0.02f : -0.02f, 0.01f );
+		}
+		dBest = fmin( dBest, ( NowNs() - dStart ) / TIMED_UPDATES );
+	}
+
+	fSink = fSum;
+
+	return dBest;
+}
+
+/* ************************************************************************** */
+static double TimeFixed( const bool bSteadyState )
+{
+	stKALMAN_Q_Cxt_t stFilter;
+	double dBest = 1e30;
+	double dStart;
+	q16_t qSum = 0;
+	q30_t qDt = FIXMATH_Q30( 0.01 );
+	uint32_t uiRun;
+	uint32_t uiStep;
+
+	KALMAN_SetupQ( &stFilter );
+	KALMAN_SetSteadyStateQ( &stFilter, bSteadyState );
+
+	for ( uiStep = 0; uiStep < 10 * KALMAN_STEADY_COUNT; uiStep++ )
+	{
+		KALMAN_UpdateQ( &stFilter, FIXMATH_FromFloat( 0.1f * Noise() ), FIXMATH_FromFloat( 0.1f * Noise() ), qDt );
+	}
+
+	for ( uiRun = 0; uiRun < TIMING_RUNS; uiRun++ )
+	{
+		dStart = NowNs();
+		for ( uiStep = 0; uiStep < TIMED_UPDATES; uiStep++ )
+		{
+			qSum += KALMAN_UpdateQ( &stFilter, ( uiStep & 1 ) ? FIXMATH_Q16( 0.01 ) : FIXMATH_Q16( -0.01 ),
+									( uiStep & 2 ) ? FIXMATH_Q16( 0.02 ) : FIXMATH_Q16( -0.02 ), qDt );
+		}
+		dBest = fmin( dBest, ( NowNs() - dStart ) / TIMED_UPDATES );
+	}
+
+	qSink = qSum;
+
+	return dBest;
+}
+
+/* ************************************************************************** */
+static double NowNs( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return ( (double)stNow.tv_sec * 1e9 ) + (double)stNow.tv_nsec;
+}
@@ -0,0 +1,360 @@
+/* ************************************************************************** **
+ * Host check of the gyro FIFO burst read (LSM9DS0_readGyroFifo) against a
+ * model of the gyro's FIFO as the part presents it over I2C, and of the
+ * helpers it shares with the flight task's interrupt driven read.
+ *
+ * Known samples are queued in the model and read back through the driver,
+ * whose bus callbacks go straight to the model's registers and note every
+ * multi-byte transfer. Each read must:
+ *   - return the number of samples queued, or the caller's maximum
+ *   - fetch them in one transfer of six bytes a sample
+ *   - start that transfer at OUT_X_L_G with the auto-increment bit set
+ *   - hand back X, Y and Z of each sample in the order they were queued
+ *   - leave behind exactly what it didn't read
+ *
+ * The flight task sizes its data job from a FIFO_SRC value and addresses it
+ * with the same helpers, so those are checked against the register as well:
+ * the level ignores the WTM, OVRN and EMPTY flags and stops at the caller's
+ * maximum, and a burst starts with the auto-increment bit set.
+ *
+ * Build and run with "make test-lsm9ds0" from the top level.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stdio.h>			// printf & friends
+#include <string.h>			// memset
+
+#include "SFE_LSM9DS0.h"	// LSM9DS0 driver
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define ADDR_G				( 0x6B )
+#define ADDR_XM				( 0x1D )
+#define AUTO_INCREMENT		( 0x80 )
+
+// FIFO_SRC_REG_G, the level field can't show a full FIFO so it stops at 31
+#define FIFO_SRC_WTM		( 0x80 )
+#define FIFO_SRC_OVRN		( 0x40 )
+#define FIFO_SRC_EMPTY		( 0x20 )
+#define FIFO_SRC_FSS_MAX	( 0x1F )
+#define FIFO_WATERMARK		( 4 )		// Sets WTM, so the level isn't all there is
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+
+// One read and what it should come to
+typedef struct
+{
+	const char *pcName;
+	uint8_t uiQueued;		// Samples put in the FIFO first
+	uint8_t uiMax;			// Most the caller takes
+	uint8_t uiExpected;		// What readGyroFifo should return
+
+} stCase_t;
+
+// A FIFO_SRC value and the level the flight task should size its read to
+typedef struct
+{
+	const char *pcName;
+	uint8_t uiSource;
+	uint8_t uiMax;
+	uint8_t uiExpected;
+
+} stLevelCase_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static void WriteByte( stLSM9DS0_t *stThis, uint8_t address, uint8_t subAddress, uint8_t data );
+static uint8_t ReadByte( stLSM9DS0_t *stThis, uint8_t address, uint8_t subAddress );
+static void ReadBytes( stLSM9DS0_t *stThis, uint8_t address, uint8_t subAddress, uint8_t *dest, uint8_t count );
+static bool RunCase( stLSM9DS0_t *pstImu, const stCase_t *pstCase );
+static bool CheckHelpers( void );
+static int16_t Sample( const uint16_t uiIndex, const uint8_t uiAxis );
+static void FifoPush( const int16_t iX, const int16_t iY, const int16_t iZ );
+static uint8_t FifoRegister( const uint8_t uiAddress, const uint8_t uiReg );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static const stCase_t astCases[] =
+{
+	{ "one sample",			1,	LSM9DS0_FIFO_DEPTH,	1 },
+	{ "several",			5,	LSM9DS0_FIFO_DEPTH,	5 },
+	{ "capped by max",		10,	4,					4 },
+	{ "full FIFO",			LSM9DS0_FIFO_DEPTH - 1,	LSM9DS0_FIFO_DEPTH,	LSM9DS0_FIFO_DEPTH - 1 },
+	{ "empty",				0,	LSM9DS0_FIFO_DEPTH,	0 },
+};
+
+static const stLevelCase_t astLevelCases[] =
+{
+	{ "src empty",		FIFO_SRC_EMPTY,										LSM9DS0_FIFO_DEPTH,	0 },
+	{ "src watermark",	FIFO_SRC_WTM | 5,									LSM9DS0_FIFO_DEPTH,	5 },
+	{ "src overrun",	FIFO_SRC_WTM | FIFO_SRC_OVRN | FIFO_SRC_FSS_MAX,	LSM9DS0_FIFO_DEPTH,	FIFO_SRC_FSS_MAX },
+	{ "src over max",	FIFO_SRC_WTM | 9,									4,					4 },
+};
+
+// The gyro FIFO, oldest sample at the head
+static int16_t aaiFifo[ LSM9DS0_FIFO_DEPTH ][3];
+static uint8_t uiFifoHead;
+static uint8_t uiFifoCount;
+
+// The multi-byte transfers made since the last reset
+static uint32_t uiBursts;
+static uint8_t uiBurstSubAddress;
+static uint8_t uiBurstCount;
+
+// Samples queued and read so far, so every one is different
+static uint16_t uiNextQueued;
+static uint16_t uiNextRead;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( void )
+{
+	stLSM9DS0_t stImu;
+	size_t sIndex;
+	bool bPass = true;
+
+	LSM9DS0_Setup( &stImu, MODE_I2C, ADDR_G, ADDR_XM, WriteByte, ReadByte, ReadBytes );
+
+	printf( "%-14s %-8s %-8s %-8s %-10s %s\n", "case", "queued", "read", "burst", "subaddr", "result" );
+
+	for ( sIndex = 0; sIndex < ( sizeof( astCases ) / sizeof( astCases[0] ) ); sIndex++ )
+	{
+		bPass = RunCase( &stImu, &astCases[ sIndex ] ) && bPass;
+	}
+
+	printf( "\n" );
+	bPass = CheckHelpers() && bPass;
+
+	if ( !bPass )
+	{
+		printf( "\nFAIL: the gyro FIFO read does not match what was queued\n" );
+		return 1;
+	}
+
+	printf( "\nPASS\n" );
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static bool RunCase( stLSM9DS0_t *pstImu, const stCase_t *pstCase )
+{
+	int16_t aiOut[ LSM9DS0_FIFO_DEPTH ][3];
+	uint8_t uiRead;
+	uint8_t uiLeft;
+	uint8_t uiIndex;
+	uint8_t uiAxis;
+	bool bOk = true;
+
+	// Start from an empty FIFO, whatever the last case left
+	uiFifoHead = 0;
+	uiFifoCount = 0;
+	uiNextRead = uiNextQueued;
+
+	for ( uiIndex = 0; uiIndex < pstCase->uiQueued; uiIndex++ )
+	{
+		FifoPush( Sample( uiNextQueued, 0 ), Sample( uiNextQueued, 1 ), Sample( uiNextQueued, 2 ) );
+		uiNextQueued++;
+	}
+
+	uiBursts = 0;
+	uiBurstSubAddress = 0;
+	uiBurstCount = 0;
+	memset( aiOut, 0, sizeof( aiOut ) );
+
+	uiRead = LSM9DS0_readGyroFifo( pstImu, aiOut, pstCase->uiMax );
+	bOk = bOk && ( pstCase->uiExpected == uiRead );
+
+	if ( 0 == pstCase->uiExpected )
+	{
+		// Nothing queued is no transfer at all
+		bOk = bOk && ( 0 == uiBursts );
+	}
+	else
+	{
+		bOk = bOk && ( 1 == uiBursts ) && ( ( uiRead * 6 ) == uiBurstCount )
+				  && ( ( OUT_X_L_G | AUTO_INCREMENT ) == uiBurstSubAddress );
+	}
+
+	for ( uiIndex = 0; uiIndex < uiRead; uiIndex++ )
+	{
+		for ( uiAxis = 0; uiAxis < 3; uiAxis++ )
+		{
+			if ( Sample( uiNextRead, uiAxis ) != aiOut[ uiIndex ][ uiAxis ] )
+			{
+				printf( "  sample %u axis %u is %d, expected %d\n", (unsigned)uiIndex, (unsigned)uiAxis,
+						aiOut[ uiIndex ][ uiAxis ], Sample( uiNextRead, uiAxis ) );
+				bOk = false;
+			}
+		}
+
+		uiNextRead++;
+	}
+
+	// What wasn't asked for is still queued
+	uiLeft = LSM9DS0_fifoCountGyro( pstImu );
+	bOk = bOk && ( ( pstCase->uiQueued - uiRead ) == uiLeft );
+
+	printf( "%-14s %-8u %-8u %-8u 0x%02X       %s\n", pstCase->pcName, (unsigned)pstCase->uiQueued,
+			(unsigned)uiRead, (unsigned)uiBurstCount, (unsigned)uiBurstSubAddress, bOk ? "ok" : "FAILED" );
+
+	return bOk;
+}
+
+/* ************************************************************************** */
+static bool CheckHelpers( void )
+{
+	size_t sIndex;
+	uint8_t uiLevel;
+	bool bOk;
+	bool bPass = true;
+
+	for ( sIndex = 0; sIndex < ( sizeof( astLevelCases ) / sizeof( astLevelCases[0] ) ); sIndex++ )
+	{
+		uiLevel = LSM9DS0_fifoLevel( astLevelCases[ sIndex ].uiSource, astLevelCases[ sIndex ].uiMax );
+		bOk = ( astLevelCases[ sIndex ].uiExpected == uiLevel );
+		bPass = bOk && bPass;
+
+		printf( "%-14s 0x%02X     %-8u %-8s %-10s %s\n", astLevelCases[ sIndex ].pcName,
+				(unsigned)astLevelCases[ sIndex ].uiSource, (unsigned)uiLevel, "", "", bOk ? "ok" : "FAILED" );
+	}
+
+	// Whether or not the bit is already there
+	bOk = ( ( OUT_X_L_G | AUTO_INCREMENT ) == LSM9DS0_i2cBurstAddress( OUT_X_L_G ) )
+		  && ( ( OUT_X_L_A | AUTO_INCREMENT ) == LSM9DS0_i2cBurstAddress( OUT_X_L_A | AUTO_INCREMENT ) );
+	bPass = bOk && bPass;
+
+	printf( "%-14s %-8s %-8s %-8s 0x%02X       %s\n", "burst address", "", "", "",
+			(unsigned)LSM9DS0_i2cBurstAddress( OUT_X_L_G ), bOk ? "ok" : "FAILED" );
+
+	return bPass;
+}
+
+/* ************************************************************************** */
+static int16_t Sample( const uint16_t uiIndex, const uint8_t uiAxis )
+{
+	// Each axis distinct, both bytes significant and negative on Y
+	switch ( uiAxis )
+	{
+		case 0:		return (int16_t)( 0x0100 + uiIndex );
+		case 1:		return (int16_t)( -0x2000 - uiIndex );
+		default:	return (int16_t)( 0x3000 + ( uiIndex << 4 ) );
+	}
+}
+
+/* ************************************************************************** */
+static void FifoPush( const int16_t iX, const int16_t iY, const int16_t iZ )
+{
+	uint8_t uiSlot;
+
+	// Stream mode, a full FIFO drops its oldest sample
+	if ( LSM9DS0_FIFO_DEPTH == uiFifoCount )
+	{
+		uiFifoHead = ( uiFifoHead + 1 ) % LSM9DS0_FIFO_DEPTH;
+		uiFifoCount--;
+	}
+
+	uiSlot = ( uiFifoHead + uiFifoCount ) % LSM9DS0_FIFO_DEPTH;
+	aaiFifo[ uiSlot ][0] = iX;
+	aaiFifo[ uiSlot ][1] = iY;
+	aaiFifo[ uiSlot ][2] = iZ;
+	uiFifoCount++;
+
+	return;
+}
+
+/* ************************************************************************** */
+static uint8_t FifoRegister( const uint8_t uiAddress, const uint8_t uiReg )
+{
+	uint8_t uiSource;
+	uint16_t uiValue;
+
+	if ( ADDR_G != uiAddress )
+	{
+		return 0;
+	}
+
+	if ( FIFO_SRC_REG_G == uiReg )
+	{
+		uiSource = ( uiFifoCount > FIFO_SRC_FSS_MAX ) ? FIFO_SRC_FSS_MAX : uiFifoCount;
+		uiSource |= ( 0 == uiFifoCount ) ? FIFO_SRC_EMPTY : 0;
+		uiSource |= ( LSM9DS0_FIFO_DEPTH == uiFifoCount ) ? FIFO_SRC_OVRN : 0;
+		uiSource |= ( FIFO_WATERMARK <= uiFifoCount ) ? FIFO_SRC_WTM : 0;
+
+		return uiSource;
+	}
+
+	if ( ( OUT_X_L_G > uiReg ) || ( OUT_Z_H_G < uiReg ) )
+	{
+		return 0;
+	}
+
+	uiValue = (uint16_t)aaiFifo[ uiFifoHead ][ ( uiReg - OUT_X_L_G ) / 2 ];
+
+	// Reading Z_H finishes the sample, an empty FIFO repeats its last one
+	if ( ( OUT_Z_H_G == uiReg ) && ( 0 < uiFifoCount ) )
+	{
+		if ( 1 < uiFifoCount )
+		{
+			uiFifoHead = ( uiFifoHead + 1 ) % LSM9DS0_FIFO_DEPTH;
+		}
+
+		uiFifoCount--;
+	}
+
+	return ( 0 == ( ( uiReg - OUT_X_L_G ) & 1 ) ) ? (uint8_t)uiValue : (uint8_t)( uiValue >> 8 );
+}
+
+/* ************************************************************************** */
+static void WriteByte( stLSM9DS0_t *stThis, uint8_t address, uint8_t subAddress, uint8_t data )
+{
+	// No register this test looks at is written
+	return;
+}
+
+/* ************************************************************************** */
+static uint8_t ReadByte( stLSM9DS0_t *stThis, uint8_t address, uint8_t subAddress )
+{
+	return FifoRegister( address, subAddress & ~AUTO_INCREMENT );
+}
+
+/* ************************************************************************** */
+static void ReadBytes( stLSM9DS0_t *stThis, uint8_t address, uint8_t subAddress, uint8_t *dest, uint8_t count )
+{
+	uint8_t uiReg = subAddress & ~AUTO_INCREMENT;
+	uint8_t uiIndex;
+
+	uiBursts++;
+	uiBurstSubAddress = subAddress;
+	uiBurstCount = count;
+
+	// As the part does, without the bit every byte is the same register. With
+	// the FIFO on the gyro rolls OUT_Z_H_G over to OUT_X_L_G.
+	for ( uiIndex = 0; uiIndex < count; uiIndex++ )
+	{
+		dest[ uiIndex ] = FifoRegister( address, uiReg );
+
+		if ( 0 != ( subAddress & AUTO_INCREMENT ) )
+		{
+			uiReg = ( OUT_Z_H_G == uiReg ) ? OUT_X_L_G : ( uiReg + 1 );
+		}
+	}
+
+	return;
+}
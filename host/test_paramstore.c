@@ -0,0 +1,350 @@
+/* ************************************************************************** **
+ * Host check of the parameter journal (paramstore.h) on the file backed
+ * storage (host/nvm.c).
+ *
+ * Parameters are changed, the journal is run as the LED task would run it
+ * and then the board is "reset": the parameters go back to their defaults
+ * and the journal is created again from the file, which must bring back what
+ * was last written. Between resets the file is damaged the way a power loss
+ * would leave the flash, a record cut short and a sector started but its
+ * snapshot never written, and the journal has to fall back to what it had
+ * before. Enough changes are made to go round the ring of sectors several
+ * times, which must wear them all alike. Start up is timed with a full
+ * sector to replay.
+ *
+ * The file is made in /tmp and removed afterwards. Build and run with
+ * "make test-paramstore" from the top level.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stdio.h>			// printf & friends
+#include <stdlib.h>			// mkstemp
+#include <string.h>			// memcpy & friends
+#include <time.h>			// clock_gettime
+#include <unistd.h>			// close, unlink
+
+#include "params.h"			// System parameters
+#include "paramstore.h"		// Parameter journal
+#include "nvm.h"			// Flash storage
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define TICK_MS				( 100 )		// The LED task's
+#define SETTLE_TICKS		( ( PARAMSTORE_SETTLE_MS / TICK_MS ) + 4 )	// And start a sector
+#define NUM_LAPS			( 5 )		// Times round the ring
+#define TIMED_BOOTS			( 1000 )
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static bool Reset( void );
+static void Run( const uint32_t uiTicks );
+static void Change( const ePARAM_Id_t eParam, const float fValue );
+static bool SameAs( const float afExpected[] );
+static void Save( float afValues[] );
+static void Poke( const uint8_t uiSector, const uint16_t uiOffset, const uint32_t uiWord, const uint16_t uiCount );
+static void Check( const char *pcName, const bool bOk, bool *pbPass );
+static double NowNs( void );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static float afDefaults[ PARAM_NUM ];
+static char acPath[] = "/tmp/test_paramstore_XXXXXX";
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( void )
+{
+	stPARAMSTORE_Status_t stStatus;
+	stPARAMSTORE_Status_t stBefore;
+	float afExpected[ PARAM_NUM ];
+	uint32_t auiErases[ NVM_NUM_SECTORS ] = { 0 };
+	uint32_t uiLastSeq;
+	uint32_t uiMin;
+	uint32_t uiMax;
+	uint32_t uiCount;
+	uint32_t uiWritten;
+	uint16_t uiOffset;
+	uint8_t uiSector;
+	double dStart;
+	int iFd;
+	bool bPass = true;
+
+	iFd = mkstemp( acPath );
+
+	if ( 0 > iFd )
+	{
+		printf( "FAIL: can't make %s\n", acPath );
+		return 1;
+	}
+
+	// An empty file is new flash
+	close( iFd );
+	setenv( "NVM_FILE", acPath, 1 );
+	Save( afDefaults );
+
+	// New storage starts a sector, and only writes a change once it settles
+	Check( "new storage in use", Reset(), &bPass );
+	Run( 3 );
+	PARAMSTORE_GetStatus( &stBefore );
+	Check( "first sector started", ( 0 < stBefore.uiFreeRecords ) && ( PARAM_NUM + 1 == stBefore.uiRecordsWritten ), &bPass );
+
+	Change( PARAM_PIDGAIN_RATE_P, 1.25f );
+	Change( PARAM_TRIM_PITCH, 0.5f );
+	Run( 2 );
+	Change( PARAM_PIDGAIN_RATE_P, 1.5f );
+	Run( 2 );
+	PARAMSTORE_GetStatus( &stStatus );
+	Check( "nothing written while changing", stStatus.uiRecordsWritten == stBefore.uiRecordsWritten, &bPass );
+
+	Run( SETTLE_TICKS );
+	PARAMSTORE_GetStatus( &stStatus );
+	Check( "settled changes written once", stStatus.uiRecordsWritten == stBefore.uiRecordsWritten + 2, &bPass );
+
+	// Reset brings them back
+	Save( afExpected );
+	Check( "journal found", Reset(), &bPass );
+	Check( "values replayed", SameAs( afExpected ), &bPass );
+
+	// A record cut short is skipped, the one before it stands
+	Change( PARAM_TRIM_ROLL, 0.25f );
+	Run( SETTLE_TICKS );
+	Save( afExpected );
+	Change( PARAM_TRIM_ROLL, 0.75f );
+	Run( SETTLE_TICKS );
+	PARAMSTORE_GetStatus( &stStatus );
+	uiOffset = NVM_SECTOR_SIZE - ( ( stStatus.uiFreeRecords + 1 ) * 8 );
+	// Some of 0.75's bits never programmed, the key and check are whole
+	Poke( stStatus.uiSector, uiOffset, NVM_Sector( stStatus.uiSector )[ uiOffset / 4 ] | 0x00F00000UL, 1 );
+	Reset();
+	Check( "torn record skipped", SameAs( afExpected ), &bPass );
+
+	// And its slot isn't written again
+	Change( PARAM_TRIM_ROLL, 0.5f );
+	Run( SETTLE_TICKS );
+	Save( afExpected );
+	Reset();
+	Check( "write after torn record", SameAs( afExpected ), &bPass );
+
+	// Go round the ring, counting erases by the sequence each sector is
+	// started with
+	PARAMSTORE_GetStatus( &stStatus );
+	uiLastSeq = stStatus.uiSectorSeq;
+	auiErases[ stStatus.uiSector ]++;
+	uiWritten = 0;
+
+	for ( uiCount = 0; ( ( stStatus.uiSectorSeq - stBefore.uiSectorSeq ) < ( NUM_LAPS * NVM_NUM_SECTORS ) ) && ( uiCount < 100000 ); uiCount++ )
+	{
+		Change( (ePARAM_Id_t)( uiCount % 3 ), (float)uiCount );
+		Run( SETTLE_TICKS );
+		PARAMSTORE_GetStatus( &stStatus );
+
+		if ( stStatus.uiSectorSeq != uiLastSeq )
+		{
+			uiLastSeq = stStatus.uiSectorSeq;
+			auiErases[ stStatus.uiSector ]++;
+		}
+
+		uiWritten++;
+	}
+
+	for ( uiSector = 0, uiMin = UINT32_MAX, uiMax = 0; uiSector < NVM_NUM_SECTORS; uiSector++ )
+	{
+		uiMin = ( auiErases[ uiSector ] < uiMin ) ? auiErases[ uiSector ] : uiMin;
+		uiMax = ( auiErases[ uiSector ] > uiMax ) ? auiErases[ uiSector ] : uiMax;
+	}
+
+	printf( "%u changes, sectors erased %u to %u times\n", (unsigned)uiWritten, (unsigned)uiMin, (unsigned)uiMax );
+	Check( "sectors worn alike", ( NUM_LAPS <= uiMin ) && ( 1 >= ( uiMax - uiMin ) ), &bPass );
+	Check( "no write errors", 0 == stStatus.uiErrors, &bPass );
+
+	Save( afExpected );
+	Reset();
+	Check( "values replayed after laps", SameAs( afExpected ), &bPass );
+
+	// Fill the sector, so the next change starts another, then lose that
+	// sector's snapshot as a power cut straight after its header would
+	PARAMSTORE_GetStatus( &stStatus );
+
+	for ( uiCount = 0; 0 < stStatus.uiFreeRecords; uiCount++ )
+	{
+		Change( PARAM_PIDGAIN_RATE_D, (float)uiCount );
+		Run( SETTLE_TICKS );
+		PARAMSTORE_GetStatus( &stStatus );
+	}
+
+	Save( afExpected );
+	Change( PARAM_PIDGAIN_ANGLE_P, 9.0f );
+	Run( SETTLE_TICKS );
+	PARAMSTORE_GetStatus( &stStatus );
+	Check( "full sector moves on", 0 < stStatus.uiFreeRecords, &bPass );
+	Poke( stStatus.uiSector, 8, NVM_ERASED_WORD, ( NVM_SECTOR_SIZE - 8 ) / 4 );
+	Reset();
+	Check( "torn snapshot falls back", SameAs( afExpected ), &bPass );
+
+	// Which starts a new sector on the next run
+	PARAMSTORE_GetStatus( &stBefore );
+	Run( 3 );
+	PARAMSTORE_GetStatus( &stStatus );
+	Check( "new sector after torn snapshot", ( stStatus.uiSectorSeq == stBefore.uiSectorSeq + 1 ) && ( 0 < stStatus.uiFreeRecords ), &bPass );
+	Reset();
+	Check( "values kept", SameAs( afExpected ), &bPass );
+
+	// Start up with a sector all but full
+	PARAMSTORE_GetStatus( &stStatus );
+
+	for ( uiCount = 0; 1 < stStatus.uiFreeRecords; uiCount++ )
+	{
+		Change( PARAM_TRIM_YAW, (float)uiCount );
+		Run( SETTLE_TICKS );
+		PARAMSTORE_GetStatus( &stStatus );
+	}
+
+	dStart = NowNs();
+
+	for ( uiCount = 0; uiCount < TIMED_BOOTS; uiCount++ )
+	{
+		PARAMSTORE_Create();
+	}
+
+	PARAMSTORE_GetStatus( &stStatus );
+	printf( "start up replaying %u records: %.1f us on the host, reading the file included\n", (unsigned)stStatus.uiReplayed,
+			( NowNs() - dStart ) / ( 1000.0 * TIMED_BOOTS ) );
+
+	unlink( acPath );
+
+	if ( !bPass )
+	{
+		printf( "\nFAIL: the journal lost or mangled parameters\n" );
+		return 1;
+	}
+
+	printf( "\nPASS\n" );
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static bool Reset( void )
+{
+	ePARAM_Id_t eParam;
+
+	for ( eParam = 0; eParam < PARAM_NUM; eParam++ )
+	{
+		PARAM_Set( PARAM_Handle( eParam ), afDefaults[ eParam ] );
+	}
+
+	PARAM_Create();
+
+	return PARAMSTORE_Create();
+}
+
+/* ************************************************************************** */
+static void Run( const uint32_t uiTicks )
+{
+	const struct timespec stTick = { 0, 1000000 };
+	uint32_t uiTick;
+
+	// Real time as well, so the file's erases get to finish
+	for ( uiTick = 0; uiTick < uiTicks; uiTick++ )
+	{
+		PARAMSTORE_Process( TICK_MS );
+
+		while ( NVM_BUSY == NVM_Status() )
+		{
+			nanosleep( &stTick, NULL );
+		}
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void Change( const ePARAM_Id_t eParam, const float fValue )
+{
+	PARAM_Set( PARAM_Handle( eParam ), fValue );
+
+	return;
+}
+
+/* ************************************************************************** */
+static bool SameAs( const float afExpected[] )
+{
+	ePARAM_Id_t eParam;
+
+	for ( eParam = 0; eParam < PARAM_NUM; eParam++ )
+	{
+		if ( astPARAM_List[ eParam ].fValue != afExpected[ eParam ] )
+		{
+			printf( "%s is %f, expected %f\n", astPARAM_List[ eParam ].sName,
+					astPARAM_List[ eParam ].fValue, afExpected[ eParam ] );
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/* ************************************************************************** */
+static void Save( float afValues[] )
+{
+	ePARAM_Id_t eParam;
+
+	for ( eParam = 0; eParam < PARAM_NUM; eParam++ )
+	{
+		afValues[ eParam ] = astPARAM_List[ eParam ].fValue;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void Poke( const uint8_t uiSector, const uint16_t uiOffset, const uint32_t uiWord, const uint16_t uiCount )
+{
+	FILE *pFile = fopen( acPath, "r+b" );
+	uint16_t uiIndex;
+
+	fseek( pFile, ( uiSector * NVM_SECTOR_SIZE ) + uiOffset, SEEK_SET );
+
+	for ( uiIndex = 0; uiIndex < uiCount; uiIndex++ )
+	{
+		fwrite( &uiWord, sizeof( uiWord ), 1, pFile );
+	}
+
+	fclose( pFile );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void Check( const char *pcName, const bool bOk, bool *pbPass )
+{
+	printf( "%-34s %s\n", pcName, bOk ? "ok" : "FAILED" );
+
+	*pbPass = *pbPass && bOk;
+
+	return;
+}
+
+/* ************************************************************************** */
+static double NowNs( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return ( (double)stNow.tv_sec * 1e9 ) + (double)stNow.tv_nsec;
+}
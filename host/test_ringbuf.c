@@ -0,0 +1,253 @@
+/* ************************************************************************** **
+ * Host check of the byte ring (ringbuf.c) the UART driver queues through.
+ *
+ * Each case drives a ring the way one of its users does and checks every
+ * byte that comes out, along with the counts in between:
+ *   - only power of two sizes are taken
+ *   - empty and full read back as such, with Used and Free adding up
+ *   - a write that doesn't fit keeps what fits and drops the rest, and a
+ *     full ring drops new bytes one at a time without touching what it holds
+ *   - reads and writes of every length straddle the end of the buffer, and
+ *     the free running indices roll over the top of a uint32_t, without a
+ *     byte lost, repeated or out of order
+ *
+ * Build and run with "make test-ringbuf" from the top level.
+ * ************************************************************************** */
+
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stdio.h>			// printf & friends
+#include <string.h>			// memset
+
+#include "ringbuf.h"		// Byte ring
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define RING_SIZE			( 16 )
+#define WALK_ROUNDS			( 2000 )
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static bool CheckSizes( void );
+static bool CheckBoundaries( void );
+static bool CheckOverflow( void );
+static bool CheckWrap( const uint32_t uiStart );
+static bool Check( const char *pcName, const bool bOk );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static uint8_t abyStorage[ RING_SIZE ];
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+int main( void )
+{
+	bool bPass = true;
+
+	bPass = CheckSizes() && bPass;
+	bPass = CheckBoundaries() && bPass;
+	bPass = CheckOverflow() && bPass;
+	bPass = CheckWrap( 0 ) && bPass;
+	bPass = CheckWrap( UINT32_MAX - ( 3 * RING_SIZE ) ) && bPass;
+
+	if ( !bPass )
+	{
+		printf( "\nFAIL: the ring lost, repeated or reordered data\n" );
+		return 1;
+	}
+
+	printf( "\nPASS\n" );
+
+	return 0;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static bool CheckSizes( void )
+{
+	stRINGBUF_Ctx_t stRing;
+	bool bOk;
+
+	bOk = ( -1 == RINGBUF_Create( &stRing, abyStorage, 0 ) )
+		  && ( -1 == RINGBUF_Create( &stRing, abyStorage, 3 ) )
+		  && ( -1 == RINGBUF_Create( &stRing, abyStorage, 12 ) )
+		  && ( 0 == RINGBUF_Create( &stRing, abyStorage, 1 ) )
+		  && ( 0 == RINGBUF_Create( &stRing, abyStorage, RING_SIZE ) );
+
+	return Check( "power of two sizes", bOk );
+}
+
+/* ************************************************************************** */
+static bool CheckBoundaries( void )
+{
+	stRINGBUF_Ctx_t stRing;
+	uint8_t abyIn[ RING_SIZE ];
+	uint8_t abyOut[ RING_SIZE + 1 ];
+	uint32_t uiIndex;
+	bool bOk;
+
+	for ( uiIndex = 0; uiIndex < RING_SIZE; uiIndex++ )
+	{
+		abyIn[ uiIndex ] = (uint8_t)( 0xA0 + uiIndex );
+	}
+
+	RINGBUF_Create( &stRing, abyStorage, RING_SIZE );
+
+	// Empty, nothing to read and all of it free
+	bOk = ( 0 == RINGBUF_Used( &stRing ) ) && ( RING_SIZE == RINGBUF_Free( &stRing ) )
+		  && ( 0 == RINGBUF_Read( &stRing, abyOut, sizeof( abyOut ) ) );
+	bOk = Check( "empty", bOk ) && bOk;
+
+	// One short of full, then full, then nothing more goes in
+	bOk = ( ( RING_SIZE - 1 ) == RINGBUF_Write( &stRing, abyIn, RING_SIZE - 1 ) )
+		  && ( 1 == RINGBUF_Free( &stRing ) )
+		  && ( 1 == RINGBUF_Write( &stRing, &abyIn[ RING_SIZE - 1 ], 1 ) )
+		  && ( RING_SIZE == RINGBUF_Used( &stRing ) ) && ( 0 == RINGBUF_Free( &stRing ) )
+		  && ( 0 == RINGBUF_Write( &stRing, abyIn, 1 ) );
+	bOk = Check( "full", bOk ) && bOk;
+
+	// A read asking for more than is there gets exactly what is
+	memset( abyOut, 0, sizeof( abyOut ) );
+	bOk = ( RING_SIZE == RINGBUF_Read( &stRing, abyOut, sizeof( abyOut ) ) )
+		  && ( 0 == memcmp( abyIn, abyOut, RING_SIZE ) ) && ( 0 == abyOut[ RING_SIZE ] )
+		  && ( 0 == RINGBUF_Used( &stRing ) ) && ( RING_SIZE == RINGBUF_Free( &stRing ) );
+	bOk = Check( "full to empty", bOk ) && bOk;
+
+	return bOk;
+}
+
+/* ************************************************************************** */
+static bool CheckOverflow( void )
+{
+	stRINGBUF_Ctx_t stRing;
+	uint8_t abyIn[ RING_SIZE * 2 ];
+	uint8_t abyOut[ RING_SIZE * 2 ];
+	uint32_t uiIndex;
+	uint32_t uiQueued = 0;
+	uint32_t uiDropped = 0;
+	uint8_t byData;
+	bool bOk = true;
+	bool bCase;
+
+	for ( uiIndex = 0; uiIndex < sizeof( abyIn ); uiIndex++ )
+	{
+		abyIn[ uiIndex ] = (uint8_t)uiIndex;
+	}
+
+	// A write bigger than the space left keeps its start and drops its end
+	RINGBUF_Create( &stRing, abyStorage, RING_SIZE );
+	RINGBUF_Write( &stRing, abyIn, 5 );
+	RINGBUF_Read( &stRing, abyOut, 2 );
+
+	bCase = ( ( RING_SIZE - 3 ) == RINGBUF_Write( &stRing, &abyIn[5], RING_SIZE ) )
+			&& ( RING_SIZE == RINGBUF_Read( &stRing, abyOut, sizeof( abyOut ) ) )
+			&& ( 0 == memcmp( &abyIn[2], abyOut, RING_SIZE ) );
+	bOk = Check( "partial write", bCase ) && bOk;
+
+	// A byte at a time counting what doesn't fit, as an interrupt filling the
+	// ring would. The reader then finds the oldest bytes intact, and what
+	// arrives after it catches up carries straight on.
+	RINGBUF_Create( &stRing, abyStorage, RING_SIZE );
+
+	for ( uiIndex = 0; uiIndex < ( RING_SIZE + 7 ); uiIndex++ )
+	{
+		byData = abyIn[ uiIndex ];
+
+		if ( 1 == RINGBUF_Write( &stRing, &byData, 1 ) )
+		{
+			uiQueued++;
+		}
+		else
+		{
+			uiDropped++;
+		}
+	}
+
+	bCase = ( RING_SIZE == uiQueued ) && ( 7 == uiDropped )
+			&& ( RING_SIZE == RINGBUF_Read( &stRing, abyOut, sizeof( abyOut ) ) )
+			&& ( 0 == memcmp( abyIn, abyOut, RING_SIZE ) );
+
+	byData = 0x5A;
+	bCase = bCase && ( 1 == RINGBUF_Write( &stRing, &byData, 1 ) )
+			&& ( 1 == RINGBUF_Read( &stRing, abyOut, sizeof( abyOut ) ) ) && ( 0x5A == abyOut[0] );
+	bOk = Check( "drop on overflow", bCase ) && bOk;
+
+	return bOk;
+}
+
+/* ************************************************************************** */
+static bool CheckWrap( const uint32_t uiStart )
+{
+	stRINGBUF_Ctx_t stRing;
+	uint8_t abyIn[ RING_SIZE ];
+	uint8_t abyOut[ RING_SIZE ];
+	uint32_t uiRound;
+	uint32_t uiIndex;
+	uint32_t uiLen;
+	uint32_t uiGot;
+	uint8_t byNextIn = 0;
+	uint8_t byNextOut = 0;
+	uint32_t uiUsed = 0;
+	char acName[ 40 ];
+	bool bOk = true;
+
+	// Start the free running indices wherever asked, as a ring that has been
+	// in use that long would have them
+	RINGBUF_Create( &stRing, abyStorage, RING_SIZE );
+	stRing.uiHead = uiStart;
+	stRing.uiTail = uiStart;
+
+	// Write and read lengths that don't divide the size, so the copies land
+	// on every offset and split at the end of the buffer in every way, with
+	// the fill level moving around between empty and full
+	for ( uiRound = 0; ( uiRound < WALK_ROUNDS ) && bOk; uiRound++ )
+	{
+		uiLen = ( ( uiRound * 7 ) + 3 ) % ( RING_SIZE + 1 );
+
+		for ( uiIndex = 0; uiIndex < uiLen; uiIndex++ )
+		{
+			abyIn[ uiIndex ] = (uint8_t)( byNextIn + uiIndex );
+		}
+
+		uiGot = RINGBUF_Write( &stRing, abyIn, uiLen );
+		bOk = ( uiGot == ( ( uiLen < ( RING_SIZE - uiUsed ) ) ? uiLen : ( RING_SIZE - uiUsed ) ) );
+		byNextIn = (uint8_t)( byNextIn + uiGot );
+		uiUsed += uiGot;
+
+		uiLen = ( ( uiRound * 5 ) + 1 ) % ( RING_SIZE + 1 );
+		uiGot = RINGBUF_Read( &stRing, abyOut, uiLen );
+		bOk = bOk && ( uiGot == ( ( uiLen < uiUsed ) ? uiLen : uiUsed ) );
+		uiUsed -= uiGot;
+
+		for ( uiIndex = 0; uiIndex < uiGot; uiIndex++ )
+		{
+			bOk = bOk && ( byNextOut++ == abyOut[ uiIndex ] );
+		}
+
+		bOk = bOk && ( uiUsed == RINGBUF_Used( &stRing ) ) && ( ( RING_SIZE - uiUsed ) == RINGBUF_Free( &stRing ) );
+	}
+
+	snprintf( acName, sizeof( acName ), "wrap from 0x%08X", (unsigned)uiStart );
+
+	return Check( acName, bOk );
+}
+
+/* ************************************************************************** */
+static bool Check( const char *pcName, const bool bOk )
+{
+	printf( "%-24s %s\n", pcName, bOk ? "ok" : "FAILED" );
+
+	return bOk;
+}
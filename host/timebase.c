@@ -0,0 +1,34 @@
+/*
+ * Host stand-in for timebase.c, see "make host".
+ *
+ * CLOCK_MONOTONIC in microseconds from TIMEBASE_Setup, the same wrap and the
+ * same differences as the target's.
+ */
+
+#include "timebase.h"
+
+#include <stdint.h>
+#include <time.h>
+
+static uint64_t uiStart_us;
+
+static uint64_t Monotonic_us( void );
+
+void TIMEBASE_Setup( void )
+{
+	uiStart_us = Monotonic_us();
+}
+
+uint32_t TIMEBASE_Now_us( void )
+{
+	return (uint32_t)( Monotonic_us() - uiStart_us );
+}
+
+static uint64_t Monotonic_us( void )
+{
+	struct timespec stNow;
+
+	clock_gettime( CLOCK_MONOTONIC, &stNow );
+
+	return ( (uint64_t)stNow.tv_sec * 1000000ULL ) + ( (uint64_t)stNow.tv_nsec / 1000 );
+}
@@ -0,0 +1,162 @@
+/*
+ * uart.c
+ *
+ * Host stand-in for uart.c, see "make host". The UART is the master side of a
+ * pseudo terminal, uart_init() prints the slave's path so a ground station or
+ * "screen" can be pointed at it as if it were the ESP link.
+ *
+ * Nothing here blocks the calling thread in the kernel, the POSIX port runs
+ * one task thread at a time and a blocked read would stall the scheduler.
+ */
+
+#define _GNU_SOURCE
+
+#include "uart.h"
+#include "common.h"
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+static int iMasterFd = -1;
+static eUartTxOverflow_t eTxOverflow;
+static stUartStats_t stStats;
+
+void uart_init( const UART_MemMapPtr channel, const uint32_t baud )
+{
+	struct termios stTermios;
+
+	eTxOverflow = UART_TX_OVERFLOW_DROP;
+	memset( &stStats, 0, sizeof( stStats ) );
+
+	iMasterFd = posix_openpt( O_RDWR | O_NOCTTY | O_NONBLOCK );
+
+	if (    ( 0 > iMasterFd )
+		 || ( 0 != grantpt( iMasterFd ) )
+		 || ( 0 != unlockpt( iMasterFd ) ) )
+	{
+		perror( "uart: pty" );
+		exit( EXIT_FAILURE );
+	}
+
+	// Raw 8 bit bytes both ways, mavlink is binary. The baud rate means
+	// nothing to a pty.
+	if ( 0 == tcgetattr( iMasterFd, &stTermios ) )
+	{
+		cfmakeraw( &stTermios );
+		tcsetattr( iMasterFd, TCSANOW, &stTermios );
+	}
+
+	fprintf( stderr, "uart: %u baud link on %s\n", (unsigned)baud, ptsname( iMasterFd ) );
+}
+
+char uart_getchar( const UART_MemMapPtr channel )
+{
+	int iChar;
+
+	// Poll rather than block, giving the other tasks a tick between tries
+	while ( 0 > ( iChar = uart_getchar_nonblock( channel ) ) )
+	{
+		vTaskDelay( 1 );
+	}
+
+	return (char)iChar;
+}
+
+int uart_getchar_nonblock( const UART_MemMapPtr channel )
+{
+	uint8_t byData;
+
+	if ( 1 != uart_read( channel, &byData, 1 ) )
+	{
+		return -1;
+	}
+
+	return byData;
+}
+
+size_t uart_read( const UART_MemMapPtr channel, void *const pvData, const size_t sMax )
+{
+	ssize_t sRead;
+
+	do
+	{
+		sRead = read( iMasterFd, pvData, sMax );
+	}
+	while ( ( 0 > sRead ) && ( EINTR == errno ) );
+
+	// EAGAIN is an empty ring, EIO means nothing has the slave open
+	if ( 0 >= sRead )
+	{
+		return 0;
+	}
+
+	stStats.uiRxBytes += (uint32_t)sRead;
+
+	return (size_t)sRead;
+}
+
+size_t uart_write( const UART_MemMapPtr channel, const void *const pvData, const size_t sLen )
+{
+	const uint8_t *pbyData = (const uint8_t*)pvData;
+	size_t sQueued = 0;
+	ssize_t sWritten;
+
+	while ( sQueued < sLen )
+	{
+		sWritten = write( iMasterFd, pbyData + sQueued, sLen - sQueued );
+
+		if ( 0 < sWritten )
+		{
+			sQueued += (size_t)sWritten;
+		}
+		else if ( ( 0 > sWritten ) && ( EINTR == errno ) )
+		{
+			continue;
+		}
+		else if (    ( UART_TX_OVERFLOW_WAIT == eTxOverflow )
+				  && ( EAGAIN == errno )
+				  && ( taskSCHEDULER_RUNNING == xTaskGetSchedulerState() ) )
+		{
+			// The pty's buffer is the tx ring, wait for the reader to drain it
+			vTaskDelay( 1 );
+		}
+		else
+		{
+			stStats.uiTxDropped += sLen - sQueued;
+			break;
+		}
+	}
+
+	stStats.uiTxBytes += sQueued;
+
+	return sQueued;
+}
+
+void uart_set_tx_overflow( const UART_MemMapPtr channel, const eUartTxOverflow_t eOverflow )
+{
+	eTxOverflow = eOverflow;
+}
+
+void uart_get_stats( const UART_MemMapPtr channel, stUartStats_t *const pstStats )
+{
+	taskENTER_CRITICAL();
+	*pstStats = stStats;
+	taskEXIT_CRITICAL();
+}
+
+void uart_putchar( const UART_MemMapPtr channel, const char ch )
+{
+	uart_write( channel, &ch, 1 );
+}
+
+void uart_puts( UART_MemMapPtr channel, const char *const s )
+{
+	uart_write( channel, s, strlen( s ) );
+}
@@ -27,12 +27,29 @@
 #include "common.h"
 #include "string.h"
 
+#include "FreeRTOS.h"		// FreeRTOS
+#include "task.h"			// taskENTER_CRITICAL()
+#include "semphr.h"			// Transfer complete semaphore
+
+/* Longest we will sleep waiting for a transfer, a full 192 byte FIFO burst takes ~5ms at our 375kHz bus speed */
+#define I2C_TIMEOUT_MS ( 20 )
+
 /* Pointer to the base of our I2C device's memory address */
 static I2C_MemMapPtr i2c_base_ptrs[] = I2C_BASE_PTRS;
 
 /* Some local metadata about the channels */
 volatile I2C_Channel i2c_channels[I2C_NUMBER_OF_DEVICES];
 
+/* Given from the ISR when a blocking transfer finishes, successfully or not */
+static SemaphoreHandle_t i2c_complete[I2C_NUMBER_OF_DEVICES];
+
+/* Per bus transfer and error counters */
+static volatile I2C_Stats i2c_stats[I2C_NUMBER_OF_DEVICES];
+
+static int32_t i2c_start( uint32_t channel_number );
+static bool i2c_next_job( volatile I2C_Channel *channel );
+static int i2c_transfer( const uint32_t channel_number, uint16_t *sequence, uint32_t sequence_length, uint8_t *received_data );
+
 /**
  * Initializes the i2c module.
  * @param[in]	Index of the I2C module to use.
@@ -45,15 +62,23 @@ uint32_t i2c_init( uint8_t i2c_number, uint8_t mult, uint8_t icr )
 
 	DisableInterrupts;
 
-	// Enable interrupt in NVIC and set priority to 0
+	// Enable interrupt in NVIC and set priority to 5
 	// See the vector channel assignments in K20P121M100SF2RM.pdf page 69
 	// The interupt for I2C0 is number 79:
 	// 24 / 32 = 0
 	// 24 % 32 = 24
 	// Therefore we choose the 0th register and set bit 24 (INT_I2C0 - 16)
+	// The completion callback gives a semaphore so the priority must be
+	// numerically >= configMAX_SYSCALL_INTERRUPT_PRIORITY.
 	NVICICPR0 |= ( 1 << 24 );
 	NVICISER0 |= ( 1 << 24 );
-	NVICIP24 = 0x00;
+	NVICIP24 = 0x50;
+
+	if ( NULL == i2c_complete[i2c_number] )
+	{
+		i2c_complete[i2c_number] = xSemaphoreCreateBinary();
+	}
+	memset( (void*)&i2c_stats[i2c_number], 0, sizeof( I2C_Stats ) );
 
 	SIM_SCGC4 |= SIM_SCGC4_I2C0_MASK;
 	SIM_SCGC5 |= SIM_SCGC5_PORTB_MASK;
@@ -88,10 +113,10 @@ int32_t i2c_send_sequence( uint32_t channel_number,
 						   void *user_data )
 {
 	volatile I2C_Channel *channel = &(i2c_channels[channel_number]);
-	I2C_MemMapPtr i2c = i2c_base_ptrs[channel_number];
 
 	if ( channel->status == I2C_BUSY )
 	{
+		i2c_stats[channel_number].errors++;
 		return -1;
 	}
 
@@ -99,11 +124,67 @@ int32_t i2c_send_sequence( uint32_t channel_number,
 	channel->sequence = sequence;
 	channel->sequence_end = sequence + sequence_length;
 	channel->received_data = received_data;
+	channel->job = NULL;
+	channel->job_end = NULL;
+	channel->status = I2C_BUSY;
+	channel->txrx = I2C_WRITING;
+	channel->callback_fn = callback_fn;
+	channel->user_data = user_data;
+
+	return i2c_start( channel_number );
+}
+
+/** Send a list of sequences, joined by repeated starts
+ *
+ */
+int32_t i2c_send_jobs( uint32_t channel_number,
+					   I2C_Job *jobs,
+					   uint32_t job_count,
+					   void (*callback_fn)(void*),
+					   void *user_data )
+{
+	volatile I2C_Channel *channel = &(i2c_channels[channel_number]);
+	I2C_Job *job = jobs;
+	I2C_Job *job_end = jobs + job_count;
+
+	/* Skip any jobs that have been emptied out */
+	while ( ( job < job_end ) && ( 0 == job->sequence_length ) )
+	{
+		job++;
+	}
+
+	if ( job == job_end )
+	{
+		return -1;
+	}
+
+	if ( channel->status == I2C_BUSY )
+	{
+		i2c_stats[channel_number].errors++;
+		return -1;
+	}
+
+	channel->sequence = job->sequence;
+	channel->sequence_end = job->sequence + job->sequence_length;
+	channel->received_data = job->received_data;
+	channel->job = job;
+	channel->job_end = job_end;
 	channel->status = I2C_BUSY;
 	channel->txrx = I2C_WRITING;
 	channel->callback_fn = callback_fn;
 	channel->user_data = user_data;
 
+	return i2c_start( channel_number );
+}
+
+/** Generate the START and write the address byte of a sequence already loaded into the channel
+ *
+ */
+static int32_t i2c_start( uint32_t channel_number )
+{
+	volatile I2C_Channel *channel = &(i2c_channels[channel_number]);
+	I2C_MemMapPtr i2c = i2c_base_ptrs[channel_number];
+
 	i2c->S |= I2C_S_IICIF_MASK; /* Acknowledge the interrupt request, just in case */
 	i2c->C1 = (I2C_C1_IICEN_MASK | I2C_C1_IICIE_MASK);
 
@@ -116,6 +197,7 @@ int32_t i2c_send_sequence( uint32_t channel_number,
 		/* Error, send sequence cleanup */
 		i2c->C1 &= ~(I2C_C1_IICIE_MASK | I2C_C1_MST_MASK | I2C_C1_TX_MASK);
 		channel->status = I2C_ERROR;
+		i2c_stats[channel_number].errors++;
 
 		return -1;
 	}
@@ -128,34 +210,118 @@ int32_t i2c_send_sequence( uint32_t channel_number,
 	return 0;
 }
 
-static bool complete_flag = false;
+/** Move a job list on to its next non-empty job, called from the ISR when the current sequence runs out
+ *
+ * Returns true with the channel pointing at the new sequence, or false if there is nothing left to send (which is
+ * always the case for a plain sequence).
+ */
+static bool i2c_next_job( volatile I2C_Channel *channel )
+{
+	I2C_Job *job = channel->job;
+
+	if ( NULL == job )
+	{
+		return false;
+	}
 
-void my_callback_from_ISR(void *data)
+	/* Let the job patch the ones after it before we look at their lengths */
+	if ( NULL != job->done_fn )
+	{
+		(*job->done_fn)( job );
+	}
+
+	do
+	{
+		job++;
+	}
+	while ( ( job < channel->job_end ) && ( 0 == job->sequence_length ) );
+
+	if ( job >= channel->job_end )
+	{
+		channel->job = NULL;
+		return false;
+	}
+
+	channel->job = job;
+	channel->sequence = job->sequence;
+	channel->sequence_end = job->sequence + job->sequence_length;
+	channel->received_data = job->received_data;
+
+	return true;
+}
+
+static void i2c_complete_from_ISR( void *data )
 {
-	/* This callback function gets called once the sequence has been processed. Note that this gets called from an ISR, so
-	   it should do as little as possible. */
-	complete_flag = true;
+	/* This callback function gets called once the sequence has been processed or has failed. Note that this gets called
+	   from an ISR, so it should do as little as possible. */
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	xSemaphoreGiveFromISR( i2c_complete[(uintptr_t)data], &xHigherPriorityTaskWoken );
+	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
 }
 
-int i2c_read_byte( const uint32_t channel_number,
-				   const uint8_t device,
-				   const uint8_t addr,
-				   uint8_t *const data )
+static int i2c_transfer( const uint32_t channel_number,
+						 uint16_t *sequence,
+						 uint32_t sequence_length,
+						 uint8_t *received_data )
 {
-	uint32_t status;
-	uint16_t init_sequence[] = { ( device << 1 ) | I2C_WRITING, addr, I2C_RESTART, ( device << 1 ) | I2C_READING, I2C_READ };
+	volatile I2C_Channel *channel = &(i2c_channels[channel_number]);
+	int32_t status;
 
-	complete_flag = false;
+	/* Drop any completion left over from a transfer we gave up on */
+	xSemaphoreTake( i2c_complete[channel_number], 0 );
+
+	status = i2c_send_sequence( channel_number, sequence, sequence_length, received_data, i2c_complete_from_ISR,
+								(void*)(uintptr_t)channel_number );
+
+	if ( 0 != status )
+	{
+		return -1;
+	}
 
-	status = i2c_send_sequence( channel_number, init_sequence, 5, data, my_callback_from_ISR, (void*)0x1234 );
+	/* Sleep until the ISR has walked the whole sequence, letting lower priority tasks run in the meantime */
+	if ( pdTRUE != xSemaphoreTake( i2c_complete[channel_number], pdMS_TO_TICKS( I2C_TIMEOUT_MS ) ) )
+	{
+		/* The sequence lives on our stack so make sure the ISR is done with it before we return */
+		i2c_abort( channel_number );
+		i2c_stats[channel_number].timeouts++;
+		return -1;
+	}
 
-	if ( 0 == status )
+	if ( I2C_ERROR == channel->status )
 	{
-		/* Block until the I2C transaction has completed */
-		while ( false == complete_flag );
+		return -1;
 	}
 
-	return status;
+	return 0;
+}
+
+void i2c_abort( const uint32_t channel_number )
+{
+	I2C_MemMapPtr i2c = i2c_base_ptrs[channel_number];
+
+	taskENTER_CRITICAL();
+
+	/* Generate STOP and disable further interrupts */
+	i2c->C1 &= ~(I2C_C1_MST_MASK | I2C_C1_IICIE_MASK | I2C_C1_TXAK_MASK);
+	i2c_channels[channel_number].status = I2C_ERROR;
+
+	taskEXIT_CRITICAL();
+}
+
+void i2c_get_stats( const uint32_t channel_number, I2C_Stats *const stats )
+{
+	*stats = i2c_stats[channel_number];
+}
+
+int i2c_read_byte( const uint32_t channel_number,
+				   const uint8_t device,
+				   const uint8_t addr,
+				   uint8_t *const data )
+{
+	uint16_t init_sequence[] = { ( device << 1 ) | I2C_WRITING, addr, I2C_RESTART, ( device << 1 ) | I2C_READING, I2C_READ };
+
+	return i2c_transfer( channel_number, init_sequence, 5, data );
 }
 
 int i2c_read_bytes( const uint32_t channel_number,
@@ -164,10 +330,14 @@ int i2c_read_bytes( const uint32_t channel_number,
 					uint8_t *const data,
 					size_t count )
 {
-	uint32_t status;
 	size_t index;
-	uint16_t sequence[20] = { ( device << 1 ) | I2C_WRITING, addr, I2C_RESTART, ( device << 1 ) | I2C_READING };
-	uint8_t offset = 4;
+	uint16_t sequence[4 + I2C_READ_BYTES_MAX] = { ( device << 1 ) | I2C_WRITING, addr, I2C_RESTART, ( device << 1 ) | I2C_READING };
+	size_t offset = 4;
+
+	if ( ( 0 == count ) || ( I2C_READ_BYTES_MAX < count ) )
+	{
+		return -1;
+	}
 
 	// Fill in the number of reads we have been requested...
 	for ( index = 0; index < count; index++ )
@@ -176,16 +346,7 @@ int i2c_read_bytes( const uint32_t channel_number,
 		offset++;
 	}
 
-	complete_flag = false;
-	status = i2c_send_sequence( channel_number, sequence, offset, data, my_callback_from_ISR, (void*)0x1234 );
-
-	if ( 0 == status )
-	{
-		/* Block until the I2C transaction has completed */
-		while ( false == complete_flag );
-	}
-
-	return status;
+	return i2c_transfer( channel_number, sequence, offset, data );
 }
 
 int i2c_write_byte( const uint32_t channel_number,
@@ -193,20 +354,9 @@ int i2c_write_byte( const uint32_t channel_number,
 					const uint8_t addr,
 					const uint8_t data )
 {
-	uint32_t status;
 	uint16_t sequence[] = { ( device << 1 ) | I2C_WRITING, addr, data };
 
-	complete_flag = false;
-
-	status = i2c_send_sequence( channel_number, sequence, 3, NULL, my_callback_from_ISR, (void*)0x1234 );
-
-	if ( 0 == status )
-	{
-		/* Block until the I2C transaction has completed */
-		while ( false == complete_flag );
-	}
-
-	return status;
+	return i2c_transfer( channel_number, sequence, 3, NULL );
 }
 
 void I2C0_IRQHandler( void )
@@ -287,6 +437,14 @@ void I2C0_IRQHandler( void )
 						element = *channel->sequence;
 						i2c->D = element;
 					}
+					else if ( i2c_next_job( channel ) )
+					{
+						/* Chain straight on to the next job of the list. Its sequence begins with an address write, which is
+						   sent after the repeated start (issue 6070 above does not affect the K20). */
+						i2c->C1 |= I2C_C1_RSTA_MASK;
+						channel->txrx = I2C_WRITING;
+						i2c->D = *channel->sequence;
+					}
 					else
 					{
 						goto i2c_isr_stop;
@@ -317,7 +475,22 @@ void I2C0_IRQHandler( void )
 			/* First, check if we are at the end of a sequence. */
 			if ( channel->sequence == channel->sequence_end )
 			{
-				goto i2c_isr_stop;
+				/* Within a job list the final write of a job must have been ACKed before we move on. */
+				if ( ( NULL != channel->job ) && ( status & I2C_S_RXAK_MASK ) )
+				{
+					goto i2c_isr_error;
+				}
+
+				if ( !i2c_next_job( channel ) )
+				{
+					goto i2c_isr_stop;
+				}
+
+				/* Repeated start into the next job, the first element is its address write. */
+				i2c->C1 |= I2C_C1_RSTA_MASK | I2C_C1_TX_MASK;
+				i2c->D = *channel->sequence;
+				channel->sequence++;
+				continue;
 			}
 
 			if ( status & I2C_S_RXAK_MASK )
@@ -387,6 +560,7 @@ i2c_isr_stop:
 		/* Generate STOP (set MST=0), switch to RX mode, and disable further interrupts. */
 		i2c->C1 &= ~(I2C_C1_MST_MASK | I2C_C1_IICIE_MASK | I2C_C1_TXAK_MASK);
 		channel->status = I2C_AVAILABLE;
+		i2c_stats[channel_number].transfers++;
 
 		/* Call the user-supplied callback function upon successful completion (if it exists). */
 		if ( NULL != channel->callback_fn )
@@ -397,7 +571,15 @@ i2c_isr_stop:
 
 i2c_isr_error:
 		i2c->C1 &= ~(I2C_C1_MST_MASK | I2C_C1_IICIE_MASK); /* Generate STOP and disable further interrupts. */
+		channel->job = NULL;
 		channel->status = I2C_ERROR;
+		i2c_stats[channel_number].errors++;
+
+		/* Let the waiter know straight away rather than leaving it to time out. */
+		if ( NULL != channel->callback_fn )
+		{
+			(*channel->callback_fn)( channel->user_data );
+		}
 		continue;
 	}
 }
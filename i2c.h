@@ -38,10 +38,21 @@
 #define I2C_BUSY 1
 #define I2C_ERROR 2
 
+/* One entry in a job list, see i2c_send_jobs(). */
+typedef struct I2C_Job {
+  uint16_t *sequence;
+  uint32_t sequence_length;	/* 0 skips the job */
+  uint8_t *received_data;
+  void (*done_fn)(struct I2C_Job *job);	/* Optional, called from the ISR once this job has finished */
+  void *user_data;			/* For done_fn, e.g. the job whose length it patches */
+} I2C_Job;
+
 typedef struct {
   uint16_t *sequence;
   uint16_t *sequence_end;
   uint8_t *received_data;
+  I2C_Job *job;
+  I2C_Job *job_end;
   void (*callback_fn)(void*);
   void *user_data;
   uint8_t reads_ahead;
@@ -51,6 +62,13 @@ typedef struct {
 
 extern volatile I2C_Channel i2c_channels[I2C_NUMBER_OF_DEVICES];
 
+/* Per bus counters, a job list counts as a single transfer. */
+typedef struct {
+  uint32_t transfers;	/* Sequences that completed successfully */
+  uint32_t errors;		/* Sequences refused (bus busy), NACKed or that lost arbitration */
+  uint32_t timeouts;	/* Sequences that did not complete within the timeout and were aborted */
+} I2C_Stats;
+
 /*
   Initializes the I2C device number i2c_number. Devices are numbered starting from 0, most Kinetis microcontrollers have
   only one I2C device. If you have more than one I2C module, remember to define I2C_NUMBER_OF_DEVICES appropriately (see
@@ -79,15 +97,49 @@ uint32_t i2c_init(uint8_t i2c_number, uint8_t mult, uint8_t icr);
   received_data should point to a buffer that can hold as many bytes as there are I2C_READ operations in the
   sequence. If there are no reads, 0 can be passed, as this parameter will not be used.
 
-  callback_fn is a pointer to a function that will get called upon successful completion of the entire sequence. If 0 is
-  supplied, no function will be called. Note that the function will be called fron an interrupt handler, so it should do
-  the absolute minimum possible (such as enqueue an event to be processed later, set a flag, exit sleep mode, etc.)
+  callback_fn is a pointer to a function that will get called upon completion of the entire sequence, or when the
+  sequence is aborted because of a NACK or lost arbitration (the channel status is then I2C_ERROR). If 0 is supplied, no
+  function will be called. Note that the function will be called fron an interrupt handler, so it should do the
+  absolute minimum possible (such as enqueue an event to be processed later, set a flag, exit sleep mode, etc.)
 
   user_data is a pointer that will be passed to the callback_fn.
 */
 int32_t i2c_send_sequence(uint32_t channel_number, uint16_t *sequence, uint32_t sequence_length, uint8_t *received_data,
 						  void (*callback_fn)(void*), void *user_data);
 
+/*
+  Sends a list of sequences back to back from the interrupt handler, each job's reads landing in its own received_data
+  buffer. Jobs are joined with a repeated start rather than a STOP/START, so every sequence must begin with an address
+  write, and callback_fn is called only once, after the last job (or on the first failure).
+
+  A job's done_fn, if set, is called from the ISR as soon as that job finishes and before the next one starts. It may
+  change the sequence_length of any later job, which lets a read size depend on a value read earlier in the same list
+  (e.g. a FIFO count). The largest length must still fit the sequence buffer, a length of 0 skips the job.
+
+  This may be called from an interrupt handler of lower priority than the I2C interrupt. The jobs and their buffers
+  must remain valid until callback_fn has been called. Returns 0 if the list was started or -1 if the bus was busy or
+  there was nothing to send.
+*/
+int32_t i2c_send_jobs(uint32_t channel_number, I2C_Job *jobs, uint32_t job_count, void (*callback_fn)(void*),
+					  void *user_data);
+
+/*
+  Stops whatever the channel is doing and marks it I2C_ERROR, no callback is made. Use this to reclaim the buffers of
+  an i2c_send_sequence() or i2c_send_jobs() call that never completed.
+*/
+void i2c_abort( const uint32_t channel_number );
+
+/*
+  The helpers below submit a sequence and then block the calling task on a semaphore given from the I2C interrupt, so
+  other tasks run while the bus is busy. They must be called from a task (not before the scheduler starts) and give up
+  after a bounded timeout. All return 0 on success or -1 on failure.
+*/
+
+/**
+ * Fills in the transfer and error counters for a bus.
+ */
+void i2c_get_stats( const uint32_t channel_number, I2C_Stats *const stats );
+
 /**
  * Performs a blocking read of a single byte.
  */
@@ -96,6 +148,12 @@ int i2c_read_byte( const uint32_t channel_number,
 				   const uint8_t addr,
 				   uint8_t *const data );
 
+/* Largest burst i2c_read_bytes() will perform, enough to drain a full 32 sample x/y/z sensor FIFO in one go. */
+#define I2C_READ_BYTES_MAX ( 32 * 6 )
+
+/**
+ * Performs a blocking auto-incrementing read of up to I2C_READ_BYTES_MAX bytes.
+ */
 int i2c_read_bytes( const uint32_t channel_number,
 					const uint8_t device,
 					const uint8_t addr,
@@ -76,6 +76,9 @@ static chanOutCtx_t chanOutCtxList[] =
 	{ FTM0_BASE_PTR, 3, PTC_BASE_PTR, 4, 12000 },
 };
 
+static pfnIODRIVER_PinIrq pfnGyroDrdyIrq = NULL;
+static void *pvGyroDrdyUserState = NULL;
+
 static void initFTM0( void );
 static void initFTM1( void );
 
@@ -181,6 +184,90 @@ int IODRIVER_SetOutputPulseWidth( int channel, uint32_t pulseDurationTicks )
 	}
 }
 
+/**
+ * @brief		Routes the LSM9DS0's DRDY_G line (PTD2, Teensy pin 7) to a
+ * 				rising edge interrupt.
+ *
+ * The callback is run from interrupt context at a priority that is allowed to
+ * use the FreeRTOS "FromISR" API.
+ *
+ * @param[in]	pfnIrq		Called on every rising edge of DRDY_G.
+ * @param[in]	pvUserState	The state to pass back to the callback.
+ */
+void IODRIVER_SetupGyroDataReady( pfnIODRIVER_PinIrq pfnIrq, void *const pvUserState )
+{
+	DisableInterrupts;
+
+	pfnGyroDrdyIrq = pfnIrq;
+	pvGyroDrdyUserState = pvUserState;
+
+	SIM_SCGC5 |= SIM_SCGC5_PORTD_MASK;
+
+	// GPIO input (alt = 1), interrupt on rising edge, clear any stale flag
+	PORTD_PCR2 = ( PORT_PCR_MUX( 0x1 ) | PORT_PCR_IRQC( 0x9 ) | PORT_PCR_ISF_MASK );
+	GPIOD_PDDR &= ~( 1 << 2 );
+
+	// Enable interrupt in NVIC, INT_PORTD is 106 so IRQ 90:
+	// 90 / 32 = 2
+	// 90 % 32 = 26
+	// Priority must be numerically >= configMAX_SYSCALL_INTERRUPT_PRIORITY
+	// as the callback talks to the kernel.
+	NVICICPR2 |= ( 1 << 26 );
+	NVICISER2 |= ( 1 << 26 );
+	NVICIP90 = 0x60;
+
+	EnableInterrupts;
+
+	return;
+}
+
+/**
+ * @brief		The level of the DRDY_G line, which stays high without a new
+ * 				edge while the gyro FIFO is above its watermark.
+ * @return		True if high.
+ */
+bool IODRIVER_GyroDataReady( void )
+{
+	return ( 0 != ( GPIOD_PDIR & ( 1 << 2 ) ) );
+}
+
+/**
+ * @brief		Turns the on board LED on or off, main() sets the pin up.
+ * @param[in]	bState		True for on.
+ */
+void IODRIVER_SetLed( const bool bState )
+{
+	if ( true == bState )
+	{
+		GPIOC_PSOR = ( 1 << 5 );
+	}
+	else
+	{
+		GPIOC_PCOR = ( 1 << 5 );
+	}
+
+	return;
+}
+
+/**
+ * @brief		ISR handler for port D pin interrupts.
+ */
+void PORTD_IRQHandler( void )
+{
+	if ( 0 != ( PORTD_ISFR & ( 1 << 2 ) ) )
+	{
+		// Clear the flag (write 1 to clear)
+		PORTD_ISFR = ( 1 << 2 );
+
+		if ( NULL != pfnGyroDrdyIrq )
+		{
+			pfnGyroDrdyIrq( pvGyroDrdyUserState );
+		}
+	}
+
+	return;
+}
+
 /**
  * @brief		ISR handler for FTM 0 and 1.
  */
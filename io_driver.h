@@ -2,6 +2,7 @@
 #define RECEIVER_H
 
 #include <stdint.h>
+#include <stdbool.h>
 
 #define RECEIVER_FTMCLK			( 48000000 )						// 24MHz
 #define RECEIVER_FTMDIV			( 4 )
@@ -16,11 +17,16 @@
 #define RECEIVER_NUM_CHAN_IN	( 6 )
 #define RECEIVER_NUM_CHAN_OUT	( 4 )
 
+typedef void (*pfnIODRIVER_PinIrq)( void *const pvUserState );
+
 void IODRIVER_Setup( void );
 void IODRIVER_FTM_ISR( void );
 void IODRIVER_Tick( uint32_t interval_millis );
 uint32_t IODRIVER_GetInputPulseWidth( int channel );
 int IODRIVER_GetOutputPulseWidth( int channel, uint32_t *pulseDurationTicks );
 int IODRIVER_SetOutputPulseWidth( int channel, uint32_t pulseDurationTicks );
+void IODRIVER_SetupGyroDataReady( pfnIODRIVER_PinIrq pfnIrq, void *const pvUserState );
+bool IODRIVER_GyroDataReady( void );
+void IODRIVER_SetLed( const bool bState );
 
 #endif
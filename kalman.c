@@ -4,8 +4,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
-#include <math.h>		// <- TODO how efficient is this - used for atan2() (see below)?
+#include <math.h>		// fabsf
 #include <kalman.h>
+#include "fixmath.h"
 
 #include <vector3f.h>
 
@@ -15,6 +16,9 @@
 #define fRatioAccel			( 1 - fRatioGyro )
 
 static float GetMag( float x, float y, float z );
+static void CheckSteady( stKALMAN_Cxt_t *pstCxt, const float K[2], const float dt );
+static void CheckSteadyQ( stKALMAN_Q_Cxt_t *pstCxt, const q30_t K[2], const q30_t dt );
+static int32_t AbsQ( const int32_t x );
 
 /* ************************************************************************** */
 void KALMAN_Setup( stKALMAN_Cxt_t *pstCxt )
@@ -31,6 +35,13 @@ void KALMAN_Setup( stKALMAN_Cxt_t *pstCxt )
 	pstCxt->P[0][1] = 0.0f;
 	pstCxt->P[1][0] = 0.0f;
 	pstCxt->P[1][1] = 0.0f;
+
+	pstCxt->K[0] = 0.0f;
+	pstCxt->K[1] = 0.0f;
+	pstCxt->fSteadyDt = 0.0f;
+	pstCxt->uiSettled = 0;
+	pstCxt->bSteadyState = false;
+	pstCxt->bSteady = false;
 }
 
 /* ************************************************************************** */
@@ -45,6 +56,20 @@ float KALMAN_Update( stKALMAN_Cxt_t *pstCxt,
 	pstCxt->rate = newRate - pstCxt->bias;
 	pstCxt->angle += dt * pstCxt->rate;
 
+	// Converged, P would come out as it went in, see KALMAN_SetSteadyState
+	if ( pstCxt->bSteady
+		 && ( ( pstCxt->fSteadyDt * ( 1.0f / ( 1 << KALMAN_STEADY_DT_SHIFT ) ) ) >= fabsf( dt - pstCxt->fSteadyDt ) ) )
+	{
+		float y = newAngle - pstCxt->angle;
+
+		pstCxt->angle += pstCxt->K[0] * y;
+		pstCxt->bias += pstCxt->K[1] * y;
+
+		return pstCxt->angle;
+	}
+
+	pstCxt->bSteady = false;
+
 	// Update estimation error covariance - Project the error covariance ahead
 	/* Step 2 */
 	pstCxt->P[0][0] += dt * (dt*pstCxt->P[1][1] - pstCxt->P[0][1] - pstCxt->P[1][0] + pstCxt->Q_angle);
@@ -61,6 +86,8 @@ float KALMAN_Update( stKALMAN_Cxt_t *pstCxt,
 	K[0] = pstCxt->P[0][0] / S;
 	K[1] = pstCxt->P[1][0] / S;
 
+	CheckSteady( pstCxt, K, dt );
+
 	// Calculate angle and bias - Update estimate with measurement zk (newAngle)
 	/* Step 3 */
 	float y = newAngle - pstCxt->angle; // Angle difference
@@ -76,13 +103,232 @@ float KALMAN_Update( stKALMAN_Cxt_t *pstCxt,
 	pstCxt->P[0][0] -= K[0] * P00_temp;
 	pstCxt->P[0][1] -= K[0] * P01_temp;
 	pstCxt->P[1][0] -= K[1] * P00_temp;
-	pstCxt->P[1][1] -= K[1] * P01_temp; ;
+	pstCxt->P[1][1] -= K[1] * P01_temp;
 
 	return pstCxt->angle;
 }
 
+/* ************************************************************************** */
+void KALMAN_SetNoise( stKALMAN_Cxt_t *pstCxt, const float fQAngle, const float fQBias, const float fRMeasure )
+{
+	// The covariance is left alone, it settles to the new noise on its own.
+	// The gain does too, so it has to be worked out again until it does
+	if ( ( fQAngle != pstCxt->Q_angle ) || ( fQBias != pstCxt->Q_bias ) || ( fRMeasure != pstCxt->R_measure ) )
+	{
+		pstCxt->bSteady = false;
+		pstCxt->uiSettled = 0;
+	}
+
+	pstCxt->Q_angle = fQAngle;
+	pstCxt->Q_bias = fQBias;
+	pstCxt->R_measure = fRMeasure;
+
+	return;
+}
+
+/* ************************************************************************** */
+void KALMAN_SetSteadyState( stKALMAN_Cxt_t *pstCxt, const bool bEnable )
+{
+	pstCxt->bSteadyState = bEnable;
+	pstCxt->bSteady = false;
+	pstCxt->uiSettled = 0;
+
+	return;
+}
+
+/* ************************************************************************** */
+bool KALMAN_IsSteady( const stKALMAN_Cxt_t *pstCxt )
+{
+	return pstCxt->bSteady;
+}
+
+/* ************************************************************************** */
+void KALMAN_SetupQ( stKALMAN_Q_Cxt_t *pstCxt )
+{
+	pstCxt->Q_angle = FIXMATH_Q30( 0.001 );
+	pstCxt->Q_bias = FIXMATH_Q30( 0.003 );
+	pstCxt->R_measure = FIXMATH_Q30( 0.03 );
+
+	pstCxt->angle = 0;
+	pstCxt->bias = 0;
+	pstCxt->rate = 0;
+
+	pstCxt->P[0][0] = 0;
+	pstCxt->P[0][1] = 0;
+	pstCxt->P[1][0] = 0;
+	pstCxt->P[1][1] = 0;
+
+	pstCxt->K[0] = 0;
+	pstCxt->K[1] = 0;
+	pstCxt->qSteadyDt = 0;
+	pstCxt->uiSettled = 0;
+	pstCxt->bSteadyState = false;
+	pstCxt->bSteady = false;
+}
+
+/* ************************************************************************** */
+q16_t KALMAN_UpdateQ( stKALMAN_Q_Cxt_t *pstCxt,
+					  q16_t newRate,
+					  q16_t newAngle,
+					  q30_t dt )
+{
+	q30_t S;
+	q30_t K[2];
+	q16_t y;
+	q30_t P00_temp;
+	q30_t P01_temp;
+	q30_t dtP11;
+
+	// Same steps as KALMAN_Update, the covariance stays well inside Q30's +-2
+	/* Step 1 */
+	pstCxt->rate = newRate - pstCxt->bias;
+	pstCxt->angle += FIXMATH_MulQ16Q30( pstCxt->rate, dt );
+
+	if ( pstCxt->bSteady && ( ( pstCxt->qSteadyDt >> KALMAN_STEADY_DT_SHIFT ) >= AbsQ( dt - pstCxt->qSteadyDt ) ) )
+	{
+		y = newAngle - pstCxt->angle;
+		pstCxt->angle += FIXMATH_MulQ16Q30( y, pstCxt->K[0] );
+		pstCxt->bias += FIXMATH_MulQ16Q30( y, pstCxt->K[1] );
+
+		return pstCxt->angle;
+	}
+
+	pstCxt->bSteady = false;
+
+	/* Step 2 */
+	dtP11 = FIXMATH_Mul30( dt, pstCxt->P[1][1] );
+	pstCxt->P[0][0] += FIXMATH_Mul30( dt, dtP11 - pstCxt->P[0][1] - pstCxt->P[1][0] + pstCxt->Q_angle );
+	pstCxt->P[0][1] -= dtP11;
+	pstCxt->P[1][0] -= dtP11;
+	pstCxt->P[1][1] += FIXMATH_Mul30( pstCxt->Q_bias, dt );
+
+	/* Step 4 */
+	S = pstCxt->P[0][0] + pstCxt->R_measure;
+	/* Step 5 */
+	K[0] = FIXMATH_Div30( pstCxt->P[0][0], S );
+	K[1] = FIXMATH_Div30( pstCxt->P[1][0], S );
+
+	CheckSteadyQ( pstCxt, K, dt );
+
+	/* Step 3 */
+	y = newAngle - pstCxt->angle;
+	/* Step 6 */
+	pstCxt->angle += FIXMATH_MulQ16Q30( y, K[0] );
+	pstCxt->bias += FIXMATH_MulQ16Q30( y, K[1] );
+
+	/* Step 7 */
+	P00_temp = pstCxt->P[0][0];
+	P01_temp = pstCxt->P[0][1];
+
+	pstCxt->P[0][0] -= FIXMATH_Mul30( K[0], P00_temp );
+	pstCxt->P[0][1] -= FIXMATH_Mul30( K[0], P01_temp );
+	pstCxt->P[1][0] -= FIXMATH_Mul30( K[1], P00_temp );
+	pstCxt->P[1][1] -= FIXMATH_Mul30( K[1], P01_temp );
+
+	return pstCxt->angle;
+}
+
+/* ************************************************************************** */
+void KALMAN_SetNoiseQ( stKALMAN_Q_Cxt_t *pstCxt, const q30_t qQAngle, const q30_t qQBias, const q30_t qRMeasure )
+{
+	if ( ( qQAngle != pstCxt->Q_angle ) || ( qQBias != pstCxt->Q_bias ) || ( qRMeasure != pstCxt->R_measure ) )
+	{
+		pstCxt->bSteady = false;
+		pstCxt->uiSettled = 0;
+	}
+
+	pstCxt->Q_angle = qQAngle;
+	pstCxt->Q_bias = qQBias;
+	pstCxt->R_measure = qRMeasure;
+
+	return;
+}
+
+/* ************************************************************************** */
+void KALMAN_SetSteadyStateQ( stKALMAN_Q_Cxt_t *pstCxt, const bool bEnable )
+{
+	pstCxt->bSteadyState = bEnable;
+	pstCxt->bSteady = false;
+	pstCxt->uiSettled = 0;
+
+	return;
+}
+
+/* ************************************************************************** */
+bool KALMAN_IsSteadyQ( const stKALMAN_Q_Cxt_t *pstCxt )
+{
+	return pstCxt->bSteady;
+}
+
 /* ************************************************************************** */
 static float GetMag( float x, float y, float z )
 {
 	return sqrtf( x*x + y*y + z*z );
 }
+
+/* ************************************************************************** */
+static void CheckSteady( stKALMAN_Cxt_t *pstCxt, const float K[2], const float dt )
+{
+	float fTol0 = fabsf( pstCxt->K[0] ) * ( 1.0f / ( 1 << KALMAN_STEADY_SHIFT ) );
+	float fTol1 = fabsf( pstCxt->K[1] ) * ( 1.0f / ( 1 << KALMAN_STEADY_SHIFT ) );
+	float fTolDt = pstCxt->fSteadyDt * ( 1.0f / ( 1 << KALMAN_STEADY_DT_SHIFT ) );
+
+	// Held near where the count started over much the same timestep, anything
+	// else starts the count again from here
+	if ( ( fTolDt >= fabsf( dt - pstCxt->fSteadyDt ) )
+		 && ( fTol0 >= fabsf( K[0] - pstCxt->K[0] ) ) && ( fTol1 >= fabsf( K[1] - pstCxt->K[1] ) ) )
+	{
+		if ( KALMAN_STEADY_COUNT <= ++pstCxt->uiSettled )
+		{
+			// Freeze the latest, the closest to where it was heading
+			pstCxt->bSteady = pstCxt->bSteadyState;
+			pstCxt->uiSettled = KALMAN_STEADY_COUNT;
+			pstCxt->K[0] = K[0];
+			pstCxt->K[1] = K[1];
+		}
+	}
+	else
+	{
+		pstCxt->uiSettled = 0;
+		pstCxt->K[0] = K[0];
+		pstCxt->K[1] = K[1];
+		pstCxt->fSteadyDt = dt;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void CheckSteadyQ( stKALMAN_Q_Cxt_t *pstCxt, const q30_t K[2], const q30_t dt )
+{
+	int32_t iTol0 = AbsQ( pstCxt->K[0] ) >> KALMAN_STEADY_SHIFT;
+	int32_t iTol1 = AbsQ( pstCxt->K[1] ) >> KALMAN_STEADY_SHIFT;
+	int32_t iTolDt = pstCxt->qSteadyDt >> KALMAN_STEADY_DT_SHIFT;
+
+	if ( ( iTolDt >= AbsQ( dt - pstCxt->qSteadyDt ) )
+		 && ( iTol0 >= AbsQ( K[0] - pstCxt->K[0] ) ) && ( iTol1 >= AbsQ( K[1] - pstCxt->K[1] ) ) )
+	{
+		if ( KALMAN_STEADY_COUNT <= ++pstCxt->uiSettled )
+		{
+			pstCxt->bSteady = pstCxt->bSteadyState;
+			pstCxt->uiSettled = KALMAN_STEADY_COUNT;
+			pstCxt->K[0] = K[0];
+			pstCxt->K[1] = K[1];
+		}
+	}
+	else
+	{
+		pstCxt->uiSettled = 0;
+		pstCxt->K[0] = K[0];
+		pstCxt->K[1] = K[1];
+		pstCxt->qSteadyDt = dt;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static int32_t AbsQ( const int32_t x )
+{
+	return ( 0 > x ) ? -x : x;
+}
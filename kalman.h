@@ -2,7 +2,9 @@
 #define KALMAN_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <vector3f.h>
+#include "fixmath.h"
 
 typedef struct
 {
@@ -16,12 +18,80 @@ typedef struct
 
 	float P[2][2]; // Error covariance matrix - This is a 2x2 matrix
 
+	// Steady state gains, see KALMAN_SetSteadyState
+	float K[2]; // The Kalman gain the count started from, frozen once steady
+	float fSteadyDt; // The timestep K was found for
+	uint16_t uiSettled; // Updates K has held near it for
+	bool bSteadyState; // Allowed to stop propagating P
+	bool bSteady; // And has, K is fixed
+
 } stKALMAN_Cxt_t;
 
+// Fixed point version of the above, the state is Q16 and the covariance Q30
+typedef struct
+{
+	q30_t Q_angle;
+	q30_t Q_bias;
+	q30_t R_measure;
+
+	q16_t angle;
+	q16_t bias;
+	q16_t rate;
+
+	q30_t P[2][2];
+
+	q30_t K[2];
+	q30_t qSteadyDt;
+	uint16_t uiSettled;
+	bool bSteadyState;
+	bool bSteady;
+
+} stKALMAN_Q_Cxt_t;
+
+/*
+ * With the noise and the timestep fixed, P and so the gain K converge within a
+ * few seconds, after which propagating P is wasted work. In steady state mode
+ * the filter watches K and once it has held near one value for
+ * KALMAN_STEADY_COUNT updates freezes it, from then on an update is the state
+ * prediction and a fixed gain correction, no covariance and no divide.
+ *
+ * The timestep is measured so it jitters from loop to loop, and K with it. Any
+ * timestep within a band of the one K was found for counts as the same, the
+ * gain for a few percent longer or shorter step is a fraction of that apart.
+ * A timestep outside the band or a change to the noise drops it back to the
+ * full update, from the P it left off with, until K settles again.
+ */
+#define KALMAN_STEADY_COUNT		( 100 )		// A second at the flight rate
+#define KALMAN_STEADY_SHIFT		( 7 )		// Held near is within K / 2^7 of where the count started
+#define KALMAN_STEADY_DT_SHIFT	( 4 )		// The same timestep is within dt / 2^4
+
 void KALMAN_Setup( stKALMAN_Cxt_t *pstCxt );
 float KALMAN_Update( stKALMAN_Cxt_t *pstCxt,
 						   float newRate,
 						   float newAngle,
 						   float dt );
+void KALMAN_SetNoise( stKALMAN_Cxt_t *pstCxt, const float fQAngle, const float fQBias, const float fRMeasure );
+
+/**
+ * @brief		Allows the filter to freeze its gain once it has converged, off
+ * 				after KALMAN_Setup.
+ * @param[in]	pstCxt		Filter context.
+ * @param[in]	bEnable		true to allow it, false for the full update always.
+ */
+void KALMAN_SetSteadyState( stKALMAN_Cxt_t *pstCxt, const bool bEnable );
+
+/**
+ * @brief		Whether the gain is frozen, the last update was gain only.
+ */
+bool KALMAN_IsSteady( const stKALMAN_Cxt_t *pstCxt );
+
+void KALMAN_SetupQ( stKALMAN_Q_Cxt_t *pstCxt );
+q16_t KALMAN_UpdateQ( stKALMAN_Q_Cxt_t *pstCxt,
+					  q16_t newRate,
+					  q16_t newAngle,
+					  q30_t dt );
+void KALMAN_SetNoiseQ( stKALMAN_Q_Cxt_t *pstCxt, const q30_t qQAngle, const q30_t qQBias, const q30_t qRMeasure );
+void KALMAN_SetSteadyStateQ( stKALMAN_Q_Cxt_t *pstCxt, const bool bEnable );
+bool KALMAN_IsSteadyQ( const stKALMAN_Q_Cxt_t *pstCxt );
 
 #endif
@@ -12,9 +12,12 @@
 #include "uart.h"			/* uart ldd */
 #include "vector3f.h"		/* vector3f_t */
 #include "io_driver.h"
+#include "timebase.h"		/* Microsecond clock */
 #include "ledstat.h"		/* Status led pattern controller */
 #include "task_flight.h"	/* Initialises the flight task */
 #include "task_comms.h"		/* Comms task */
+#include "params.h"			/* System parameters */
+#include "paramstore.h"		/* Parameters kept in flash */
 #include "task_led.h"		/* Led task */
 #include "IPC_types.h"		// stFlightDetails_t
 
@@ -75,6 +78,16 @@ int port_putchar( int c )
 	return 1;
 }
 
+int port_write( const void *buf, int len )
+{
+	return (int)uart_write( UART0_BASE_PTR, buf, (size_t)len );
+}
+
+int port_read( void *buf, int max )
+{
+	return (int)uart_read( UART0_BASE_PTR, buf, (size_t)max );
+}
+
 int port_getchar( void )
 {
 	return uart_getchar( UART0_BASE_PTR );
@@ -179,6 +192,9 @@ int main( void )
 	// Initialise the Teensy's on-board LED and our LED pattern controller
 	init_led();
 
+	// The microsecond clock the flight loop times its samples with
+	TIMEBASE_Setup();
+
 	// Initialise the UART module for comms with the ESP module
 	uart_init( UART0_BASE_PTR, 115200 );
 
@@ -188,7 +204,14 @@ int main( void )
 
 	// Initialise I2C which is used to talk to the LSM9DS0 IMU module
 	// TODO check status?
-	i2c_init( 0, 0x01, 0x20 );
+	// 48MHz / ( 2 * 64 ) = 375kHz, the gyro's 760Hz reads don't fit at 150kHz
+	i2c_init( 0, 0x01, 0x12 );
+
+	// The parameters' name index, before anything can look one up
+	PARAM_Create();
+
+	// Then the values kept from last time, before the tasks read them
+	PARAMSTORE_Create();
 
 	// Create tasks
 	TASK_FLIGHT_Create();
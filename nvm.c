@@ -0,0 +1,132 @@
+/**
+ * Parameter storage in the K20's FlexNVM data flash, see nvm.h.
+ */
+#include "nvm.h"
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+
+#include "MK20D7.h"			// Chip definitions for FTFL, FMC and SIM registers
+
+// Data flash is read at 0x10000000 and given to FTFL commands with bit 23 set
+#define DATA_FLASH_BASE		( 0x10000000UL )
+#define DATA_FLASH_FCCOB	( 0x00800000UL )
+
+#define FTFL_CMD_PROGRAM_LONGWORD	( 0x06 )
+#define FTFL_CMD_ERASE_SECTOR		( 0x09 )
+
+#define FTFL_FSTAT_ERRORS	( FTFL_FSTAT_ACCERR_MASK | FTFL_FSTAT_FPVIOL_MASK | FTFL_FSTAT_MGSTAT0_MASK )
+
+// SIM_FCFG1 DEPART for a FlexNVM that is all data flash, as it comes and as
+// it reads with the partition never programmed
+#define DEPART_ALL_DATA_FLASH		( 0x0 )
+#define DEPART_UNPARTITIONED		( 0xF )
+
+static bool bReady;
+
+static bool Launch( const uint8_t uiCommand, const uint32_t uiAddress );
+static void InvalidateCache( void );
+
+/* ************************************************************************** */
+bool NVM_Setup( void )
+{
+	uint32_t uiDepart = ( SIM_FCFG1 & SIM_FCFG1_DEPART_MASK ) >> SIM_FCFG1_DEPART_SHIFT;
+
+	// Anything else has given some or all of it to EEPROM backup, and the
+	// journal starts at the bottom of the data flash
+	bReady = ( DEPART_ALL_DATA_FLASH == uiDepart ) || ( DEPART_UNPARTITIONED == uiDepart );
+
+	return bReady;
+}
+
+/* ************************************************************************** */
+const uint32_t *NVM_Sector( const uint8_t uiSector )
+{
+	return (const uint32_t *)( DATA_FLASH_BASE + ( (uint32_t)uiSector * NVM_SECTOR_SIZE ) );
+}
+
+/* ************************************************************************** */
+bool NVM_Program( const uint8_t uiSector, const uint16_t uiOffset, const uint32_t uiWord )
+{
+	if ( !bReady || ( NVM_NUM_SECTORS <= uiSector ) || ( NVM_SECTOR_SIZE <= uiOffset ) || ( 0 != ( uiOffset & 3 ) ) )
+	{
+		return false;
+	}
+
+	// Most significant byte first, it lands little endian
+	FTFL_FCCOB4 = (uint8_t)( uiWord >> 24 );
+	FTFL_FCCOB5 = (uint8_t)( uiWord >> 16 );
+	FTFL_FCCOB6 = (uint8_t)( uiWord >> 8 );
+	FTFL_FCCOB7 = (uint8_t)uiWord;
+
+	if ( !Launch( FTFL_CMD_PROGRAM_LONGWORD, ( (uint32_t)uiSector * NVM_SECTOR_SIZE ) + uiOffset ) )
+	{
+		return false;
+	}
+
+	// Short enough to wait for, the program flash is still read meanwhile
+	while ( 0 == ( FTFL_FSTAT & FTFL_FSTAT_CCIF_MASK ) );
+
+	InvalidateCache();
+
+	return ( 0 == ( FTFL_FSTAT & FTFL_FSTAT_ERRORS ) );
+}
+
+/* ************************************************************************** */
+bool NVM_StartErase( const uint8_t uiSector )
+{
+	if ( !bReady || ( NVM_NUM_SECTORS <= uiSector ) )
+	{
+		return false;
+	}
+
+	return Launch( FTFL_CMD_ERASE_SECTOR, (uint32_t)uiSector * NVM_SECTOR_SIZE );
+}
+
+/* ************************************************************************** */
+eNVM_Status_t NVM_Status( void )
+{
+	if ( 0 == ( FTFL_FSTAT & FTFL_FSTAT_CCIF_MASK ) )
+	{
+		return NVM_BUSY;
+	}
+
+	InvalidateCache();
+
+	return ( 0 == ( FTFL_FSTAT & FTFL_FSTAT_ERRORS ) ) ? NVM_IDLE : NVM_ERROR;
+}
+
+/* ************************************************************************** */
+static bool Launch( const uint8_t uiCommand, const uint32_t uiAddress )
+{
+	uint32_t uiFccobAddress = DATA_FLASH_FCCOB | uiAddress;
+
+	if ( 0 == ( FTFL_FSTAT & FTFL_FSTAT_CCIF_MASK ) )
+	{
+		return false;
+	}
+
+	// Errors from the last command are cleared by writing them back
+	FTFL_FSTAT = FTFL_FSTAT_ACCERR_MASK | FTFL_FSTAT_FPVIOL_MASK | FTFL_FSTAT_RDCOLERR_MASK;
+
+	FTFL_FCCOB0 = uiCommand;
+	FTFL_FCCOB1 = (uint8_t)( uiFccobAddress >> 16 );
+	FTFL_FCCOB2 = (uint8_t)( uiFccobAddress >> 8 );
+	FTFL_FCCOB3 = (uint8_t)uiFccobAddress;
+
+	// Clearing CCIF starts it
+	FTFL_FSTAT = FTFL_FSTAT_CCIF_MASK;
+
+	return true;
+}
+
+/* ************************************************************************** */
+static void InvalidateCache( void )
+{
+	// The flash cache and speculation buffer may still hold what was there
+	// before, both clear themselves
+	FMC_PFB0CR |= FMC_PFB0CR_CINV_WAY( 0xF ) | FMC_PFB0CR_S_B_INV_MASK;
+
+	return;
+}
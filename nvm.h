@@ -0,0 +1,75 @@
+#ifndef NVM_H
+#define NVM_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+
+/*
+ * Non-volatile storage for the parameter journal (paramstore.h), a few
+ * sectors of flash that are erased whole and programmed a 32 bit word at a
+ * time. An erased word reads 0xFFFFFFFF and a word may only be programmed
+ * once between erases.
+ *
+ * On the K20 these are the first sectors of the FlexNVM block as data flash.
+ * It is a separate block from the program flash, so code keeps running and
+ * interrupts keep being served while it is programmed or erased. A word
+ * takes about 100us and is waited for, a sector erase takes tens of
+ * milliseconds and is started and then polled, so nothing has to wait on it.
+ * A part whose FlexNVM has been partitioned for EEPROM emulation has no data
+ * flash, NVM_Setup says so and the parameters stay at their defaults.
+ *
+ * host/nvm.c stands in for the host builds, on a file.
+ *
+ * Only one task may use it, it is not locked.
+ */
+
+#define NVM_SECTOR_SIZE		( 2048 )	// Bytes, the K20's data flash sector
+#define NVM_NUM_SECTORS		( 4 )		// Sectors the journal has, 8K of the 32K
+#define NVM_ERASED_WORD		( 0xFFFFFFFFUL )
+
+typedef enum
+{
+	NVM_IDLE,			// Ready, the last erase went well
+	NVM_BUSY,			// An erase is running
+	NVM_ERROR,			// The last erase failed
+
+} eNVM_Status_t;
+
+/**
+ * @brief		Gets the storage ready, call once before anything else.
+ * @return		false if there is no storage to use.
+ */
+bool NVM_Setup( void );
+
+/**
+ * @brief		A sector's contents, readable directly. Not to be read while
+ * 				it is being erased.
+ * @param[in]	uiSector	The sector, 0 to NVM_NUM_SECTORS - 1.
+ */
+const uint32_t *NVM_Sector( const uint8_t uiSector );
+
+/**
+ * @brief		Programs one word and waits for it, not to be called while
+ * 				an erase is running.
+ * @param[in]	uiSector	The sector.
+ * @param[in]	uiOffset	Byte offset in the sector, a multiple of 4.
+ * @param[in]	uiWord		The value, the word must be erased.
+ * @return		false if it failed.
+ */
+bool NVM_Program( const uint8_t uiSector, const uint16_t uiOffset, const uint32_t uiWord );
+
+/**
+ * @brief		Starts a sector erasing and returns, NVM_Status says when it
+ * 				is done.
+ * @param[in]	uiSector	The sector.
+ * @return		false if it could not be started.
+ */
+bool NVM_StartErase( const uint8_t uiSector );
+
+/**
+ * @brief		Whether an erase is still running and how the last one went.
+ */
+eNVM_Status_t NVM_Status( void );
+
+#endif
@@ -9,10 +9,23 @@
 #include <string.h>			// memset & friends
 #include <stdio.h>			// printf & friends
 
+#include "FreeRTOS.h"		// FreeRTOS
+#include "task.h"			// taskENTER_CRITICAL()
+
 /* ************************************************************************** **
  * Macros and Defines
  * ************************************************************************** */
-#define mArrayLen( x )		( sizeof( x ) / sizeof( x[0] ) )
+// Writers have finished with the values before readers see the sequence move
+// on, and readers are done copying before they check it again
+#define mLoadAcquire( x )		__atomic_load_n( &( x ), __ATOMIC_ACQUIRE )
+#define mStoreRelaxed( x, v )	__atomic_store_n( &( x ), ( v ), __ATOMIC_RELAXED )
+#define mStoreRelease( x, v )	__atomic_store_n( &( x ), ( v ), __ATOMIC_RELEASE )
+
+#define mPARAM_ENTRY( eParam, sName, tValue, xDefault )		{ sName, (float)( xDefault ), PARAM_GENERATION_FIRST },
+
+// A name that fills sName exactly is allowed, it goes without a terminator
+#define mPARAM_CHECK_NAME( eParam, sName, tValue, xDefault ) \
+	_Static_assert( sizeof( sName ) <= ( LEN_NAME_MAX + 1 ), #eParam " name too long" );
 
 /* ************************************************************************** **
  * Typedefs
@@ -21,100 +34,212 @@
 /* ************************************************************************** **
  * Function Prototypes
  * ************************************************************************** */
+static int CompareName( const char *const sName, const size_t uiLen, const uint16_t uiIndex );
 
 /* ************************************************************************** **
  * Local Variables
  * ************************************************************************** */
-static stPARAM_t astParamList[] =
-{
-	{
-		"PIDGainRate_P",
-		0.0f
-	},
-	{
-		"PIDGainRate_D",
-		0.0f
-	},
-	{
-		"PIDGainAngle_P",
-		0.0f
-	},
-	{
-		"PIDGainRateYaw_P",
-		0.0f
-	},
-	{
-		"PIDGainRateYaw_D",
-		0.0f
-	},
-	{
-		"TrimRoll",
-		-0.014f
-	},
-	{
-		"TrimPitch",
-		0.080f
-	},
-	{
-		"TrimYaw",
-		-0.0f
-	}
-};
+// Odd while a set is writing, each set moves it on by two
+static volatile uint32_t uiWriteSeq;
+static volatile uint32_t uiParamGeneration = PARAM_GENERATION_FIRST;
+
+// Sorted by name for PARAM_FindParamByName, built by PARAM_Create
+static uint16_t auiNameIndex[ PARAM_NUM ];
+
+stPARAM_t astPARAM_List[ PARAM_NUM ] = { PARAM_TABLE( mPARAM_ENTRY ) };
+
+PARAM_TABLE( mPARAM_CHECK_NAME )
 
 /* ************************************************************************** **
  * API Functions
  * ************************************************************************** */
 
+/* ************************************************************************** */
+void PARAM_Create( void )
+{
+	uint16_t uiIndex;
+	uint16_t uiSlot;
+
+	// Insertion sort, once at start up and the table is short
+	for ( uiIndex = 0; uiIndex < PARAM_NUM; uiIndex++ )
+	{
+		for ( uiSlot = uiIndex; ( 0 < uiSlot )
+								&& ( 0 < CompareName( astPARAM_List[ auiNameIndex[ uiSlot - 1 ] ].sName, LEN_NAME_MAX, uiIndex ) );
+			  uiSlot-- )
+		{
+			auiNameIndex[ uiSlot ] = auiNameIndex[ uiSlot - 1 ];
+		}
+
+		auiNameIndex[ uiSlot ] = uiIndex;
+	}
+
+	return;
+}
+
 /* ************************************************************************** */
 size_t PARAM_GetParamCount( void )
 {
-	return mArrayLen( astParamList );
+	return PARAM_NUM;
 }
 
 /* ************************************************************************** */
 stPARAM_t *PARAM_GetParamList( void )
 {
-	return &astParamList[0];
+	return &astPARAM_List[0];
 }
 
 /* ************************************************************************** */
 stPARAM_t *PARAM_FindParamByName( const char* const sName, const size_t uiLen, size_t *puiIndex )
 {
-	size_t sParamIndex;
+	size_t sLen = ( ( 0 == uiLen ) || ( LEN_NAME_MAX < uiLen ) ) ? LEN_NAME_MAX : uiLen;
+	size_t sLow = 0;
+	size_t sHigh = PARAM_NUM;
+	size_t sMid;
+	int iOrder;
 
-	for ( sParamIndex = 0; sParamIndex < mArrayLen( astParamList ); sParamIndex++ )
+	while ( sLow < sHigh )
 	{
-		if ( 0 != uiLen )
+		sMid = ( sLow + sHigh ) / 2;
+		iOrder = CompareName( sName, sLen, auiNameIndex[ sMid ] );
+
+		if ( 0 == iOrder )
 		{
-			if ( 0 == strncmp( sName, astParamList[sParamIndex].sName, uiLen ) )
+			if ( puiIndex )
 			{
-				break;
+				*puiIndex = auiNameIndex[ sMid ];
 			}
+
+			return &astPARAM_List[ auiNameIndex[ sMid ] ];
+		}
+		else if ( 0 > iOrder )
+		{
+			sHigh = sMid;
 		}
 		else
 		{
-			if ( 0 == strcmp( sName, astParamList[sParamIndex].sName ) )
-			{
-				break;
-			}
+			sLow = sMid + 1;
+		}
+	}
+
+	return NULL;
+}
+
+/* ************************************************************************** */
+uint32_t PARAM_GetGeneration( void )
+{
+	return uiParamGeneration;
+}
+
+/* ************************************************************************** */
+bool PARAM_ChangedSince( const stPARAM_t *const pstParam, const uint32_t uiGeneration )
+{
+	return ( NULL != pstParam ) && ( pstParam->uiGeneration > uiGeneration );
+}
+
+/* ************************************************************************** */
+bool PARAM_GroupChangedSince( stPARAM_t *const apstParams[], const size_t sCount, const uint32_t uiGeneration )
+{
+	size_t sIndex;
+
+	// Nothing at all has changed, the usual case
+	if ( uiParamGeneration <= uiGeneration )
+	{
+		return false;
+	}
+
+	for ( sIndex = 0; sIndex < sCount; sIndex++ )
+	{
+		if ( PARAM_ChangedSince( apstParams[ sIndex ], uiGeneration ) )
+		{
+			return true;
 		}
 	}
 
-	if ( sParamIndex != mArrayLen( astParamList ) )
+	return false;
+}
+
+/* ************************************************************************** */
+bool PARAM_Set( stPARAM_t *const pstParam, const float fValue )
+{
+	stPARAM_t *apstParams[ 1 ] = { pstParam };
+
+	return PARAM_SetGroup( apstParams, &fValue, 1 );
+}
+
+/* ************************************************************************** */
+bool PARAM_SetGroup( stPARAM_t *const apstParams[], const float afValues[], const size_t sCount )
+{
+	uint32_t uiNext;
+	size_t sIndex;
+	bool bChanged = false;
+
+	// Any task may set, the critical section keeps writers apart and the
+	// sequence lets readers see they raced one
+	taskENTER_CRITICAL();
+
+	uiNext = uiParamGeneration + 1;
+	mStoreRelaxed( uiWriteSeq, uiWriteSeq + 1 );
+	__atomic_thread_fence( __ATOMIC_RELEASE );
+
+	for ( sIndex = 0; sIndex < sCount; sIndex++ )
 	{
-		if ( puiIndex )
+		if ( ( NULL != apstParams[ sIndex ] ) && ( apstParams[ sIndex ]->fValue != afValues[ sIndex ] ) )
 		{
-			*puiIndex = sParamIndex;
+			apstParams[ sIndex ]->fValue = afValues[ sIndex ];
+			apstParams[ sIndex ]->uiGeneration = uiNext;
+			bChanged = true;
 		}
-		return &astParamList[sParamIndex];
 	}
-	else
+
+	if ( bChanged )
 	{
-		return NULL;
+		uiParamGeneration = uiNext;
 	}
+
+	mStoreRelease( uiWriteSeq, uiWriteSeq + 1 );
+
+	taskEXIT_CRITICAL();
+
+	return bChanged;
+}
+
+/* ************************************************************************** */
+uint32_t PARAM_ReadGroup( stPARAM_t *const apstParams[], float afValues[], const size_t sCount )
+{
+	uint32_t uiSeqBefore;
+	uint32_t uiSeqAfter;
+	uint32_t uiGeneration;
+	size_t sIndex;
+
+	do
+	{
+		uiSeqBefore = mLoadAcquire( uiWriteSeq );
+		uiGeneration = uiParamGeneration;
+
+		for ( sIndex = 0; sIndex < sCount; sIndex++ )
+		{
+			if ( NULL != apstParams[ sIndex ] )
+			{
+				afValues[ sIndex ] = apstParams[ sIndex ]->fValue;
+			}
+		}
+
+		__atomic_thread_fence( __ATOMIC_ACQUIRE );
+		uiSeqAfter = uiWriteSeq;
+
+		// A set was writing when we started, or one happened while we copied
+	} while ( ( 0 != ( uiSeqBefore & 1 ) ) || ( uiSeqAfter != uiSeqBefore ) );
+
+	return uiGeneration;
 }
 
 /* ************************************************************************** **
  * Local Functions
  * ************************************************************************** */
 
+/* ************************************************************************** */
+static int CompareName( const char *const sName, const size_t uiLen, const uint16_t uiIndex )
+{
+	return strncmp( sName, astPARAM_List[ uiIndex ].sName, uiLen );
+}
+
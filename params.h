@@ -7,15 +7,146 @@
 
 #define LEN_NAME_MAX		( 16 )
 
+// Every parameter, declared once here in MAVLink index order. Each gets an ID
+// (its index), a name of up to LEN_NAME_MAX characters, the C type it is
+// read as (all are stored as float, which is what MAVLink carries) and its
+// default. Code refers to parameters by ID through PARAM_Handle and
+// PARAM_Get, which resolve at build time, names are only looked up for what
+// comes in over MAVLink.
+#define PARAM_TABLE( X ) \
+	X( PARAM_PIDGAIN_RATE_P,		"PIDGainRate_P",	float,		0.0f ) \
+	X( PARAM_PIDGAIN_RATE_D,		"PIDGainRate_D",	float,		0.0f ) \
+	X( PARAM_PIDGAIN_ANGLE_P,		"PIDGainAngle_P",	float,		0.0f ) \
+	X( PARAM_PIDGAIN_RATEYAW_P,		"PIDGainRateYaw_P",	float,		0.0f ) \
+	X( PARAM_PIDGAIN_RATEYAW_D,		"PIDGainRateYaw_D",	float,		0.0f ) \
+	X( PARAM_TRIM_ROLL,				"TrimRoll",			float,		-0.014f ) \
+	X( PARAM_TRIM_PITCH,			"TrimPitch",		float,		0.080f ) \
+	X( PARAM_TRIM_YAW,				"TrimYaw",			float,		-0.0f ) \
+	X( PARAM_FUSION_FILTER,			"FusionFilter",		int32_t,	0 ) /* eSENSORFUSION_Strategy_t, the flight task sets the build's default */ \
+
+#define mPARAM_ID( eParam, sName, tValue, xDefault )		eParam,
+#define mPARAM_TYPE( eParam, sName, tValue, xDefault )		typedef tValue eParam##_t;
+
+typedef enum
+{
+	PARAM_TABLE( mPARAM_ID )
+	PARAM_NUM
+
+} ePARAM_Id_t;
+
+// PARAM_TRIM_ROLL_t etc, the type each parameter is read as
+PARAM_TABLE( mPARAM_TYPE )
+
+/*
+ * Every applied change moves the global generation on by one and stamps the
+ * parameter with it, so a consumer that remembers the generation it last
+ * applied can tell cheaply whether anything, or a given parameter, has
+ * changed since. Setting a parameter to the value it already has is not a
+ * change.
+ *
+ * Values are only written through PARAM_Set and PARAM_SetGroup, any task may
+ * call them. A single value can be read directly, related values that must
+ * be seen together (a set of gains) are read with PARAM_ReadGroup, which
+ * never sees half of a PARAM_SetGroup.
+ */
+
+#define PARAM_GENERATION_NONE	( 0 )	// Before the defaults, everything has changed since
+#define PARAM_GENERATION_FIRST	( 1 )	// The defaults
+
 typedef struct
 {
 	char sName[ LEN_NAME_MAX ];
 	float fValue;
+	volatile uint32_t uiGeneration;		// When it last changed
 
 } stPARAM_t;
 
+// The table, in ePARAM_Id_t order. Use the handles rather than indexing it.
+extern stPARAM_t astPARAM_List[ PARAM_NUM ];
+
+/**
+ * @brief		The parameter with ID eParam, a constant address.
+ */
+#define PARAM_Handle( eParam )		( &astPARAM_List[ eParam ] )
+
+/**
+ * @brief		The value of the parameter with ID eParam, as its type.
+ */
+#define PARAM_Get( eParam )			( (eParam##_t)PARAM_Handle( eParam )->fValue )
+
+/**
+ * @brief		Builds the name index for PARAM_FindParamByName, call once
+ * 				before the tasks start.
+ */
+void PARAM_Create( void );
+
 size_t PARAM_GetParamCount( void );
 stPARAM_t *PARAM_GetParamList( void );
+
+/**
+ * @brief		Looks up a parameter by name, a binary search of the name
+ * 				index. Only for names that arrive at run time, code uses
+ * 				PARAM_Handle.
+ * @param[in]	sName		The name.
+ * @param[in]	uiLen		Characters to compare, 0 for a terminated name.
+ * 							Names from MAVLink are LEN_NAME_MAX without a
+ * 							terminator when they fill it.
+ * @param[out]	puiIndex	Where to put its index, may be NULL.
+ * @return		The parameter, NULL if there is no such name.
+ */
 stPARAM_t *PARAM_FindParamByName( const char* const sName, const size_t uiLen, size_t *puiIndex );
 
+/**
+ * @brief		The global generation, the newest of all the parameters'.
+ */
+uint32_t PARAM_GetGeneration( void );
+
+/**
+ * @brief		Whether a parameter has changed since a generation.
+ * @param[in]	pstParam		The parameter, NULL never changes.
+ * @param[in]	uiGeneration	A generation from PARAM_GetGeneration or
+ * 								PARAM_ReadGroup, or PARAM_GENERATION_NONE.
+ */
+bool PARAM_ChangedSince( const stPARAM_t *const pstParam, const uint32_t uiGeneration );
+
+/**
+ * @brief		Whether any of a group of parameters has changed since a
+ * 				generation.
+ * @param[in]	apstParams		The parameters, NULL entries are skipped.
+ * @param[in]	sCount			How many.
+ * @param[in]	uiGeneration	As PARAM_ChangedSince.
+ */
+bool PARAM_GroupChangedSince( stPARAM_t *const apstParams[], const size_t sCount, const uint32_t uiGeneration );
+
+/**
+ * @brief		Sets a parameter.
+ * @param[in]	pstParam	The parameter.
+ * @param[in]	fValue		Its new value.
+ * @return		true if the value changed and a new generation was applied.
+ */
+bool PARAM_Set( stPARAM_t *const pstParam, const float fValue );
+
+/**
+ * @brief		Sets a group of related parameters as one change, readers see
+ * 				all of them change or none. Only those whose value differs are
+ * 				stamped, all with the one new generation.
+ * @param[in]	apstParams	The parameters, NULL entries are skipped.
+ * @param[in]	afValues	Their new values.
+ * @param[in]	sCount		How many.
+ * @return		true if any value changed.
+ */
+bool PARAM_SetGroup( stPARAM_t *const apstParams[], const float afValues[], const size_t sCount );
+
+/**
+ * @brief		Reads a group of related parameters as they were at one
+ * 				generation, never part way through a PARAM_SetGroup. Doesn't
+ * 				block, it retries if a set lands while it is copying.
+ * @param[in]	apstParams	The parameters, the value of a NULL entry is left
+ * 							as it is.
+ * @param[out]	afValues	Their values.
+ * @param[in]	sCount		How many.
+ * @return		The generation the values are from.
+ */
+uint32_t PARAM_ReadGroup( stPARAM_t *const apstParams[], float afValues[], const size_t sCount );
+
 #endif
@@ -0,0 +1,521 @@
+/* ************************************************************************** **
+ * Includes
+ * ************************************************************************** */
+#include "paramstore.h"
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <string.h>			// memset & friends
+
+#include "nvm.h"			// Flash storage
+#include "params.h"			// System parameters
+
+/* ************************************************************************** **
+ * Macros and Defines
+ * ************************************************************************** */
+#define HEADER_BYTES		( 8 )
+#define RECORD_BYTES		( 8 )
+#define RECORDS_PER_SECTOR	( ( NVM_SECTOR_SIZE - HEADER_BYTES ) / RECORD_BYTES )
+
+#define HEADER_MAGIC		( 0x5041 )		// "PA"
+#define KEY_SNAPSHOT_END	( 0xFFFF )		// Its value is how many came before it
+#define CRC_INIT			( 0xFFFF )
+
+#define mHeaderCheck( uiSeq )		( ( (uint32_t)HEADER_MAGIC << 16 ) | Crc16Word( CRC_INIT, ( uiSeq ) ) )
+#define mSeqNewer( a, b )			( 0 < (int32_t)( ( a ) - ( b ) ) )
+#define mPARAM_HANDLE( eParam, sName, tValue, xDefault )	PARAM_Handle( eParam ),
+
+// A snapshot has to leave most of a sector for the changes after it
+_Static_assert( ( 2 * ( PARAM_NUM + 1 ) ) < RECORDS_PER_SECTOR, "Parameter table too big for a journal sector" );
+
+/* ************************************************************************** **
+ * Typedefs
+ * ************************************************************************** */
+typedef enum
+{
+	STATE_OFF,				// No storage
+	STATE_READY,			// uiSector is open for records
+	STATE_ROTATE,			// The next sector needs starting
+	STATE_ERASING,			// And is being erased
+
+} eState_t;
+
+/* ************************************************************************** **
+ * Function Prototypes
+ * ************************************************************************** */
+static int FindSectors( uint8_t auiSectors[], uint32_t auiSeqs[] );
+static bool HasSnapshot( const uint8_t uiSector, const uint32_t uiSeq );
+static uint16_t Replay( const uint8_t uiSector, const uint32_t uiSeq, float afValues[] );
+static bool StartSector( void );
+static bool Append( const uint16_t uiKey, const uint32_t uiValue );
+static int FindKey( const uint16_t uiKey );
+static uint16_t KeyOf( const char *const sName );
+static uint16_t RecordCheck( const uint32_t uiSeq, const uint16_t uiKey, const uint32_t uiValue );
+static uint16_t Crc16Word( uint16_t uiCrc, const uint32_t uiWord );
+static uint32_t FloatBits( const float fValue );
+static float BitsFloat( const uint32_t uiBits );
+
+/* ************************************************************************** **
+ * Local Variables
+ * ************************************************************************** */
+static stPARAM_t *const apstParams[ PARAM_NUM ] = { PARAM_TABLE( mPARAM_HANDLE ) };
+
+// CRC-16/CCITT a nibble at a time, small and quick enough for start up
+static const uint16_t auiCrcTable[ 16 ] =
+{
+	0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+	0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+static eState_t eState;
+static uint8_t uiSector;
+static uint32_t uiSeq;
+static uint16_t uiHead;					// Byte offset of the next record
+
+static uint16_t auiKeys[ PARAM_NUM ];
+static uint32_t auiStored[ PARAM_NUM ];	// What the journal holds, as bits
+static uint32_t uiStoredGeneration;
+static uint32_t uiSeenGeneration;
+static uint32_t uiSettled_ms;
+
+static uint16_t uiReplayed;
+static uint32_t uiRecordsWritten;
+static uint32_t uiErrors;
+
+/* ************************************************************************** **
+ * API Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+bool PARAMSTORE_Create( void )
+{
+	uint8_t auiSectors[ NVM_NUM_SECTORS ];
+	uint32_t auiSeqs[ NVM_NUM_SECTORS ];
+	float afValues[ PARAM_NUM ];
+	int iNumSectors;
+	int iBase;
+	uint16_t uiIndex;
+
+	eState = STATE_OFF;
+	uiReplayed = 0;
+	uiRecordsWritten = 0;
+	uiErrors = 0;
+
+	PARAM_ReadGroup( apstParams, afValues, PARAM_NUM );
+
+	for ( uiIndex = 0; uiIndex < PARAM_NUM; uiIndex++ )
+	{
+		auiKeys[ uiIndex ] = KeyOf( apstParams[ uiIndex ]->sName );
+
+		// Two names with one key can't be told apart, rename one
+		if ( FindKey( auiKeys[ uiIndex ] ) != uiIndex )
+		{
+			return false;
+		}
+	}
+
+	if ( !NVM_Setup() )
+	{
+		return false;
+	}
+
+	iNumSectors = FindSectors( auiSectors, auiSeqs );
+
+	if ( 0 == iNumSectors )
+	{
+		// New storage, the first sector started is 0
+		uiSector = NVM_NUM_SECTORS - 1;
+		uiSeq = 0;
+		eState = STATE_ROTATE;
+	}
+	else
+	{
+		// Newest first, go back to the first whole snapshot and replay
+		// forwards from there
+		for ( iBase = 0; ( iBase < ( iNumSectors - 1 ) ) && !HasSnapshot( auiSectors[ iBase ], auiSeqs[ iBase ] ); iBase++ );
+
+		for ( ; iBase >= 0; iBase-- )
+		{
+			uiHead = Replay( auiSectors[ iBase ], auiSeqs[ iBase ], afValues );
+		}
+
+		uiSector = auiSectors[ 0 ];
+		uiSeq = auiSeqs[ 0 ];
+
+		// Records only ever follow a whole snapshot
+		eState = ( ( NVM_SECTOR_SIZE > uiHead ) && HasSnapshot( uiSector, uiSeq ) ) ? STATE_READY : STATE_ROTATE;
+	}
+
+	PARAM_SetGroup( apstParams, afValues, PARAM_NUM );
+
+	for ( uiIndex = 0; uiIndex < PARAM_NUM; uiIndex++ )
+	{
+		auiStored[ uiIndex ] = FloatBits( afValues[ uiIndex ] );
+	}
+
+	uiStoredGeneration = PARAM_GetGeneration();
+	uiSeenGeneration = uiStoredGeneration;
+	uiSettled_ms = 0;
+
+	return true;
+}
+
+/* ************************************************************************** */
+void PARAMSTORE_Process( const uint32_t uiElapsed_ms )
+{
+	float afValues[ PARAM_NUM ];
+	uint32_t uiGeneration;
+	uint32_t uiValue;
+	uint16_t uiIndex;
+
+	switch ( eState )
+	{
+		case STATE_ERASING:
+			switch ( NVM_Status() )
+			{
+				case NVM_BUSY:
+					break;
+
+				case NVM_IDLE:
+					eState = StartSector() ? STATE_READY : STATE_ROTATE;
+					break;
+
+				default:
+					// Leave it behind and try the next one
+					uiErrors++;
+					eState = STATE_ROTATE;
+					break;
+			}
+			break;
+
+		case STATE_ROTATE:
+			// Round the ring, the oldest sector goes
+			uiSector = ( uiSector + 1 ) % NVM_NUM_SECTORS;
+			uiSeq++;
+
+			if ( NVM_StartErase( uiSector ) )
+			{
+				eState = STATE_ERASING;
+			}
+			else
+			{
+				uiErrors++;
+			}
+			break;
+
+		case STATE_READY:
+			uiGeneration = PARAM_GetGeneration();
+
+			if ( uiGeneration == uiStoredGeneration )
+			{
+				break;
+			}
+
+			// Wait for them to stop changing
+			if ( uiGeneration != uiSeenGeneration )
+			{
+				uiSeenGeneration = uiGeneration;
+				uiSettled_ms = 0;
+				break;
+			}
+
+			uiSettled_ms += uiElapsed_ms;
+
+			if ( PARAMSTORE_SETTLE_MS > uiSettled_ms )
+			{
+				break;
+			}
+
+			uiGeneration = PARAM_ReadGroup( apstParams, afValues, PARAM_NUM );
+
+			for ( uiIndex = 0; uiIndex < PARAM_NUM; uiIndex++ )
+			{
+				uiValue = FloatBits( afValues[ uiIndex ] );
+
+				if ( uiValue == auiStored[ uiIndex ] )
+				{
+					continue;
+				}
+
+				// A full sector or a failed write, the new sector's snapshot
+				// takes whatever is left
+				if ( !Append( auiKeys[ uiIndex ], uiValue ) )
+				{
+					eState = STATE_ROTATE;
+					return;
+				}
+
+				auiStored[ uiIndex ] = uiValue;
+			}
+
+			uiStoredGeneration = uiGeneration;
+			break;
+
+		default:
+			break;
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+void PARAMSTORE_GetStatus( stPARAMSTORE_Status_t *const pstStatus )
+{
+	pstStatus->bEnabled = ( STATE_OFF != eState );
+	pstStatus->uiSector = uiSector;
+	pstStatus->uiSectorSeq = uiSeq;
+	pstStatus->uiFreeRecords = ( STATE_READY == eState ) ? ( ( NVM_SECTOR_SIZE - uiHead ) / RECORD_BYTES ) : 0;
+	pstStatus->uiReplayed = uiReplayed;
+	pstStatus->uiRecordsWritten = uiRecordsWritten;
+	pstStatus->uiErrors = uiErrors;
+
+	return;
+}
+
+/* ************************************************************************** **
+ * Local Functions
+ * ************************************************************************** */
+
+/* ************************************************************************** */
+static int FindSectors( uint8_t auiSectors[], uint32_t auiSeqs[] )
+{
+	const uint32_t *puiHeader;
+	int iNum = 0;
+	int iSlot;
+	uint8_t uiIndex;
+
+	// Those with a good header, newest first
+	for ( uiIndex = 0; uiIndex < NVM_NUM_SECTORS; uiIndex++ )
+	{
+		puiHeader = NVM_Sector( uiIndex );
+
+		if ( mHeaderCheck( puiHeader[ 0 ] ) != puiHeader[ 1 ] )
+		{
+			continue;
+		}
+
+		for ( iSlot = iNum; ( 0 < iSlot ) && mSeqNewer( puiHeader[ 0 ], auiSeqs[ iSlot - 1 ] ); iSlot-- )
+		{
+			auiSectors[ iSlot ] = auiSectors[ iSlot - 1 ];
+			auiSeqs[ iSlot ] = auiSeqs[ iSlot - 1 ];
+		}
+
+		auiSectors[ iSlot ] = uiIndex;
+		auiSeqs[ iSlot ] = puiHeader[ 0 ];
+		iNum++;
+	}
+
+	return iNum;
+}
+
+/* ************************************************************************** */
+static bool HasSnapshot( const uint8_t uiSector, const uint32_t uiSeq )
+{
+	const uint32_t *puiWord = NVM_Sector( uiSector );
+	uint32_t uiValue;
+	uint32_t uiCheck;
+	uint16_t uiOffset;
+	uint16_t uiKey;
+
+	// The marker is near the start, only a sector without one is read through
+	for ( uiOffset = HEADER_BYTES; uiOffset < NVM_SECTOR_SIZE; uiOffset += RECORD_BYTES )
+	{
+		uiValue = puiWord[ uiOffset / 4 ];
+		uiCheck = puiWord[ ( uiOffset / 4 ) + 1 ];
+
+		if ( ( NVM_ERASED_WORD == uiValue ) && ( NVM_ERASED_WORD == uiCheck ) )
+		{
+			break;
+		}
+
+		uiKey = (uint16_t)( uiCheck >> 16 );
+
+		if ( ( KEY_SNAPSHOT_END == uiKey ) && ( RecordCheck( uiSeq, uiKey, uiValue ) == (uint16_t)uiCheck ) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* ************************************************************************** */
+static uint16_t Replay( const uint8_t uiSector, const uint32_t uiSeq, float afValues[] )
+{
+	const uint32_t *puiWord = NVM_Sector( uiSector );
+	uint32_t uiValue;
+	uint32_t uiCheck;
+	uint16_t uiOffset;
+	uint16_t uiKey;
+	int iIndex;
+
+	for ( uiOffset = HEADER_BYTES; uiOffset < NVM_SECTOR_SIZE; uiOffset += RECORD_BYTES )
+	{
+		uiValue = puiWord[ uiOffset / 4 ];
+		uiCheck = puiWord[ ( uiOffset / 4 ) + 1 ];
+
+		// The first empty slot is where the next record goes
+		if ( ( NVM_ERASED_WORD == uiValue ) && ( NVM_ERASED_WORD == uiCheck ) )
+		{
+			break;
+		}
+
+		uiKey = (uint16_t)( uiCheck >> 16 );
+		iIndex = FindKey( uiKey );
+
+		// Cut short, the marker, or a parameter this build doesn't have
+		if ( ( 0 > iIndex ) || ( RecordCheck( uiSeq, uiKey, uiValue ) != (uint16_t)uiCheck ) )
+		{
+			continue;
+		}
+
+		afValues[ iIndex ] = BitsFloat( uiValue );
+		uiReplayed++;
+	}
+
+	return uiOffset;
+}
+
+/* ************************************************************************** */
+static bool StartSector( void )
+{
+	float afValues[ PARAM_NUM ];
+	uint32_t uiGeneration;
+	uint16_t uiIndex;
+
+	// Sequence first, a header cut short between the two fails its check
+	if ( !NVM_Program( uiSector, 0, uiSeq ) || !NVM_Program( uiSector, 4, mHeaderCheck( uiSeq ) ) )
+	{
+		uiErrors++;
+		return false;
+	}
+
+	uiHead = HEADER_BYTES;
+	uiGeneration = PARAM_ReadGroup( apstParams, afValues, PARAM_NUM );
+
+	for ( uiIndex = 0; uiIndex < PARAM_NUM; uiIndex++ )
+	{
+		if ( !Append( auiKeys[ uiIndex ], FloatBits( afValues[ uiIndex ] ) ) )
+		{
+			return false;
+		}
+	}
+
+	if ( !Append( KEY_SNAPSHOT_END, PARAM_NUM ) )
+	{
+		return false;
+	}
+
+	for ( uiIndex = 0; uiIndex < PARAM_NUM; uiIndex++ )
+	{
+		auiStored[ uiIndex ] = FloatBits( afValues[ uiIndex ] );
+	}
+
+	uiStoredGeneration = uiGeneration;
+
+	return true;
+}
+
+/* ************************************************************************** */
+static bool Append( const uint16_t uiKey, const uint32_t uiValue )
+{
+	uint32_t uiCheck = ( (uint32_t)uiKey << 16 ) | RecordCheck( uiSeq, uiKey, uiValue );
+
+	if ( NVM_SECTOR_SIZE <= uiHead )
+	{
+		return false;
+	}
+
+	// The slot is used from the first word on, whether or not it completes
+	uiHead += RECORD_BYTES;
+
+	// Value first, a record cut short between the two fails its check
+	if ( !NVM_Program( uiSector, uiHead - RECORD_BYTES, uiValue )
+		 || !NVM_Program( uiSector, uiHead - RECORD_BYTES + 4, uiCheck ) )
+	{
+		uiErrors++;
+		return false;
+	}
+
+	uiRecordsWritten++;
+
+	return true;
+}
+
+/* ************************************************************************** */
+static int FindKey( const uint16_t uiKey )
+{
+	int iIndex;
+
+	for ( iIndex = 0; iIndex < PARAM_NUM; iIndex++ )
+	{
+		if ( auiKeys[ iIndex ] == uiKey )
+		{
+			return iIndex;
+		}
+	}
+
+	return -1;
+}
+
+/* ************************************************************************** */
+static uint16_t KeyOf( const char *const sName )
+{
+	uint32_t uiHash = 2166136261UL;
+	size_t sIndex;
+
+	// FNV-1a folded to 16 bits, the marker's key is kept for the marker
+	for ( sIndex = 0; ( sIndex < LEN_NAME_MAX ) && ( '\0' != sName[ sIndex ] ); sIndex++ )
+	{
+		uiHash = ( uiHash ^ (uint8_t)sName[ sIndex ] ) * 16777619UL;
+	}
+
+	uiHash = ( uiHash >> 16 ) ^ ( uiHash & 0xFFFF );
+
+	return ( KEY_SNAPSHOT_END == uiHash ) ? ( KEY_SNAPSHOT_END - 1 ) : (uint16_t)uiHash;
+}
+
+/* ************************************************************************** */
+static uint16_t RecordCheck( const uint32_t uiSeq, const uint16_t uiKey, const uint32_t uiValue )
+{
+	// The sequence ties a record to its sector, so nothing left over from
+	// before an erase can pass
+	return Crc16Word( Crc16Word( Crc16Word( CRC_INIT, uiSeq ), uiKey ), uiValue );
+}
+
+/* ************************************************************************** */
+static uint16_t Crc16Word( uint16_t uiCrc, const uint32_t uiWord )
+{
+	uint8_t uiShift;
+	uint8_t uiByte;
+
+	for ( uiShift = 0; uiShift < 32; uiShift += 8 )
+	{
+		uiByte = (uint8_t)( uiWord >> uiShift );
+		uiCrc = (uint16_t)( ( uiCrc << 4 ) ^ auiCrcTable[ ( uiCrc >> 12 ) ^ ( uiByte >> 4 ) ] );
+		uiCrc = (uint16_t)( ( uiCrc << 4 ) ^ auiCrcTable[ ( uiCrc >> 12 ) ^ ( uiByte & 0x0F ) ] );
+	}
+
+	return uiCrc;
+}
+
+/* ************************************************************************** */
+static uint32_t FloatBits( const float fValue )
+{
+	uint32_t uiBits;
+
+	memcpy( &uiBits, &fValue, sizeof( uiBits ) );
+
+	return uiBits;
+}
+
+/* ************************************************************************** */
+static float BitsFloat( const uint32_t uiBits )
+{
+	float fValue;
+
+	memcpy( &fValue, &uiBits, sizeof( fValue ) );
+
+	return fValue;
+}
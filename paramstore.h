@@ -0,0 +1,68 @@
+#ifndef PARAMSTORE_H
+#define PARAMSTORE_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+
+/*
+ * Keeps the parameters (params.h) across power cycles in a journal in the
+ * storage nvm.h gives us.
+ *
+ * Each sector starts with a header holding its sequence number, then a
+ * snapshot of every parameter closed by a marker record, then a record for
+ * each change after that. A record is the parameter's key (a hash of its
+ * name, so the table can be reordered or grown between builds), its value and
+ * a CRC over both and the sector's sequence. The sector is filled in order
+ * and when it is full the next one round the ring is erased and started, so
+ * every sector wears at the same rate.
+ *
+ * At start up the newest sector with a whole snapshot is replayed along with
+ * any newer one, normally just the one sector. A record or header cut short
+ * by a power loss fails its CRC and is skipped, a snapshot cut short leaves
+ * the sector before it to replay from and the next change starts a new one.
+ *
+ * PARAMSTORE_Process writes changes once they have stopped for
+ * PARAMSTORE_SETTLE_MS, so a slider being dragged is one record rather than
+ * hundreds. It never waits on an erase, and only reads the parameters
+ * through PARAM_ReadGroup, so whichever task calls it never holds up the
+ * flight task.
+ */
+
+#define PARAMSTORE_SETTLE_MS	( 1000 )
+
+typedef struct
+{
+	bool bEnabled;				// False with no storage, values are the defaults
+	uint8_t uiSector;			// The one being written
+	uint32_t uiSectorSeq;		// Sectors started since the storage was new
+	uint16_t uiFreeRecords;		// Left in this sector
+	uint16_t uiReplayed;		// Records applied at start up
+	uint32_t uiRecordsWritten;	// Since start up, snapshots included
+	uint32_t uiErrors;			// Failed writes and erases
+
+} stPARAMSTORE_Status_t;
+
+/**
+ * @brief		Finds the journal and applies what it holds to the
+ * 				parameters, call once after PARAM_Create and before the tasks
+ * 				start. Also the reset for the host tests.
+ * @return		true if the journal is in use, false if there is no storage
+ * 				and the parameters stay at their defaults.
+ */
+bool PARAMSTORE_Create( void );
+
+/**
+ * @brief		Writes parameter changes to the journal, or moves on an erase.
+ * 				Call regularly from one low priority task.
+ * @param[in]	uiElapsed_ms	Time since the last call.
+ */
+void PARAMSTORE_Process( const uint32_t uiElapsed_ms );
+
+/**
+ * @brief		How the journal is doing.
+ * @param[out]	pstStatus	Where to put it.
+ */
+void PARAMSTORE_GetStatus( stPARAMSTORE_Status_t *const pstStatus );
+
+#endif
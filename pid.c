@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include "fixmath.h"
 
 /* ************************************************************************** */
 void PID_Setup( stPidCxt_t *pstCxt,
@@ -27,6 +28,14 @@ float PID_Update( stPidCxt_t *pstCxt, float fError, float fTimestep_s )
 {
 	float fDiff;
 
+	// No time passed, nothing to integrate and no rate of change to take. As
+	// PID_UpdateQ does with a zero 1 / timestep.
+	if ( 0.0f >= fTimestep_s )
+	{
+		pstCxt->fLastError = fError;
+		return ( fError * pstCxt->fKProp ) + ( pstCxt->fIntegral * pstCxt->fKInt );
+	}
+
 	// Calc integral
 	pstCxt->fIntegral += ( fError * fTimestep_s );
 
@@ -55,3 +64,60 @@ void PID_SetGains( stPidCxt_t *pstCxt, const float fP, const float fD, const flo
 	pstCxt->fKProp = fP;
 	pstCxt->fKDiff = fD;
 }
+
+/* ************************************************************************** */
+void PID_SetupQ( stPidQCxt_t *pstCxt,
+				 q16_t qKInt,
+				 q16_t qKProp,
+				 q16_t qKDiff,
+				 q16_t qIntMax,
+				 q16_t qIntMin )
+{
+	pstCxt->qKInt = qKInt;
+	pstCxt->qKProp = qKProp;
+	pstCxt->qKDiff = qKDiff;
+	pstCxt->qIntMax = qIntMax;
+	pstCxt->qIntMin = qIntMin;
+
+	pstCxt->qLastError = 0;
+	pstCxt->qIntegral = 0;
+}
+
+/* ************************************************************************** */
+q16_t PID_UpdateQ( stPidQCxt_t *pstCxt, q16_t qError, q30_t qTimestep_s, q16_t qInvTimestep )
+{
+	q16_t qDiff;
+	q16_t qOutput;
+
+	// Calc integral
+	pstCxt->qIntegral = FIXMATH_Add( pstCxt->qIntegral, FIXMATH_MulQ16Q30( qError, qTimestep_s ) );
+
+	// Integral Limiting
+	if ( pstCxt->qIntegral > pstCxt->qIntMax )
+	{
+		pstCxt->qIntegral = pstCxt->qIntMax;
+	}
+	else if ( pstCxt->qIntegral < pstCxt->qIntMin )
+	{
+		pstCxt->qIntegral = pstCxt->qIntMin;
+	}
+
+	// Calc differential
+	qDiff = FIXMATH_Mul( FIXMATH_Sub( qError, pstCxt->qLastError ), qInvTimestep );
+	pstCxt->qLastError = qError;
+
+	// Calc output, saturating rather than wrapping if a gain is silly
+	qOutput = FIXMATH_Mul( qError, pstCxt->qKProp );
+	qOutput = FIXMATH_Add( qOutput, FIXMATH_Mul( pstCxt->qIntegral, pstCxt->qKInt ) );
+	qOutput = FIXMATH_Add( qOutput, FIXMATH_Mul( qDiff, pstCxt->qKDiff ) );
+
+	return qOutput;
+}
+
+/* ************************************************************************** */
+void PID_SetGainsQ( stPidQCxt_t *pstCxt, const q16_t qP, const q16_t qD, const q16_t qI )
+{
+	pstCxt->qKInt = qI;
+	pstCxt->qKProp = qP;
+	pstCxt->qKDiff = qD;
+}
@@ -2,6 +2,7 @@
 #define PID_H
 
 #include <stdint.h>
+#include "fixmath.h"
 
 typedef struct
 {
@@ -17,6 +18,21 @@ typedef struct
 
 } stPidCxt_t;
 
+// Fixed point version of the above, everything is Q16
+typedef struct
+{
+	q16_t qKInt;
+	q16_t qKProp;
+	q16_t qKDiff;
+
+	q16_t qIntMax;
+	q16_t qIntMin;
+
+	q16_t qLastError;
+	q16_t qIntegral;
+
+} stPidQCxt_t;
+
 void PID_Setup( stPidCxt_t *pstCxt,
 				float fKInt,
 				float fKProp,
@@ -26,4 +42,15 @@ void PID_Setup( stPidCxt_t *pstCxt,
 float PID_Update( stPidCxt_t *pstCxt, float fError, float fTimestep_s );
 void PID_SetGains( stPidCxt_t *pstCxt, const float fP, const float fD, const float fI );
 
+void PID_SetupQ( stPidQCxt_t *pstCxt,
+				 q16_t qKInt,
+				 q16_t qKProp,
+				 q16_t qKDiff,
+				 q16_t qIntMax,
+				 q16_t qIntMin );
+// The caller passes 1 / timestep as well so a loop running several PIDs
+// divides once rather than once per PID
+q16_t PID_UpdateQ( stPidQCxt_t *pstCxt, q16_t qError, q30_t qTimestep_s, q16_t qInvTimestep );
+void PID_SetGainsQ( stPidQCxt_t *pstCxt, const q16_t qP, const q16_t qD, const q16_t qI );
+
 #endif
@@ -6,6 +6,7 @@
 #include <stdint.h>			// std types
 #include <stdbool.h>		// bool definition
 #include <stddef.h>			// size_t
+#include <string.h>			// memcpy & friends
 
 #include "FreeRTOS.h"		// FreeRTOS
 #include "FreeRTOSConfig.h"	// FreeRTOS portable config
@@ -18,18 +19,48 @@
 /* ************************************************************************** **
  * Macros and Defines
  * ************************************************************************** */
+#ifndef MAX_SUBS
 #define MAX_SUBS		( 16 )
+#endif
+
+#define mIPC_TOPIC_SIZE( eTopic, tMsg, eKind )		sizeof( tMsg ),
+
+// Two message slots for each LATEST topic and nothing for QUEUE topics
+#define mMAILBOX_STORAGE_LATEST( eTopic, tMsg )		static uint8_t abyMailbox_##eTopic[ 2 * sizeof( tMsg ) ];
+#define mMAILBOX_STORAGE_QUEUE( eTopic, tMsg )
+#define mMAILBOX_SLOTS_LATEST( eTopic )				abyMailbox_##eTopic
+#define mMAILBOX_SLOTS_QUEUE( eTopic )				NULL
+#define mIPC_TOPIC_MAILBOX_STORAGE( eTopic, tMsg, eKind )	mMAILBOX_STORAGE_##eKind( eTopic, tMsg )
+#define mIPC_TOPIC_MAILBOX( eTopic, tMsg, eKind )			{ 0, mMAILBOX_SLOTS_##eKind( eTopic ) },
+
+// Publish has finished with the slot before readers see the sequence move on,
+// and readers are done copying before they check it again
+#define mLoadAcquire( x )		__atomic_load_n( &( x ), __ATOMIC_ACQUIRE )
+#define mStoreRelaxed( x, v )	__atomic_store_n( &( x ), ( v ), __ATOMIC_RELAXED )
+#define mStoreRelease( x, v )	__atomic_store_n( &( x ), ( v ), __ATOMIC_RELEASE )
 
 /* ************************************************************************** **
  * Typedefs
  * ************************************************************************** */
 struct stSubscription
 {
-	uint32_t uiTopic;
+	eIPC_Topic_t eTopic;
 	size_t sMsgSize;
 	QueueHandle_t xQueue;
+	struct stSubscription *pstNext;		// Next subscriber to the same topic
 };
 
+// Sequence locked double buffer. The sequence is odd while a publish is
+// writing and every completed publish moves it on by two, flipping which of
+// the two slots holds the newest message. Readers copy the newest slot and
+// retry only if a publish could have started writing over it meanwhile.
+typedef struct
+{
+	volatile uint32_t uiSeq;
+	uint8_t *pbySlots;
+
+} stMailbox_t;
+
 /* ************************************************************************** **
  * Function Prototypes
  * ************************************************************************** */
@@ -40,6 +71,16 @@ struct stSubscription
 static struct stSubscription astSubs[ MAX_SUBS ];
 static size_t sNumSubs;
 
+// Head of each topic's subscriber list, built at subscribe time so that a
+// publish only ever visits its own subscribers
+static struct stSubscription *apstTopicSubs[ TOPIC_NUM ];
+
+static const size_t asTopicMsgSize[ TOPIC_NUM ] = { IPC_TOPICS( mIPC_TOPIC_SIZE ) };
+
+IPC_TOPICS( mIPC_TOPIC_MAILBOX_STORAGE )
+
+static stMailbox_t astMailbox[ TOPIC_NUM ] = { IPC_TOPICS( mIPC_TOPIC_MAILBOX ) };
+
 /* ************************************************************************** **
  * API Functions
  * ************************************************************************** */
@@ -47,16 +88,28 @@ static size_t sNumSubs;
 /* ************************************************************************** */
 void PUBSUB_Create( void )
 {
+	uint32_t uiIndex;
+
 	sNumSubs = 0;
 
+	for ( uiIndex = 0; uiIndex < TOPIC_NUM; uiIndex++ )
+	{
+		apstTopicSubs[uiIndex] = NULL;
+	}
+
 	return;
 }
 
 /* ************************************************************************** */
-hPUBSUB_Subscription_t PUBSUB_Subscribe( const uint32_t uiTopic, const size_t sMsgSize, const size_t sQueueLen )
+hPUBSUB_Subscription_t PUBSUB_SubscribeTopic( const eIPC_Topic_t eTopic, const size_t sQueueLen )
 {
 	struct stSubscription *pstSub = NULL;
 
+	if ( TOPIC_NUM <= eTopic )
+	{
+		return NULL;
+	}
+
 	taskENTER_CRITICAL();
 
 	if ( sNumSubs < MAX_SUBS )
@@ -69,9 +122,15 @@ hPUBSUB_Subscription_t PUBSUB_Subscribe( const uint32_t uiTopic, const size_t sM
 
 	if ( NULL != pstSub )
 	{
-		pstSub->xQueue = xQueueCreate( sQueueLen, sMsgSize );
-		pstSub->uiTopic = uiTopic;
-		pstSub->sMsgSize = sMsgSize;
+		pstSub->xQueue = xQueueCreate( sQueueLen, asTopicMsgSize[eTopic] );
+		pstSub->eTopic = eTopic;
+		pstSub->sMsgSize = asTopicMsgSize[eTopic];
+
+		// Only make it visible to publishers once it is fully set up
+		taskENTER_CRITICAL();
+		pstSub->pstNext = apstTopicSubs[eTopic];
+		apstTopicSubs[eTopic] = pstSub;
+		taskEXIT_CRITICAL();
 
 		return pstSub;
 	}
@@ -82,21 +141,82 @@ hPUBSUB_Subscription_t PUBSUB_Subscribe( const uint32_t uiTopic, const size_t sM
 }
 
 /* ************************************************************************** */
-void PUBSUB_Publish( const uint32_t uiTopic, const void *const pvMsg )
+void PUBSUB_PublishTopic( const eIPC_Topic_t eTopic, const void *const pvMsg )
 {
-	uint32_t uiIndex;
+	struct stSubscription *pstSub;
+	stMailbox_t *pstMailbox;
+	uint32_t uiSeq;
+	uint32_t uiSlot;
 
-	for ( uiIndex = 0; uiIndex < sNumSubs; uiIndex++ )
+	if ( TOPIC_NUM <= eTopic )
 	{
-		if ( astSubs[uiIndex].uiTopic == uiTopic )
-		{
-			xQueueSend( astSubs[uiIndex].xQueue, pvMsg, 0 );
-		}
+		return;
+	}
+
+	pstMailbox = &astMailbox[eTopic];
+
+	if ( NULL != pstMailbox->pbySlots )
+	{
+		// Write the slot readers aren't pointed at, bracketed by the odd
+		// sequence number. There is only one publisher so no lock is needed.
+		uiSeq = pstMailbox->uiSeq;
+		uiSlot = ( ( uiSeq >> 1 ) + 1 ) & 1;
+
+		mStoreRelaxed( pstMailbox->uiSeq, uiSeq + 1 );
+		__atomic_thread_fence( __ATOMIC_RELEASE );
+
+		memcpy( &pstMailbox->pbySlots[ uiSlot * asTopicMsgSize[eTopic] ], pvMsg, asTopicMsgSize[eTopic] );
+
+		mStoreRelease( pstMailbox->uiSeq, uiSeq + 2 );
+	}
+
+	for ( pstSub = apstTopicSubs[eTopic]; NULL != pstSub; pstSub = pstSub->pstNext )
+	{
+		xQueueSend( pstSub->xQueue, pvMsg, 0 );
 	}
 
 	return;
 }
 
+/* ************************************************************************** */
+bool PUBSUB_ReadLatestTopic( const eIPC_Topic_t eTopic, void *const pvMsg )
+{
+	stMailbox_t *pstMailbox;
+	uint32_t uiSeqBefore;
+	uint32_t uiSeqAfter;
+	size_t sMsgSize;
+
+	if ( ( TOPIC_NUM <= eTopic ) || ( NULL == astMailbox[eTopic].pbySlots ) )
+	{
+		return false;
+	}
+
+	pstMailbox = &astMailbox[eTopic];
+	sMsgSize = asTopicMsgSize[eTopic];
+
+	do
+	{
+		uiSeqBefore = mLoadAcquire( pstMailbox->uiSeq );
+
+		if ( uiSeqBefore < 2 )
+		{
+			// Nothing has been published yet
+			memset( pvMsg, 0, sMsgSize );
+			return false;
+		}
+
+		memcpy( pvMsg, &pstMailbox->pbySlots[ ( ( uiSeqBefore >> 1 ) & 1 ) * sMsgSize ], sMsgSize );
+
+		__atomic_thread_fence( __ATOMIC_ACQUIRE );
+		uiSeqAfter = pstMailbox->uiSeq;
+
+		// Our slot is only written again by the publish after next, which
+		// starts two counts on from a stable sequence or one from an odd one
+	} while ( ( uiSeqAfter - uiSeqBefore ) > ( ( uiSeqBefore & 1 ) ? 1u : 2u ) );
+
+	return true;
+}
+
 /* ************************************************************************** */
 bool PUBSUB_Receive( hPUBSUB_Subscription_t hSubscription, void *const pvMsg )
 {
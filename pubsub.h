@@ -5,17 +5,72 @@
 #include <stdbool.h>		// bool definition
 #include <stddef.h>			// size_t
 
+#include "IPC_types.h"		// eIPC_Topic_t and the topic message types
+
 struct stSubscription;
 
 typedef struct stSubscription* hPUBSUB_Subscription_t;
 
+// Fails to compile if sMsgSize isn't the size of the message type declared for
+// eTopic in IPC_types.h
+#define mPUBSUB_CHECK_SIZE( eTopic, sMsgSize ) \
+	_Static_assert( ( sMsgSize ) == sizeof( eTopic##_t ), #eTopic " message size mismatch" )
+
+/**
+ * @brief		Subscribes to a topic, checking the message size at compile
+ * 				time. eTopic must be one of the TOPIC_ names.
+ * @param[in]	eTopic		The topic to subscribe to.
+ * @param[in]	sMsgSize	Size of the message type the subscriber expects.
+ * @param[in]	sQueueLen	Number of messages to queue for this subscriber.
+ * @return		The subscription handle, NULL if no subscriptions are left.
+ */
+#define PUBSUB_Subscribe( eTopic, sMsgSize, sQueueLen ) \
+	( { mPUBSUB_CHECK_SIZE( eTopic, sMsgSize ); PUBSUB_SubscribeTopic( eTopic, sQueueLen ); } )
+
+/**
+ * @brief		Publishes a message to every subscriber of a topic, checking
+ * 				the message size at compile time. eTopic must be one of the
+ * 				TOPIC_ names and pvMsg a typed pointer to the message.
+ * @param[in]	eTopic		The topic to publish on.
+ * @param[in]	pvMsg		The message.
+ */
+#define PUBSUB_Publish( eTopic, pvMsg ) \
+	do { mPUBSUB_CHECK_SIZE( eTopic, sizeof( *( pvMsg ) ) ); PUBSUB_PublishTopic( eTopic, pvMsg ); } while ( 0 )
+
+/**
+ * @brief		Copies out the newest message of a LATEST topic, checking the
+ * 				message size at compile time. Never blocks, any number of
+ * 				tasks may read, and publish doesn't wait for readers.
+ * @param[in]	eTopic		The topic to read, must be a LATEST topic.
+ * @param[out]	pvMsg		Typed pointer to where to put the message.
+ * @return		true if a message was read, false (with the message zeroed)
+ * 				if nothing has been published yet.
+ */
+#define PUBSUB_ReadLatest( eTopic, pvMsg ) \
+	( { mPUBSUB_CHECK_SIZE( eTopic, sizeof( *( pvMsg ) ) ); PUBSUB_ReadLatestTopic( eTopic, pvMsg ); } )
+
 /**
  * @brief		Initialises the pubsub module.
  */
 void PUBSUB_Create( void );
 
-hPUBSUB_Subscription_t PUBSUB_Subscribe( const uint32_t uiTopic, const size_t sMsgSize, const size_t sQueueLen );
-void PUBSUB_Publish( const uint32_t uiTopic, const void *const pvMsg  );
+/**
+ * @brief		Unchecked PUBSUB_Subscribe, the queue is sized from the topic
+ * 				list so prefer the macro.
+ */
+hPUBSUB_Subscription_t PUBSUB_SubscribeTopic( const eIPC_Topic_t eTopic, const size_t sQueueLen );
+
+/**
+ * @brief		Unchecked PUBSUB_Publish. Only the topic's own subscribers
+ * 				are visited, a LATEST topic's mailbox is updated first.
+ */
+void PUBSUB_PublishTopic( const eIPC_Topic_t eTopic, const void *const pvMsg );
+
+/**
+ * @brief		Unchecked PUBSUB_ReadLatest.
+ */
+bool PUBSUB_ReadLatestTopic( const eIPC_Topic_t eTopic, void *const pvMsg );
+
 bool PUBSUB_Receive( hPUBSUB_Subscription_t hSubscription, void *const pbyMsg );
 uint32_t PUBSUB_MessagesWaiting( hPUBSUB_Subscription_t hSubscription );
 
@@ -0,0 +1,88 @@
+#include "ringbuf.h"
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+#include <string.h>			// memcpy & friends
+
+// The data copy must be complete before the other side sees the index move,
+// and the index must be read before the data it guards. On the single core
+// K20 this only has to stop the compiler reordering, on the host it is a
+// real fence.
+#define mLoadAcquire( x )		__atomic_load_n( &( x ), __ATOMIC_ACQUIRE )
+#define mStoreRelease( x, v )	__atomic_store_n( &( x ), ( v ), __ATOMIC_RELEASE )
+
+/* ************************************************************************** */
+int RINGBUF_Create( stRINGBUF_Ctx_t *const pstCtx, uint8_t *const pbyBuffer, const uint32_t uiSize )
+{
+	if ( ( 0 == uiSize ) || ( 0 != ( uiSize & ( uiSize - 1 ) ) ) )
+	{
+		return -1;
+	}
+
+	pstCtx->pbyBuffer = pbyBuffer;
+	pstCtx->uiMask = uiSize - 1;
+	pstCtx->uiHead = 0;
+	pstCtx->uiTail = 0;
+
+	return 0;
+}
+
+/* ************************************************************************** */
+uint32_t RINGBUF_Write( stRINGBUF_Ctx_t *const pstCtx, const uint8_t *pbyData, const uint32_t uiLen )
+{
+	uint32_t uiHead = pstCtx->uiHead;
+	uint32_t uiTail = mLoadAcquire( pstCtx->uiTail );
+	uint32_t uiFree = ( pstCtx->uiMask + 1 ) - ( uiHead - uiTail );
+	uint32_t uiCount = ( uiLen < uiFree ) ? uiLen : uiFree;
+	uint32_t uiOffset = uiHead & pstCtx->uiMask;
+	uint32_t uiFirst = ( pstCtx->uiMask + 1 ) - uiOffset;
+
+	// At most two copies, up to the end of the buffer then from the start
+	if ( uiFirst > uiCount )
+	{
+		uiFirst = uiCount;
+	}
+
+	memcpy( &pstCtx->pbyBuffer[ uiOffset ], pbyData, uiFirst );
+	memcpy( pstCtx->pbyBuffer, pbyData + uiFirst, uiCount - uiFirst );
+
+	mStoreRelease( pstCtx->uiHead, uiHead + uiCount );
+
+	return uiCount;
+}
+
+/* ************************************************************************** */
+uint32_t RINGBUF_Read( stRINGBUF_Ctx_t *const pstCtx, uint8_t *pbyData, const uint32_t uiMax )
+{
+	uint32_t uiTail = pstCtx->uiTail;
+	uint32_t uiHead = mLoadAcquire( pstCtx->uiHead );
+	uint32_t uiUsed = uiHead - uiTail;
+	uint32_t uiCount = ( uiMax < uiUsed ) ? uiMax : uiUsed;
+	uint32_t uiOffset = uiTail & pstCtx->uiMask;
+	uint32_t uiFirst = ( pstCtx->uiMask + 1 ) - uiOffset;
+
+	if ( uiFirst > uiCount )
+	{
+		uiFirst = uiCount;
+	}
+
+	memcpy( pbyData, &pstCtx->pbyBuffer[ uiOffset ], uiFirst );
+	memcpy( pbyData + uiFirst, pstCtx->pbyBuffer, uiCount - uiFirst );
+
+	mStoreRelease( pstCtx->uiTail, uiTail + uiCount );
+
+	return uiCount;
+}
+
+/* ************************************************************************** */
+uint32_t RINGBUF_Used( const stRINGBUF_Ctx_t *const pstCtx )
+{
+	return mLoadAcquire( pstCtx->uiHead ) - mLoadAcquire( pstCtx->uiTail );
+}
+
+/* ************************************************************************** */
+uint32_t RINGBUF_Free( const stRINGBUF_Ctx_t *const pstCtx )
+{
+	return ( pstCtx->uiMask + 1 ) - RINGBUF_Used( pstCtx );
+}
@@ -0,0 +1,68 @@
+#ifndef RINGBUF_H
+#define RINGBUF_H
+
+#include <stdint.h>			// std types
+#include <stdbool.h>		// bool definition
+#include <stddef.h>			// size_t
+
+/*
+ * Single producer, single consumer byte ring. One side may be an interrupt
+ * handler, neither side takes a lock. The head and tail are free running and
+ * only ever written by one side each, the buffer size must be a power of two
+ * so that they can be masked rather than wrapped with a modulo. This holds no
+ * hardware knowledge so it builds on the host as well as the target.
+ */
+
+typedef struct
+{
+	uint8_t *pbyBuffer;
+	uint32_t uiMask;			// Buffer size - 1
+
+	volatile uint32_t uiHead;	// Written by the producer only
+	volatile uint32_t uiTail;	// Written by the consumer only
+
+} stRINGBUF_Ctx_t;
+
+/**
+ * @brief		Initialises an empty ring over a caller supplied buffer.
+ * @param[in]	pstCtx		The ring context to initialise.
+ * @param[in]	pbyBuffer	Storage for the ring.
+ * @param[in]	uiSize		Size of the storage, must be a power of two.
+ * @return		0 on success, -1 if the size is not a power of two.
+ */
+int RINGBUF_Create( stRINGBUF_Ctx_t *const pstCtx, uint8_t *const pbyBuffer, const uint32_t uiSize );
+
+/**
+ * @brief		Copies as much of the data as will fit into the ring, producer
+ * 				side only.
+ * @param[in]	pstCtx		The ring context to use.
+ * @param[in]	pbyData		The data to queue.
+ * @param[in]	uiLen		Number of bytes to queue.
+ * @return		The number of bytes queued, less than uiLen if the ring filled.
+ */
+uint32_t RINGBUF_Write( stRINGBUF_Ctx_t *const pstCtx, const uint8_t *pbyData, const uint32_t uiLen );
+
+/**
+ * @brief		Copies up to uiMax bytes out of the ring, consumer side only.
+ * @param[in]	pstCtx		The ring context to use.
+ * @param[out]	pbyData		Where to put the data.
+ * @param[in]	uiMax		Size of pbyData.
+ * @return		The number of bytes read, 0 if the ring was empty.
+ */
+uint32_t RINGBUF_Read( stRINGBUF_Ctx_t *const pstCtx, uint8_t *pbyData, const uint32_t uiMax );
+
+/**
+ * @brief		Number of bytes waiting to be read. Exact from the consumer
+ * 				side, a lower bound from the producer side.
+ * @param[in]	pstCtx		The ring context to use.
+ */
+uint32_t RINGBUF_Used( const stRINGBUF_Ctx_t *const pstCtx );
+
+/**
+ * @brief		Number of bytes that can be written. Exact from the producer
+ * 				side, a lower bound from the consumer side.
+ * @param[in]	pstCtx		The ring context to use.
+ */
+uint32_t RINGBUF_Free( const stRINGBUF_Ctx_t *const pstCtx );
+
+#endif
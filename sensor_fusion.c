@@ -1,25 +1,90 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
-#include <math.h>		// <- TODO how efficient is this - used for atan2() (see below)?
+#include <math.h>		// cosf & sinf, the rest is fastmath
 #include <string.h>
 
 #include "sensor_fusion.h"
 #include "kalman.h"
 #include "vector3f.h"
 #include "MadgwickAHRS.h"
+#include "MahonyAHRS.h"
+#include "ekf.h"
+#include "fixmath.h"
+#include "fastmath.h"
+#include "cycles.h"
 
 #define PI					( 3.14159265359f )
 #define RAD2DEG				( 180/PI )
 #define fRatioGyro			( 0.99 )
 #define fRatioAccel			( 1 - fRatioGyro )
 
-// Which sensor fusion algorithm to use
+// Which sensor fusion algorithm to start with, unless the build picks one with
+// -D. SENSORFUSION_SetStrategy changes it at run time.
+#if !defined KALMAN && !defined MADGWICK && !defined MAHONY && !defined COMPLIMENTARY && !defined EKF
 #define KALMAN
 //#define MADGWICK
+//#define MAHONY
 //#define COMPLIMENTARY
+//#define EKF
+#endif
+
+#if defined MADGWICK
+#define STRATEGY_DEFAULT	SENSORFUSION_MADGWICK
+#elif defined MAHONY
+#define STRATEGY_DEFAULT	SENSORFUSION_MAHONY
+#elif defined COMPLIMENTARY
+#define STRATEGY_DEFAULT	SENSORFUSION_COMPLIMENTARY
+#elif defined EKF
+#define STRATEGY_DEFAULT	SENSORFUSION_EKF
+#else
+#define STRATEGY_DEFAULT	SENSORFUSION_KALMAN
+#endif
+
+// One algorithm. Start is called on switching to it, NULL if it carries on
+// from stRotation as it is, and Update leaves its estimate in stRotation.
+typedef struct
+{
+	const char *pcName;
+	void (*pfStart)( stSENSORFUSION_Cxt_t *pstCxt );
+	void (*pfUpdate)( stSENSORFUSION_Cxt_t *pstCxt,
+					  const vector3f_t *pstGyro,
+					  const vector3f_t *pstDelta,
+					  const vector3f_t *pstAccel,
+					  const vector3f_t *pstMag,
+					  const float fTimestep_s );
+
+} stSTRATEGY_t;
 
 static float GetMag( float x, float y, float z );
+static q16_t GetMagQ( q16_t x, q16_t y );
+
+static void StartKalman( stSENSORFUSION_Cxt_t *pstCxt );
+static void UpdateKalman( stSENSORFUSION_Cxt_t *pstCxt, const vector3f_t *pstGyro, const vector3f_t *pstDelta,
+						  const vector3f_t *pstAccel, const vector3f_t *pstMag, const float fTimestep_s );
+static void UpdateComplimentary( stSENSORFUSION_Cxt_t *pstCxt, const vector3f_t *pstGyro, const vector3f_t *pstDelta,
+								 const vector3f_t *pstAccel, const vector3f_t *pstMag, const float fTimestep_s );
+static void StartMadgwick( stSENSORFUSION_Cxt_t *pstCxt );
+static void UpdateMadgwick( stSENSORFUSION_Cxt_t *pstCxt, const vector3f_t *pstGyro, const vector3f_t *pstDelta,
+							const vector3f_t *pstAccel, const vector3f_t *pstMag, const float fTimestep_s );
+static void StartMahony( stSENSORFUSION_Cxt_t *pstCxt );
+static void UpdateMahony( stSENSORFUSION_Cxt_t *pstCxt, const vector3f_t *pstGyro, const vector3f_t *pstDelta,
+						  const vector3f_t *pstAccel, const vector3f_t *pstMag, const float fTimestep_s );
+static void StartEkf( stSENSORFUSION_Cxt_t *pstCxt );
+static void UpdateEkf( stSENSORFUSION_Cxt_t *pstCxt, const vector3f_t *pstGyro, const vector3f_t *pstDelta,
+					   const vector3f_t *pstAccel, const vector3f_t *pstMag, const float fTimestep_s );
+static void EulerToQuat( const vector3f_t *pstRotation, float *pfQ0, float *pfQ1, float *pfQ2, float *pfQ3 );
+static void QuatToEuler( const float fQ0, const float fQ1, const float fQ2, const float fQ3, vector3f_t *pstRotation );
+
+// Indexed by eSENSORFUSION_Strategy_t
+static const stSTRATEGY_t astStrategies[ SENSORFUSION_NUM_STRATEGIES ] =
+{
+	[ SENSORFUSION_KALMAN ]			= { "kalman", StartKalman, UpdateKalman },
+	[ SENSORFUSION_COMPLIMENTARY ]	= { "complimentary", NULL, UpdateComplimentary },
+	[ SENSORFUSION_MADGWICK ]		= { "madgwick", StartMadgwick, UpdateMadgwick },
+	[ SENSORFUSION_EKF ]			= { "ekf", StartEkf, UpdateEkf },
+	[ SENSORFUSION_MAHONY ]			= { "mahony", StartMahony, UpdateMahony },
+};
 
 /* ************************************************************************** */
 void SENSORFUSION_Setup( stSENSORFUSION_Cxt_t *pstCxt )
@@ -29,61 +94,319 @@ void SENSORFUSION_Setup( stSENSORFUSION_Cxt_t *pstCxt )
 	pstCxt->stRotation.y = 0;
 	pstCxt->stRotation.z = 0;
 
-#ifdef KALMAN
+	// Every filter is set up so any can be tuned, or switched to, whichever
+	// is running
 	KALMAN_Setup( &pstCxt->stKalmanPitch );
 	KALMAN_Setup( &pstCxt->stKalmanRoll );
-#endif
+	KALMAN_SetSteadyState( &pstCxt->stKalmanPitch, true );
+	KALMAN_SetSteadyState( &pstCxt->stKalmanRoll, true );
+	MadgwickSetup( &pstCxt->stMadgwick );
+	MahonySetup( &pstCxt->stMahony );
+	EKF_Setup( &pstCxt->stEkf );
+
+	pstCxt->eStrategy = STRATEGY_DEFAULT;
+	pstCxt->uiCycles = 0;
 }
 
 /* ************************************************************************** */
 void SENSORFUSION_Update( stSENSORFUSION_Cxt_t *pstCxt,
 						  vector3f_t *pstGyro,
+						  vector3f_t *pstGyroDelta,
 						  vector3f_t *pstAccel,
 						  vector3f_t *pstMag,
 						  vector3f_t *pstRotation,
 						  float fTimestep_s )
 {
-#ifdef KALMAN
+	uint32_t uiStart = CYCLES_Now();
+	vector3f_t stDelta;
+
+	// Prefer the integrated delta-angle over rate * timestep when we have one
+	// as it includes every gyro sample taken during the timestep.
+	if ( NULL != pstGyroDelta )
+	{
+		stDelta = *pstGyroDelta;
+	}
+	else
+	{
+		stDelta = VECTOR3F_Scale( *pstGyro, fTimestep_s );
+	}
+
+	astStrategies[ pstCxt->eStrategy ].pfUpdate( pstCxt, pstGyro, &stDelta, pstAccel, pstMag, fTimestep_s );
+
+	memcpy( pstRotation, &pstCxt->stRotation, sizeof( vector3f_t ) );
+
+	pstCxt->uiCycles = CYCLES_Now() - uiStart;
+
+	return;
+}
+
+/* ************************************************************************** */
+bool SENSORFUSION_SetStrategy( stSENSORFUSION_Cxt_t *pstCxt, const eSENSORFUSION_Strategy_t eStrategy )
+{
+	if ( (unsigned)eStrategy >= SENSORFUSION_NUM_STRATEGIES )
+	{
+		return false;
+	}
+
+	if ( ( eStrategy != pstCxt->eStrategy ) && ( NULL != astStrategies[ eStrategy ].pfStart ) )
+	{
+		astStrategies[ eStrategy ].pfStart( pstCxt );
+	}
+
+	pstCxt->eStrategy = eStrategy;
+
+	return true;
+}
+
+/* ************************************************************************** */
+const char *SENSORFUSION_GetStrategyName( const eSENSORFUSION_Strategy_t eStrategy )
+{
+	return ( (unsigned)eStrategy < SENSORFUSION_NUM_STRATEGIES ) ? astStrategies[ eStrategy ].pcName : NULL;
+}
+
+/* ************************************************************************** */
+bool SENSORFUSION_FindStrategy( const char *pcName, eSENSORFUSION_Strategy_t *peStrategy )
+{
+	int iStrategy;
+
+	for ( iStrategy = 0; iStrategy < SENSORFUSION_NUM_STRATEGIES; iStrategy++ )
+	{
+		if ( 0 == strcmp( pcName, astStrategies[ iStrategy ].pcName ) )
+		{
+			*peStrategy = (eSENSORFUSION_Strategy_t)iStrategy;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* ************************************************************************** */
+void SENSORFUSION_SetupQ( stSENSORFUSION_Q_Cxt_t *pstCxt )
+{
+	memset( &pstCxt->stRotation, 0, sizeof( pstCxt->stRotation ) );
+
+	KALMAN_SetupQ( &pstCxt->stKalmanPitch );
+	KALMAN_SetupQ( &pstCxt->stKalmanRoll );
+	KALMAN_SetSteadyStateQ( &pstCxt->stKalmanPitch, true );
+	KALMAN_SetSteadyStateQ( &pstCxt->stKalmanRoll, true );
+	pstCxt->uiCycles = 0;
+
+	return;
+}
+
+/* ************************************************************************** */
+void SENSORFUSION_UpdateQ( stSENSORFUSION_Q_Cxt_t *pstCxt,
+						   const vector3q_t *pstGyro,
+						   const vector3q_t *pstGyroDelta,
+						   const vector3q_t *pstAccel,
+						   vector3q_t *pstRotation,
+						   q30_t qTimestep_s )
+{
+	uint32_t uiStart = CYCLES_Now();
+	q16_t qDeltaYaw;
+	q16_t qPitchAngle;
+	q16_t qRollAngle;
+
+	if ( NULL != pstGyroDelta )
+	{
+		qDeltaYaw = pstGyroDelta->z;
+	}
+	else
+	{
+		qDeltaYaw = FIXMATH_MulQ16Q30( pstGyro->z, qTimestep_s );
+	}
+
+	// As the KALMAN case of SENSORFUSION_Update
+	qPitchAngle = FIXMATH_Atan2( -pstAccel->x, GetMagQ( pstAccel->z, pstAccel->y ) );
+	qRollAngle = FIXMATH_Atan2( pstAccel->y, GetMagQ( pstAccel->z, pstAccel->x ) );
+
+	pstCxt->stRotation.y = KALMAN_UpdateQ( &pstCxt->stKalmanPitch, pstGyro->y, qPitchAngle, qTimestep_s );
+	pstCxt->stRotation.x = KALMAN_UpdateQ( &pstCxt->stKalmanRoll, pstGyro->x, qRollAngle, qTimestep_s );
+	pstCxt->stRotation.z = qDeltaYaw + pstCxt->stRotation.z;
+
+	memcpy( pstRotation, &pstCxt->stRotation, sizeof( vector3q_t ) );
+
+	pstCxt->uiCycles = CYCLES_Now() - uiStart;
+
+	return;
+}
+
+/* ************************************************************************** */
+static float GetMag( float x, float y, float z )
+{
+	return FASTMATH_Sqrt( x*x + y*y + z*z );
+}
+
+/* ************************************************************************** */
+static q16_t GetMagQ( q16_t x, q16_t y )
+{
+	return FIXMATH_Sqrt( FIXMATH_Mul( x, x ) + FIXMATH_Mul( y, y ) );
+}
+
+/* ************************************************************************** */
+static void StartKalman( stSENSORFUSION_Cxt_t *pstCxt )
+{
+	// Carry on from the last estimate, the bias and covariance are as they
+	// were left
+	pstCxt->stKalmanRoll.angle = pstCxt->stRotation.x;
+	pstCxt->stKalmanPitch.angle = pstCxt->stRotation.y;
+
+	return;
+}
+
+/* ************************************************************************** */
+static void UpdateKalman( stSENSORFUSION_Cxt_t *pstCxt, const vector3f_t *pstGyro, const vector3f_t *pstDelta,
+						  const vector3f_t *pstAccel, const vector3f_t *pstMag, const float fTimestep_s )
+{
 	float pitchRate = pstGyro->y;
-	float pitchAngle = atan2f( -pstAccel->x, GetMag( pstAccel->z, pstAccel->y, 0 ) );
+	float pitchAngle = FASTMATH_Atan2( -pstAccel->x, GetMag( pstAccel->z, pstAccel->y, 0 ) );
 	float rollRate = pstGyro->x;
-	float rollAngle = atan2f( pstAccel->y, GetMag( pstAccel->z, pstAccel->x, 0 ) );
+	float rollAngle = FASTMATH_Atan2( pstAccel->y, GetMag( pstAccel->z, pstAccel->x, 0 ) );
 
 	pstCxt->stRotation.y = KALMAN_Update( &pstCxt->stKalmanPitch, pitchRate, pitchAngle, fTimestep_s );
 	pstCxt->stRotation.x = KALMAN_Update( &pstCxt->stKalmanRoll, rollRate, rollAngle, fTimestep_s );
-	pstCxt->stRotation.z = pstGyro->z * fTimestep_s + pstCxt->stRotation.z;
+	pstCxt->stRotation.z = pstDelta->z + pstCxt->stRotation.z;
 
-	memcpy( pstRotation, &pstCxt->stRotation, sizeof( vector3f_t ) );
-#elif defined COMPLIMENTARY
-	// Complimentary filter
-	pstCxt->stRotation.x = ( fRatioGyro * ( pstGyro->x * fTimestep_s + pstCxt->stRotation.x ) )
-			+ ( fRatioAccel * ( atan2f( pstAccel->y, GetMag( pstAccel->z, pstAccel->x, 0 ) ) ) );
-	pstCxt->stRotation.y = ( fRatioGyro * ( pstGyro->y * fTimestep_s + pstCxt->stRotation.y ) )
-			- ( fRatioAccel * ( atan2f( pstAccel->x, GetMag( pstAccel->z, pstAccel->y, 0 ) ) ) );
+	return;
+}
 
-	memcpy( pstRotation, &pstCxt->stRotation, sizeof( vector3f_t ) );
-#elif defined MADGWICK
+/* ************************************************************************** */
+static void UpdateComplimentary( stSENSORFUSION_Cxt_t *pstCxt, const vector3f_t *pstGyro, const vector3f_t *pstDelta,
+								 const vector3f_t *pstAccel, const vector3f_t *pstMag, const float fTimestep_s )
+{
+	pstCxt->stRotation.x = ( fRatioGyro * ( pstDelta->x + pstCxt->stRotation.x ) )
+			+ ( fRatioAccel * ( FASTMATH_Atan2( pstAccel->y, GetMag( pstAccel->z, pstAccel->x, 0 ) ) ) );
+	pstCxt->stRotation.y = ( fRatioGyro * ( pstDelta->y + pstCxt->stRotation.y ) )
+			- ( fRatioAccel * ( FASTMATH_Atan2( pstAccel->x, GetMag( pstAccel->z, pstAccel->y, 0 ) ) ) );
 
-	MadgwickAHRSupdateIMU( pstGyro->x, pstGyro->y, pstGyro->z,
-						   pstAccel->x, pstAccel->y, pstAccel->z );
+	return;
+}
 
-	/*
-	MadgwickQuaternionUpdate( pstGyro->x, pstGyro->y, pstGyro->z,
-							  pstAccel->x, pstAccel->y, pstAccel->z,
-							  pstMag->x, pstMag->y, pstMag->z );
-							  */
+/* ************************************************************************** */
+static void StartMadgwick( stSENSORFUSION_Cxt_t *pstCxt )
+{
+	stMADGWICK_Cxt_t *pstM = &pstCxt->stMadgwick;
 
-	pstCxt->stRotation.x = atan2(2.0f * (q0 * q1 + q2 * q3), q0 * q0 - q1 * q1 - q2 * q2 + q3 * q3);
-	pstCxt->stRotation.y = -asin(2.0f * (q1 * q3 - q0 * q2));
-	pstCxt->stRotation.z = atan2(2.0f * (q1 * q2 + q0 * q3), q0 * q0 + q1 * q1 - q2 * q2 - q3 * q3);
+	// Carry on from the last estimate
+	EulerToQuat( &pstCxt->stRotation, &pstM->q0, &pstM->q1, &pstM->q2, &pstM->q3 );
 
-#endif
+	return;
+}
+
+/* ************************************************************************** */
+static void UpdateMadgwick( stSENSORFUSION_Cxt_t *pstCxt, const vector3f_t *pstGyro, const vector3f_t *pstDelta,
+							const vector3f_t *pstAccel, const vector3f_t *pstMag, const float fTimestep_s )
+{
+	stMADGWICK_Cxt_t *pstM = &pstCxt->stMadgwick;
+	float fPerSecond;
+
+	// No time has passed, so there is no rate to take from the delta-angle
+	if ( 0.0f >= fTimestep_s )
+	{
+		return;
+	}
+
+	// The rate over the whole timestep, from the delta-angle
+	fPerSecond = 1.0f / fTimestep_s;
+	MadgwickAHRSupdateIMU( pstM,
+						   pstDelta->x * fPerSecond, pstDelta->y * fPerSecond, pstDelta->z * fPerSecond,
+						   pstAccel->x, pstAccel->y, pstAccel->z,
+						   fTimestep_s );
+
+	QuatToEuler( pstM->q0, pstM->q1, pstM->q2, pstM->q3, &pstCxt->stRotation );
 
 	return;
 }
 
 /* ************************************************************************** */
-static float GetMag( float x, float y, float z )
+static void StartMahony( stSENSORFUSION_Cxt_t *pstCxt )
+{
+	stMAHONY_Cxt_t *pstM = &pstCxt->stMahony;
+
+	// Carry on from the last estimate, the integral is kept
+	EulerToQuat( &pstCxt->stRotation, &pstM->q0, &pstM->q1, &pstM->q2, &pstM->q3 );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void UpdateMahony( stSENSORFUSION_Cxt_t *pstCxt, const vector3f_t *pstGyro, const vector3f_t *pstDelta,
+						  const vector3f_t *pstAccel, const vector3f_t *pstMag, const float fTimestep_s )
 {
-	return sqrtf( x*x + y*y + z*z );
+	stMAHONY_Cxt_t *pstM = &pstCxt->stMahony;
+	float fPerSecond;
+
+	// As UpdateMadgwick
+	if ( 0.0f >= fTimestep_s )
+	{
+		return;
+	}
+
+	fPerSecond = 1.0f / fTimestep_s;
+	MahonyAHRSupdateIMU( pstM,
+						 pstDelta->x * fPerSecond, pstDelta->y * fPerSecond, pstDelta->z * fPerSecond,
+						 pstAccel->x, pstAccel->y, pstAccel->z,
+						 fTimestep_s );
+
+	QuatToEuler( pstM->q0, pstM->q1, pstM->q2, pstM->q3, &pstCxt->stRotation );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void StartEkf( stSENSORFUSION_Cxt_t *pstCxt )
+{
+	stEKF_Cxt_t *pstEkf = &pstCxt->stEkf;
+	float fQAngle = pstEkf->fQAngle;
+	float fQBias = pstEkf->fQBias;
+	float fRAccel = pstEkf->fRAccel;
+
+	// Levels itself again off the next accelerometer reading, the tuning is
+	// put back
+	EKF_Setup( pstEkf );
+	EKF_SetNoise( pstEkf, fQAngle, fQBias, fRAccel );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void UpdateEkf( stSENSORFUSION_Cxt_t *pstCxt, const vector3f_t *pstGyro, const vector3f_t *pstDelta,
+					   const vector3f_t *pstAccel, const vector3f_t *pstMag, const float fTimestep_s )
+{
+	EKF_Update( &pstCxt->stEkf, pstDelta, pstAccel, pstMag, fTimestep_s );
+	EKF_GetEuler( &pstCxt->stEkf, &pstCxt->stRotation );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void EulerToQuat( const vector3f_t *pstRotation, float *pfQ0, float *pfQ1, float *pfQ2, float *pfQ3 )
+{
+	float fCr = cosf( pstRotation->x * 0.5f );
+	float fSr = sinf( pstRotation->x * 0.5f );
+	float fCp = cosf( pstRotation->y * 0.5f );
+	float fSp = sinf( pstRotation->y * 0.5f );
+	float fCy = cosf( pstRotation->z * 0.5f );
+	float fSy = sinf( pstRotation->z * 0.5f );
+
+	// Body to world, the inverse of QuatToEuler
+	*pfQ0 = ( fCr * fCp * fCy ) + ( fSr * fSp * fSy );
+	*pfQ1 = ( fSr * fCp * fCy ) - ( fCr * fSp * fSy );
+	*pfQ2 = ( fCr * fSp * fCy ) + ( fSr * fCp * fSy );
+	*pfQ3 = ( fCr * fCp * fSy ) - ( fSr * fSp * fCy );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void QuatToEuler( const float fQ0, const float fQ1, const float fQ2, const float fQ3, vector3f_t *pstRotation )
+{
+	pstRotation->x = FASTMATH_Atan2( 2.0f * ( fQ0 * fQ1 + fQ2 * fQ3 ), fQ0 * fQ0 - fQ1 * fQ1 - fQ2 * fQ2 + fQ3 * fQ3 );
+	// FASTMATH_Asin clamps the sine, rounding can take it a hair past 1 at +-90
+	// degrees
+	pstRotation->y = -FASTMATH_Asin( 2.0f * ( fQ1 * fQ3 - fQ0 * fQ2 ) );
+	pstRotation->z = FASTMATH_Atan2( 2.0f * ( fQ1 * fQ2 + fQ0 * fQ3 ), fQ0 * fQ0 + fQ1 * fQ1 - fQ2 * fQ2 - fQ3 * fQ3 );
+
+	return;
 }
@@ -2,23 +2,89 @@
 #define SENSORFUSION_H
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <vector3f.h>
 #include "kalman.h"
+#include "MadgwickAHRS.h"
+#include "MahonyAHRS.h"
+#include "ekf.h"
+#include "fixmath.h"
+
+// The float sensor fusion algorithms, any of them can be switched to at run
+// time with SENSORFUSION_SetStrategy. The values are those of the
+// FusionFilter parameter so keep the order.
+typedef enum
+{
+	SENSORFUSION_KALMAN,			// Kalman filter each for roll and pitch, yaw integrated
+	SENSORFUSION_COMPLIMENTARY,		// Fixed blend of gyro and accelerometer angles
+	SENSORFUSION_MADGWICK,			// Madgwick gradient descent, gyro and accelerometer
+	SENSORFUSION_EKF,				// Quaternion EKF, magnetometer for yaw
+	SENSORFUSION_MAHONY,			// Mahony complementary filter, gyro and accelerometer
+	SENSORFUSION_NUM_STRATEGIES
+
+} eSENSORFUSION_Strategy_t;
 
 typedef struct
 {
+	eSENSORFUSION_Strategy_t eStrategy;
 	vector3f_t stRotation;
 	stKALMAN_Cxt_t stKalmanPitch;
 	stKALMAN_Cxt_t stKalmanRoll;
+	stMADGWICK_Cxt_t stMadgwick;
+	stMAHONY_Cxt_t stMahony;
+	stEKF_Cxt_t stEkf;
+	uint32_t uiCycles;		// Taken by the last update, see cycles.h
 
 } stSENSORFUSION_Cxt_t;
 
+// Fixed point version, this only implements the Kalman filter
+typedef struct
+{
+	vector3q_t stRotation;
+	stKALMAN_Q_Cxt_t stKalmanPitch;
+	stKALMAN_Q_Cxt_t stKalmanRoll;
+	uint32_t uiCycles;
+
+} stSENSORFUSION_Q_Cxt_t;
+
 void SENSORFUSION_Setup( stSENSORFUSION_Cxt_t *pstCxt );
 void SENSORFUSION_Update( stSENSORFUSION_Cxt_t *pstCxt,
 						  vector3f_t *pstGyro,
+						  vector3f_t *pstGyroDelta,
 						  vector3f_t *pstAccel,
 						  vector3f_t *pstMag,
 						  vector3f_t *pstRotation,
 						  float fTimestep_s );
 
+/**
+ * @brief		Switches to another algorithm. It starts from the current
+ * 				estimate where it can and keeps its tuning.
+ * @param[in]	pstCxt		Sensor fusion context.
+ * @param[in]	eStrategy	The algorithm to run from the next update.
+ * @return		False, with nothing changed, if there is no such algorithm.
+ */
+bool SENSORFUSION_SetStrategy( stSENSORFUSION_Cxt_t *pstCxt, const eSENSORFUSION_Strategy_t eStrategy );
+
+/**
+ * @brief		Short lower case name of an algorithm, "kalman" and so on, or
+ * 				NULL if there is no such algorithm.
+ */
+const char *SENSORFUSION_GetStrategyName( const eSENSORFUSION_Strategy_t eStrategy );
+
+/**
+ * @brief		Looks up an algorithm by its SENSORFUSION_GetStrategyName name.
+ * @param[in]	pcName		The name.
+ * @param[out]	peStrategy	The algorithm, if there is one.
+ * @return		False if no algorithm has that name.
+ */
+bool SENSORFUSION_FindStrategy( const char *pcName, eSENSORFUSION_Strategy_t *peStrategy );
+
+void SENSORFUSION_SetupQ( stSENSORFUSION_Q_Cxt_t *pstCxt );
+void SENSORFUSION_UpdateQ( stSENSORFUSION_Q_Cxt_t *pstCxt,
+						   const vector3q_t *pstGyro,
+						   const vector3q_t *pstGyroDelta,
+						   const vector3q_t *pstAccel,
+						   vector3q_t *pstRotation,
+						   q30_t qTimestep_s );
+
 #endif
@@ -0,0 +1,64 @@
+#ifndef SENSORLOG_H
+#define SENSORLOG_H
+
+#include <stdint.h>			// std types
+
+/*
+ * Binary log of the raw inputs to each flight controller tick, enough to run
+ * the controller again off the aircraft and get the same answer (see "make
+ * replay"). Little endian, as both the K20 and the build machine are.
+ *
+ * A log is one stSENSORLOG_Header_t followed by one record per tick, each an
+ * stSENSORLOG_Tick_t followed by uiGyroCount then uiAccelCount raw x, y, z
+ * FIFO samples. Every field is 16 bits or less, so records only need 2 byte
+ * alignment and can be read in place from a mapped file.
+ */
+
+#define SENSORLOG_MAGIC			( 0x474C5154UL )	// "TQLG"
+#define SENSORLOG_VERSION		( 1 )
+#define SENSORLOG_SAMPLES_MAX	( 32 )				// LSM9DS0 FIFO depth
+#define SENSORLOG_NUM_PULSES	( 6 )
+
+typedef struct
+{
+	uint32_t uiMagic;
+	uint16_t uiVersion;
+	uint16_t uiHeaderLen;		// sizeof( stSENSORLOG_Header_t ), the first tick follows
+
+	// Scaling of the raw samples, as set up by the flight task
+	float fGyroRes_dps;
+	float fAccelRes_g;
+	float fMagRes_gauss;
+	float fGyroPeriod_s;		// 1 / ODR
+	float fAccelPeriod_s;
+
+	uint32_t uiReserved;
+
+} stSENSORLOG_Header_t;
+
+typedef struct
+{
+	uint16_t uiDt_us;			// Since the previous tick, saturated
+	uint8_t uiGyroCount;		// Samples that follow, up to SENSORLOG_SAMPLES_MAX
+	uint8_t uiAccelCount;
+	int16_t iTemp;				// Raw temperature
+	int16_t aiMag[3];			// Raw magnetometer
+	uint16_t auiPulse[ SENSORLOG_NUM_PULSES ];	// Receiver pulse widths above
+												// RECEIVER_FLOOR, in
+												// stReceiverInput_t order
+
+} stSENSORLOG_Tick_t;
+
+// A tick with room for full FIFOs, to build one in place before writing it
+typedef struct
+{
+	stSENSORLOG_Tick_t stTick;
+	int16_t aaiSample[ 2 * SENSORLOG_SAMPLES_MAX ][3];
+
+} stSENSORLOG_Record_t;
+
+// Bytes of a tick and the samples that follow it
+#define SENSORLOG_TICK_LEN( pstTick ) \
+	( sizeof( stSENSORLOG_Tick_t ) + ( ( (pstTick)->uiGyroCount + (pstTick)->uiAccelCount ) * 3 * sizeof( int16_t ) ) )
+
+#endif
@@ -28,6 +28,8 @@
 // from embedded platforms.
 extern int port_getchar( void );
 extern int port_putchar( int c );
+extern int port_write( const void *buf, int len );
+extern int port_read( void *buf, int max );
 extern int port_getchar_nonblock( void );
 
 /* ************************************************************************** **
@@ -39,6 +41,7 @@ extern int port_getchar_nonblock( void );
 #define SYSID				( 69 )		// hehe
 #define PI					( 3.14159265359f )
 #define RAD2DEG				( 180 / PI )
+#define LEN_RX_CHUNK		( 64 )
 
 //#define PID_TUNE
 
@@ -103,6 +106,8 @@ static void ReadPIDTuneMessage( void );
 
 static void SendHeartbeat( void );
 static void SendAttitude( void );
+static void SendTiming( void );
+static void SendTimingProbe( const uint16_t uiProbe, const char *pcName, const stCYCLESTATS_Summary_t *pstSummary );
 static void ReadMavlink( void );
 static void SendParam( int iParamIndex );
 
@@ -124,17 +129,18 @@ static const uint32_t custom_mode = 0;                 ///< Custom mode, can be
 static const uint8_t system_state = MAV_STATE_STANDBY; ///< System ready for flight
 
 static uint8_t buf[MAVLINK_MAX_PACKET_LEN];
+static uint8_t abyRxChunk[ LEN_RX_CHUNK ];
 static mavlink_message_t mavlink_mesg_rx;
 static mavlink_message_t mavlink_mesg_tx;
 
 static uint32_t uiMillisSinceBoot;
 static uint16_t uiParamIndex;
 
-static stPARAM_t *pstPidGainRateP;
-static stPARAM_t *pstPidGainRateD;
-static stPARAM_t *pstPidGainAngleP;
-static stPARAM_t *pstPidGainRateYawP;
-static stPARAM_t *pstPidGainRateYawD;
+// Too big for the stack, and only a new window is worth sending
+static stFlightTiming_t stFlightTiming;
+static uint16_t uiTimingWindowSent;
+static const char *const apcStageNames[ FLIGHT_STAGE_NUM ] = { "t_rate", "t_angle", "t_telem", "t_slow" };
+
 
 static uint8_t bySig1;
 static uint8_t bySig2;
@@ -142,8 +148,6 @@ static uint32_t uiRxMsgCount;
 static stPidTuneCfgMsgFmt_t stMsg;
 static int uiIndex;
 
-static hPUBSUB_Subscription_t hFlightDetails;
-
 /* ************************************************************************** **
  * API Functions
  * ************************************************************************** */
@@ -172,8 +176,6 @@ void TASK_COMMS_Create( void )
 
 	uiMillisSinceBoot = 0;
 
-	hFlightDetails = PUBSUB_Subscribe( TOPIC_FLIGHT_DETAILS, sizeof( stFlightDetails_t ), 16 );
-
 	return;
 }
 
@@ -198,12 +200,6 @@ static void TaskHandler( void *arg )
 
 	uiParamIndex = PARAM_GetParamCount();
 
-	pstPidGainRateP = PARAM_FindParamByName( "PIDGainRate_P", 0, NULL );
-	pstPidGainRateD = PARAM_FindParamByName( "PIDGainRate_D", 0, NULL );
-	pstPidGainAngleP = PARAM_FindParamByName( "PIDGainAngle_P", 0, NULL );
-	pstPidGainRateYawP = PARAM_FindParamByName( "PIDGainRateYaw_P", 0, NULL );
-	pstPidGainRateYawD = PARAM_FindParamByName( "PIDGainRateYaw_D", 0, NULL );
-
 	for ( ; ; )
 	{
 		uiMillisSinceBoot += TASK_TICK_MS;
@@ -221,14 +217,25 @@ static void TaskHandler( void *arg )
 		//SendHeartbeat();
 		//SendAttitude();
 
-		while ( true == PUBSUB_Receive( hFlightDetails, &stFlightDetails ) );
+		// The run time histograms or the status line, see config.h
+#ifdef CFG_MAVLINK_TIMING
+		SendTiming();
+#else
+		PUBSUB_ReadLatest( TOPIC_FLIGHT_DETAILS, &stFlightDetails );
 
-		printf( "runcnt=%d, gyrocnt=%d, accelcount=%d missed=%d\r\n",
+		printf( "runcnt=%d, gyrocnt=%d, accelcount=%d missed=%d i2cerr=%d fusion=%d overruns=%d/%d/%d/%d\r\n",
 				stFlightDetails.uiFlightRunCount,
 				stFlightDetails.uiGyroSampleCount,
 				stFlightDetails.uiAccelSampleCount,
-				stFlightDetails.uiFlightTaskMissed
+				stFlightDetails.uiFlightTaskMissed,
+				stFlightDetails.uiI2CErrorCount,
+				(int)stFlightDetails.uiFusionCycles,
+				stFlightDetails.auiStageOverrunCount[ FLIGHT_STAGE_RATE ],
+				stFlightDetails.auiStageOverrunCount[ FLIGHT_STAGE_ANGLE ],
+				stFlightDetails.auiStageOverrunCount[ FLIGHT_STAGE_TELEMETRY ],
+				stFlightDetails.auiStageOverrunCount[ FLIGHT_STAGE_SLOW ]
 				);
+#endif
 
 		if ( uiParamIndex < PARAM_GetParamCount() )
 		{
@@ -253,16 +260,12 @@ static void SendPIDTuneTelem( void )
 {
 	stPidTuneMsgFmt_t stMsg;
 	stFlightDetails_t stFlightDetails;
-	uint16_t uiIndex = 0;
 	uint8_t *pbyMsg;
 
 	memset( &stMsg, 0, sizeof( stPidTuneMsgFmt_t ) );
 
-	// Clear the queue
-	while ( PUBSUB_MessagesWaiting( hFlightDetails ) )
-	{
-		PUBSUB_Receive( hFlightDetails, &stFlightDetails );
-	}
+	// Sample the newest flight details
+	PUBSUB_ReadLatest( TOPIC_FLIGHT_DETAILS, &stFlightDetails );
 
 	stMsg.fAttitudeRoll = stFlightDetails.stAttitude.x;
 	stMsg.fAttitudePitch = stFlightDetails.stAttitude.y;
@@ -275,54 +278,65 @@ static void SendPIDTuneTelem( void )
 
 	stMsg.uiRxMsgCnt = uiRxMsgCount;
 
-	stMsg.fGainRateP = pstPidGainRateP->fValue;
+	stMsg.fGainRateP = PARAM_Get( PARAM_PIDGAIN_RATE_P );
 
 	pbyMsg = (uint8_t*)(void*)&stMsg;
 
-	while( uiIndex < sizeof( stPidTuneMsgFmt_t ) )
-	{
-		port_putchar( pbyMsg[uiIndex++] );
-	}
+	port_write( pbyMsg, sizeof( stPidTuneMsgFmt_t ) );
 }
 
 /* ************************************************************************** */
 static void ReadPIDTuneMessage( void )
 {
 	int iReadValue;
+	int iReadLen;
+	int iReadIndex;
 	uint8_t *pbyMsg;
 
 	pbyMsg = ( (uint8_t*)(void*)&stMsg ) + 2;
 
-	// Read a byte at a time from our stream interface
-	while ( -1 != ( iReadValue = port_getchar_nonblock() ) )
+	// Drain everything that has arrived in one go, then parse it a byte at
+	// a time
+	while ( 0 < ( iReadLen = port_read( abyRxChunk, sizeof( abyRxChunk ) ) ) )
 	{
-		if ( uiIndex == ( sizeof( stPidTuneCfgMsgFmt_t ) - 2 ) )
+		for ( iReadIndex = 0; iReadIndex < iReadLen; iReadIndex++ )
 		{
-			bySig2 = iReadValue;
+			iReadValue = abyRxChunk[ iReadIndex ];
 
-			if ( ( bySig1 == 0xA5 ) && ( bySig2 == 0xA5 ) )
+			if ( uiIndex == ( sizeof( stPidTuneCfgMsgFmt_t ) - 2 ) )
 			{
-				bySig1 = bySig2 = 0;
-				uiIndex = 0;
+				bySig2 = iReadValue;
+
+				if ( ( bySig1 == 0xA5 ) && ( bySig2 == 0xA5 ) )
+				{
+					bySig1 = bySig2 = 0;
+					uiIndex = 0;
+				}
+				else
+				{
+					bySig1 = bySig2;
+				}
 			}
 			else
 			{
-				bySig1 = bySig2;
-			}
-		}
-		else
-		{
-			// We are in the middle of reading a message
-			pbyMsg[uiIndex++] = (uint8_t)iReadValue;
+				// We are in the middle of reading a message
+				pbyMsg[uiIndex++] = (uint8_t)iReadValue;
 
-			if ( uiIndex == ( sizeof( stPidTuneCfgMsgFmt_t ) - 2 ) )
-			{
-				// Message done
-				pstPidGainRateP->fValue = stMsg.fPidRateP;
-				pstPidGainRateD->fValue = stMsg.fPidRateD;
-				pstPidGainAngleP->fValue = stMsg.fPidAngleP;
+				if ( uiIndex == ( sizeof( stPidTuneCfgMsgFmt_t ) - 2 ) )
+				{
+					// Message done, the gains go in together
+					stPARAM_t *apstGains[ 3 ] =
+					{
+						PARAM_Handle( PARAM_PIDGAIN_RATE_P ),
+						PARAM_Handle( PARAM_PIDGAIN_RATE_D ),
+						PARAM_Handle( PARAM_PIDGAIN_ANGLE_P )
+					};
+					float afGains[ 3 ] = { stMsg.fPidRateP, stMsg.fPidRateD, stMsg.fPidAngleP };
+
+					PARAM_SetGroup( apstGains, afGains, mArraySize( apstGains ) );
 
-				uiRxMsgCount++;
+					uiRxMsgCount++;
+				}
 			}
 		}
 	}
@@ -333,7 +347,6 @@ static void SendHeartbeat( void )
 {
 	// Initialize the required buffers
 	uint16_t len;
-	uint16_t uiIndex = 0;
 
 	// Pack the message
 	mavlink_msg_heartbeat_pack( mavlink_system.sysid,
@@ -348,10 +361,7 @@ static void SendHeartbeat( void )
 	// Copy the message to the send buffer
 	len = mavlink_msg_to_send_buffer( buf, &mavlink_mesg_tx );
 
-	while( uiIndex < len )
-	{
-		port_putchar( buf[uiIndex++] );
-	}
+	port_write( buf, len );
 }
 
 /* ************************************************************************** */
@@ -359,13 +369,9 @@ static void SendAttitude( void )
 {
 	uint16_t len;
 	stFlightDetails_t stFlightDetails;
-	uint16_t uiIndex = 0;
 
-	// Clear the queue
-	while ( PUBSUB_MessagesWaiting( hFlightDetails ) )
-	{
-		PUBSUB_Receive( hFlightDetails, &stFlightDetails );
-	}
+	// Sample the newest flight details
+	PUBSUB_ReadLatest( TOPIC_FLIGHT_DETAILS, &stFlightDetails );
 
 	// Send attitude - negate the roll (x) value for qground control
 	mavlink_msg_attitude_pack( mavlink_system.sysid,
@@ -384,10 +390,64 @@ static void SendAttitude( void )
 	len = mavlink_msg_to_send_buffer( buf, &mavlink_mesg_tx );
 
 	// Send the message
-	while( uiIndex < len )
+	port_write( buf, len );
+}
+
+/* ************************************************************************** */
+static void SendTiming( void )
+{
+	uint16_t uiStage;
+
+	// Sample the newest timing window, each is only sent once
+	if ( !PUBSUB_ReadLatest( TOPIC_FLIGHT_TIMING, &stFlightTiming )
+		 || ( stFlightTiming.uiWindow == uiTimingWindowSent ) )
 	{
-		port_putchar( buf[uiIndex++] );
+		return;
 	}
+
+	uiTimingWindowSent = stFlightTiming.uiWindow;
+
+	// Probes numbered as stFlightTiming_t lays them out, the stages first
+	for ( uiStage = 0; uiStage < FLIGHT_STAGE_NUM; uiStage++ )
+	{
+		SendTimingProbe( uiStage, apcStageNames[ uiStage ], &stFlightTiming.astStage[ uiStage ] );
+	}
+
+	SendTimingProbe( FLIGHT_STAGE_NUM, "t_i2c", &stFlightTiming.stSensorRead );
+	SendTimingProbe( FLIGHT_STAGE_NUM + 1, "t_fusion", &stFlightTiming.stFusion );
+}
+
+/* ************************************************************************** */
+static void SendTimingProbe( const uint16_t uiProbe, const char *pcName, const stCYCLESTATS_Summary_t *pstSummary )
+{
+	uint16_t len;
+	float fPerUs = ( 0 == stFlightTiming.uiCyclesPerUs ) ? 1.0f : (float)stFlightTiming.uiCyclesPerUs;
+
+	// Min, mean and max in us as a debug vector
+	mavlink_msg_debug_vect_pack( mavlink_system.sysid,
+								 mavlink_system.compid,
+								 &mavlink_mesg_tx,
+								 pcName,
+								 (uint64_t)uiMillisSinceBoot * 1000,
+								 pstSummary->uiMin / fPerUs,
+								 pstSummary->uiMean / fPerUs,
+								 pstSummary->uiMax / fPerUs );
+
+	len = mavlink_msg_to_send_buffer( buf, &mavlink_mesg_tx );
+	port_write( buf, len );
+
+	// And the histogram as 16 x uint16_t (ver 1, type 1), at the probe's
+	// number
+	mavlink_msg_memory_vect_pack( mavlink_system.sysid,
+								  mavlink_system.compid,
+								  &mavlink_mesg_tx,
+								  uiProbe,
+								  1,
+								  1,
+								  (const int8_t*)(const void*)pstSummary->auiBuckets );
+
+	len = mavlink_msg_to_send_buffer( buf, &mavlink_mesg_tx );
+	port_write( buf, len );
 }
 
 /* ************************************************************************** */
@@ -397,73 +457,78 @@ static void ReadMavlink( void )
 	mavlink_param_set_t set;
 	mavlink_param_request_read_t stMsgParamReqRead;
 	int iReadValue;
+	int iReadLen;
+	int iReadIndex;
 	stPARAM_t *pstParam;
 	size_t uiIndex;
 
-	// Read a byte at a time from our stream interface
-	while ( -1 != ( iReadValue = port_getchar_nonblock() ) )
+	// Drain everything that has arrived in one go, then parse it a byte at
+	// a time
+	while ( 0 < ( iReadLen = port_read( abyRxChunk, sizeof( abyRxChunk ) ) ) )
 	{
-		// Try to get a new messagparamIndexe
-		if( mavlink_parse_char( MAVLINK_COMM_0, (uint8_t)iReadValue, &mavlink_mesg_rx, &stStatus ) )
+		for ( iReadIndex = 0; iReadIndex < iReadLen; iReadIndex++ )
 		{
-			// Handle message
-			switch( mavlink_mesg_rx.msgid )
+			iReadValue = abyRxChunk[ iReadIndex ];
+
+			// Try to get a new messagparamIndexe
+			if( mavlink_parse_char( MAVLINK_COMM_0, (uint8_t)iReadValue, &mavlink_mesg_rx, &stStatus ) )
 			{
-				case MAVLINK_MSG_ID_HEARTBEAT:
-					// E.g. read GCS heartbeat and go into
-					// comm lost mode if timer times out
-					break;
+				// Handle message
+				switch( mavlink_mesg_rx.msgid )
+				{
+					case MAVLINK_MSG_ID_HEARTBEAT:
+						// E.g. read GCS heartbeat and go into
+						// comm lost mode if timer times out
+						break;
 
-				case MAVLINK_MSG_ID_COMMAND_LONG:
-					// EXECUTE ACTION
-					break;
+					case MAVLINK_MSG_ID_COMMAND_LONG:
+						// EXECUTE ACTION
+						break;
 
-				case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
+					case MAVLINK_MSG_ID_PARAM_REQUEST_LIST:
 
-					// Reset parameter index to start sending the params one by one
-					uiParamIndex = 0;
+						// Reset parameter index to start sending the params one by one
+						uiParamIndex = 0;
 
-					break;
+						break;
 
-				case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
-				{
-					mavlink_msg_param_request_read_decode( &mavlink_mesg_rx, &stMsgParamReqRead );
+					case MAVLINK_MSG_ID_PARAM_REQUEST_READ:
+					{
+						mavlink_msg_param_request_read_decode( &mavlink_mesg_rx, &stMsgParamReqRead );
 
-					SendParam( stMsgParamReqRead.param_index );
+						SendParam( stMsgParamReqRead.param_index );
 
-					break;
-				}
+						break;
+					}
 
-				case MAVLINK_MSG_ID_PARAM_SET:
-				{
-					mavlink_msg_param_set_decode( &mavlink_mesg_rx, &set );
+					case MAVLINK_MSG_ID_PARAM_SET:
+					{
+						mavlink_msg_param_set_decode( &mavlink_mesg_rx, &set );
 
-					pstParam = PARAM_FindParamByName( set.param_id, 16, &uiIndex );
+						pstParam = PARAM_FindParamByName( set.param_id, 16, &uiIndex );
 
-					if ( pstParam )
-					{
-						// Only write and emit changes if there is actually a difference
-						// AND only write if new value is NOT "not-a-number"
-						// AND is NOT infinity
-						if (    ( pstParam->fValue != set.param_value )
-							 && ( !isnan( set.param_value ) )
-							 && ( !isinf( set.param_value ) )
-							 && ( set.param_type == MAV_PARAM_TYPE_REAL32 ) )
+						if ( pstParam )
 						{
-							// Write new value
-							pstParam->fValue = set.param_value;
-
-							// Report back new value
-							SendParam( uiIndex );
+							// Only write and emit changes if there is actually a difference
+							// AND only write if new value is NOT "not-a-number"
+							// AND is NOT infinity
+							if (    ( !isnan( set.param_value ) )
+								 && ( !isinf( set.param_value ) )
+								 && ( set.param_type == MAV_PARAM_TYPE_REAL32 )
+								 && PARAM_Set( pstParam, set.param_value ) )
+							{
+								// Report back new value
+								SendParam( uiIndex );
+							}
+							break;
 						}
 						break;
 					}
-					break;
-				}
 
-				default:
-					//Do nothing
-					break;
+					default:
+						//Do nothing
+						break;
+				}
 			}
 		}
 	}
@@ -473,7 +538,6 @@ static void SendParam( int iParamIndex )
 {
 	uint16_t len;
 	stPARAM_t *pastParamList = PARAM_GetParamList();
-	uint16_t uiIndex = 0;
 
 	mavlink_msg_param_value_pack( mavlink_system.sysid,
 								  mavlink_system.compid,
@@ -488,9 +552,6 @@ static void SendParam( int iParamIndex )
 	len = mavlink_msg_to_send_buffer( buf, &mavlink_mesg_tx );
 
 	// Send the message
-	while( uiIndex < len )
-	{
-		port_putchar( buf[uiIndex++] );
-	}
+	port_write( buf, len );
 }
 
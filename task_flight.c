@@ -25,11 +25,23 @@
 #include "IPC_types.h"		// stFlightDetails_t
 #include "params.h"			// System parameter access
 #include "pubsub.h"			// IPC publish-subscribe
+#include "decimator.h"		// FIFO sample aggregation
+#include "drdy.h"			// Gyro data ready wake up
+#include "task.h"			// Task notifications
+#include "fixmath.h"		// Fixed point arithmetic
+#include "cycles.h"			// Cycle counter
+#include "timebase.h"		// Microsecond clock
+#include "executive.h"		// Multi-rate stages
+#include "cyclestats.h"		// Run time histograms
 
 /* ************************************************************************** **
  * Macros and Defines
  * ************************************************************************** */
-#define FLIGHT_TICK_MS			( 10UL )
+#define GYRO_ODR_HZ				( 760 )
+#define GYRO_FIFO_WATERMARK		( 1 )		// Every sample, a tick at the gyro's rate
+#define FLIGHT_TICK_US			( ( GYRO_FIFO_WATERMARK * 1000000UL ) / GYRO_ODR_HZ )
+#define FLIGHT_WAKE_TIMEOUT_MS	( 5 )		// A hung bus, not a missed edge. The OS tick is 1ms
+#define FLIGHT_TIMESTEP_MAX_US	( 2 * FLIGHT_WAKE_TIMEOUT_MS * 1000UL )
 #define mArrayLen( x )			( sizeof( x ) / sizeof( x[0] ) )
 
 #define LSM9DS0_XM				( 0x1D ) // Would be 0x1E if SDO_XM is LOW
@@ -39,6 +51,54 @@
 #define RAD2DEG					( 180 / PI )
 #define DEG2RAD					( PI / 180 )
 
+// Sensor output data rates as configured in LSM9DS0_begin_adv below and how
+// each FIFO burst is reduced to a single controller input. The rate PIDs take
+// the gyro unfiltered, the FIR's 4 sample group delay is 5ms at 760Hz, which
+// a loop that fast can't afford. Sensor fusion at a third of the rate still
+// gets the FIR's low pass, and the delta-angle is the same for both.
+#define GYRO_SAMPLE_PERIOD_S	( 1.0f / GYRO_ODR_HZ )
+#define GYRO_SAMPLE_PERIOD_US	( 1000000UL / GYRO_ODR_HZ )
+#define ACCEL_SAMPLE_PERIOD_S	( 1.0f / 400.0f )
+#define GYRO_RATE_DECIMATION	( DECIMATOR_MODE_AVERAGE )
+#define GYRO_ANGLE_DECIMATION	( DECIMATOR_MODE_FIR )
+#define ACCEL_DECIMATION		( DECIMATOR_MODE_AVERAGE )
+
+// Each stage runs every DIVIDER'th tick, on the PHASE'th of those, and counts
+// an overrun if it takes longer than its BUDGET. The rate stage goes first so
+// the motors are set before anything slower runs. The others never share a
+// tick: telemetry and slow divide by multiples of the angle stage's 3 on
+// phases that aren't, and of telemetry's 9 on different phases. The sensor
+// read on the angle ticks already has the accel in, so it is the one kept
+// off most.
+#define STAGE_RATE_DIVIDER		( 1 )		// 760Hz
+#define STAGE_RATE_BUDGET_US	( 250 )
+#define STAGE_ANGLE_DIVIDER		( 3 )		// 253Hz
+#define STAGE_ANGLE_BUDGET_US	( 500 )
+#define STAGE_TELEMETRY_DIVIDER	( 9 )		// 84Hz, near the 95Hz the single rate loop published at
+#define STAGE_TELEMETRY_PHASE	( 2 )
+#define STAGE_TELEMETRY_BUDGET_US	( 100 )
+#define STAGE_SLOW_DIVIDER		( 36 )		// 21Hz
+#define STAGE_SLOW_PHASE		( 1 )
+#define STAGE_SLOW_BUDGET_US	( 300 )
+
+// The timing histograms are published and restarted every so many telemetry
+// runs, about once a second
+#define TIMING_WINDOW_RUNS		( 95 )
+
+// The sensor read run from the I2C interrupt each tick, in bus order. The gyro
+// is read every tick, the rest only when a stage that needs them is due.
+#define SENSOR_JOB_GYRO_COUNT	( 0 )
+#define SENSOR_JOB_GYRO_DATA	( 1 )
+#define SENSOR_JOB_ACCEL_COUNT	( 2 )
+#define SENSOR_JOB_ACCEL_DATA	( 3 )
+#define SENSOR_JOB_TEMP			( 4 )
+#define SENSOR_JOB_MAG			( 5 )
+#define SENSOR_JOB_NUM			( 6 )
+
+// Address write, register, restart, address read, then the reads
+#define SENSOR_SEQ_HEADER_LEN	( 4 )
+#define SENSOR_FIFO_BYTES		( LSM9DS0_FIFO_DEPTH * 6 )
+
 /* ************************************************************************** **
  * Typedefs
  * ************************************************************************** */
@@ -59,13 +119,137 @@ typedef struct
 static void TaskHandler( void *arg );
 
 /**
- * @brief		Callback for the timer.
- * @param[in]	xTimer	Timer handle.
+ * @brief		Called from the DRDY_G pin interrupt, notes when the edge came.
+ * @param[in]	pvUserState	Data ready context.
+ */
+static void DataReadyHandler( void *const pvUserState );
+
+/**
+ * @brief		The level of DRDY_G, for DRDY_Complete.
+ * @param[in]	pvUserState	Unused.
+ * @returns		True while the gyro FIFO is at or above the watermark.
+ */
+static bool DataReadyLevel( void *const pvUserState );
+
+/**
+ * @brief		Starts the sensor read, called from interrupt context (or with
+ * 				it masked, from DRDY_Complete) when the flight task is ready
+ * 				for the next batch.
+ * @param[in]	pvUserState	Unused.
+ */
+static void WakeFromISR( void *const pvUserState );
+
+/**
+ * @brief		Called from the I2C interrupt once the sensor read has finished
+ * 				or failed, wakes the flight task.
+ * @param[in]	pvUserState	Unused.
  */
-static void TimerHandler( TimerHandle_t xTimer );
+static void SensorReadDoneFromISR( void *pvUserState );
+
+/**
+ * @brief		Called from the I2C interrupt after a FIFO count has been read,
+ * 				sizes the FIFO data read that follows it.
+ * @param[in]	pstJob	The FIFO count job, its user data is the data job.
+ */
+static void FifoCountDoneFromISR( I2C_Job *pstJob );
+
+/**
+ * @brief		Builds the list of I2C jobs that make up one sensor read.
+ */
+static void SetupSensorJobs( void );
+
+/**
+ * @brief		Skips the parts of the sensor read that none of the next tick's
+ * 				stages need.
+ */
+static void SelectSensorJobs( void );
+
+/**
+ * @brief		Fills in an auto-incrementing register read sequence.
+ * @param[out]	puiSequence	The sequence to fill, must hold the header plus uiCount.
+ * @param[in]	uiAddress	I2C address of the device.
+ * @param[in]	uiSubAddress	First register to read.
+ * @param[in]	uiCount		Number of bytes to read.
+ * @returns		The length of the sequence.
+ */
+static uint32_t FillReadSequence( uint16_t *puiSequence, uint8_t uiAddress, uint8_t uiSubAddress, uint16_t uiCount );
+
+/**
+ * @brief		Number of samples a FIFO data job actually read.
+ * @param[in]	pstJob	The FIFO data job.
+ * @returns		The number of x/y/z samples in the job's buffer.
+ */
+static uint8_t FifoSamplesRead( const I2C_Job *pstJob );
+
+/**
+ * @brief		Latest receiver pulse widths, in stReceiverInput_t order.
+ * @param[out]	auiPulse	Widths above RECEIVER_FLOOR in FTM ticks.
+ */
+static void ReadReceiverPulses( uint16_t auiPulse[ NUM_RCVR_CHANNELS ] );
+
+#ifdef CFG_FIXED_POINT
+/**
+ * @brief		The rate stage in fixed point, the gyro through the rate PIDs
+ * 				to the motor outputs.
+ * @param[in]	pvUserState		Unused.
+ * @param[in]	uiTimestep_us	Time since it last ran.
+ */
+static void RateStageFixed( void *const pvUserState, const uint32_t uiTimestep_us );
+
+/**
+ * @brief		The angle stage in fixed point, the accel and the gyro since
+ * 				the last run through sensor fusion and the angle PIDs.
+ * @param[in]	pvUserState		Unused.
+ * @param[in]	uiTimestep_us	Time since it last ran.
+ */
+static void AngleStageFixed( void *const pvUserState, const uint32_t uiTimestep_us );
+
+/**
+ * @brief		Sets a motor output from a Q16 demand, 0 to 1.
+ */
+static void SetMotorOutputQ( const int iChannel, const q16_t qDemand );
+#else
+/**
+ * @brief		As RateStageFixed, in soft float.
+ */
+static void RateStageFloat( void *const pvUserState, const uint32_t uiTimestep_us );
+
+/**
+ * @brief		As AngleStageFixed, in soft float.
+ */
+static void AngleStageFloat( void *const pvUserState, const uint32_t uiTimestep_us );
+#endif
+
+/**
+ * @brief		Publishes the flight details.
+ * @param[in]	pvUserState		Unused.
+ * @param[in]	uiTimestep_us	Unused.
+ */
+static void TelemetryStage( void *const pvUserState, const uint32_t uiTimestep_us );
+
+/**
+ * @brief		The slowly changing inputs, the gyro bias from the
+ * 				temperature, the mag and the parameters.
+ * @param[in]	pvUserState		Unused.
+ * @param[in]	uiTimestep_us	Unused.
+ */
+static void SlowStage( void *const pvUserState, const uint32_t uiTimestep_us );
+
+/**
+ * @brief		Closes the timing window, publishing what each probe saw.
+ */
+static void PublishTiming( void );
 
 static void UpdateParameters( void );
 
+/**
+ * @brief		Time since the newest gyro sample of the last loop to that of
+ * 				this one, from the watermark timestamp.
+ * @param[in]	uiGyroCount	Gyro samples read this loop.
+ * @return		The timestep in microseconds.
+ */
+static uint32_t GetTimestep_us( const uint8_t uiGyroCount );
+
 #if 0
 /**
  * @brief		Prints some debug to stdout.
@@ -91,27 +275,88 @@ static void read_bytes( stLSM9DS0_t * stThis, uint8_t address, uint8_t subAddres
  * Local Variables
  * ************************************************************************** */
 static TaskHandle_t xFlightTaskHandle = NULL;
-static TimerHandle_t xFlightTimerHandle = NULL;
+static stDRDY_Ctx_t stGyroDrdy;
 static stLSM9DS0_t stImu;
+static stFLIGHT_Cxt_t stFlight;
+static stEXECUTIVE_Ctx_t stExecutive;
 static vector3f_t stAverageGyro;
 
+// Handed from stage to stage
+static uint8_t uiGyroFifoCount;
+#ifdef CFG_FIXED_POINT
+static stDECIMATOR_Q_Cxt_t stGyroDecimatorQ;
+static stDECIMATOR_Q_Cxt_t stGyroAngleDecimatorQ;
+static stDECIMATOR_Q_Cxt_t stAccelDecimatorQ;
+static vector3q_t stGyroBiasQ;
+static int16_t iGyroBiasTempQ;
+static vector3q_t stGyroQ;
+static vector3q_t stGyroDeltaSumQ;			// Since the angle stage last ran
+static stReceiverInputQ_t stReceiverInputsQ;
+#else
+static stDECIMATOR_Cxt_t stGyroDecimator;
+static stDECIMATOR_Cxt_t stGyroAngleDecimator;
+static stDECIMATOR_Cxt_t stAccelDecimator;
+static vector3f_t stGyroBias;
+static vector3f_t stGyro;
+static vector3f_t stGyroDeltaSum;			// Since the angle stage last ran
+static vector3f_t stMag;
+static stReceiverInput_t stReceiverInputs;
+#endif
+
+// Everything below is written by the I2C interrupt while a sensor read is in
+// flight, the data ready gating stops a new read starting until the task has
+// finished with the last one
+static I2C_Job astSensorJobs[ SENSOR_JOB_NUM ];
+static uint16_t auiGyroCountSeq[ SENSOR_SEQ_HEADER_LEN + 1 ];
+static uint16_t auiGyroDataSeq[ SENSOR_SEQ_HEADER_LEN + SENSOR_FIFO_BYTES ];
+static uint16_t auiAccelCountSeq[ SENSOR_SEQ_HEADER_LEN + 1 ];
+static uint16_t auiAccelDataSeq[ SENSOR_SEQ_HEADER_LEN + SENSOR_FIFO_BYTES ];
+static uint16_t auiTempSeq[ SENSOR_SEQ_HEADER_LEN + 2 ];
+static uint16_t auiMagSeq[ SENSOR_SEQ_HEADER_LEN + 6 ];
+static uint8_t uiGyroFifoSrc;
+static uint8_t auiGyroFifoRaw[ SENSOR_FIFO_BYTES ];
+static uint8_t uiAccelFifoSrc;
+static uint8_t auiAccelFifoRaw[ SENSOR_FIFO_BYTES ];
+static uint8_t auiTempRaw[ 2 ];
+static uint8_t auiMagRaw[ 6 ];
+static volatile bool bSensorReadOk;
+static volatile uint32_t uiWatermark_us;
+static volatile uint32_t uiEdge_us;
+static volatile bool bEdge;
+static volatile uint32_t uiReadStartCycles;
+static volatile uint32_t uiSensorReadCycles;
+
+// The newest gyro sample's time last loop
+static uint32_t uiLastSample_us;
+static bool bLastSample;
+
 static const uint16_t auiLedPatternFlight[] = { 500, 500 };
 
-// Parameters
-static stPARAM_t *pstTrimRoll;
-static stPARAM_t *pstTrimPitch;
-static stPARAM_t *pstTrimYaw;
-static stPARAM_t *pstPidGainRateP;
-static stPARAM_t *pstPidGainRateD;
-static stPARAM_t *pstPidGainAngleP;
-static stPARAM_t *pstPidGainRateYawP;
-static stPARAM_t *pstPidGainRateYawD;
+// Parameters, each group is read and applied as one
+static stPARAM_t *const apstTrim[ 3 ] =
+{
+	PARAM_Handle( PARAM_TRIM_ROLL ),
+	PARAM_Handle( PARAM_TRIM_PITCH ),
+	PARAM_Handle( PARAM_TRIM_YAW )
+};
+static stPARAM_t *const apstPidGains[ 3 ] =
+{
+	PARAM_Handle( PARAM_PIDGAIN_RATE_P ),
+	PARAM_Handle( PARAM_PIDGAIN_RATE_D ),
+	PARAM_Handle( PARAM_PIDGAIN_ANGLE_P )
+};
+static uint32_t uiParamGeneration;			// Of the parameters last applied
 
 static uint16_t uiWhoAmI;
 
-static bool bDone;
 static stFlightDetails_t stFlightDetails;
 
+// The probes that aren't a whole stage, the executive times those
+static stCYCLESTATS_Ctx_t stSensorReadCycles;
+static stCYCLESTATS_Ctx_t stFusionCycles;
+static stFlightTiming_t stFlightTiming;
+static uint16_t uiTelemetryRuns;
+
 /* ************************************************************************** **
  * API Functions
  * ************************************************************************** */
@@ -127,12 +372,8 @@ void TASK_FLIGHT_Create( void )
 				 2,								// Priority, this is our only task so.. lets just use 0
 				 &xFlightTaskHandle );			// We could put a pointer to a task handle here which will be filled in when the task is created
 
-	// Create a timer for our flight task
-	xFlightTimerHandle = xTimerCreate( "TIMER_Flight", 							// A text name, purely to help debugging.
-									   ( FLIGHT_TICK_MS / portTICK_PERIOD_MS ),	// The timer period, in this case 500ms.
-									   pdTRUE,										// We want this to be a recurring timer so set uxAutoReload to pdTRUE.
-									   ( void * ) 0,								// The ID is not used, so can be set to anything.
-									   TimerHandler );								// The callback function that is called when the timer expires.
+	// The flight task is paced by the gyro's FIFO watermark interrupt
+	DRDY_Create( &stGyroDrdy, WakeFromISR, DataReadyLevel, NULL );
 
 	memset( &stAverageGyro, 0, sizeof( stAverageGyro ) );
 
@@ -146,20 +387,10 @@ void TASK_FLIGHT_Create( void )
 /* ************************************************************************** */
 static void TaskHandler( void *arg )
 {
-	vector3f_t accel;
-	vector3f_t gyro;
-	vector3f_t mag;
-	vector3f_t stGyroBias;
-	stReceiverInput_t stReceiverInputs;
-	stMotorDemands_t stMotorDemands;
 	stLedPattern_t stLedPattern;
-	uint8_t uiCount;
 
 	memset( &stFlightDetails, 0, sizeof( stFlightDetails ) );
 
-	// Start our timer which will resume this task accurately on a tick
-	xTimerStart( xFlightTimerHandle, 0 );
-
 	// Set the LED to blink with the "flying" pattern
 	memcpy( stLedPattern.auiPattern, auiLedPatternFlight, sizeof( auiLedPatternFlight ) );
 	stLedPattern.sPatternLen = mArrayLen( auiLedPatternFlight );
@@ -173,164 +404,682 @@ static void TaskHandler( void *arg )
 								  G_SCALE_500DPS,
 								  A_SCALE_8G,
 								  M_SCALE_4GS,
-								  G_ODR_380_BW_100,
-								  A_ODR_800,
+								  G_ODR_760_BW_100,
+								  A_ODR_400,
 								  M_ODR_25 );
 
 	// Print whoami to serve as a comms sanity check
 	printf( "LSM: Whoami=%X - should be 49D4\r\n", (int)uiWhoAmI );
 
-	// Initialize the flight controller module
-	flight_setup();
+	// Have the gyro raise DRDY_G once a tick's worth of samples is queued and
+	// route that pin to our wake up handler, which reads the sensors
+	SetupSensorJobs();
+	LSM9DS0_setGyroFifoWatermark( &stImu, GYRO_FIFO_WATERMARK );
+	IODRIVER_SetupGyroDataReady( DataReadyHandler, &stGyroDrdy );
+
+	// Initialize the flight controller module, timing its sensor fusion
+	CYCLES_Setup();
+	flight_setup( &stFlight );
+
+	// Every FIFO sample is fed through these on its way to the controller
+#ifdef CFG_FIXED_POINT
+	// These take raw samples, scaling straight to rad/sec and g
+	DECIMATOR_SetupQ( &stGyroDecimatorQ, GYRO_RATE_DECIMATION,
+					  FIXMATH_FromFloat30( stImu.gRes * DEG2RAD ), FIXMATH_Q30( GYRO_SAMPLE_PERIOD_S ) );
+	DECIMATOR_SetupQ( &stGyroAngleDecimatorQ, GYRO_ANGLE_DECIMATION,
+					  FIXMATH_FromFloat30( stImu.gRes * DEG2RAD ), FIXMATH_Q30( GYRO_SAMPLE_PERIOD_S ) );
+	DECIMATOR_SetupQ( &stAccelDecimatorQ, ACCEL_DECIMATION,
+					  FIXMATH_FromFloat30( stImu.aRes ), FIXMATH_Q30( ACCEL_SAMPLE_PERIOD_S ) );
+	iGyroBiasTempQ = INT16_MIN;
+#else
+	DECIMATOR_Setup( &stGyroDecimator, GYRO_RATE_DECIMATION, GYRO_SAMPLE_PERIOD_S );
+	DECIMATOR_Setup( &stGyroAngleDecimator, GYRO_ANGLE_DECIMATION, GYRO_SAMPLE_PERIOD_S );
+	DECIMATOR_Setup( &stAccelDecimator, ACCEL_DECIMATION, ACCEL_SAMPLE_PERIOD_S );
+	stGyroBias = GetBias( stImu.temperature );
+#endif
 
-	// Search for and store pointers to system parameters for quick access later
-	// This makes the assumption that parameters cannot come and go at runtime
-	pstTrimRoll = PARAM_FindParamByName( "TrimRoll", 0, NULL );
-	pstTrimPitch = PARAM_FindParamByName( "TrimPitch", 0, NULL );
-	pstTrimYaw = PARAM_FindParamByName( "TrimYaw", 0, NULL );
-	pstPidGainRateP = PARAM_FindParamByName( "PIDGainRate_P", 0, NULL );
-	pstPidGainRateD = PARAM_FindParamByName( "PIDGainRate_D", 0, NULL );
-	pstPidGainAngleP = PARAM_FindParamByName( "PIDGainAngle_P", 0, NULL );
-	pstPidGainRateYawP = PARAM_FindParamByName( "PIDGainRateYaw_P", 0, NULL );
-	pstPidGainRateYawD = PARAM_FindParamByName( "PIDGainRateYaw_D", 0, NULL );
+	// The stages in eFLIGHT_Stage_t order, their index is the stage's ID
+	EXECUTIVE_Create( &stExecutive );
+#ifdef CFG_FIXED_POINT
+	EXECUTIVE_AddStage( &stExecutive, "rate", RateStageFixed, NULL,
+						STAGE_RATE_DIVIDER, 0, STAGE_RATE_BUDGET_US );
+	EXECUTIVE_AddStage( &stExecutive, "angle", AngleStageFixed, NULL,
+						STAGE_ANGLE_DIVIDER, 0, STAGE_ANGLE_BUDGET_US );
+#else
+	EXECUTIVE_AddStage( &stExecutive, "rate", RateStageFloat, NULL,
+						STAGE_RATE_DIVIDER, 0, STAGE_RATE_BUDGET_US );
+	EXECUTIVE_AddStage( &stExecutive, "angle", AngleStageFloat, NULL,
+						STAGE_ANGLE_DIVIDER, 0, STAGE_ANGLE_BUDGET_US );
+#endif
+	EXECUTIVE_AddStage( &stExecutive, "telemetry", TelemetryStage, NULL,
+						STAGE_TELEMETRY_DIVIDER, STAGE_TELEMETRY_PHASE, STAGE_TELEMETRY_BUDGET_US );
+	EXECUTIVE_AddStage( &stExecutive, "slow", SlowStage, NULL,
+						STAGE_SLOW_DIVIDER, STAGE_SLOW_PHASE, STAGE_SLOW_BUDGET_US );
+
+	CYCLESTATS_Create( &stSensorReadCycles );
+	CYCLESTATS_Create( &stFusionCycles );
+	stFlightTiming.uiCyclesPerUs = (uint16_t)CYCLES_PerUs();
+
+	// The parameter starts out as whichever filter the build runs first,
+	// unless one was kept from before (paramstore.h) for the first update to
+	// switch to
+	if ( !PARAM_ChangedSince( PARAM_Handle( PARAM_FUSION_FILTER ), PARAM_GENERATION_FIRST ) )
+	{
+		PARAM_Set( PARAM_Handle( PARAM_FUSION_FILTER ), (float)FLIGHT_GetFusionStrategy( &stFlight ) );
+	}
+
+	// Nothing applied yet, the first update takes every parameter
+	uiParamGeneration = PARAM_GENERATION_NONE;
+
+	// DRDY_G may have gone high before its interrupt was enabled, leaving no
+	// edge to come, so start the first read as the interrupt would have
+	SelectSensorJobs();
+	taskENTER_CRITICAL();
+	DRDY_Signal( &stGyroDrdy );
+	taskEXIT_CRITICAL();
 
 	for ( ; ; )
 	{
-		bDone = false;
+		// Wait for the sensor read started by the FIFO watermark
+		if ( 0 == ulTaskNotifyTake( pdTRUE, pdMS_TO_TICKS( FLIGHT_WAKE_TIMEOUT_MS ) ) )
+		{
+			// The bus has hung, take the buffers back and carry on without.
+			// Counted as an overrun, so DRDY_Complete starts the next read.
+			i2c_abort( 0 );
+			bSensorReadOk = false;
+
+			taskENTER_CRITICAL();
+			DRDY_Signal( &stGyroDrdy );
+			taskEXIT_CRITICAL();
+		}
+
+		// Only reads that completed, a failed one stops wherever it failed
+		if ( bSensorReadOk )
+		{
+			CYCLESTATS_Add( &stSensorReadCycles, uiSensorReadCycles );
+		}
+
+		stFlightDetails.uiFlightTaskMissed = (uint16_t)stGyroDrdy.uiOverrunCount;
 		stFlightDetails.uiFlightRunCount++;
 
-		// Collects trim and PID gain updates from the parameters and passes
-		// them into the flight controller if they have updated
-		UpdateParameters();
+		// The gyro samples' times give the tick its timestep
+		uiGyroFifoCount = bSensorReadOk ? FifoSamplesRead( &astSensorJobs[ SENSOR_JOB_GYRO_DATA ] ) : 0;
+		stFlightDetails.uiGyroSampleCount += uiGyroFifoCount;
 
-		// Read the gyro fifo
-		uiCount = LSM9DS0_fifoCountGyro( &stImu );
-		stFlightDetails.uiGyroSampleCount += uiCount;
+		// Run whichever stages are due
+		EXECUTIVE_Tick( &stExecutive, GetTimestep_us( uiGyroFifoCount ) );
 
-		while ( uiCount-- > 0 )
-		{
-			LSM9DS0_readGyro( &stImu );
+		// Ready for the next batch, which only reads what the stages due on
+		// that tick need. If the watermark was reached while we were busy the
+		// read starts here, masked as it would be in the ISR.
+		SelectSensorJobs();
+		taskENTER_CRITICAL();
+		DRDY_Complete( &stGyroDrdy );
+		taskEXIT_CRITICAL();
+	}
+}
 
-			// Read off gyro values scaling into rad/sec
-			gyro.x = LSM9DS0_calcGyro( &stImu, stImu.gx );
-			gyro.y = LSM9DS0_calcGyro( &stImu, stImu.gy );
-			gyro.z = LSM9DS0_calcGyro( &stImu, stImu.gz );
-		}
+/* ************************************************************************** */
+static void ReadReceiverPulses( uint16_t auiPulse[ NUM_RCVR_CHANNELS ] )
+{
+	auiPulse[0] = (uint16_t)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_ROLL );
+	auiPulse[1] = (uint16_t)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_PITCH );
+	auiPulse[2] = (uint16_t)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_THROTTLE );
+	auiPulse[3] = (uint16_t)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_YAW );
+	auiPulse[4] = (uint16_t)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_VRA );
+	auiPulse[5] = (uint16_t)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_VRB );
+
+	return;
+}
 
-		// Read the accel fifo
-		uiCount = LSM9DS0_fifoCountAccel( &stImu );
-		stFlightDetails.uiAccelSampleCount += uiCount;
+#ifndef CFG_FIXED_POINT
+/* ************************************************************************** */
+static void RateStageFloat( void *const pvUserState, const uint32_t uiTimestep_us )
+{
+	vector3f_t gyroDelta;
+	vector3f_t sample;
+	stMotorDemands_t stMotorDemands;
+	uint16_t auiPulse[ NUM_RCVR_CHANNELS ];
+	int16_t aiFifo[ LSM9DS0_FIFO_DEPTH ][ 3 ];
+	uint8_t uiIndex;
+	uint16_t uiGyroCount;
 
-		while ( uiCount-- > 0 )
-		{
-			LSM9DS0_readAccel( &stImu );
+	// Unpack the gyro fifo read by the interrupt
+	LSM9DS0_unpackFifo( auiGyroFifoRaw, uiGyroFifoCount, aiFifo );
 
-			// Read off gyro values scaling into rad/sec
-			accel.x = LSM9DS0_calcAccel( &stImu, stImu.ax );
-			accel.y = LSM9DS0_calcAccel( &stImu, stImu.ay );
-			accel.z = LSM9DS0_calcAccel( &stImu, stImu.az );
-		}
+	for ( uiIndex = 0; uiIndex < uiGyroFifoCount; uiIndex++ )
+	{
+		// Scale each gyro sample into deg/sec
+		sample.x = LSM9DS0_calcGyro( &stImu, aiFifo[uiIndex][0] );
+		sample.y = LSM9DS0_calcGyro( &stImu, aiFifo[uiIndex][1] );
+		sample.z = LSM9DS0_calcGyro( &stImu, aiFifo[uiIndex][2] );
+		DECIMATOR_Push( &stGyroDecimator, &sample );
+		DECIMATOR_Push( &stGyroAngleDecimator, &sample );
+	}
 
-#if 1
+	// Rate plus the rate integrated over every sample
+	uiGyroCount = DECIMATOR_Output( &stGyroDecimator, &stGyro, &gyroDelta );
 
-		// Read the latest accel and gyro values
-		//LSM9DS0_readAccel( &stImu );
-		//LSM9DS0_readGyro( &stImu );
-		//LSM9DS0_readMag( &stImu );
+	// Apply the gyro bias for the slow stage's temperature
+	stGyro = VECTOR3F_Subtract( stGyro, stGyroBias );
+	gyroDelta = VECTOR3F_Subtract( gyroDelta, VECTOR3F_Scale( stGyroBias, uiGyroCount * GYRO_SAMPLE_PERIOD_S ) );
 
-		// Scale the gyro values into rad/sec
-		mag.x = LSM9DS0_calcMag( &stImu, stImu.mx );
-		mag.y = LSM9DS0_calcMag( &stImu, stImu.my );
-		mag.z = LSM9DS0_calcMag( &stImu, stImu.mz );
+	// The value we get out of the gyro is in degrees/sec but we want it in
+	// rad/sec so lets convert it now.
+	stGyro = VECTOR3F_Scale( stGyro, DEG2RAD );
+	gyroDelta = VECTOR3F_Scale( gyroDelta, DEG2RAD );
 
-		// Calculate and apply gyro bias
-		LSM9DS0_readTemp( &stImu );
-		stGyroBias = GetBias( stImu.temperature );
-		gyro = VECTOR3F_Subtract( gyro, stGyroBias );
-
-		// The value we get out of the gyro is in degrees/sec but we want it in
-		// rad/sec so lets convert it now.
-		gyro.x *= DEG2RAD;
-		gyro.y *= DEG2RAD;
-		gyro.z *= DEG2RAD;
-
-		// Work out receiver input values as floats
-		stReceiverInputs.fRoll = ( (float)( (int32_t)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_ROLL ) - RECEIVER_CENTER ) ) / ( RECEIVER_RANGE / 2 );
-		stReceiverInputs.fPitch = ( (float)( (int32_t)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_PITCH ) - RECEIVER_CENTER ) ) / ( RECEIVER_RANGE / 2 );
-		stReceiverInputs.fThrottle = ( (float)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_THROTTLE ) ) / RECEIVER_RANGE;
-		stReceiverInputs.fYaw = ( (float)( (int32_t)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_YAW ) - RECEIVER_CENTER ) ) / ( RECEIVER_RANGE / 2 );
-		stReceiverInputs.fVarA = ( (float)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_VRA ) ) / RECEIVER_RANGE;
-		stReceiverInputs.fVarB = ( (float)IODRIVER_GetInputPulseWidth( CFG_RECEIVER_VRB ) ) / RECEIVER_RANGE;
-
-		// Process flight controller
-		flight_process( FLIGHT_TICK_MS,
-						&accel,
-						&gyro,
-						&mag,
-						&stReceiverInputs,
-						&stMotorDemands );
-
-		// Set the motor outputs based on the results from the flight controller
-		IODRIVER_SetOutputPulseWidth( CFG_MOTOR_FL, (uint32_t)( stMotorDemands.fFL * RECEIVER_RANGE ) );
-		IODRIVER_SetOutputPulseWidth( CFG_MOTOR_FR, (uint32_t)( stMotorDemands.fFR * RECEIVER_RANGE ) );
-		IODRIVER_SetOutputPulseWidth( CFG_MOTOR_RL, (uint32_t)( stMotorDemands.fRL * RECEIVER_RANGE ) );
-		IODRIVER_SetOutputPulseWidth( CFG_MOTOR_RR, (uint32_t)( stMotorDemands.fRR * RECEIVER_RANGE ) );
+	// The angle stage integrates every sample since it last ran
+	stGyroDeltaSum = VECTOR3F_Add( stGyroDeltaSum, gyroDelta );
+
+	// Work out receiver input values as floats
+	ReadReceiverPulses( auiPulse );
+	FLIGHT_ReceiverFromPulses( auiPulse, &stReceiverInputs );
+
+	// The rate PIDs, on the angle stage's latest rate target
+	FLIGHT_UpdateRate( &stFlight, uiTimestep_us, &stGyro, &stReceiverInputs, &stMotorDemands );
+
+	// Set the motor outputs based on the results from the flight controller
+	IODRIVER_SetOutputPulseWidth( CFG_MOTOR_FL, (uint32_t)( stMotorDemands.fFL * RECEIVER_RANGE ) );
+	IODRIVER_SetOutputPulseWidth( CFG_MOTOR_FR, (uint32_t)( stMotorDemands.fFR * RECEIVER_RANGE ) );
+	IODRIVER_SetOutputPulseWidth( CFG_MOTOR_RL, (uint32_t)( stMotorDemands.fRL * RECEIVER_RANGE ) );
+	IODRIVER_SetOutputPulseWidth( CFG_MOTOR_RR, (uint32_t)( stMotorDemands.fRR * RECEIVER_RANGE ) );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void AngleStageFloat( void *const pvUserState, const uint32_t uiTimestep_us )
+{
+	vector3f_t accel;
+	vector3f_t gyro;
+	vector3f_t sample;
+	int16_t aiFifo[ LSM9DS0_FIFO_DEPTH ][ 3 ];
+	uint8_t uiCount;
+	uint8_t uiIndex;
+
+	// Unpack the accel fifo read by the interrupt
+	uiCount = bSensorReadOk ? FifoSamplesRead( &astSensorJobs[ SENSOR_JOB_ACCEL_DATA ] ) : 0;
+	LSM9DS0_unpackFifo( auiAccelFifoRaw, uiCount, aiFifo );
+	stFlightDetails.uiAccelSampleCount += uiCount;
+
+	for ( uiIndex = 0; uiIndex < uiCount; uiIndex++ )
+	{
+		// Scale each accel sample into g
+		sample.x = LSM9DS0_calcAccel( &stImu, aiFifo[uiIndex][0] );
+		sample.y = LSM9DS0_calcAccel( &stImu, aiFifo[uiIndex][1] );
+		sample.z = LSM9DS0_calcAccel( &stImu, aiFifo[uiIndex][2] );
+		DECIMATOR_Push( &stAccelDecimator, &sample );
+	}
 
+	DECIMATOR_Output( &stAccelDecimator, &accel, NULL );
+
+	// The filtered gyro, from the samples the rate stage pushed
+	DECIMATOR_Output( &stGyroAngleDecimator, &gyro, NULL );
+	gyro = VECTOR3F_Scale( VECTOR3F_Subtract( gyro, stGyroBias ), DEG2RAD );
+
+	// Sensor fusion over the gyro samples the rate stage has seen since the
+	// last run, then the angle PIDs for the rate stage's target
+	FLIGHT_UpdateAttitude( &stFlight, uiTimestep_us, &accel, &gyro, &stGyroDeltaSum, &stMag );
+	memset( &stGyroDeltaSum, 0, sizeof( stGyroDeltaSum ) );
+	CYCLESTATS_Add( &stFusionCycles, FLIGHT_GetFusionCycles( &stFlight ) );
+
+	FLIGHT_UpdateAngle( &stFlight, uiTimestep_us, &stReceiverInputs );
+
+	return;
+}
 #endif
 
-		// Publish flight details
-		FLIGHT_GetRotation( &stFlightDetails.stAttitude );
-		stFlightDetails.stAttitudeRate = gyro;
-		PUBSUB_Publish( TOPIC_FLIGHT_DETAILS, &stFlightDetails );
+#ifdef CFG_FIXED_POINT
+/* ************************************************************************** */
+static void RateStageFixed( void *const pvUserState, const uint32_t uiTimestep_us )
+{
+	vector3q_t gyroDelta;
+	stMotorDemandsQ_t stMotorDemands;
+	uint16_t auiPulse[ NUM_RCVR_CHANNELS ];
+	int16_t aiFifo[ LSM9DS0_FIFO_DEPTH ][ 3 ];
+	uint8_t uiIndex;
+	uint16_t uiGyroCount;
+
+	// Raw gyro samples go straight into the decimator, which scales once
+	LSM9DS0_unpackFifo( auiGyroFifoRaw, uiGyroFifoCount, aiFifo );
 
-		// Suspend until our timer wakes us up again
-		bDone = true;
-		vTaskSuspend( NULL );
+	for ( uiIndex = 0; uiIndex < uiGyroFifoCount; uiIndex++ )
+	{
+		DECIMATOR_PushQ( &stGyroDecimatorQ, aiFifo[uiIndex] );
+		DECIMATOR_PushQ( &stGyroAngleDecimatorQ, aiFifo[uiIndex] );
 	}
+
+	uiGyroCount = DECIMATOR_OutputQ( &stGyroDecimatorQ, &stGyroQ, &gyroDelta );
+
+	stGyroQ.x -= stGyroBiasQ.x;
+	stGyroQ.y -= stGyroBiasQ.y;
+	stGyroQ.z -= stGyroBiasQ.z;
+	gyroDelta.x -= FIXMATH_MulQ16Q30( stGyroBiasQ.x, uiGyroCount * FIXMATH_Q30( GYRO_SAMPLE_PERIOD_S ) );
+	gyroDelta.y -= FIXMATH_MulQ16Q30( stGyroBiasQ.y, uiGyroCount * FIXMATH_Q30( GYRO_SAMPLE_PERIOD_S ) );
+	gyroDelta.z -= FIXMATH_MulQ16Q30( stGyroBiasQ.z, uiGyroCount * FIXMATH_Q30( GYRO_SAMPLE_PERIOD_S ) );
+
+	stGyroDeltaSumQ.x += gyroDelta.x;
+	stGyroDeltaSumQ.y += gyroDelta.y;
+	stGyroDeltaSumQ.z += gyroDelta.z;
+
+	ReadReceiverPulses( auiPulse );
+	FLIGHT_ReceiverFromPulsesQ( auiPulse, &stReceiverInputsQ );
+
+	FLIGHT_UpdateRateQ( &stFlight, uiTimestep_us, &stGyroQ, &stReceiverInputsQ, &stMotorDemands );
+
+	SetMotorOutputQ( CFG_MOTOR_FL, stMotorDemands.qFL );
+	SetMotorOutputQ( CFG_MOTOR_FR, stMotorDemands.qFR );
+	SetMotorOutputQ( CFG_MOTOR_RL, stMotorDemands.qRL );
+	SetMotorOutputQ( CFG_MOTOR_RR, stMotorDemands.qRR );
+
+	return;
 }
 
 /* ************************************************************************** */
-static void UpdateParameters( void )
+static void AngleStageFixed( void *const pvUserState, const uint32_t uiTimestep_us )
 {
-	vector3f_t stTrim = { 0, };
+	vector3q_t accel;
+	vector3q_t gyro;
+	int16_t aiFifo[ LSM9DS0_FIFO_DEPTH ][ 3 ];
+	uint8_t uiCount;
+	uint8_t uiIndex;
+
+	// As the gyro, raw samples into the decimator
+	uiCount = bSensorReadOk ? FifoSamplesRead( &astSensorJobs[ SENSOR_JOB_ACCEL_DATA ] ) : 0;
+	LSM9DS0_unpackFifo( auiAccelFifoRaw, uiCount, aiFifo );
+	stFlightDetails.uiAccelSampleCount += uiCount;
 
-	// Copy in each parameter if they exist
-	if ( pstTrimRoll )
+	for ( uiIndex = 0; uiIndex < uiCount; uiIndex++ )
 	{
-		stTrim.x = pstTrimRoll->fValue;
+		DECIMATOR_PushQ( &stAccelDecimatorQ, aiFifo[uiIndex] );
 	}
 
-	if ( pstTrimPitch )
+	DECIMATOR_OutputQ( &stAccelDecimatorQ, &accel, NULL );
+
+	DECIMATOR_OutputQ( &stGyroAngleDecimatorQ, &gyro, NULL );
+	gyro.x -= stGyroBiasQ.x;
+	gyro.y -= stGyroBiasQ.y;
+	gyro.z -= stGyroBiasQ.z;
+
+	FLIGHT_UpdateAttitudeQ( &stFlight, uiTimestep_us, &accel, &gyro, &stGyroDeltaSumQ );
+	memset( &stGyroDeltaSumQ, 0, sizeof( stGyroDeltaSumQ ) );
+	CYCLESTATS_Add( &stFusionCycles, FLIGHT_GetFusionCyclesQ( &stFlight ) );
+
+	FLIGHT_UpdateAngleQ( &stFlight, uiTimestep_us, &stReceiverInputsQ );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void SetMotorOutputQ( const int iChannel, const q16_t qDemand )
+{
+	// A negative demand means off, rather than a huge unsigned pulse
+	if ( 0 > qDemand )
+	{
+		IODRIVER_SetOutputPulseWidth( iChannel, 0 );
+	}
+	else
+	{
+		IODRIVER_SetOutputPulseWidth( iChannel, (uint32_t)FIXMATH_MulShift( qDemand, RECEIVER_RANGE, 16 ) );
+	}
+
+	return;
+}
+#endif
+
+/* ************************************************************************** */
+static void TelemetryStage( void *const pvUserState, const uint32_t uiTimestep_us )
+{
+	I2C_Stats stI2CStats;
+	int iStage;
+#ifdef CFG_FIXED_POINT
+	vector3q_t stRotation;
+
+	// Telemetry stays in float, it is only converted here on its way out
+	FLIGHT_GetRotationQ( &stFlight, &stRotation );
+	stFlightDetails.stAttitude.x = FIXMATH_ToFloat( stRotation.x );
+	stFlightDetails.stAttitude.y = FIXMATH_ToFloat( stRotation.y );
+	stFlightDetails.stAttitude.z = FIXMATH_ToFloat( stRotation.z );
+	stFlightDetails.stAttitudeRate.x = FIXMATH_ToFloat( stGyroQ.x );
+	stFlightDetails.stAttitudeRate.y = FIXMATH_ToFloat( stGyroQ.y );
+	stFlightDetails.stAttitudeRate.z = FIXMATH_ToFloat( stGyroQ.z );
+	stFlightDetails.uiFusionCycles = FLIGHT_GetFusionCyclesQ( &stFlight );
+#else
+	FLIGHT_GetRotation( &stFlight, &stFlightDetails.stAttitude );
+	stFlightDetails.stAttitudeRate = stGyro;
+	stFlightDetails.uiFusionCycles = FLIGHT_GetFusionCycles( &stFlight );
+#endif
+
+	for ( iStage = 0; iStage < FLIGHT_STAGE_NUM; iStage++ )
+	{
+		stFlightDetails.auiStageOverrunCount[ iStage ] =
+			(uint16_t)EXECUTIVE_GetStage( &stExecutive, iStage )->uiOverrunCount;
+	}
+
+	i2c_get_stats( 0, &stI2CStats );
+	stFlightDetails.uiI2CErrorCount = (uint16_t)( stI2CStats.errors + stI2CStats.timeouts );
+	PUBSUB_Publish( TOPIC_FLIGHT_DETAILS, &stFlightDetails );
+
+	if ( TIMING_WINDOW_RUNS <= ++uiTelemetryRuns )
+	{
+		uiTelemetryRuns = 0;
+		PublishTiming();
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void PublishTiming( void )
+{
+	int iStage;
+
+	// This run of the telemetry stage goes into the next window, the
+	// executive only adds it once it returns
+	for ( iStage = 0; iStage < FLIGHT_STAGE_NUM; iStage++ )
+	{
+		EXECUTIVE_TakeCycleStats( &stExecutive, iStage, &stFlightTiming.astStage[ iStage ] );
+	}
+
+	CYCLESTATS_Summarise( &stSensorReadCycles, &stFlightTiming.stSensorRead );
+	CYCLESTATS_Summarise( &stFusionCycles, &stFlightTiming.stFusion );
+	stFlightTiming.uiWindow++;
+
+	PUBSUB_Publish( TOPIC_FLIGHT_TIMING, &stFlightTiming );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void SlowStage( void *const pvUserState, const uint32_t uiTimestep_us )
+{
+	int16_t aiMag[ 1 ][ 3 ];
+#ifdef CFG_FIXED_POINT
+	vector3f_t stGyroBias;
+#endif
+
+	if ( bSensorReadOk )
+	{
+		// The mag's output registers are laid out as one FIFO sample
+		stImu.temperature = LSM9DS0_unpackTemp( auiTempRaw );
+		LSM9DS0_unpackFifo( auiMagRaw, 1, aiMag );
+		stImu.mx = aiMag[0][0];
+		stImu.my = aiMag[0][1];
+		stImu.mz = aiMag[0][2];
+	}
+
+#ifdef CFG_FIXED_POINT
+	// The bias table is in float deg/sec, only look it up again when the
+	// temperature moves
+	if ( iGyroBiasTempQ != stImu.temperature )
 	{
-		stTrim.y = pstTrimPitch->fValue;
+		iGyroBiasTempQ = stImu.temperature;
+		stGyroBias = GetBias( stImu.temperature );
+		stGyroBiasQ.x = FIXMATH_FromFloat( stGyroBias.x * DEG2RAD );
+		stGyroBiasQ.y = FIXMATH_FromFloat( stGyroBias.y * DEG2RAD );
+		stGyroBiasQ.z = FIXMATH_FromFloat( stGyroBias.z * DEG2RAD );
 	}
+#else
+	stGyroBias = GetBias( stImu.temperature );
+
+	stMag.x = LSM9DS0_calcMag( &stImu, stImu.mx );
+	stMag.y = LSM9DS0_calcMag( &stImu, stImu.my );
+	stMag.z = LSM9DS0_calcMag( &stImu, stImu.mz );
+#endif
 
-	if ( pstTrimYaw )
+	// Collects trim and PID gain updates from the parameters and passes
+	// them into the flight controller if they have updated
+	UpdateParameters();
+
+	return;
+}
+
+/* ************************************************************************** */
+static void UpdateParameters( void )
+{
+	float afTrim[ 3 ] = { 0, };
+	float afGains[ 3 ] = { 0, };
+	vector3f_t stTrim;
+	uint32_t uiGeneration = PARAM_GetGeneration();
+
+	// Nothing has changed since the last time, the usual case. Anything set
+	// after this read is newer than uiGeneration and is picked up next time.
+	if ( uiGeneration == uiParamGeneration )
 	{
-		stTrim.y = pstTrimPitch->fValue;
+		return;
 	}
 
 	// Set the trim in the flight controller
-	FLIGHT_SetTrim( &stTrim );
+	if ( PARAM_GroupChangedSince( apstTrim, mArrayLen( apstTrim ), uiParamGeneration ) )
+	{
+		PARAM_ReadGroup( apstTrim, afTrim, mArrayLen( apstTrim ) );
+		stTrim.x = afTrim[0];
+		stTrim.y = afTrim[1];
+		stTrim.z = afTrim[2];
+		FLIGHT_SetTrim( &stFlight, &stTrim );
+	}
 
 	// Update the PID gains of the flight controller (the ones that matter!)
-	FLIGHT_SetPidGains( pstPidGainRateP->fValue, pstPidGainRateD->fValue, pstPidGainAngleP->fValue );
+	if ( PARAM_GroupChangedSince( apstPidGains, mArrayLen( apstPidGains ), uiParamGeneration ) )
+	{
+		PARAM_ReadGroup( apstPidGains, afGains, mArrayLen( apstPidGains ) );
+		FLIGHT_SetPidGains( &stFlight, afGains[0], afGains[1], afGains[2] );
+	}
+
+	// Switch sensor fusion if it has been changed, a value that isn't one of
+	// the filters is put back to the one running
+	if ( PARAM_ChangedSince( PARAM_Handle( PARAM_FUSION_FILTER ), uiParamGeneration )
+		 && ( FLIGHT_GetFusionStrategy( &stFlight ) != PARAM_Get( PARAM_FUSION_FILTER ) ) )
+	{
+		FLIGHT_SetFusionStrategy( &stFlight, (eSENSORFUSION_Strategy_t)PARAM_Get( PARAM_FUSION_FILTER ) );
+		PARAM_Set( PARAM_Handle( PARAM_FUSION_FILTER ), (float)FLIGHT_GetFusionStrategy( &stFlight ) );
+	}
+
+	uiParamGeneration = uiGeneration;
+
+	return;
+}
+
+/* ************************************************************************** */
+static uint32_t GetTimestep_us( const uint8_t uiGyroCount )
+{
+	uint32_t uiSample_us = uiWatermark_us;
+	uint32_t uiTimestep_us;
+
+	// The edge is when the watermark'th sample landed, any after it were
+	// queued while the fifo was being read
+	if ( 0 != uiGyroCount )
+	{
+		uiSample_us += (uint32_t)( ( (int32_t)uiGyroCount - GYRO_FIFO_WATERMARK ) * (int32_t)GYRO_SAMPLE_PERIOD_US );
+	}
+
+	// Nothing to measure against on the first loop. After that a stalled
+	// sensor shouldn't integrate a huge step, nor a late edge a zero or
+	// negative one, no two samples are closer than the gyro's period.
+	uiTimestep_us = bLastSample ? FLIGHT_BoundTimestep_us( uiSample_us, uiLastSample_us,
+														   GYRO_SAMPLE_PERIOD_US, FLIGHT_TIMESTEP_MAX_US )
+								: FLIGHT_TICK_US;
+	uiLastSample_us = uiSample_us;
+	bLastSample = true;
+
+	return uiTimestep_us;
+}
+
+/* ************************************************************************** */
+static void DataReadyHandler( void *const pvUserState )
+{
+	// The watermark'th gyro sample has just landed. If a read is still going
+	// the next one starts later, from DRDY_Complete, and keeps this time.
+	uiEdge_us = TIMEBASE_Now_us();
+	bEdge = true;
+
+	DRDY_Signal( (stDRDY_Ctx_t*)pvUserState );
 
 	return;
 }
 
 /* ************************************************************************** */
-static void TimerHandler( TimerHandle_t xTimer )
+static bool DataReadyLevel( void *const pvUserState )
+{
+	return IODRIVER_GyroDataReady();
+}
+
+/* ************************************************************************** */
+static void WakeFromISR( void *const pvUserState )
 {
-	if ( bDone == false )
+	// When the watermark'th gyro sample landed. Only an edge says so. A read
+	// started without one, on the level or to get going again, is taken to
+	// have had its samples land at the gyro's rate after the last read's.
+	if ( bEdge )
+	{
+		uiWatermark_us = uiEdge_us;
+		bEdge = false;
+	}
+	else if ( bLastSample )
 	{
-		stFlightDetails.uiFlightTaskMissed++;
+		uiWatermark_us = uiLastSample_us + ( GYRO_FIFO_WATERMARK * GYRO_SAMPLE_PERIOD_US );
 	}
 	else
 	{
-		vTaskResume( xFlightTaskHandle );
+		uiWatermark_us = TIMEBASE_Now_us();
+	}
+
+	uiReadStartCycles = CYCLES_Now();
+
+	// Read every sensor register the loop needs from the I2C interrupt, the
+	// flight task is only woken once it is all in memory
+	if ( 0 != i2c_send_jobs( 0, astSensorJobs, mArrayLen( astSensorJobs ), SensorReadDoneFromISR, NULL ) )
+	{
+		// Bus busy, run the loop without new samples rather than stall it.
+		// The channel isn't available so this reports the read as failed.
+		SensorReadDoneFromISR( NULL );
+	}
+
+	return;
+}
+
+/* ************************************************************************** */
+static void SensorReadDoneFromISR( void *pvUserState )
+{
+	BaseType_t xHigherPriorityTaskWoken = pdFALSE;
+
+	bSensorReadOk = ( I2C_AVAILABLE == i2c_channels[0].status );
+	uiSensorReadCycles = CYCLES_Now() - uiReadStartCycles;
+
+	vTaskNotifyGiveFromISR( xFlightTaskHandle, &xHigherPriorityTaskWoken );
+	portYIELD_FROM_ISR( xHigherPriorityTaskWoken );
+
+	return;
+}
+
+/* ************************************************************************** */
+static void FifoCountDoneFromISR( I2C_Job *pstJob )
+{
+	I2C_Job *pstDataJob = (I2C_Job*)pstJob->user_data;
+	uint8_t uiCount = LSM9DS0_fifoLevel( pstJob->received_data[0], LSM9DS0_FIFO_DEPTH );
+
+	// Read exactly what is queued, or skip the data read if nothing is
+	pstDataJob->sequence_length = ( 0 == uiCount ) ? 0 : ( SENSOR_SEQ_HEADER_LEN + ( uiCount * 6 ) );
+
+	return;
+}
+
+/* ************************************************************************** */
+static uint8_t FifoSamplesRead( const I2C_Job *pstJob )
+{
+	if ( 0 == pstJob->sequence_length )
+	{
+		return 0;
+	}
+
+	return (uint8_t)( ( pstJob->sequence_length - SENSOR_SEQ_HEADER_LEN ) / 6 );
+}
+
+/* ************************************************************************** */
+static uint32_t FillReadSequence( uint16_t *puiSequence, uint8_t uiAddress, uint8_t uiSubAddress, uint16_t uiCount )
+{
+	uint16_t uiIndex;
+
+	// Addressed as the driver's own burst reads are
+	puiSequence[0] = ( uiAddress << 1 ) | I2C_WRITING;
+	puiSequence[1] = LSM9DS0_i2cBurstAddress( uiSubAddress );
+	puiSequence[2] = I2C_RESTART;
+	puiSequence[3] = ( uiAddress << 1 ) | I2C_READING;
+
+	for ( uiIndex = 0; uiIndex < uiCount; uiIndex++ )
+	{
+		puiSequence[ SENSOR_SEQ_HEADER_LEN + uiIndex ] = I2C_READ;
 	}
 
+	return SENSOR_SEQ_HEADER_LEN + uiCount;
+}
+
+/* ************************************************************************** */
+static void SetupSensorJobs( void )
+{
+	I2C_Job *pstJob;
+
+	memset( astSensorJobs, 0, sizeof( astSensorJobs ) );
+
+	// Gyro FIFO level, which sizes the gyro data read that follows
+	pstJob = &astSensorJobs[ SENSOR_JOB_GYRO_COUNT ];
+	pstJob->sequence = auiGyroCountSeq;
+	pstJob->sequence_length = FillReadSequence( auiGyroCountSeq, LSM9DS0_G, FIFO_SRC_REG_G, 1 );
+	pstJob->received_data = &uiGyroFifoSrc;
+	pstJob->done_fn = FifoCountDoneFromISR;
+	pstJob->user_data = &astSensorJobs[ SENSOR_JOB_GYRO_DATA ];
+
+	// Gyro FIFO data, the sequence holds a full FIFO's worth of reads
+	pstJob = &astSensorJobs[ SENSOR_JOB_GYRO_DATA ];
+	pstJob->sequence = auiGyroDataSeq;
+	pstJob->sequence_length = FillReadSequence( auiGyroDataSeq, LSM9DS0_G, OUT_X_L_G, SENSOR_FIFO_BYTES );
+	pstJob->received_data = auiGyroFifoRaw;
+
+	// Accel FIFO level and data, as above
+	pstJob = &astSensorJobs[ SENSOR_JOB_ACCEL_COUNT ];
+	pstJob->sequence = auiAccelCountSeq;
+	pstJob->sequence_length = FillReadSequence( auiAccelCountSeq, LSM9DS0_XM, FIFO_SRC_REG, 1 );
+	pstJob->received_data = &uiAccelFifoSrc;
+	pstJob->done_fn = FifoCountDoneFromISR;
+	pstJob->user_data = &astSensorJobs[ SENSOR_JOB_ACCEL_DATA ];
+
+	pstJob = &astSensorJobs[ SENSOR_JOB_ACCEL_DATA ];
+	pstJob->sequence = auiAccelDataSeq;
+	pstJob->sequence_length = FillReadSequence( auiAccelDataSeq, LSM9DS0_XM, OUT_X_L_A, SENSOR_FIFO_BYTES );
+	pstJob->received_data = auiAccelFifoRaw;
+
+	// Temperature for the gyro bias lookup
+	pstJob = &astSensorJobs[ SENSOR_JOB_TEMP ];
+	pstJob->sequence = auiTempSeq;
+	pstJob->sequence_length = FillReadSequence( auiTempSeq, LSM9DS0_XM, OUT_TEMP_L_XM, 2 );
+	pstJob->received_data = auiTempRaw;
+
+	// Magnetometer output, laid out as one FIFO sample
+	pstJob = &astSensorJobs[ SENSOR_JOB_MAG ];
+	pstJob->sequence = auiMagSeq;
+	pstJob->sequence_length = FillReadSequence( auiMagSeq, LSM9DS0_XM, OUT_X_L_M, 6 );
+	pstJob->received_data = auiMagRaw;
+
+	bSensorReadOk = false;
+
+	return;
+}
+
+/* ************************************************************************** */
+static void SelectSensorJobs( void )
+{
+	bool bAccel = EXECUTIVE_IsDueNext( &stExecutive, FLIGHT_STAGE_ANGLE );
+	bool bSlow = EXECUTIVE_IsDueNext( &stExecutive, FLIGHT_STAGE_SLOW );
+
+	// A zero length job is skipped. The FIFO data jobs are sized by their
+	// count jobs as the read goes, a skipped count leaves its data skipped too
+	// and the stage reads that as no samples.
+	astSensorJobs[ SENSOR_JOB_ACCEL_COUNT ].sequence_length = bAccel ? ( SENSOR_SEQ_HEADER_LEN + 1 ) : 0;
+	astSensorJobs[ SENSOR_JOB_ACCEL_DATA ].sequence_length = 0;
+	astSensorJobs[ SENSOR_JOB_TEMP ].sequence_length = bSlow ? ( SENSOR_SEQ_HEADER_LEN + 2 ) : 0;
+	astSensorJobs[ SENSOR_JOB_MAG ].sequence_length = bSlow ? ( SENSOR_SEQ_HEADER_LEN + 6 ) : 0;
+
 	return;
 }
 
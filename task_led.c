@@ -19,6 +19,7 @@
 #include "IPC_types.h"		// stLedPattern_t
 #include "ledstat.h"		// Led status controller
 #include "pubsub.h"			// Publish subscribe
+#include "paramstore.h"		// Parameters kept in flash
 
 /* ************************************************************************** **
  * Macros and Defines
@@ -113,6 +114,9 @@ static void TaskHandler( void *arg )
 
 		LEDSTAT_Process( &stLedStat, TASK_TICK_MS );
 
+		// The lowest priority task, so flash writes never hold up the others
+		PARAMSTORE_Process( TASK_TICK_MS );
+
 		// Suspend ourselves until some nice person resumes us...
 		vTaskSuspend( NULL );
 	}
@@ -131,18 +135,7 @@ static void TimerHandler( TimerHandle_t xTimer )
 /* ************************************************************************** */
 static void SetLed( void *const pvUserState, const bool bState )
 {
-	// FIXME Should not be accessing registers directly from within a task,
-	// access should be wrapped in an LDD!
-	if ( true == bState )
-	{
-		// Set LED
-		GPIOC_PSOR = ( 1 << 5 );
-	}
-	else
-	{
-		// Clear LED
-		GPIOC_PCOR = ( 1 << 5 );
-	}
+	IODRIVER_SetLed( bState );
 
 	return;
 }
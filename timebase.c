@@ -0,0 +1,50 @@
+/**
+ * Microsecond clock on the DWT cycle counter, see timebase.h.
+ */
+#include "timebase.h"
+
+#include <stdint.h>			// std types
+
+#include "cycles.h"			// DWT cycle counter
+
+static uint32_t uiCyclesPerUs;
+static uint32_t uiLastCycles;
+static uint32_t uiCarryCycles;
+static uint32_t uiNow_us;
+
+/* ************************************************************************** */
+void TIMEBASE_Setup( void )
+{
+	CYCLES_Setup();
+
+	uiCyclesPerUs = CYCLES_PerUs();
+	uiLastCycles = CYCLES_Now();
+	uiCarryCycles = 0;
+	uiNow_us = 0;
+
+	return;
+}
+
+/* ************************************************************************** */
+uint32_t TIMEBASE_Now_us( void )
+{
+	uint32_t uiPrimask;
+	uint32_t uiCycles;
+	uint32_t uiResult;
+
+	// Read and advance as one, an interrupt reading the clock in between
+	// would count the same cycles twice
+	__asm__ volatile ( "mrs %0, primask\n\tcpsid i" : "=r" ( uiPrimask ) : : "memory" );
+
+	uiCycles = CYCLES_Now();
+	uiCarryCycles += uiCycles - uiLastCycles;
+	uiLastCycles = uiCycles;
+
+	uiNow_us += uiCarryCycles / uiCyclesPerUs;
+	uiCarryCycles %= uiCyclesPerUs;
+	uiResult = uiNow_us;
+
+	__asm__ volatile ( "msr primask, %0" : : "r" ( uiPrimask ) : "memory" );
+
+	return uiResult;
+}
@@ -0,0 +1,33 @@
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#include <stdint.h>			// std types
+
+/*
+ * Monotonic microsecond clock, for timestamping sensor reads so the flight
+ * controller integrates over the time that really passed rather than the
+ * nominal loop period.
+ *
+ * On the K20 it is the DWT cycle counter (cycles.h) divided down by the core
+ * clock, the cycles left over are carried to the next read so no time is
+ * lost. The counter wraps about once a minute, so the clock must be read at
+ * least that often to notice, the flight task reads it every loop. Safe to
+ * call from interrupts.
+ *
+ * host/timebase.c stands in for the host builds, on CLOCK_MONOTONIC.
+ *
+ * The count itself wraps after 71 minutes, differences of two reads (as
+ * uint32_t) are good across that.
+ */
+
+/**
+ * @brief		Starts the clock at zero, call once the core clock is set.
+ */
+void TIMEBASE_Setup( void );
+
+/**
+ * @brief		Microseconds since TIMEBASE_Setup, modulo 2^32.
+ */
+uint32_t TIMEBASE_Now_us( void );
+
+#endif
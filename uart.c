@@ -7,21 +7,31 @@
 
 #include "uart.h"
 #include "common.h"
+#include "ringbuf.h"
 #include <string.h>
 
-#define LEN_RX_BUF		( 1024 )
+#define LEN_RX_BUF		( 1024 )	// Must be a power of two
+#define LEN_TX_BUF		( 1024 )	// Must be a power of two
 
-char achReceiveBuffer[ LEN_RX_BUF ];
-size_t uiHead;
-size_t uiTail;
+// Filled by the receive interrupt, drained by a single reader task
+static uint8_t abyReceiveBuffer[ LEN_RX_BUF ];
+static stRINGBUF_Ctx_t stRxRing;
+
+// Filled by any task through uart_write, drained by the transmit interrupt
+static uint8_t abyTransmitBuffer[ LEN_TX_BUF ];
+static stRINGBUF_Ctx_t stTxRing;
+static eUartTxOverflow_t eTxOverflow;
+static stUartStats_t stStats;
 
 void uart_init( const UART_MemMapPtr channel, const uint32_t baud )
 {
 	register uint16_t ubd, brfa;
 	uint8_t temp;
 
-	uiHead = 0;
-	uiTail = 0;
+	RINGBUF_Create( &stRxRing, abyReceiveBuffer, LEN_RX_BUF );
+	RINGBUF_Create( &stTxRing, abyTransmitBuffer, LEN_TX_BUF );
+	eTxOverflow = UART_TX_OVERFLOW_DROP;
+	memset( &stStats, 0, sizeof( stStats ) );
 
 	// Initialise serial port pins
 	PORTB_PCR16 = PORT_PCR_MUX( 0x3 );
@@ -54,10 +64,14 @@ void uart_init( const UART_MemMapPtr channel, const uint32_t baud )
 	temp = UART_C4_REG( channel ) & ~( UART_C4_BRFA( 0x1F ) );
 	UART_C4_REG( channel ) = temp | UART_C4_BRFA( brfa );
 
-	/* Enable receiver and transmitter */
+	/* Enable receiver and transmitter, the transmit interrupt (TIE) is only
+	 * turned on while there is something in the tx ring.
+	 */
 	UART_C2_REG( channel ) |= ( UART_C2_TE_MASK | UART_C2_RE_MASK | UART_C2_RIE_MASK );
 
-	// Enable interrupt in NVIC and set priority to 0 */
+	// Enable interrupt in NVIC and set priority to 0. This is above
+	// configMAX_SYSCALL_INTERRUPT_PRIORITY so output keeps draining inside
+	// FreeRTOS critical sections, but means the ISR must not call FreeRTOS.
 	NVICICPR1 |= ( 1 << 13 );
 	NVICISER1 |= ( 1 << 13 );
 	NVICIP45 = 0x00;
@@ -65,16 +79,44 @@ void uart_init( const UART_MemMapPtr channel, const uint32_t baud )
 
 void UART0_RX_TX_IRQHandler( void )
 {
-	while ( UART_S1_REG( UART0_BASE_PTR ) & UART_S1_RDRF_MASK )
+	uint8_t byData;
+	uint8_t byStatus;
+
+	while ( ( byStatus = UART_S1_REG( UART0_BASE_PTR ) ) & UART_S1_RDRF_MASK )
 	{
-		achReceiveBuffer[uiHead++] = UART_D_REG( UART0_BASE_PTR );
-		uiHead %= LEN_RX_BUF;
+		// Reading S1 then D clears RDRF, and OR if the receiver overran
+		byData = UART_D_REG( UART0_BASE_PTR );
 
-		// Move the tail on if we have caught up with it
-		if ( uiHead == uiTail )
+		if ( byStatus & UART_S1_OR_MASK )
+		{
+			stStats.uiRxOverrun++;
+		}
+
+		// Keep what we already have if the reader has fallen behind, it is
+		// easier to resync on a protocol after a gap than a splice
+		if ( 1 == RINGBUF_Write( &stRxRing, &byData, 1 ) )
+		{
+			stStats.uiRxBytes++;
+		}
+		else
 		{
-			uiTail++;
-			uiTail %= LEN_RX_BUF;
+			stStats.uiRxDropped++;
+		}
+	}
+
+	// Keep the transmitter fed, reading S1 then writing D clears TDRE
+	if ( UART_C2_REG( UART0_BASE_PTR ) & UART_C2_TIE_MASK )
+	{
+		while ( UART_S1_REG( UART0_BASE_PTR ) & UART_S1_TDRE_MASK )
+		{
+			if ( 0 == RINGBUF_Read( &stTxRing, &byData, 1 ) )
+			{
+				// All sent, stop TDRE interrupting until there is more
+				UART_C2_REG( UART0_BASE_PTR ) &= ~UART_C2_TIE_MASK;
+				break;
+			}
+
+			UART_D_REG( UART0_BASE_PTR ) = byData;
 		}
 	}
 }
@@ -90,23 +132,14 @@ char uart_getchar( const UART_MemMapPtr channel )
 
 int uart_getchar_nonblock( const UART_MemMapPtr channel )
 {
-	char cRetVal;
+	uint8_t byData;
 
-	if ( uiHead == uiTail )
+	if ( 0 == RINGBUF_Read( &stRxRing, &byData, 1 ) )
 	{
 		return -1;
 	}
-	else
-	{
-		DisableInterrupts;
 
-		cRetVal = achReceiveBuffer[ uiTail++ ];
-		uiTail %= LEN_RX_BUF;
-
-		EnableInterrupts;
-
-		return cRetVal;
-	}
+	return byData;
 
 #if 0
 	/* Wait until character has been received */
@@ -122,21 +155,75 @@ int uart_getchar_nonblock( const UART_MemMapPtr channel )
 #endif
 }
 
-void uart_putchar( const UART_MemMapPtr channel, const char ch )
+size_t uart_read( const UART_MemMapPtr channel, void *const pvData, const size_t sMax )
 {
-	/* Wait until space is available in the FIFO */
-	while(!(UART_S1_REG(channel) & UART_S1_TDRE_MASK));
-
-	/* Send the character */
-	UART_D_REG(channel) = (uint8_t)ch;
+	// The ISR is the only producer and there is only one reader, no locking
+	return RINGBUF_Read( &stRxRing, (uint8_t*)pvData, sMax );
 }
 
-void uart_puts( UART_MemMapPtr channel, const char *const s )
+size_t uart_write( const UART_MemMapPtr channel, const void *const pvData, const size_t sLen )
 {
-	int i;
+	const uint8_t *pbyData = (const uint8_t*)pvData;
+	size_t sQueued = 0;
+	uint32_t uiCount;
+	uint32_t uiUsed;
 
-	for ( i = 0; i < strlen( s ); i++ )
+	for ( ; ; )
 	{
-		uart_putchar( channel, s[i] );
+		// Any task may write so the producer side is serialised, this is only
+		// held for the copy. The ISR is the only consumer.
+		DisableInterrupts;
+
+		uiCount = RINGBUF_Write( &stTxRing, pbyData + sQueued, sLen - sQueued );
+		sQueued += uiCount;
+		stStats.uiTxBytes += uiCount;
+
+		uiUsed = RINGBUF_Used( &stTxRing );
+		if ( uiUsed > stStats.uiTxHighWater )
+		{
+			stStats.uiTxHighWater = uiUsed;
+		}
+
+		if ( ( sQueued < sLen ) && ( UART_TX_OVERFLOW_DROP == eTxOverflow ) )
+		{
+			stStats.uiTxDropped += sLen - sQueued;
+		}
+
+		// Have the transmit interrupt drain what we've added
+		UART_C2_REG( channel ) |= UART_C2_TIE_MASK;
+
+		EnableInterrupts;
+
+		if ( ( sQueued == sLen ) || ( UART_TX_OVERFLOW_DROP == eTxOverflow ) )
+		{
+			break;
+		}
+
+		// Wait for the interrupt to make some room
+		while ( 0 == RINGBUF_Free( &stTxRing ) );
 	}
+
+	return sQueued;
+}
+
+void uart_set_tx_overflow( const UART_MemMapPtr channel, const eUartTxOverflow_t eOverflow )
+{
+	eTxOverflow = eOverflow;
+}
+
+void uart_get_stats( const UART_MemMapPtr channel, stUartStats_t *const pstStats )
+{
+	DisableInterrupts;
+	*pstStats = stStats;
+	EnableInterrupts;
+}
+
+void uart_putchar( const UART_MemMapPtr channel, const char ch )
+{
+	uart_write( channel, &ch, 1 );
+}
+
+void uart_puts( UART_MemMapPtr channel, const char *const s )
+{
+	uart_write( channel, s, strlen( s ) );
 }
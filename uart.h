@@ -13,6 +13,26 @@
 #define __UART_H__
 
 #include "common.h"
+#include <stddef.h>
+
+/* What uart_write() does when the transmit ring is full */
+typedef enum
+{
+	UART_TX_OVERFLOW_DROP,		/* Queue what fits and drop the rest, never blocks */
+	UART_TX_OVERFLOW_WAIT,		/* Spin until the interrupt has made room for everything */
+
+} eUartTxOverflow_t;
+
+typedef struct
+{
+	uint32_t uiTxBytes;			/* Bytes queued for transmission */
+	uint32_t uiTxDropped;		/* Bytes thrown away because the ring was full */
+	uint32_t uiTxHighWater;		/* Most bytes ever waiting in the ring */
+	uint32_t uiRxBytes;			/* Bytes received into the rx ring */
+	uint32_t uiRxDropped;		/* Bytes thrown away because the rx ring was full */
+	uint32_t uiRxOverrun;		/* Times the hardware receiver overran before the ISR ran */
+
+} stUartStats_t;
 
 /*
  *  These routines support access to all UARTs on the Teensy 3.x (K20).
@@ -40,6 +60,16 @@ void uart_init( const UART_MemMapPtr channel, const uint32_t baud );
  */
 char uart_getchar( const UART_MemMapPtr channel );
 
+/**
+ * @brief		Read everything waiting in the rx ring, up to sMax bytes. This
+ * 				never blocks or masks interrupts, but only one task may read.
+ * @param[in]	channel		UART module's base register pointer.
+ * @param[out]	pvData		Where to put the received data.
+ * @param[in]	sMax		Size of pvData.
+ * @return		Number of bytes read, 0 if nothing was waiting.
+ */
+size_t uart_read( const UART_MemMapPtr channel, void *const pvData, const size_t sMax );
+
 /**
  * @brief		Get a character from the buffer - non blocking.
  * @param[in]	channel		UART module's base register pointer.
@@ -47,6 +77,32 @@ char uart_getchar( const UART_MemMapPtr channel );
  */
 int uart_getchar_nonblock( const UART_MemMapPtr channel );
 
+/**
+ * @brief		Queue data in the tx ring, it is sent from the transmit
+ * 				interrupt so this returns as soon as the data is copied.
+ * @param[in]	channel		UART module's base register pointer.
+ * @param[in]	pvData		Data to send.
+ * @param[in]	sLen		Number of bytes to send.
+ * @return		Number of bytes queued, less than sLen only if the ring was
+ * 				full and the overflow policy is UART_TX_OVERFLOW_DROP.
+ */
+size_t uart_write( const UART_MemMapPtr channel, const void *const pvData, const size_t sLen );
+
+/**
+ * @brief		Sets what uart_write does when the tx ring is full. The
+ * 				default is UART_TX_OVERFLOW_DROP.
+ * @param[in]	channel		UART module's base register pointer.
+ * @param[in]	eOverflow	The new overflow policy.
+ */
+void uart_set_tx_overflow( const UART_MemMapPtr channel, const eUartTxOverflow_t eOverflow );
+
+/**
+ * @brief		Get a snapshot of the UART statistics.
+ * @param[in]	channel		UART module's base register pointer.
+ * @param[out]	pstStats	Filled in with the current statistics.
+ */
+void uart_get_stats( const UART_MemMapPtr channel, stUartStats_t *const pstStats );
+
 /**
  * @brief		Put a character into the tx buffer.
  * @param[in]	channel		UART module's base register pointer.